@@ -0,0 +1,123 @@
+#include "bench.h"
+
+#include <core/math/bbox_batch.h>
+#include <core/math/math_includes.h>
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace
+{
+const std::size_t count = 100000;
+const std::size_t runs = 20;
+const float world_size = 2000.0f;
+
+// The batch path computes the box from center and extents, bbox::mul from
+// the corners, so the two may differ by rounding.
+bool nearly_equal(float a, float b)
+{
+	return std::abs(a - b) <= 1e-3f * (1.0f + std::abs(a) + std::abs(b));
+}
+
+bool same_box(const math::bbox& a, const math::bbox& b)
+{
+	return nearly_equal(a.min.x, b.min.x) && nearly_equal(a.min.y, b.min.y) &&
+		   nearly_equal(a.min.z, b.min.z) && nearly_equal(a.max.x, b.max.x) &&
+		   nearly_equal(a.max.y, b.max.y) && nearly_equal(a.max.z, b.max.z);
+}
+}
+
+int main()
+{
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> position(-world_size * 0.5f, world_size * 0.5f);
+	std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 4.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	// Rotated and scaled instances so the extents of every axis mix.
+	std::vector<math::bbox> local(count);
+	std::vector<math::transform> world(count);
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		const float e = extent(rng);
+		local[i] = math::bbox(-e, -e * 0.5f, -e, e, e * 2.0f, e);
+		world[i].set_scale({scale(rng), scale(rng), scale(rng)});
+		world[i].rotate(angle(rng), angle(rng), angle(rng));
+		world[i].set_position({position(rng), position(rng) * 0.01f, position(rng)});
+	}
+
+	const math::vec3 eye(0.0f, 10.0f, 0.0f);
+	const math::vec3 up(0.0f, 1.0f, 0.0f);
+	const math::transform view = math::lookAt(eye, eye + math::vec3(1.0f, -0.1f, 0.3f), up);
+	const math::transform proj = math::perspectiveNO(math::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	const math::frustum f(view, proj, true);
+
+	std::vector<math::bbox> scalar_bounds(count);
+	bench::report("bbox::mul per instance", bench::measure_ms(runs, [&]() {
+					  for(std::size_t i = 0; i < count; ++i)
+					  {
+						  scalar_bounds[i] = math::bbox::mul(local[i], world[i]);
+					  }
+				  }),
+				  count);
+
+	math::bbox_soa batch_bounds;
+	bench::report("transform_bounds batch", bench::measure_ms(runs, [&]() {
+					  math::transform_bounds(local.data(), world.data(), count, batch_bounds);
+				  }),
+				  count);
+
+	std::vector<bool> scalar_visible(count);
+	bench::report("frustum::test_aabb per instance", bench::measure_ms(runs, [&]() {
+					  for(std::size_t i = 0; i < count; ++i)
+					  {
+						  scalar_visible[i] = f.test_aabb(batch_bounds.get(i));
+					  }
+				  }),
+				  count);
+
+	std::vector<std::uint64_t> batch_visible;
+	bench::report("test_bounds batch", bench::measure_ms(runs, [&]() {
+					  math::test_bounds(f, batch_bounds, batch_visible);
+				  }),
+				  count);
+
+	// The batch results have to match the functions they replace.
+	std::size_t box_mismatches = 0;
+	std::size_t visibility_mismatches = 0;
+	std::size_t visible = 0;
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		box_mismatches += same_box(scalar_bounds[i], batch_bounds.get(i)) ? 0 : 1;
+		visibility_mismatches += scalar_visible[i] == math::is_visible(batch_visible, i) ? 0 : 1;
+		visible += scalar_visible[i] ? 1 : 0;
+	}
+	std::printf("%zu of %zu boxes visible\n", visible, count);
+
+	bool ok = bench::check(box_mismatches == 0, "transform_bounds matches bbox::mul");
+	ok &= bench::check(visibility_mismatches == 0, "test_bounds matches frustum::test_aabb");
+	ok &= bench::check(visible > 0 && visible < count, "the frustum sees part of the scene");
+
+	// A count which is not a multiple of the simd width uses the scalar tail.
+	const std::size_t tail_count = 7;
+	math::bbox_soa tail_bounds;
+	std::vector<std::uint64_t> tail_visible;
+	math::transform_bounds(local.data(), world.data(), tail_count, tail_bounds);
+	math::test_bounds(f, tail_bounds, tail_visible);
+	ok &= bench::check(tail_bounds.size() == tail_count && tail_visible.size() == 1, "tail output sizes");
+	for(std::size_t i = 0; i < tail_count; ++i)
+	{
+		ok &= bench::check(same_box(scalar_bounds[i], tail_bounds.get(i)), "tail boxes match bbox::mul");
+		ok &= bench::check(scalar_visible[i] == math::is_visible(tail_visible, i), "tail visibility matches");
+	}
+
+	// Nothing to test still gives an empty mask.
+	math::bbox_soa empty;
+	math::test_bounds(f, empty, tail_visible);
+	ok &= bench::check(tail_visible.empty(), "empty input gives an empty mask");
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+namespace bench
+{
+//-----------------------------------------------------------------------------
+//  Name : measure_ms ()
+/// <summary>
+/// Runs f the given number of times and returns the fastest run in
+/// milliseconds. The fastest run is the least disturbed by the rest of the
+/// machine.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename F>
+double measure_ms(std::size_t runs, F&& f)
+{
+	std::vector<double> times;
+	times.reserve(runs);
+	for(std::size_t i = 0; i < runs; ++i)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		const auto end = std::chrono::steady_clock::now();
+		times.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return *std::min_element(std::begin(times), std::end(times));
+}
+
+//-----------------------------------------------------------------------------
+//  Name : report ()
+/// <summary>
+/// Prints one result line with the time per item in nanoseconds.
+/// </summary>
+//-----------------------------------------------------------------------------
+inline void report(const char* name, double ms, std::size_t items)
+{
+	const double ns_per_item = items > 0 ? ms * 1000000.0 / static_cast<double>(items) : 0.0;
+	std::printf("%-48s %10.3f ms %10.2f ns/item\n", name, ms, ns_per_item);
+}
+
+//-----------------------------------------------------------------------------
+//  Name : check ()
+/// <summary>
+/// Prints a failed expectation. Returns the expectation so that tests can
+/// count failures.
+/// </summary>
+//-----------------------------------------------------------------------------
+inline bool check(bool expectation, const char* what)
+{
+	if(!expectation)
+	{
+		std::printf("FAILED: %s\n", what);
+	}
+	return expectation;
+}
+}
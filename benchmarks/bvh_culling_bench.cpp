@@ -0,0 +1,154 @@
+#include "bench.h"
+
+#include <core/math/math_includes.h>
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace
+{
+const float world_size = 2000.0f;
+const std::size_t frames_per_path = 32;
+
+struct scene
+{
+	std::vector<math::bbox> local_bounds;
+	std::vector<math::transform> world;
+	math::dynamic_bvh bvh;
+	std::vector<std::uint32_t> proxies;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : make_scene ()
+/// <summary>
+/// Scatters instances over a level sized ground plane, the way props and
+/// buildings are laid out.
+/// </summary>
+//-----------------------------------------------------------------------------
+void make_scene(scene& s, std::size_t count)
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(-world_size * 0.5f, world_size * 0.5f);
+	std::uniform_real_distribution<float> height(0.0f, 20.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 4.0f);
+
+	s.local_bounds.resize(count);
+	s.world.resize(count);
+	s.proxies.resize(count);
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		const float e = extent(rng);
+		s.local_bounds[i] = math::bbox(-e, -e, -e, e, e, e);
+		s.world[i].set_position({position(rng), height(rng), position(rng)});
+		s.proxies[i] = s.bvh.insert(math::bbox::mul(s.local_bounds[i], s.world[i]), i);
+	}
+}
+
+math::frustum make_frustum(const math::vec3& eye, const math::vec3& at)
+{
+	const math::transform view = math::lookAt(eye, at, math::vec3(0.0f, 1.0f, 0.0f));
+	const math::transform proj = math::perspectiveNO(math::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	return math::frustum(view, proj, true);
+}
+
+//-----------------------------------------------------------------------------
+//  Name : make_path ()
+/// <summary>
+/// Camera paths with different amounts of the level in view. Street level
+/// sees far along a line, the orbit turns in the middle of the level and
+/// the flyover looks down on a small area.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::vector<math::frustum> make_path(int kind)
+{
+	std::vector<math::frustum> path;
+	for(std::size_t i = 0; i < frames_per_path; ++i)
+	{
+		const float t = float(i) / float(frames_per_path);
+		if(kind == 0)
+		{
+			const math::vec3 eye(-world_size * 0.4f + t * world_size * 0.8f, 2.0f, 0.0f);
+			path.emplace_back(make_frustum(eye, eye + math::vec3(1.0f, 0.0f, 0.2f)));
+		}
+		else if(kind == 1)
+		{
+			const float angle = t * math::two_pi<float>();
+			const math::vec3 eye(0.0f, 10.0f, 0.0f);
+			path.emplace_back(make_frustum(eye, eye + math::vec3(math::cos(angle), -0.1f, math::sin(angle))));
+		}
+		else
+		{
+			const math::vec3 eye(-world_size * 0.4f + t * world_size * 0.8f, 300.0f, 0.0f);
+			path.emplace_back(make_frustum(eye, eye + math::vec3(0.1f, -1.0f, 0.0f)));
+		}
+	}
+	return path;
+}
+}
+
+int main()
+{
+	const char* path_names[] = {"street", "orbit", "flyover"};
+	for(const std::size_t count : {10000, 20000, 40000, 80000})
+	{
+		scene s;
+		make_scene(s, count);
+
+		for(int kind = 0; kind < 3; ++kind)
+		{
+			const auto path = make_path(kind);
+			std::size_t visible_linear = 0;
+			std::size_t visible_bvh = 0;
+
+			const double linear_ms = bench::measure_ms(3, [&]() {
+				visible_linear = 0;
+				for(const auto& f : path)
+				{
+					for(std::size_t i = 0; i < count; ++i)
+					{
+						visible_linear += math::frustum::test_obb(f, s.local_bounds[i], s.world[i]) ? 1 : 0;
+					}
+				}
+			});
+
+			const double bvh_ms = bench::measure_ms(3, [&]() {
+				visible_bvh = 0;
+				for(const auto& f : path)
+				{
+					s.bvh.query(f, [&](std::uint64_t data) {
+						const auto i = static_cast<std::size_t>(data);
+						visible_bvh += math::frustum::test_obb(f, s.local_bounds[i], s.world[i]) ? 1 : 0;
+					});
+				}
+			});
+
+			char name[64];
+			std::snprintf(name, sizeof(name), "%zu %s linear test_obb", count, path_names[kind]);
+			bench::report(name, linear_ms / frames_per_path, count);
+			std::snprintf(name, sizeof(name), "%zu %s bvh query", count, path_names[kind]);
+			bench::report(name, bvh_ms / frames_per_path, count);
+
+			if(!bench::check(visible_linear == visible_bvh, "the hierarchy finds every visible instance"))
+			{
+				return 1;
+			}
+		}
+
+		// Moving 5% of the instances a frame, as dirty transforms do.
+		const std::size_t moved = count / 20;
+		const double update_ms = bench::measure_ms(3, [&]() {
+			for(std::size_t i = 0; i < moved; ++i)
+			{
+				const std::size_t index = (i * 7919) % count;
+				s.world[index].translate({0.5f, 0.0f, 0.0f});
+				s.bvh.update(s.proxies[index], math::bbox::mul(s.local_bounds[index], s.world[index]));
+			}
+		});
+		char name[64];
+		std::snprintf(name, sizeof(name), "%zu update 5%% moved", count);
+		bench::report(name, update_ms, moved);
+	}
+
+	return 0;
+}
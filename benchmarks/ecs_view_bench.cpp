@@ -0,0 +1,127 @@
+#include "bench.h"
+
+#include <runtime/ecs/ecs.h>
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace
+{
+const std::size_t entity_count = 50000;
+const std::size_t runs = 20;
+
+// Same footprint as transform_component and model_component hot data.
+struct bench_transform : public runtime::component_impl<bench_transform>
+{
+	std::array<float, 16> world{};
+};
+
+struct bench_model : public runtime::component_impl<bench_model>
+{
+	float lod_transition = 1.0f;
+	bool is_static = true;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : shared_layout
+/// <summary>
+/// The layout component_storage had before it was packed. Every component
+/// is its own heap allocation, iteration checks the masks of all entities
+/// and locks a weak_ptr per component through a std::function.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct shared_layout
+{
+	std::vector<std::shared_ptr<bench_transform>> transforms;
+	std::vector<std::shared_ptr<bench_model>> models;
+	std::vector<std::uint8_t> masks;
+
+	void for_each(const std::function<void(bench_transform&, bench_model&)>& f) const
+	{
+		for(std::size_t i = 0; i < masks.size(); ++i)
+		{
+			if(masks[i] != 0x3)
+			{
+				continue;
+			}
+			std::weak_ptr<bench_transform> transform = transforms[i];
+			std::weak_ptr<bench_model> model = models[i];
+			f(*transform.lock(), *model.lock());
+		}
+	}
+};
+}
+
+int main()
+{
+	runtime::entity_component_system ecs(false);
+	shared_layout layout;
+	layout.transforms.resize(entity_count);
+	layout.models.resize(entity_count);
+	layout.masks.resize(entity_count);
+
+	std::vector<runtime::entity> entities;
+	entities.reserve(entity_count);
+	for(std::size_t i = 0; i < entity_count; ++i)
+	{
+		auto e = ecs.create();
+		e.assign<bench_transform>();
+		layout.transforms[i] = std::make_shared<bench_transform>();
+		layout.masks[i] |= 0x1;
+
+		// Every fourth entity has no model, like lights and cameras.
+		if(i % 4 != 0)
+		{
+			e.assign<bench_model>();
+			layout.models[i] = std::make_shared<bench_model>();
+			layout.masks[i] |= 0x2;
+		}
+		entities.emplace_back(e);
+	}
+
+	float sink = 0.0f;
+	const auto visit = [&sink](bench_transform& t, bench_model& m) {
+		sink += t.world[12] + m.lod_transition;
+	};
+
+	bench::report("shared_ptr layout for_each", bench::measure_ms(runs, [&]() { layout.for_each(visit); }),
+				  entity_count);
+
+	bench::report("packed for_each", bench::measure_ms(runs, [&]() {
+					  ecs.for_each<bench_transform, bench_model>(
+						  [&visit](runtime::entity, bench_transform& t, bench_model& m) { visit(t, m); });
+				  }),
+				  entity_count);
+
+	bench::report("chandle lock per entity", bench::measure_ms(runs, [&]() {
+					  for(const auto& e : entities)
+					  {
+						  auto t = e.get_component<bench_transform>().lock();
+						  auto m = e.get_component<bench_model>().lock();
+						  if(t && m)
+						  {
+							  visit(*t, *m);
+						  }
+					  }
+				  }),
+				  entity_count);
+
+	bench::report("component_ref per entity", bench::measure_ms(runs, [&]() {
+					  for(const auto& e : entities)
+					  {
+						  auto t = e.get_component_ref<bench_transform>();
+						  auto m = e.get_component_ref<bench_model>();
+						  if(t && m)
+						  {
+							  visit(*t, *m);
+						  }
+					  }
+				  }),
+				  entity_count);
+
+	std::printf("checksum %f\n", double(sink));
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "bench.h"
+
+#include <runtime/rendering/camera.h>
+#include <runtime/rendering/light_clusters.h>
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace
+{
+const std::size_t runs = 20;
+const float level_size = 200.0f;
+
+void add_lights(light_clusters& clusters, std::size_t count)
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> position(-level_size * 0.5f, level_size * 0.5f);
+	std::uniform_real_distribution<float> height(0.5f, 8.0f);
+	std::uniform_real_distribution<float> range(1.0f, 12.0f);
+
+	clusters.clear();
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		cluster_light light;
+		light.position_range = math::vec4(position(rng), height(rng), position(rng), range(rng));
+		light.color_intensity = math::vec4(1.0f);
+		light.direction_type = math::vec4(0.0f, -1.0f, 0.0f, float(i % 2));
+		light.data = math::vec4(0.9f, 0.8f, 0.0f, 0.0f);
+		clusters.add_light(light);
+	}
+}
+
+//-----------------------------------------------------------------------------
+//  Name : find_cluster ()
+/// <summary>
+/// Finds the cluster holding a view space point from the parameters the
+/// shader gets. Returns false when the point is out of the view.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool find_cluster(const light_clusters& clusters, const math::vec3& world, std::uint32_t& cluster)
+{
+	const auto& view = clusters.get_view_params();
+	const auto& projection = clusters.get_projection_params();
+	const auto& depth = clusters.get_depth_params();
+	const auto to_point = world - math::vec3(view[3]);
+	const math::vec3 p(math::dot(to_point, math::vec3(view[0])), math::dot(to_point, math::vec3(view[1])),
+					   math::dot(to_point, math::vec3(view[2])));
+	if(p.z <= depth.z || p.z >= depth.w)
+	{
+		return false;
+	}
+
+	const float scale = projection.z > 0.0f ? 1.0f / p.z : 1.0f;
+	const float x = p.x * projection.x * scale;
+	const float y = p.y * projection.y * scale;
+	if(x <= -1.0f || x >= 1.0f || y <= -1.0f || y >= 1.0f)
+	{
+		return false;
+	}
+
+	const auto i = std::uint32_t((x + 1.0f) * 0.5f * float(light_clusters::tiles_x));
+	const auto j = std::uint32_t((y + 1.0f) * 0.5f * float(light_clusters::tiles_y));
+	const float slice = math::floor(math::log(p.z) * depth.x + depth.y);
+	const auto k = std::uint32_t(math::clamp(slice, 0.0f, float(light_clusters::slices - 1)));
+	cluster = (k * light_clusters::tiles_y + j) * light_clusters::tiles_x + i;
+	return true;
+}
+
+bool is_listed(const light_clusters& clusters, std::uint32_t cluster, std::uint32_t light)
+{
+	const auto& grid = clusters.get_grid();
+	const auto& indices = clusters.get_indices();
+	const auto first = std::size_t(grid[cluster * 2 + 0]);
+	const auto count = std::size_t(grid[cluster * 2 + 1]);
+	for(std::size_t i = first; i < first + count; ++i)
+	{
+		if(std::uint32_t(indices[i]) == light)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+}
+
+int main()
+{
+	camera cam;
+	cam.set_fov(60.0f);
+	cam.set_near_clip(0.1f);
+	cam.set_far_clip(300.0f);
+	cam.set_aspect_ratio(16.0f / 9.0f, true);
+
+	light_clusters clusters;
+	bool ok = true;
+	for(const std::size_t count : {256, 1024, 4096})
+	{
+		add_lights(clusters, count);
+
+		// A camera walking through the level, the cluster boxes stay the same.
+		std::size_t frame = 0;
+		char name[64];
+		std::snprintf(name, sizeof(name), "build %zu lights", count);
+		bench::report(name, bench::measure_ms(runs, [&]() {
+						  const float t = float(frame++ % 32) / 32.0f;
+						  const math::vec3 eye(-level_size * 0.4f + t * level_size * 0.8f, 2.0f, 0.0f);
+						  cam.look_at(eye, eye + math::vec3(1.0f, -0.05f, 0.3f));
+						  clusters.build(cam);
+					  }),
+					  count);
+
+		// The cluster around the center of a light always has to list it,
+		// unless the index list ran out of room.
+		const auto& grid = clusters.get_grid();
+		std::size_t listed = 0;
+		for(std::size_t c = 0; c < light_clusters::cluster_count; ++c)
+		{
+			listed += std::size_t(grid[c * 2 + 1]);
+		}
+		const bool complete = clusters.get_indices().size() < light_clusters::max_indices;
+		const auto& lights = clusters.get_lights();
+		std::size_t missing = 0;
+		for(std::uint32_t l = 0; l < std::uint32_t(lights.size()) && complete; ++l)
+		{
+			std::uint32_t cluster = 0;
+			if(find_cluster(clusters, math::vec3(lights[l].position_range), cluster))
+			{
+				missing += is_listed(clusters, cluster, l) ? 0 : 1;
+			}
+		}
+		std::printf("%zu light indices listed\n", listed);
+		ok &= bench::check(listed > 0, "some lights reach the view");
+		ok &= bench::check(missing == 0, "every light is listed in the cluster around its center");
+	}
+
+	return ok ? 0 : 1;
+}
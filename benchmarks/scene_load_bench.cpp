@@ -0,0 +1,115 @@
+#include "bench.h"
+
+#include <runtime/ecs/components/transform_component.h>
+#include <runtime/ecs/constructs/utils.h>
+#include <runtime/ecs/ecs.h>
+
+#include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+const std::size_t root_count = 500;
+const std::size_t nodes_per_root = 100;
+const std::size_t children_per_node = 3;
+const std::size_t runs = 5;
+
+//-----------------------------------------------------------------------------
+//  Name : load_ms ()
+/// <summary>
+/// Loads the file into the emptied system the given number of times and
+/// returns the fastest load in milliseconds. Clearing the system is not
+/// part of the measurement.
+/// </summary>
+//-----------------------------------------------------------------------------
+double load_ms(runtime::entity_component_system& ecs, const fs::path& path,
+			   std::vector<runtime::entity>& roots)
+{
+	double best = 0.0;
+	for(std::size_t i = 0; i < runs; ++i)
+	{
+		ecs.dispose();
+		roots.clear();
+
+		const auto start = std::chrono::steady_clock::now();
+		std::ifstream stream(path.string(), std::ios::binary);
+		ecs::utils::deserialize_data(stream, roots);
+		const auto end = std::chrono::steady_clock::now();
+
+		const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		best = i == 0 ? ms : std::min(best, ms);
+	}
+	return best;
+}
+
+bool same_scene(const runtime::entity_component_system& ecs, const std::vector<runtime::entity>& roots)
+{
+	if(ecs.size() != root_count * nodes_per_root || roots.size() != root_count)
+	{
+		return false;
+	}
+
+	// The first nodes of a tree are all parents in the breadth first layout.
+	auto transform = roots.front().get_component<transform_component>().lock();
+	return transform && transform->get_children().size() == children_per_node;
+}
+}
+
+int main()
+{
+	core::details::initialize();
+	core::add_subsystem<core::task_system>(false);
+	auto& ecs = core::add_subsystem<runtime::entity_component_system>();
+
+	// Trees filled breadth first, like the levels of a scene with props
+	// parented under a few groups.
+	std::vector<runtime::entity> roots;
+	for(std::size_t r = 0; r < root_count; ++r)
+	{
+		std::vector<runtime::entity> tree;
+		for(std::size_t i = 0; i < nodes_per_root; ++i)
+		{
+			auto e = ecs.create();
+			e.set_name("node " + std::to_string(i));
+			auto transform = e.assign<transform_component>().lock();
+			transform->set_local_position({float(i), float(r), 0.0f});
+			if(i > 0)
+			{
+				transform->set_parent(tree[(i - 1) / children_per_node]);
+			}
+			tree.emplace_back(e);
+		}
+		roots.emplace_back(tree.front());
+	}
+
+	const auto dir = fs::temp_directory_path();
+	const auto json_path = dir / "ethereal_scene_load_bench.json";
+	const auto binary_path = dir / "ethereal_scene_load_bench.bin";
+	ecs::utils::save_entities_to_file(json_path, roots);
+	ecs::utils::save_entities_to_binary_file(binary_path, roots);
+
+	fs::error_code err;
+	const auto json_kb = std::size_t(fs::file_size(json_path, err) / 1024);
+	const auto binary_kb = std::size_t(fs::file_size(binary_path, err) / 1024);
+	std::printf("%zu entities, json %zu kb, binary %zu kb\n", ecs.size(), json_kb, binary_kb);
+
+	const std::size_t entity_count = root_count * nodes_per_root;
+	bench::report("load json scene", load_ms(ecs, json_path, roots), entity_count);
+	bool ok = bench::check(same_scene(ecs, roots), "the json scene loads every entity and parent");
+
+	bench::report("load binary scene", load_ms(ecs, binary_path, roots), entity_count);
+	ok &= bench::check(same_scene(ecs, roots), "the binary scene loads every entity and parent");
+
+	roots.clear();
+	fs::remove(json_path, err);
+	fs::remove(binary_path, err);
+	core::details::dispose();
+	return ok ? 0 : 1;
+}
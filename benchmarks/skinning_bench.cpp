@@ -0,0 +1,165 @@
+#include "bench.h"
+
+#include <core/math/math_includes.h>
+#include <core/math/matrix_simd.h>
+#include <core/tasks/task_system.h>
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace
+{
+const std::size_t character_count = 500;
+const std::size_t bones_per_character = 64;
+const std::size_t runs = 20;
+
+using mat4 = math::transform::mat4_t;
+
+// Bone world transforms and the bind poses of the shared skin.
+struct character
+{
+	std::vector<math::transform> bones;
+	std::vector<mat4> skinning;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : skin_per_frame ()
+/// <summary>
+/// The path bone_system had before skinning matrices were persistent. The
+/// bone transforms are copied into a new vector every frame and multiplied
+/// by the bind poses with the transform operator into another one.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::size_t skin_per_frame(const character& c, const std::vector<math::transform>& bind_poses)
+{
+	std::vector<math::transform> bones;
+	bones.reserve(c.bones.size());
+	for(const auto& bone : c.bones)
+	{
+		bones.emplace_back(bone);
+	}
+
+	std::vector<math::transform> skinning;
+	skinning.reserve(bones.size());
+	for(std::size_t i = 0; i < bones.size(); ++i)
+	{
+		skinning.emplace_back(bones[i] * bind_poses[i]);
+	}
+	return skinning.size();
+}
+
+void skin_in_place(character& c, const std::vector<math::transform>& bind_poses)
+{
+	for(std::size_t i = 0; i < c.bones.size(); ++i)
+	{
+		math::multiply(c.bones[i].get_matrix(), bind_poses[i].get_matrix(), c.skinning[i]);
+	}
+}
+
+bool nearly_equal(const mat4& a, const mat4& b)
+{
+	for(int col = 0; col < 4; ++col)
+	{
+		for(int row = 0; row < 4; ++row)
+		{
+			const float x = a[col][row];
+			const float y = b[col][row];
+			if(std::abs(x - y) > 1e-4f * (1.0f + std::abs(x) + std::abs(y)))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+}
+
+int main()
+{
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+	std::vector<math::transform> bind_poses(bones_per_character);
+	for(auto& bind_pose : bind_poses)
+	{
+		bind_pose.rotate(angle(rng), angle(rng), angle(rng));
+		bind_pose.set_position({offset(rng), offset(rng), offset(rng)});
+		// The matrices are computed lazily, resolve them up front as
+		// bone_system does before going wide.
+		bind_pose.get_matrix();
+	}
+
+	std::vector<character> characters(character_count);
+	for(auto& c : characters)
+	{
+		c.bones.resize(bones_per_character);
+		c.skinning.resize(bones_per_character);
+		for(auto& bone : c.bones)
+		{
+			bone.rotate(angle(rng), angle(rng), angle(rng));
+			bone.set_scale({1.0f, 1.0f, 1.0f + offset(rng) * 0.1f});
+			bone.set_position({offset(rng) * 100.0f, offset(rng), offset(rng) * 100.0f});
+			bone.get_matrix();
+		}
+	}
+
+	const std::size_t bone_count = character_count * bones_per_character;
+	std::printf("%zu characters with %zu bones\n", character_count, bones_per_character);
+
+	std::size_t sink = 0;
+	bench::report("per frame vectors, transform operator", bench::measure_ms(runs, [&]() {
+					  for(const auto& c : characters)
+					  {
+						  sink += skin_per_frame(c, bind_poses);
+					  }
+				  }),
+				  bone_count);
+
+	bench::report("persistent buffer, math::multiply", bench::measure_ms(runs, [&]() {
+					  for(auto& c : characters)
+					  {
+						  skin_in_place(c, bind_poses);
+					  }
+				  }),
+				  bone_count);
+
+	// Characters are skinned in parallel like the bone_system pass.
+	for(const std::size_t workers : {1, 2, 4})
+	{
+		core::task_system ts(true, workers + 1);
+		char name[64];
+		std::snprintf(name, sizeof(name), "persistent buffer, %zu workers", workers);
+		bench::report(name, bench::measure_ms(runs, [&]() {
+						  ts.parallel_for(0, character_count, 16, [&](std::size_t begin, std::size_t end) {
+							  for(std::size_t i = begin; i < end; ++i)
+							  {
+								  skin_in_place(characters[i], bind_poses);
+							  }
+						  });
+					  }),
+					  bone_count);
+	}
+	std::printf("checksum %zu\n", sink);
+
+	// The simd product has to match the glm one it replaced.
+	std::size_t mismatches = 0;
+	for(const auto& c : characters)
+	{
+		for(std::size_t i = 0; i < c.bones.size(); ++i)
+		{
+			const mat4 expected = c.bones[i].get_matrix() * bind_poses[i].get_matrix();
+			mismatches += nearly_equal(expected, c.skinning[i]) ? 0 : 1;
+		}
+	}
+
+	// The output may alias an input.
+	mat4 aliased = characters[0].bones[0].get_matrix();
+	math::multiply(aliased, bind_poses[0].get_matrix(), aliased);
+
+	bool ok = bench::check(mismatches == 0, "math::multiply matches the glm product");
+	ok &= bench::check(nearly_equal(aliased, characters[0].skinning[0]), "math::multiply into its input");
+	return ok ? 0 : 1;
+}
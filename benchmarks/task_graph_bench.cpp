@@ -0,0 +1,106 @@
+#include "bench.h"
+
+#include <core/tasks/task_graph.h>
+#include <core/tasks/task_system.h>
+
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const std::size_t entity_count = 100000;
+const std::size_t grain = 1024;
+
+// Stand ins for the component arrays the frame update systems touch.
+struct world
+{
+	std::vector<float> positions = std::vector<float>(entity_count * 3, 1.0f);
+	std::vector<float> velocities = std::vector<float>(entity_count * 3, 0.5f);
+	std::vector<float> bounds = std::vector<float>(entity_count * 6, 0.0f);
+	std::vector<float> gains = std::vector<float>(entity_count, 0.0f);
+	std::vector<float> poses = std::vector<float>(entity_count * 3, 0.0f);
+};
+
+enum resource : core::task_graph::resource_id_t
+{
+	positions,
+	velocities,
+	bounds,
+	gains,
+	poses
+};
+
+//-----------------------------------------------------------------------------
+//  Name : build_frame ()
+/// <summary>
+/// Builds a frame with the same shape as the app update graph. Animation and
+/// audio are independent, the hierarchy and bounds follow the movement.
+/// </summary>
+//-----------------------------------------------------------------------------
+void build_frame(core::task_graph& graph, core::task_system& ts, world& w)
+{
+	graph.add_node("animation", {}, {poses}, [&ts, &w]() {
+		ts.parallel_for(0, entity_count, grain, [&w](std::size_t begin, std::size_t end) {
+			for(std::size_t i = begin; i < end; ++i)
+			{
+				w.poses[i * 3] = std::sin(float(i) * 0.001f);
+				w.poses[i * 3 + 1] = std::cos(float(i) * 0.001f);
+			}
+		});
+	});
+	graph.add_node("scene_graph", {velocities, poses}, {positions}, [&ts, &w]() {
+		ts.parallel_for(0, entity_count, grain, [&w](std::size_t begin, std::size_t end) {
+			for(std::size_t i = begin * 3; i < end * 3; ++i)
+			{
+				w.positions[i] += w.velocities[i] * 0.016f + w.poses[i] * 0.001f;
+			}
+		});
+	});
+	graph.add_node("bounds", {positions}, {bounds}, [&ts, &w]() {
+		ts.parallel_for(0, entity_count, grain, [&w](std::size_t begin, std::size_t end) {
+			for(std::size_t i = begin; i < end; ++i)
+			{
+				for(std::size_t c = 0; c < 3; ++c)
+				{
+					w.bounds[i * 6 + c] = w.positions[i * 3 + c] - 1.0f;
+					w.bounds[i * 6 + 3 + c] = w.positions[i * 3 + c] + 1.0f;
+				}
+			}
+		});
+	});
+	graph.add_node("audio", {positions}, {gains}, [&ts, &w]() {
+		ts.parallel_for(0, entity_count, grain, [&w](std::size_t begin, std::size_t end) {
+			for(std::size_t i = begin; i < end; ++i)
+			{
+				const float x = w.positions[i * 3];
+				const float y = w.positions[i * 3 + 1];
+				const float z = w.positions[i * 3 + 2];
+				w.gains[i] = 1.0f / (1.0f + std::sqrt(x * x + y * y + z * z));
+			}
+		});
+	});
+}
+}
+
+int main()
+{
+	std::printf("frame graph over %zu entities, %u hardware threads\n", entity_count,
+				std::thread::hardware_concurrency());
+
+	world w;
+	for(const std::size_t workers : {1, 2, 4, 8})
+	{
+		// The owner thread counts as one of the threads.
+		core::task_system ts(true, workers + 1);
+		core::task_graph graph;
+		build_frame(graph, ts, w);
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "frame with %zu workers", workers);
+		bench::report(name, bench::measure_ms(20, [&]() { graph.run(ts); }), entity_count);
+	}
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include "bench.h"
+
+#include <core/tasks/task_system.h>
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+namespace
+{
+const std::size_t task_count = 1000000;
+
+//-----------------------------------------------------------------------------
+//  Name : run_from_owner ()
+/// <summary>
+/// The owner thread pushes every tiny task to the workers.
+/// </summary>
+//-----------------------------------------------------------------------------
+void run_from_owner(core::task_system& ts)
+{
+	std::atomic<std::size_t> done{0};
+	for(std::size_t i = 0; i < task_count; ++i)
+	{
+		ts.push_on_worker_thread([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+	}
+
+	while(done.load() < task_count)
+	{
+		std::this_thread::yield();
+	}
+}
+
+//-----------------------------------------------------------------------------
+//  Name : run_from_workers ()
+/// <summary>
+/// A few root jobs each spawn their share of the tiny tasks from a worker,
+/// the way culling and asset jobs fan out.
+/// </summary>
+//-----------------------------------------------------------------------------
+void run_from_workers(core::task_system& ts)
+{
+	const std::size_t roots = 64;
+	std::atomic<std::size_t> done{0};
+	for(std::size_t r = 0; r < roots; ++r)
+	{
+		ts.push_on_worker_thread([&ts, &done, roots]() {
+			for(std::size_t i = 0; i < task_count / roots; ++i)
+			{
+				ts.push_on_worker_thread([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+			}
+		});
+	}
+
+	while(done.load() < task_count / roots * roots)
+	{
+		std::this_thread::yield();
+	}
+}
+}
+
+int main()
+{
+	using mode = core::task_system::scheduler_mode;
+	const auto threads = std::max(2u, std::thread::hardware_concurrency());
+	std::printf("1M tiny tasks, %u threads\n", threads);
+
+	for(const auto m : {mode::locked_queues, mode::work_stealing})
+	{
+		const char* mode_name = m == mode::work_stealing ? "work_stealing" : "locked_queues";
+		core::task_system ts(true, threads, m);
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "%s pushed by owner", mode_name);
+		bench::report(name, bench::measure_ms(3, [&ts]() { run_from_owner(ts); }), task_count);
+
+		std::snprintf(name, sizeof(name), "%s pushed by workers", mode_name);
+		bench::report(name, bench::measure_ms(3, [&ts]() { run_from_workers(ts); }), task_count);
+	}
+
+	return 0;
+}
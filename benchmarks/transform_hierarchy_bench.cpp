@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include <runtime/ecs/components/transform_component.h>
+#include <runtime/ecs/ecs.h>
+#include <runtime/ecs/systems/scene_graph.h>
+
+#include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace
+{
+const std::size_t node_count = 100000;
+const std::size_t root_count = 1000;
+const std::size_t children_per_node = 3;
+const std::size_t moved_per_frame = node_count / 20;
+const std::size_t runs = 20;
+}
+
+int main()
+{
+	core::details::initialize();
+	core::add_subsystem<core::task_system>(false);
+	auto& ecs = core::add_subsystem<runtime::entity_component_system>();
+	auto& graph = core::add_subsystem<runtime::scene_graph>();
+
+	// Every root owns a tree where each node has a few children, filled
+	// breadth first, which gives rigs around five levels deep.
+	std::vector<transform_component*> nodes;
+	nodes.reserve(node_count);
+	std::vector<runtime::entity> entities;
+	entities.reserve(node_count);
+	const std::size_t per_root = node_count / root_count;
+	for(std::size_t r = 0; r < root_count; ++r)
+	{
+		const std::size_t first = entities.size();
+		for(std::size_t i = 0; i < per_root; ++i)
+		{
+			auto e = ecs.create();
+			auto transform = e.assign<transform_component>().lock();
+			transform->set_local_position({float(i), 0.0f, 0.0f});
+			if(i > 0)
+			{
+				transform->set_parent(entities[first + (i - 1) / children_per_node]);
+			}
+			entities.emplace_back(e);
+			nodes.emplace_back(transform.get());
+		}
+	}
+
+	const delta_t dt(0.016f);
+	graph.frame_update(dt);
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<std::size_t> pick(0, node_count - 1);
+	const auto move_some = [&]() {
+		for(std::size_t i = 0; i < moved_per_frame; ++i)
+		{
+			nodes[pick(rng)]->move_local({0.01f, 0.0f, 0.0f});
+		}
+	};
+
+	bench::report("move 5% and resolve breadth first", bench::measure_ms(runs, [&]() {
+					  move_some();
+					  graph.frame_update(dt);
+				  }),
+				  node_count);
+
+	// The lazy path resolves every node by walking up its parent chain.
+	bench::report("move 5% and resolve lazily per node", bench::measure_ms(runs, [&]() {
+					  move_some();
+					  for(auto node : nodes)
+					  {
+						  node->get_transform();
+					  }
+				  }),
+				  node_count);
+
+	core::details::dispose();
+	return 0;
+}
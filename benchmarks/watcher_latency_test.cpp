@@ -0,0 +1,146 @@
+#include "bench.h"
+
+#include <core/common/platform/config.hpp>
+#include <core/filesystem/filesystem_watcher.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#if ETH_ON(ETH_PLATFORM_LINUX)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+using namespace std::chrono_literals;
+using steady_clock = std::chrono::steady_clock;
+
+const std::size_t directory_count = 200;
+const std::size_t files_per_directory = 100;
+const std::size_t modifications = 20;
+const auto poll_interval = 500ms;
+const auto event_timeout = 2s;
+
+//-----------------------------------------------------------------------------
+//  Name : cpu_time ()
+/// <summary>
+/// User and system time spent by the whole process so far.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::chrono::duration<double, std::milli> cpu_time()
+{
+#if ETH_ON(ETH_PLATFORM_LINUX)
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	const auto to_ms = [](const timeval& t) {
+		return double(t.tv_sec) * 1000.0 + double(t.tv_usec) / 1000.0;
+	};
+	return std::chrono::duration<double, std::milli>(to_ms(usage.ru_utime) + to_ms(usage.ru_stime));
+#else
+	return std::chrono::duration<double, std::milli>(0.0);
+#endif
+}
+
+void write_file(const fs::path& path, std::size_t value)
+{
+	std::ofstream stream(path.string(), std::ios::trunc);
+	stream << value;
+}
+}
+
+int main()
+{
+	const auto root = fs::temp_directory_path() / "ethereal_watcher_latency_test";
+	fs::error_code err;
+	fs::remove_all(root, err);
+	for(std::size_t d = 0; d < directory_count; ++d)
+	{
+		const auto dir = root / std::to_string(d);
+		fs::create_directories(dir, err);
+		for(std::size_t f = 0; f < files_per_directory; ++f)
+		{
+			write_file(dir / (std::to_string(f) + ".asset"), 0);
+		}
+	}
+	std::printf("synthetic tree of %zu files, %lld ms poll interval\n", directory_count * files_per_directory,
+				static_cast<long long>(poll_interval.count()));
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	fs::path expected;
+	bool seen = false;
+
+	// Watched the way the project manager watches an asset type.
+	const auto key = fs::watcher::watch(
+		root / "*.asset", true, false, poll_interval,
+		[&](const std::vector<fs::watcher::entry>& entries, bool /*is_initial_list*/) {
+			std::lock_guard<std::mutex> lock(mutex);
+			for(const auto& e : entries)
+			{
+				if(e.path == expected)
+				{
+					seen = true;
+					cv.notify_all();
+				}
+			}
+		});
+
+	// Let the watcher settle on the initial scan before measuring.
+	std::this_thread::sleep_for(2 * poll_interval);
+
+	const auto idle_wall = 2s;
+	const auto idle_cpu_begin = cpu_time();
+	std::this_thread::sleep_for(idle_wall);
+	const auto idle_cpu = cpu_time() - idle_cpu_begin;
+	const double idle_percent =
+		100.0 * idle_cpu.count() / std::chrono::duration<double, std::milli>(idle_wall).count();
+
+	double total_ms = 0.0;
+	double max_ms = 0.0;
+	std::size_t missed = 0;
+	for(std::size_t i = 0; i < modifications; ++i)
+	{
+		const auto dir = root / std::to_string((i * 37) % directory_count);
+		const auto path = dir / (std::to_string(i % files_per_directory) + ".asset");
+
+		std::unique_lock<std::mutex> lock(mutex);
+		expected = path;
+		seen = false;
+		lock.unlock();
+
+		const auto start = steady_clock::now();
+		write_file(path, i + 1);
+
+		lock.lock();
+		if(!cv.wait_for(lock, event_timeout, [&seen]() { return seen; }))
+		{
+			++missed;
+			continue;
+		}
+		const double ms = std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+		total_ms += ms;
+		max_ms = std::max(max_ms, ms);
+	}
+
+	fs::watcher::unwatch(key);
+	fs::remove_all(root, err);
+
+	const std::size_t received = modifications - missed;
+	std::printf("idle cpu use                 %8.2f %%\n", idle_percent);
+	std::printf("mean event latency           %8.2f ms\n", received > 0 ? total_ms / double(received) : 0.0);
+	std::printf("max event latency            %8.2f ms\n", max_ms);
+
+	bool ok = bench::check(missed == 0, "every modification is reported");
+#if ETH_ON(ETH_PLATFORM_LINUX)
+	// With inotify the changes arrive long before the next poll would.
+	ok &= bench::check(max_ms < std::chrono::duration<double, std::milli>(poll_interval).count(),
+					   "changes are reported before the poll interval");
+#endif
+	return ok ? 0 : 1;
+}
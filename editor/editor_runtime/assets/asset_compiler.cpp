@@ -9,6 +9,7 @@
 #include <core/audio/loaders/loader.h>
 #include <core/audio/sound.h>
 #include <core/filesystem/filesystem.h>
+#include <core/filesystem/filesystem_pack.h>
 #include <core/graphics/graphics.h>
 #include <core/graphics/shader.h>
 #include <core/graphics/texture.h>
@@ -245,10 +246,32 @@ void compile<mesh>(const fs::path& absolute_meta_key, const fs::path& output)
 
 	if(!data.vertex_data.empty())
 	{
+		// Do all the vertex processing and sorting here so that the runtime
+		// only has to create the buffers.
+		mesh::compiled_data compiled;
+		{
+			mesh prepared;
+			prepared.prepare_mesh(data.vertex_format);
+			prepared.set_vertex_source(&data.vertex_data[0], data.vertex_count, data.vertex_format);
+			prepared.add_primitives(data.triangle_data);
+			prepared.set_subset_count(data.material_count);
+			prepared.bind_skin(data.skin_data);
+			prepared.bind_armature(data.root_node);
+			prepared.end_prepare(false, false, false, false);
+
+			if(!prepared.get_compiled(compiled))
+			{
+				APPLOG_ERROR("Failed compilation of {0}", str_input);
+				return;
+			}
+		}
+
 		{
 			std::ofstream soutput(temp.string(), std::ios::out | std::ios::binary);
 			cereal::oarchive_binary_t ar(soutput);
-			try_save(ar, cereal::make_nvp("mesh", data));
+			std::uint32_t tag = mesh::compiled_data::tag;
+			try_save(ar, cereal::make_nvp("tag", tag));
+			try_save(ar, cereal::make_nvp("mesh", compiled));
 		}
 		fs::copy_file(temp, output, fs::copy_options::overwrite_existing, err);
 		fs::remove(temp, err);
@@ -431,4 +454,35 @@ void compile<scene>(const fs::path& absolute_meta_key, const fs::path& output)
 	fs::copy_file(absolute_key, output, fs::copy_options::overwrite_existing, err);
 	APPLOG_INFO("Successful compilation of {0}", absolute_key.string());
 }
+
+bool build_pack(const std::string& protocol, const fs::path& output)
+{
+	const std::string cache_key = protocol + "/cache";
+	const fs::path cache_dir = fs::resolve_protocol(cache_key);
+
+	fs::error_code err;
+	std::vector<std::pair<std::string, fs::path>> entries;
+	fs::recursive_directory_iterator it(cache_dir, err);
+	for(const auto& entry : it)
+	{
+		const auto& absolute_path = entry.path();
+		if(!entry.is_regular_file(err) || absolute_path.extension() != ".asset")
+		{
+			continue;
+		}
+
+		// keys must match the ones the asset reader builds from the protocol
+		const auto relative = fs::relative(absolute_path, cache_dir, err);
+		entries.emplace_back(cache_key + "/" + relative.generic_string(), absolute_path);
+	}
+
+	if(!fs::write_pack(output, entries, err))
+	{
+		APPLOG_ERROR("Failed packing of {0} with error: {1}", cache_key, err.message());
+		return false;
+	}
+
+	APPLOG_INFO("Successful packing of {0} ({1} assets) into {2}", cache_key, entries.size(), output.string());
+	return true;
+}
 }
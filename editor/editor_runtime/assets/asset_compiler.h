@@ -6,4 +6,13 @@ namespace asset_compiler
 
 template <typename T>
 extern void compile(const fs::path& absolute_meta_key, const fs::path& output);
+
+//-----------------------------------------------------------------------------
+//  Name : build_pack ()
+/// <summary>
+/// Packs every compiled asset under the cache of the specified protocol
+/// (e.g. "app:") into a single file that the runtime can mount.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool build_pack(const std::string& protocol, const fs::path& output);
 };
@@ -106,8 +106,8 @@ void picking_system::frame_render(delta_t dt)
 				std::uint32_t bb = (entity_index >> 16) & 0xff;
 				math::vec4 color_id = {rr / 255.0f, gg / 255.0f, bb / 255.0f, 1.0f};
 
-				const auto& bone_transforms = model_comp_ref.get_bone_transforms();
-				model.render(pass.id, world_transform, bone_transforms, true, true, true, 0, 0,
+				const auto& skinning_transforms = model_comp_ref.get_skinning_transforms();
+				model.render(pass.id, world_transform, skinning_transforms, true, true, true, 0, 0,
 							 program_.get(), [&color_id](auto& p) { p.set_uniform("u_id", &color_id); });
 			});
 	}
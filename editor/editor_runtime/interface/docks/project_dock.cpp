@@ -153,7 +153,7 @@ static void process_drag_drop_target(const fs::path& absolute_path)
 						{
 							auto prefab_path = absolute_path /
 											   fs::path(dropped_entity.to_string() + ".pfb").make_preferred();
-							ecs::utils::save_entity_to_file(prefab_path, dropped_entity);
+							ecs::utils::save_entities_to_binary_file(prefab_path, {dropped_entity});
 						}
 					}
 				}
@@ -1,4 +1,5 @@
 #include "app.h"
+#include "../assets/asset_compiler.h"
 #include "../console/console_log.h"
 #include "../editing/editing_system.h"
 #include "../editing/picking_system.h"
@@ -213,7 +214,7 @@ auto save_scene()
 	if(path != "")
 	{
 		auto entities = gather_scene_data();
-		ecs::utils::save_entities_to_file(path, std::move(entities));
+		ecs::utils::save_entities_to_binary_file(path, entities);
 		APPLOG_INFO("Saving scene successful.");
 	}
 
@@ -236,6 +237,20 @@ void save_scene_as()
 
 	es.save_editor_camera();
 }
+
+void build_asset_pack()
+{
+	std::string path;
+	if(native::save_file_dialog("pack", fs::resolve_protocol("app:/").string(), path))
+	{
+		fs::path pack_path = path;
+		if(!pack_path.has_extension())
+			pack_path.replace_extension(".pack");
+
+		// The runtime mounts it with --pack.
+		asset_compiler::build_pack("app:", pack_path);
+	}
+}
 }
 
 void app::draw_menubar(render_window& window)
@@ -306,6 +321,12 @@ void app::draw_menubar(render_window& window)
 				save_scene_as();
 			}
 
+			gui::Separator();
+			if(gui::MenuItem("BUILD ASSET PACK..", nullptr, false, current_project != ""))
+			{
+				build_asset_pack();
+			}
+
 			gui::EndMenu();
 		}
 		if(gui::BeginMenu("EDIT"))
@@ -4,6 +4,18 @@
 
 namespace utils
 {
+// 32 bit fnv-1a of a null terminated string, usable at compile time.
+constexpr std::uint32_t fnv1a_hash(const char* str)
+{
+	std::uint32_t hash = 2166136261u;
+	while(*str != 0)
+	{
+		hash ^= static_cast<std::uint8_t>(*str++);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
 template <class T>
 inline void hash_combine(std::size_t& seed, const T& v)
 {
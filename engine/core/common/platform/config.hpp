@@ -122,6 +122,31 @@
 #define ETH_UNDEFINED_COMPILER ETH_YES
 #endif
 
+// Instruction sets enabled for the target
+#if defined(__AVX__)
+#define ETH_SIMD_AVX ETH_YES
+#define ETH_SIMD_AVELSE ETH_NO
+#else
+#define ETH_SIMD_AVX ETH_NO
+#define ETH_SIMD_AVELSE ETH_YES
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ETH_SIMD_SSE ETH_YES
+#define ETH_SIMD_SELSE ETH_NO
+#else
+#define ETH_SIMD_SSE ETH_NO
+#define ETH_SIMD_SELSE ETH_YES
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ETH_SIMD_NEON ETH_YES
+#define ETH_SIMD_NELSE ETH_NO
+#else
+#define ETH_SIMD_NEON ETH_NO
+#define ETH_SIMD_NELSE ETH_YES
+#endif
+
 #if ETH_ON(ETH_PLATFORM_WINDOWS) || ETH_ON(ETH_PLATFORM_LINUX) || ETH_ON(ETH_PLATFORM_APPLE) ||              \
 	ETH_ON(ETH_PLATFORM_ANDROID)
 #define ETH_UNDEFINED_OS ETH_NO
@@ -0,0 +1,221 @@
+#include "filesystem_mapped_file.h"
+
+#if ETH_ON(ETH_PLATFORM_WINDOWS)
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs
+{
+mapped_file::~mapped_file()
+{
+	close();
+}
+
+#if ETH_ON(ETH_PLATFORM_WINDOWS)
+bool mapped_file::open(const path& file, error_code& err)
+{
+	close();
+
+	HANDLE handle = CreateFileW(file.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+								FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(handle == INVALID_HANDLE_VALUE)
+	{
+		err = error_code(static_cast<int>(GetLastError()), std::system_category());
+		return false;
+	}
+	file_ = handle;
+
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(handle, &file_size))
+	{
+		err = error_code(static_cast<int>(GetLastError()), std::system_category());
+		close();
+		return false;
+	}
+
+	is_open_ = true;
+	size_ = static_cast<std::size_t>(file_size.QuadPart);
+	if(size_ == 0)
+	{
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapping == nullptr)
+	{
+		err = error_code(static_cast<int>(GetLastError()), std::system_category());
+		close();
+		return false;
+	}
+	mapping_ = mapping;
+
+	data_ = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if(data_ == nullptr)
+	{
+		err = error_code(static_cast<int>(GetLastError()), std::system_category());
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void mapped_file::close()
+{
+	if(data_ != nullptr)
+	{
+		UnmapViewOfFile(data_);
+	}
+	if(mapping_ != nullptr)
+	{
+		CloseHandle(mapping_);
+	}
+	if(file_ != nullptr)
+	{
+		CloseHandle(file_);
+	}
+	data_ = nullptr;
+	mapping_ = nullptr;
+	file_ = nullptr;
+	size_ = 0;
+	is_open_ = false;
+}
+#else
+bool mapped_file::open(const path& file, error_code& err)
+{
+	close();
+
+	const int fd = ::open(file.string().c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		err = error_code(errno, std::system_category());
+		return false;
+	}
+
+	struct stat st;
+	if(::fstat(fd, &st) != 0)
+	{
+		err = error_code(errno, std::system_category());
+		::close(fd);
+		return false;
+	}
+
+	is_open_ = true;
+	size_ = static_cast<std::size_t>(st.st_size);
+	if(size_ == 0)
+	{
+		::close(fd);
+		return true;
+	}
+
+	void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid after the descriptor is closed
+	::close(fd);
+	if(data == MAP_FAILED)
+	{
+		err = error_code(errno, std::system_category());
+		size_ = 0;
+		is_open_ = false;
+		return false;
+	}
+
+	// the whole file is about to be consumed front to back
+	::madvise(data, size_, MADV_SEQUENTIAL);
+	::madvise(data, size_, MADV_WILLNEED);
+
+	data_ = static_cast<const std::uint8_t*>(data);
+	return true;
+}
+
+void mapped_file::close()
+{
+	if(data_ != nullptr)
+	{
+		::munmap(const_cast<std::uint8_t*>(data_), size_);
+	}
+	data_ = nullptr;
+	size_ = 0;
+	is_open_ = false;
+}
+#endif
+
+std::shared_ptr<mapped_file> open_mapped_file(const path& file, error_code& err)
+{
+	auto result = std::make_shared<mapped_file>();
+	if(!result->open(file, err))
+	{
+		return nullptr;
+	}
+	return result;
+}
+
+memory_istream::buffer::buffer(const std::uint8_t* data, std::size_t size)
+{
+	// the stream never writes through the get area
+	auto begin = reinterpret_cast<char*>(const_cast<std::uint8_t*>(data));
+	setg(begin, begin, begin + size);
+}
+
+memory_istream::buffer::pos_type memory_istream::buffer::seekoff(off_type off, std::ios_base::seekdir dir,
+																 std::ios_base::openmode which)
+{
+	if((which & std::ios_base::in) == 0)
+	{
+		return pos_type(off_type(-1));
+	}
+
+	off_type base = 0;
+	if(dir == std::ios_base::cur)
+	{
+		base = gptr() - eback();
+	}
+	else if(dir == std::ios_base::end)
+	{
+		base = egptr() - eback();
+	}
+
+	const off_type target = base + off;
+	if(target < 0 || target > egptr() - eback())
+	{
+		return pos_type(off_type(-1));
+	}
+
+	setg(eback(), eback() + target, egptr());
+	return pos_type(target);
+}
+
+memory_istream::buffer::pos_type memory_istream::buffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+memory_istream::memory_istream(std::shared_ptr<const mapped_file> file)
+	: std::istream(nullptr)
+	, owner_(file)
+	, buffer_(file->data(), file->size())
+{
+	rdbuf(&buffer_);
+}
+
+memory_istream::memory_istream(std::shared_ptr<const byte_array_t> bytes)
+	: std::istream(nullptr)
+	, owner_(bytes)
+	, buffer_(bytes->data(), bytes->size())
+{
+	rdbuf(&buffer_);
+}
+
+memory_istream::memory_istream(data_view view)
+	: std::istream(nullptr)
+	, owner_(std::move(view.owner))
+	, buffer_(view.data, view.size)
+{
+	rdbuf(&buffer_);
+}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "filesystem.h"
+#include "../common/platform/config.hpp"
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <streambuf>
+
+namespace fs
+{
+//-----------------------------------------------------------------------------
+//  Name : mapped_file (Class)
+/// <summary>
+/// Read only view of a whole file mapped into memory. The pages are loaded
+/// by the os on first access, so reading through data() does not need an
+/// intermediate buffer.
+/// </summary>
+//-----------------------------------------------------------------------------
+class mapped_file
+{
+public:
+	mapped_file() = default;
+	~mapped_file();
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	//-----------------------------------------------------------------------------
+	//  Name : open ()
+	/// <summary>
+	/// Maps the specified file. An empty file is opened successfully but has
+	/// no data.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool open(const path& file, error_code& err);
+
+	//-----------------------------------------------------------------------------
+	//  Name : close ()
+	/// <summary>
+	/// Unmaps the file. Pointers returned by data() become invalid.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void close();
+
+	bool is_open() const
+	{
+		return is_open_;
+	}
+
+	const std::uint8_t* data() const
+	{
+		return data_;
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+private:
+	const std::uint8_t* data_ = nullptr;
+	std::size_t size_ = 0;
+	bool is_open_ = false;
+#if ETH_ON(ETH_PLATFORM_WINDOWS)
+	void* file_ = nullptr;
+	void* mapping_ = nullptr;
+#endif
+};
+
+//-----------------------------------------------------------------------------
+//  Name : open_mapped_file ()
+/// <summary>
+/// Maps the specified file and returns it in a shared_ptr so that it can be
+/// handed over between tasks and kept alive by whoever consumes the data.
+/// Returns nullptr on failure.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::shared_ptr<mapped_file> open_mapped_file(const path& file, error_code& err);
+
+//-----------------------------------------------------------------------------
+//  Name : data_view (Struct)
+/// <summary>
+/// Range of read only bytes together with whatever keeps them alive, e.g. a
+/// whole mapped file or a single entry of a mounted pack.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct data_view
+{
+	std::shared_ptr<const void> owner;
+	const std::uint8_t* data = nullptr;
+	std::size_t size = 0;
+
+	explicit operator bool() const
+	{
+		return owner != nullptr;
+	}
+};
+
+//-----------------------------------------------------------------------------
+//  Name : memory_istream (Class)
+/// <summary>
+/// Input stream that reads directly from memory owned by someone else
+/// (a mapped file or a byte array) and keeps the owner alive for as long
+/// as the stream exists.
+/// </summary>
+//-----------------------------------------------------------------------------
+class memory_istream : public std::istream
+{
+	class buffer : public std::streambuf
+	{
+	public:
+		buffer(const std::uint8_t* data, std::size_t size);
+
+	protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+						 std::ios_base::openmode which = std::ios_base::in) override;
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+	};
+
+public:
+	explicit memory_istream(std::shared_ptr<const mapped_file> file);
+	explicit memory_istream(std::shared_ptr<const byte_array_t> bytes);
+	explicit memory_istream(data_view view);
+
+private:
+	std::shared_ptr<const void> owner_;
+	buffer buffer_;
+};
+}
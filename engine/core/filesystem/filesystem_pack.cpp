@@ -0,0 +1,314 @@
+#include "filesystem_pack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+
+namespace fs
+{
+namespace
+{
+const char pack_magic[4] = {'E', 'P', 'A', 'K'};
+const std::uint32_t pack_version = 1;
+const std::uint64_t pack_alignment = 16;
+
+struct pack_header
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t count;
+	std::uint64_t strings_size;
+};
+
+static_assert(sizeof(pack_header) == 24, "pack header layout changed");
+static_assert(sizeof(pack_entry) == 40, "pack entry layout changed");
+
+std::uint64_t align_up(std::uint64_t value)
+{
+	return (value + pack_alignment - 1) & ~(pack_alignment - 1);
+}
+
+bool less_hash(const pack_entry& entry, std::uint64_t hash)
+{
+	return entry.hash < hash;
+}
+
+struct mounted_packs
+{
+	std::mutex mutex;
+	std::vector<std::shared_ptr<pack>> packs;
+};
+
+mounted_packs& get_mounted_packs()
+{
+	static mounted_packs mounted;
+	return mounted;
+}
+}
+
+bool pack::open(const path& file, error_code& err)
+{
+	toc_ = nullptr;
+	count_ = 0;
+	strings_ = nullptr;
+	strings_size_ = 0;
+
+	if(!file_.open(file, err))
+	{
+		return false;
+	}
+	path_ = file;
+
+	const auto invalid = [&]() {
+		err = std::make_error_code(std::errc::invalid_argument);
+		file_.close();
+		return false;
+	};
+
+	const auto file_size = static_cast<std::uint64_t>(file_.size());
+	if(file_size < sizeof(pack_header))
+	{
+		return invalid();
+	}
+
+	pack_header header;
+	std::memcpy(&header, file_.data(), sizeof(header));
+	if(std::memcmp(header.magic, pack_magic, sizeof(pack_magic)) != 0 || header.version != pack_version)
+	{
+		return invalid();
+	}
+
+	const std::uint64_t toc_offset = sizeof(pack_header);
+	if(header.count > (file_size - toc_offset) / sizeof(pack_entry))
+	{
+		return invalid();
+	}
+	const std::uint64_t strings_offset = toc_offset + header.count * sizeof(pack_entry);
+	if(header.strings_size > file_size - strings_offset)
+	{
+		return invalid();
+	}
+
+	toc_ = reinterpret_cast<const pack_entry*>(file_.data() + toc_offset);
+	count_ = static_cast<std::size_t>(header.count);
+	strings_ = reinterpret_cast<const char*>(file_.data() + strings_offset);
+	strings_size_ = static_cast<std::size_t>(header.strings_size);
+
+	// validate everything once so that lookups can trust the table
+	for(std::size_t i = 0; i < count_; ++i)
+	{
+		const auto& entry = toc_[i];
+		const bool sorted = i == 0 || toc_[i - 1].hash <= entry.hash;
+		const bool key_in_range = std::uint64_t(entry.key_offset) + entry.key_size <= strings_size_;
+		const bool data_in_range = entry.offset <= file_size && entry.size <= file_size - entry.offset;
+		if(!sorted || !key_in_range || !data_in_range)
+		{
+			toc_ = nullptr;
+			count_ = 0;
+			return invalid();
+		}
+	}
+
+	return true;
+}
+
+data_view pack::find(const std::string& key) const
+{
+	const auto hash = hash_pack_key(key);
+	const auto end = toc_ + count_;
+	for(auto it = std::lower_bound(toc_, end, hash, less_hash); it != end && it->hash == hash; ++it)
+	{
+		const auto& entry = *it;
+		if(entry.key_size != key.size() || key.compare(0, key.size(), strings_ + entry.key_offset,
+														 entry.key_size) != 0)
+		{
+			continue;
+		}
+
+		// only uncompressed data can be viewed in place
+		if(entry.compression != pack_compression::none)
+		{
+			return {};
+		}
+
+		data_view view;
+		view.owner = shared_from_this();
+		view.data = file_.data() + entry.offset;
+		view.size = static_cast<std::size_t>(entry.size);
+		return view;
+	}
+
+	return {};
+}
+
+std::uint64_t hash_pack_key(const std::string& key)
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	for(const auto c : key)
+	{
+		hash ^= static_cast<std::uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool write_pack(const path& file, const std::vector<std::pair<std::string, path>>& entries,
+				error_code& err)
+{
+	struct pending
+	{
+		pack_entry entry;
+		const std::pair<std::string, path>* source = nullptr;
+	};
+
+	std::vector<pending> sorted;
+	sorted.reserve(entries.size());
+	for(const auto& source : entries)
+	{
+		pending p;
+		p.entry.hash = hash_pack_key(source.first);
+		p.source = &source;
+		sorted.emplace_back(p);
+	}
+	std::sort(std::begin(sorted), std::end(sorted), [](const pending& lhs, const pending& rhs) {
+		if(lhs.entry.hash != rhs.entry.hash)
+		{
+			return lhs.entry.hash < rhs.entry.hash;
+		}
+		return lhs.source->first < rhs.source->first;
+	});
+
+	std::string strings;
+	for(auto& p : sorted)
+	{
+		const auto& key = p.source->first;
+		if(strings.size() + key.size() > std::numeric_limits<std::uint32_t>::max())
+		{
+			err = std::make_error_code(std::errc::file_too_large);
+			return false;
+		}
+		p.entry.key_offset = static_cast<std::uint32_t>(strings.size());
+		p.entry.key_size = static_cast<std::uint32_t>(key.size());
+		strings += key;
+	}
+
+	pack_header header;
+	std::memcpy(header.magic, pack_magic, sizeof(pack_magic));
+	header.version = pack_version;
+	header.count = sorted.size();
+	header.strings_size = strings.size();
+
+	const auto temp = path(file.string() + ".tmp");
+	{
+		std::ofstream output(temp.string(), std::ios::binary | std::ios::trunc);
+		if(!output)
+		{
+			err = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+
+		const char padding[pack_alignment] = {};
+		const auto write_padding = [&]() {
+			const auto offset = static_cast<std::uint64_t>(output.tellp());
+			output.write(padding, static_cast<std::streamsize>(align_up(offset) - offset));
+		};
+
+		// the table is written twice, once to reserve the space and once
+		// more when all the offsets are known
+		std::vector<pack_entry> toc(sorted.size());
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		output.write(reinterpret_cast<const char*>(toc.data()),
+					 static_cast<std::streamsize>(toc.size() * sizeof(pack_entry)));
+		output.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+		write_padding();
+
+		for(std::size_t i = 0; i < sorted.size(); ++i)
+		{
+			auto& entry = sorted[i].entry;
+			auto source = open_mapped_file(sorted[i].source->second, err);
+			if(!source)
+			{
+				output.close();
+				error_code ignored;
+				fs::remove(temp, ignored);
+				return false;
+			}
+
+			entry.offset = static_cast<std::uint64_t>(output.tellp());
+			entry.size = source->size();
+			entry.compression = pack_compression::none;
+			output.write(reinterpret_cast<const char*>(source->data()),
+						 static_cast<std::streamsize>(source->size()));
+			write_padding();
+
+			toc[i] = entry;
+		}
+
+		output.seekp(sizeof(header));
+		output.write(reinterpret_cast<const char*>(toc.data()),
+					 static_cast<std::streamsize>(toc.size() * sizeof(pack_entry)));
+		output.flush();
+		if(!output)
+		{
+			output.close();
+			error_code ignored;
+			fs::remove(temp, ignored);
+			err = std::make_error_code(std::errc::io_error);
+			return false;
+		}
+	}
+
+	// readers never see a half written pack
+	fs::rename(temp, file, err);
+	return !err;
+}
+
+bool mount_pack(const path& file, error_code& err)
+{
+	auto mounted_pack = std::make_shared<pack>();
+	if(!mounted_pack->open(file, err))
+	{
+		return false;
+	}
+
+	auto& mounted = get_mounted_packs();
+	std::lock_guard<std::mutex> lock(mounted.mutex);
+	mounted.packs.emplace_back(std::move(mounted_pack));
+	return true;
+}
+
+void unmount_pack(const path& file)
+{
+	auto& mounted = get_mounted_packs();
+	std::lock_guard<std::mutex> lock(mounted.mutex);
+	auto& packs = mounted.packs;
+	packs.erase(std::remove_if(std::begin(packs), std::end(packs),
+							   [&file](const auto& p) { return p->get_path() == file; }),
+				std::end(packs));
+}
+
+void unmount_all_packs()
+{
+	auto& mounted = get_mounted_packs();
+	std::lock_guard<std::mutex> lock(mounted.mutex);
+	mounted.packs.clear();
+}
+
+data_view find_packed(const std::string& key)
+{
+	auto& mounted = get_mounted_packs();
+	std::lock_guard<std::mutex> lock(mounted.mutex);
+	const auto& packs = mounted.packs;
+	for(auto it = packs.rbegin(); it != packs.rend(); ++it)
+	{
+		auto view = (*it)->find(key);
+		if(view)
+		{
+			return view;
+		}
+	}
+	return {};
+}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "filesystem.h"
+#include "filesystem_mapped_file.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs
+{
+
+enum class pack_compression : std::uint32_t
+{
+	none = 0,
+};
+
+//-----------------------------------------------------------------------------
+//  Name : pack_entry (Struct)
+/// <summary>
+/// Table of contents record as stored on disk. Entries are sorted by hash so
+/// a lookup is a binary search followed by a key compare to rule out
+/// collisions.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct pack_entry
+{
+	std::uint64_t hash = 0;
+	std::uint64_t offset = 0;
+	std::uint64_t size = 0;
+	pack_compression compression = pack_compression::none;
+	std::uint32_t key_offset = 0;
+	std::uint32_t key_size = 0;
+	std::uint32_t reserved = 0;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : pack (Class)
+/// <summary>
+/// Read only archive of many small files packed into one mapped file.
+/// Looking up an entry does not touch the file system at all. Must be owned
+/// by a shared_ptr since the views it hands out keep it alive.
+/// </summary>
+//-----------------------------------------------------------------------------
+class pack : public std::enable_shared_from_this<pack>
+{
+public:
+	//-----------------------------------------------------------------------------
+	//  Name : open ()
+	/// <summary>
+	/// Maps the pack and validates its table of contents.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool open(const path& file, error_code& err);
+
+	//-----------------------------------------------------------------------------
+	//  Name : find ()
+	/// <summary>
+	/// Finds the entry stored under the specified key. The returned view keeps
+	/// the pack alive. Returns an empty view if the key is not present.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	data_view find(const std::string& key) const;
+
+	const path& get_path() const
+	{
+		return path_;
+	}
+
+	std::size_t size() const
+	{
+		return count_;
+	}
+
+private:
+	path path_;
+	mapped_file file_;
+	const pack_entry* toc_ = nullptr;
+	std::size_t count_ = 0;
+	const char* strings_ = nullptr;
+	std::size_t strings_size_ = 0;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : hash_pack_key ()
+/// <summary>
+/// Stable 64 bit fnv-1a hash used for the table of contents. It must not
+/// change between the tool that writes a pack and the runtime reading it.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::uint64_t hash_pack_key(const std::string& key);
+
+//-----------------------------------------------------------------------------
+//  Name : write_pack ()
+/// <summary>
+/// Writes a pack from a list of key/file pairs.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool write_pack(const path& file, const std::vector<std::pair<std::string, path>>& entries,
+				error_code& err);
+
+//-----------------------------------------------------------------------------
+//  Name : mount_pack ()
+/// <summary>
+/// Opens a pack and adds it to the set searched by find_packed. Packs
+/// mounted later take precedence.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool mount_pack(const path& file, error_code& err);
+
+//-----------------------------------------------------------------------------
+//  Name : unmount_pack ()
+/// <summary>
+/// Removes a previously mounted pack. Views already handed out stay valid.
+/// </summary>
+//-----------------------------------------------------------------------------
+void unmount_pack(const path& file);
+
+//-----------------------------------------------------------------------------
+//  Name : unmount_all_packs ()
+/// <summary>
+/// Removes every mounted pack.
+/// </summary>
+//-----------------------------------------------------------------------------
+void unmount_all_packs();
+
+//-----------------------------------------------------------------------------
+//  Name : find_packed ()
+/// <summary>
+/// Searches the mounted packs for the specified key.
+/// </summary>
+//-----------------------------------------------------------------------------
+data_view find_packed(const std::string& key);
+}
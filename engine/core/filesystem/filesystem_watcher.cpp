@@ -1,6 +1,18 @@
 #include <utility>
 
 #include "filesystem_watcher.h"
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#if ETH_ON(ETH_PLATFORM_LINUX)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
 namespace fs
 {
 using namespace std::literals;
@@ -30,6 +42,15 @@ static std::pair<path, std::string> get_path_filter_pair(const fs::path& path)
 	return std::make_pair(p, filter);
 }
 
+static bool matches_wild_card(const std::string& before, const std::string& after, const fs::path& path)
+{
+	std::string current = path.string();
+	size_t before_pos = current.find(before);
+	size_t after_pos = current.find(after);
+	return (before_pos != std::string::npos || before.empty()) &&
+		   (after_pos != std::string::npos || after.empty());
+}
+
 static std::pair<path, std::string> visit_wild_card_path(const fs::path& path, bool recursive,
 														 bool visit_empty,
 														 const std::function<bool(const fs::path&)>& visitor)
@@ -52,11 +73,7 @@ static std::pair<path, std::string> visit_wild_card_path(const fs::path& path, b
 			const auto iterate = [&](auto& it) {
 				for(const auto& entry : it)
 				{
-					std::string current = entry.path().string();
-					size_t before_pos = current.find(before);
-					size_t after_pos = current.find(after);
-					if((before_pos != std::string::npos || before.empty()) &&
-					   (after_pos != std::string::npos || after.empty()))
+					if(matches_wild_card(before, after, entry.path()))
 					{
 						if(visitor(entry.path()))
 						{
@@ -93,7 +110,7 @@ public:
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	impl(const fs::path& path, const std::string& filter, bool recursive, bool initial_list,
-		 clock_t::duration poll_interval, notify_callback list_callback)
+		 clock_t::duration poll_interval, notify_callback list_callback, bool use_notifications)
 		: filter_(filter)
 		, callback_(std::move(list_callback))
 		, poll_interval_(poll_interval)
@@ -117,6 +134,15 @@ public:
 			poll_entry(root_, entries, created, modified);
 		}
 
+#if ETH_ON(ETH_PLATFORM_LINUX)
+		if(use_notifications)
+		{
+			init_notifications();
+		}
+#else
+		(void)use_notifications;
+#endif
+
 		if(initial_list)
 		{
 			// this means that the first watch won't call the callback function
@@ -128,6 +154,28 @@ public:
 		}
 	}
 
+	~impl()
+	{
+#if ETH_ON(ETH_PLATFORM_LINUX)
+		close_notifications();
+#endif
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : is_polling ()
+	/// <summary>
+	/// Whether changes are detected by polling instead of notifications.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool is_polling() const
+	{
+#if ETH_ON(ETH_PLATFORM_LINUX)
+		return notify_fd_ < 0;
+#else
+		return true;
+#endif
+	}
+
 	//-----------------------------------------------------------------------------
 	//  Name : watch ()
 	/// <summary>
@@ -167,49 +215,85 @@ public:
 	void process_modifications(std::vector<filesystem_watcher::entry>& entries,
 							   const std::vector<size_t>& created, const std::vector<size_t>& /*unused*/)
 	{
-		using namespace std::literals;
-
 		auto it = std::begin(entries_);
 		while(it != std::end(entries_))
 		{
-			auto& fi = it->second;
-			fs::error_code err;
-			if(!fs::exists(fi.path, err))
-			{
-				bool was_removed = true;
-				for(auto idx : created)
-				{
-					auto& e = entries[idx];
-					if(e.size == fi.size)
-					{
-						//using sys_clock = std::chrono::system_clock;
-						//std::chrono::microseconds tolerance = 1000us;
-						//auto diff = sys_clock::from_time_t(e.last_mod_time - fi.last_mod_time);
-						//auto d = std::chrono::time_point_cast<std::chrono::microseconds>(diff);
-						if(e.last_mod_time == fi.last_mod_time)
-						{
+			it = process_entry(it, entries, created);
+		}
+	}
 
-							e.status = filesystem_watcher::entry_status::renamed;
-							e.last_path = fi.path;
-							was_removed = false;
-							break;
-						}
-					}
-				}
+	//-----------------------------------------------------------------------------
+	//  Name : process_removed ()
+	/// <summary>
+	/// Same as process_modifications but only checks the cached entry of the
+	/// path and the entries below it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void process_removed(const fs::path& path, std::vector<filesystem_watcher::entry>& entries,
+						 const std::vector<size_t>& created)
+	{
+		const std::string key = path.string();
+		auto it = entries_.find(key);
+		if(it != std::end(entries_))
+		{
+			process_entry(it, entries, created);
+		}
 
-				if(was_removed)
-				{
-					fi.status = filesystem_watcher::entry_status::removed;
-					entries.push_back(fi);
-				}
+		const std::string prefix = key + char(fs::path::preferred_separator);
+		it = entries_.lower_bound(prefix);
+		while(it != std::end(entries_) && it->first.compare(0, prefix.size(), prefix) == 0)
+		{
+			it = process_entry(it, entries, created);
+		}
+	}
 
-				it = entries_.erase(it);
-			}
-			else
+	//-----------------------------------------------------------------------------
+	//  Name : process_entry ()
+	/// <summary>
+	/// Checks whether a cached entry still exists. Missing entries are reported
+	/// as removed, or as renamed if a created entry matches them, and are erased
+	/// from the cache. Returns the iterator following the entry.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::map<std::string, filesystem_watcher::entry>::iterator
+	process_entry(std::map<std::string, filesystem_watcher::entry>::iterator it,
+				  std::vector<filesystem_watcher::entry>& entries, const std::vector<size_t>& created)
+	{
+		auto& fi = it->second;
+		fs::error_code err;
+		if(fs::exists(fi.path, err))
+		{
+			return ++it;
+		}
+
+		bool was_removed = true;
+		for(auto idx : created)
+		{
+			auto& e = entries[idx];
+			if(e.size == fi.size)
 			{
-				it++;
+				//using sys_clock = std::chrono::system_clock;
+				//std::chrono::microseconds tolerance = 1000us;
+				//auto diff = sys_clock::from_time_t(e.last_mod_time - fi.last_mod_time);
+				//auto d = std::chrono::time_point_cast<std::chrono::microseconds>(diff);
+				if(e.last_mod_time == fi.last_mod_time)
+				{
+
+					e.status = filesystem_watcher::entry_status::renamed;
+					e.last_path = fi.path;
+					was_removed = false;
+					break;
+				}
 			}
 		}
+
+		if(was_removed)
+		{
+			fi.status = filesystem_watcher::entry_status::removed;
+			entries.push_back(fi);
+		}
+
+		return entries_.erase(it);
 	}
 
 	//-----------------------------------------------------------------------------
@@ -266,6 +350,262 @@ public:
 		}
 	}
 
+#if ETH_ON(ETH_PLATFORM_LINUX)
+	//-----------------------------------------------------------------------------
+	//  Name : init_notifications ()
+	/// <summary>
+	/// Sets up an inotify instance for the watched directories. On failure
+	/// (e.g. the user watch limit is reached) the watcher keeps polling.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void init_notifications()
+	{
+		notify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(notify_fd_ < 0)
+		{
+			return;
+		}
+
+		if(!add_notifications(root_, false))
+		{
+			close_notifications();
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : close_notifications ()
+	/// <summary>
+	/// Closes the inotify instance and falls back to polling.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void close_notifications()
+	{
+		if(notify_fd_ >= 0)
+		{
+			::close(notify_fd_);
+			notify_fd_ = -1;
+		}
+		notify_dirs_.clear();
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : add_notifications ()
+	/// <summary>
+	/// Watches the path and, for recursive filtered watchers, every directory
+	/// below it. If poll_new is true every matching entry found below the path
+	/// is polled, which is needed for directories that appear after the
+	/// watcher was created.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool add_notifications(const fs::path& path, bool poll_new,
+						   std::vector<filesystem_watcher::entry>* entries = nullptr,
+						   std::vector<size_t>* created = nullptr, std::vector<size_t>* modified = nullptr)
+	{
+		const std::uint32_t mask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+								   IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+		const int wd = inotify_add_watch(notify_fd_, path.string().c_str(), mask);
+		if(wd < 0)
+		{
+			return false;
+		}
+		notify_dirs_[wd] = path;
+
+		if(filter_.empty() || !recursive_)
+		{
+			return true;
+		}
+
+		const std::string full = (root_ / filter_).string();
+		const size_t wildcard_pos = full.find('*');
+		const std::string before = full.substr(0, wildcard_pos);
+		const std::string after = full.substr(wildcard_pos + 1);
+
+		fs::error_code err;
+		fs::recursive_directory_iterator it(path, err);
+		for(const auto& entry : it)
+		{
+			fs::error_code ec;
+			if(entry.is_directory(ec))
+			{
+				const int sub_wd = inotify_add_watch(notify_fd_, entry.path().string().c_str(), mask);
+				if(sub_wd < 0)
+				{
+					return false;
+				}
+				notify_dirs_[sub_wd] = entry.path();
+			}
+
+			if(poll_new && matches_wild_card(before, after, entry.path()))
+			{
+				poll_entry(entry.path(), *entries, *created, *modified);
+			}
+		}
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : notify ()
+	/// <summary>
+	/// Reads the pending inotify events and reports the changes of the
+	/// affected paths only, instead of walking the whole tree.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void notify()
+	{
+		std::vector<fs::path> changed;
+		std::vector<fs::path> new_dirs;
+		bool rescan = false;
+		bool root_lost = false;
+
+		alignas(inotify_event) char buffer[16 * 1024];
+		for(;;)
+		{
+			const auto length = ::read(notify_fd_, buffer, sizeof(buffer));
+			if(length <= 0)
+			{
+				break;
+			}
+
+			for(const char* ptr = buffer; ptr < buffer + length;)
+			{
+				const auto event = reinterpret_cast<const inotify_event*>(ptr);
+				ptr += sizeof(inotify_event) + event->len;
+
+				if(event->mask & IN_Q_OVERFLOW)
+				{
+					rescan = true;
+					continue;
+				}
+
+				auto it = notify_dirs_.find(event->wd);
+				if(it == std::end(notify_dirs_))
+				{
+					continue;
+				}
+				const fs::path dir = it->second;
+
+				if(event->mask & IN_IGNORED)
+				{
+					notify_dirs_.erase(it);
+					root_lost |= dir == root_;
+					continue;
+				}
+
+				if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+				{
+					root_lost |= dir == root_;
+					changed.push_back(dir);
+					continue;
+				}
+
+				if(event->len == 0)
+				{
+					changed.push_back(dir);
+					continue;
+				}
+
+				const fs::path path = dir / event->name;
+				if(event->mask & IN_ISDIR)
+				{
+					if(event->mask & (IN_CREATE | IN_MOVED_TO))
+					{
+						new_dirs.push_back(path);
+					}
+				}
+				else if(event->mask & IN_CREATE)
+				{
+					// Files are reported once they are closed after writing.
+					continue;
+				}
+
+				changed.push_back(path);
+				// The modification time of the directory changes as well.
+				changed.push_back(dir);
+			}
+		}
+
+		if(root_lost)
+		{
+			// The watched path was replaced or removed, keep polling it.
+			close_notifications();
+		}
+		else if(rescan)
+		{
+			// Events were dropped so directories might be missing watches.
+			close_notifications();
+			init_notifications();
+		}
+
+		if(root_lost || rescan || filter_.empty())
+		{
+			if(rescan || root_lost || !changed.empty())
+			{
+				watch();
+			}
+			return;
+		}
+
+		std::sort(std::begin(changed), std::end(changed));
+		changed.erase(std::unique(std::begin(changed), std::end(changed)), std::end(changed));
+
+		const std::string full = (root_ / filter_).string();
+		const size_t wildcard_pos = full.find('*');
+		const std::string before = full.substr(0, wildcard_pos);
+		const std::string after = full.substr(wildcard_pos + 1);
+
+		std::vector<filesystem_watcher::entry> entries;
+		std::vector<size_t> created;
+		std::vector<size_t> modified;
+		std::vector<fs::path> removed;
+
+		for(const auto& path : changed)
+		{
+			fs::error_code err;
+			if(!fs::exists(path, err))
+			{
+				removed.push_back(path);
+			}
+			else if(path != root_ && matches_wild_card(before, after, path))
+			{
+				poll_entry(path, entries, created, modified);
+			}
+		}
+
+		for(const auto& dir : new_dirs)
+		{
+			fs::error_code err;
+			if(!recursive_ || !fs::is_directory(dir, err))
+			{
+				continue;
+			}
+
+			if(!add_notifications(dir, true, &entries, &created, &modified))
+			{
+				// Out of watches, the next polls will pick up the rest.
+				close_notifications();
+				break;
+			}
+		}
+
+		// Created entries are known now so renames can be matched.
+		for(const auto& path : removed)
+		{
+			process_removed(path, entries, created);
+		}
+
+		if(!entries.empty() && callback_)
+		{
+			callback_(entries, false);
+		}
+	}
+
+	/// inotify instance or -1 when polling
+	int notify_fd_ = -1;
+	/// Watched directories by watch descriptor
+	std::map<int, fs::path> notify_dirs_;
+#endif
+
 protected:
 	friend class filesystem_watcher;
 	/// Path to watch
@@ -348,10 +688,24 @@ void filesystem_watcher::close()
 	{
 		thread_.join();
 	}
+
+#if ETH_ON(ETH_PLATFORM_LINUX)
+	if(wake_fd_ >= 0)
+	{
+		::close(wake_fd_);
+		wake_fd_ = -1;
+	}
+#endif
 }
 
 void filesystem_watcher::start()
 {
+#if ETH_ON(ETH_PLATFORM_LINUX)
+	if(wake_fd_ < 0)
+	{
+		wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+#endif
 	watching_ = true;
 	thread_ = std::thread([this]() {
 		// keep watching for modifications every ms milliseconds
@@ -371,6 +725,12 @@ void filesystem_watcher::start()
 			{
 				auto watcher = pair.second;
 
+				// The others wake us up when they have something to report.
+				if(!watcher->is_polling())
+				{
+					continue;
+				}
+
 				auto now = clock_t::now();
 
 				auto diff = (watcher->last_poll_ + watcher->poll_interval_) - now;
@@ -387,12 +747,73 @@ void filesystem_watcher::start()
 				}
 			}
 
-			std::unique_lock<std::mutex> lock(mutex_);
-			cv_.wait_for(lock, sleep_time);
+			wait(watchers, sleep_time);
 		}
 	});
 }
 
+void filesystem_watcher::wait(const std::map<std::uint64_t, std::shared_ptr<impl>>& watchers,
+							  clock_t::duration timeout)
+{
+#if ETH_ON(ETH_PLATFORM_LINUX)
+	if(wake_fd_ >= 0)
+	{
+		std::vector<pollfd> fds;
+		std::vector<impl*> notified;
+		fds.push_back({wake_fd_, POLLIN, 0});
+		for(const auto& pair : watchers)
+		{
+			if(!pair.second->is_polling())
+			{
+				fds.push_back({pair.second->notify_fd_, POLLIN, 0});
+				notified.push_back(pair.second.get());
+			}
+		}
+
+		const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+		const int poll_timeout = ms > INT_MAX ? -1 : static_cast<int>(ms);
+		if(::poll(fds.data(), fds.size(), poll_timeout) <= 0)
+		{
+			return;
+		}
+
+		if(fds[0].revents & POLLIN)
+		{
+			std::uint64_t value = 0;
+			auto result = ::read(wake_fd_, &value, sizeof(value));
+			(void)result;
+		}
+
+		for(size_t i = 0; i < notified.size(); ++i)
+		{
+			if(fds[i + 1].revents & POLLIN)
+			{
+				notified[i]->notify();
+			}
+		}
+		return;
+	}
+#else
+	(void)watchers;
+#endif
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	cv_.wait_for(lock, timeout);
+}
+
+void filesystem_watcher::wake()
+{
+#if ETH_ON(ETH_PLATFORM_LINUX)
+	if(wake_fd_ >= 0)
+	{
+		const std::uint64_t value = 1;
+		auto result = ::write(wake_fd_, &value, sizeof(value));
+		(void)result;
+	}
+#endif
+	cv_.notify_all();
+}
+
 std::uint64_t filesystem_watcher::watch_impl(const fs::path& path, bool recursive, bool initial_list,
 											 clock_t::duration poll_interval,
 											 notify_callback& list_callback)
@@ -434,12 +855,16 @@ std::uint64_t filesystem_watcher::watch_impl(const fs::path& path, bool recursiv
 		{
 			// we do it like this because if initial_list is true we don't want
 			// to call a user callback on a locked mutex
-			auto imp =
-				std::make_shared<impl>(p, filter, recursive, initial_list, poll_interval, std::move(list_callback));
+			bool use_notifications = false;
+#if ETH_ON(ETH_PLATFORM_LINUX)
+			use_notifications = wd.wake_fd_ >= 0;
+#endif
+			auto imp = std::make_shared<impl>(p, filter, recursive, initial_list, poll_interval,
+											  std::move(list_callback), use_notifications);
 			std::lock_guard<std::mutex> lock(wd.mutex_);
 			wd.watchers_.emplace(key, std::move(imp));
 		}
-		wd.cv_.notify_all();
+		wd.wake();
 		return key;
 	}
 
@@ -454,7 +879,7 @@ void filesystem_watcher::unwatch_impl(std::uint64_t key)
 		std::lock_guard<std::mutex> lock(wd.mutex_);
 		wd.watchers_.erase(key);
 	}
-	wd.cv_.notify_all();
+	wd.wake();
 }
 
 void filesystem_watcher::unwatch_all_impl()
@@ -464,6 +889,6 @@ void filesystem_watcher::unwatch_all_impl()
 		std::lock_guard<std::mutex> lock(wd.mutex_);
 		wd.watchers_.clear();
 	}
-	wd.cv_.notify_all();
+	wd.wake();
 }
 }
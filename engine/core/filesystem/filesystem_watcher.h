@@ -12,6 +12,7 @@
 #include <functional>
 
 #include "filesystem.h"
+#include "../common/platform/config.hpp"
 
 namespace fs
 {
@@ -49,7 +50,8 @@ public:
 	/// Watches a file or directory for modification and call back the specified
 	/// std::function. A list of modified files or directory is passed as argument
 	/// of the callback. Use this version only if you are watching multiple files
-	/// or a directory.
+	/// or a directory. Where the platform supports change notifications (inotify
+	/// on linux) they are used and the poll interval only applies as a fallback.
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	static std::uint64_t watch(const fs::path& path, bool recursive, bool initial_list,
@@ -94,6 +96,8 @@ public:
 	filesystem_watcher() = default;
 
 protected:
+	class impl;
+
 	//-----------------------------------------------------------------------------
 	//  Name : close ()
 	/// <summary>
@@ -114,6 +118,24 @@ protected:
 	//-----------------------------------------------------------------------------
 	void start();
 
+	//-----------------------------------------------------------------------------
+	//  Name : wait ()
+	/// <summary>
+	/// Blocks the watcher thread until the timeout expires, a watcher receives
+	/// change notifications or wake() is called.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void wait(const std::map<std::uint64_t, std::shared_ptr<impl>>& watchers,
+			  clock_t::duration timeout);
+
+	//-----------------------------------------------------------------------------
+	//  Name : wake ()
+	/// <summary>
+	/// Wakes up the watcher thread.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void wake();
+
 	//-----------------------------------------------------------------------------
 	//  Name : watch_impl ()
 	/// <summary>
@@ -137,8 +159,11 @@ protected:
 	std::condition_variable cv_;
 	/// Thread that polls for changes
 	std::thread thread_;
+#if ETH_ON(ETH_PLATFORM_LINUX)
+	/// Event descriptor used to wake up the thread
+	int wake_fd_ = -1;
+#endif
 	/// Registered file watchers
-	class impl;
 	std::map<std::uint64_t, std::shared_ptr<impl>> watchers_;
 };
 }
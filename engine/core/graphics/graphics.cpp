@@ -1,11 +1,25 @@
 #include "graphics.h"
 #include <algorithm>
+#include <cstring>
 #include <map>
+#include <vector>
 namespace gfx
 {
 static std::map<std::string, std::function<void(const std::string&)>> s_loggers;
 static bool s_initted = false;
 
+// Last value set to every uniform in the current frame, indexed by handle.
+// Uniform values are shared by every program using the same name so they
+// are cached per handle and not per program.
+struct uniform_cache_entry
+{
+	std::uint32_t frame = 0;
+	std::uint16_t size = 0;
+	std::uint8_t data[64];
+};
+static std::vector<uniform_cache_entry> s_uniform_cache;
+static std::uint32_t s_uniform_cache_frame = 1;
+
 void set_info_logger(const std::function<void(const std::string&)>& logger)
 {
 	s_loggers["info"] = logger;
@@ -186,6 +200,7 @@ void end(encoder* _encoder)
 
 uint32_t frame(bool _capture)
 {
+	++s_uniform_cache_frame;
 	return bgfx::frame(_capture);
 }
 
@@ -521,6 +536,10 @@ uniform_handle create_uniform(const char* _name, uniform_type _type, uint16_t _n
 
 void destroy(uniform_handle _handle)
 {
+	if(_handle.idx < s_uniform_cache.size())
+	{
+		s_uniform_cache[_handle.idx].frame = 0;
+	}
 	bgfx::destroy(_handle);
 }
 
@@ -657,7 +676,38 @@ void set_transform(uint32_t _cache, uint16_t _num)
 
 void set_uniform(uniform_handle _handle, const void* _value, uint16_t _num)
 {
+	if(_handle.idx < s_uniform_cache.size())
+	{
+		s_uniform_cache[_handle.idx].frame = 0;
+	}
+	bgfx::setUniform(_handle, _value, _num);
+}
+
+bool set_uniform_cached(uniform_handle _handle, const void* _value, uint16_t _size, uint16_t _num)
+{
+	if(!bgfx::isValid(_handle) || _size > sizeof(uniform_cache_entry::data))
+	{
+		set_uniform(_handle, _value, _num);
+		return true;
+	}
+
+	if(_handle.idx >= s_uniform_cache.size())
+	{
+		s_uniform_cache.resize(_handle.idx + 1u);
+	}
+
+	auto& entry = s_uniform_cache[_handle.idx];
+	if(entry.frame == s_uniform_cache_frame && entry.size == _size &&
+	   std::memcmp(entry.data, _value, _size) == 0)
+	{
+		return false;
+	}
+
+	entry.frame = s_uniform_cache_frame;
+	entry.size = _size;
+	std::memcpy(entry.data, _value, _size);
 	bgfx::setUniform(_handle, _value, _num);
+	return true;
 }
 
 void set_index_buffer(index_buffer_handle _handle, uint32_t _firstIndex, uint32_t _numIndices)
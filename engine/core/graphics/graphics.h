@@ -405,6 +405,11 @@ void set_transform(uint32_t _cache, uint16_t _num = 1);
 /**/
 void set_uniform(uniform_handle _handle, const void* _value, uint16_t _num = 1);
 
+/// Same as set_uniform but skips the call when the uniform already holds the
+/// value in this frame. _size is the size of the value in bytes. Only valid
+/// for views that keep the submission order. Returns true if it was set.
+bool set_uniform_cached(uniform_handle _handle, const void* _value, uint16_t _size, uint16_t _num = 1);
+
 /**/
 void set_index_buffer(index_buffer_handle _handle, uint32_t _firstIndex, uint32_t _numIndices);
 
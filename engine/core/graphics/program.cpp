@@ -4,8 +4,19 @@
 #include "texture.h"
 #include "uniform.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace gfx
 {
+namespace
+{
+bool less_hash(const std::pair<std::uint32_t, gfx::uniform*>& lhs, std::uint32_t hash)
+{
+	return lhs.first < hash;
+}
+}
+
 program::program(const std::shared_ptr<shader>& compute_shader)
 {
 	if(compute_shader)
@@ -14,7 +25,7 @@ program::program(const std::shared_ptr<shader>& compute_shader)
 
 		for(auto& uniform : compute_shader->uniforms)
 		{
-			uniforms[uniform->info.name] = uniform;
+			add_uniform(uniform);
 		}
 	}
 }
@@ -27,12 +38,12 @@ program::program(const std::shared_ptr<shader>& vertex_shader, const std::shared
 
 		for(auto& uniform : vertex_shader->uniforms)
 		{
-			uniforms[uniform->info.name] = uniform;
+			add_uniform(uniform);
 		}
 
 		for(auto& uniform : fragment_shader->uniforms)
 		{
-			uniforms[uniform->info.name] = uniform;
+			add_uniform(uniform);
 		}
 	}
 }
@@ -84,10 +95,74 @@ std::shared_ptr<gfx::uniform> program::get_uniform(const std::string& _name, boo
 		if(texture)
 		{
 			hUniform = std::make_shared<gfx::uniform>(_name, gfx::uniform_type::Int1, 1);
-			uniforms[_name] = hUniform;
+			add_uniform(hUniform);
 		}
 	}
 
 	return hUniform;
 }
+
+void program::set_texture(std::uint8_t _stage, const uniform_id& _sampler, gfx::texture* _texture,
+						  std::uint32_t _flags /*= std::numeric_limits<std::uint32_t>::max()*/)
+{
+	if(_texture == nullptr)
+	{
+		return;
+	}
+
+	auto uniform = get_uniform(_sampler);
+	if(uniform == nullptr)
+	{
+		// Samplers the shaders do not list are created on first use.
+		set_texture(_stage, _sampler.name, _texture, _flags);
+		return;
+	}
+
+	gfx::set_texture(_stage, uniform->native_handle(), _texture->native_handle(), _flags);
+}
+
+void program::set_uniform(const uniform_id& _id, const void* _value, std::uint16_t _num)
+{
+	auto uniform = get_uniform(_id);
+
+	if(uniform)
+	{
+		gfx::set_uniform_cached(uniform->native_handle(), _value,
+								std::uint16_t(uniform->get_value_size() * _num), _num);
+	}
+}
+
+gfx::uniform* program::get_uniform(const uniform_id& _id) const
+{
+	// Names that collide share a hash, the name tells them apart.
+	auto it = std::lower_bound(std::begin(uniforms_by_hash_), std::end(uniforms_by_hash_), _id.hash, less_hash);
+	for(; it != std::end(uniforms_by_hash_) && it->first == _id.hash; ++it)
+	{
+		if(std::strcmp(it->second->info.name, _id.name) == 0)
+		{
+			return it->second;
+		}
+	}
+
+	return nullptr;
+}
+
+void program::add_uniform(const std::shared_ptr<gfx::uniform>& _uniform)
+{
+	const std::string name = _uniform->info.name;
+	uniforms[name] = _uniform;
+
+	const auto hash = utils::fnv1a_hash(name.c_str());
+	auto it = std::lower_bound(std::begin(uniforms_by_hash_), std::end(uniforms_by_hash_), hash, less_hash);
+	for(; it != std::end(uniforms_by_hash_) && it->first == hash; ++it)
+	{
+		if(name == it->second->info.name)
+		{
+			it->second = _uniform.get();
+			return;
+		}
+	}
+
+	uniforms_by_hash_.emplace(it, hash, _uniform.get());
+}
 }
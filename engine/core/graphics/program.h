@@ -12,6 +12,7 @@ struct frame_buffer;
 struct texture;
 struct shader;
 struct uniform;
+struct uniform_id;
 
 struct program : public handle_impl<program_handle>
 {
@@ -88,7 +89,43 @@ struct program : public handle_impl<program_handle>
 	//-----------------------------------------------------------------------------
 	std::shared_ptr<gfx::uniform> get_uniform(const std::string& _name, bool texture = false);
 
+	//-----------------------------------------------------------------------------
+	//  Name : set_texture ()
+	/// <summary>
+	/// Same as the overload taking the sampler name without the string
+	/// lookup.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_texture(std::uint8_t _stage, const uniform_id& _sampler, gfx::texture* _texture,
+					 std::uint32_t _flags = std::numeric_limits<std::uint32_t>::max());
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_uniform ()
+	/// <summary>
+	/// Same as the overload taking the uniform name without the string
+	/// lookup. The value is not set again if the uniform already holds it in
+	/// this frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_uniform(const uniform_id& _id, const void* _value, std::uint16_t _num = 1);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_uniform ()
+	/// <summary>
+	/// Finds a uniform by the hash of its name. Returns nullptr if the
+	/// program does not have it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	gfx::uniform* get_uniform(const uniform_id& _id) const;
+
 	/// All uniforms for this program.
 	std::unordered_map<std::string, std::shared_ptr<gfx::uniform>> uniforms;
+
+private:
+	void add_uniform(const std::shared_ptr<gfx::uniform>& _uniform);
+
+	/// Uniforms sorted by the hash of their name. Colliding names each keep
+	/// their own entry.
+	std::vector<std::pair<std::uint32_t, gfx::uniform*>> uniforms_by_hash_;
 };
 }
@@ -14,4 +14,19 @@ uniform::uniform(handle_type_t _handle)
 	gfx::get_uniform_info(_handle, info);
 	handle = gfx::create_uniform(info.name, info.type, info.num);
 }
+
+std::uint16_t uniform::get_value_size() const
+{
+	switch(info.type)
+	{
+		case uniform_type::Vec4:
+			return sizeof(float) * 4;
+		case uniform_type::Mat3:
+			return sizeof(float) * 9;
+		case uniform_type::Mat4:
+			return sizeof(float) * 16;
+		default:
+			return sizeof(std::int32_t);
+	}
+}
 }
@@ -1,10 +1,32 @@
 #pragma once
 
 #include "handle_impl.h"
+
+#include "../common/hash.hpp"
+
 #include <string>
 
 namespace gfx
 {
+//-----------------------------------------------------------------------------
+//  Name : uniform_id (Struct)
+/// <summary>
+/// Name of a uniform and its hash computed at compile time. Programs find
+/// their uniforms by the hash so no string is hashed when setting values.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct uniform_id
+{
+	constexpr explicit uniform_id(const char* _name)
+		: name(_name)
+		, hash(utils::fnv1a_hash(_name))
+	{
+	}
+
+	const char* name = nullptr;
+	std::uint32_t hash = 0;
+};
+
 struct uniform : public handle_impl<uniform_handle>
 {
 	uniform() = default;
@@ -28,6 +50,14 @@ struct uniform : public handle_impl<uniform_handle>
 	//-----------------------------------------------------------------------------
 	uniform(handle_type_t _handle);
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_value_size ()
+	/// <summary>
+	/// Size in bytes of a single element of the uniform.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::uint16_t get_value_size() const;
+
 	/// Uniform info
 	uniform_info info;
 };
@@ -0,0 +1,355 @@
+#include "bbox_batch.h"
+#include "../common/platform/config.hpp"
+
+#include <array>
+#include <cmath>
+
+#if ETH_ON(ETH_SIMD_SSE) || ETH_ON(ETH_SIMD_AVX)
+#include <immintrin.h>
+#elif ETH_ON(ETH_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace math
+{
+namespace
+{
+struct plane_soa
+{
+	float a, b, c, d;
+	float abs_a, abs_b, abs_c;
+};
+
+std::array<plane_soa, 6> get_planes(const frustum& f)
+{
+	std::array<plane_soa, 6> result;
+	for(std::size_t i = 0; i < f.planes.size(); ++i)
+	{
+		const auto& p = f.planes[i].data;
+		result[i] = {p.x, p.y, p.z, p.w, std::abs(p.x), std::abs(p.y), std::abs(p.z)};
+	}
+	return result;
+}
+
+// A box is outside when even its point closest to the inside of a plane
+// is in front of it. Works on the center and half size of the box.
+bool is_outside(const std::array<plane_soa, 6>& planes, float cx, float cy, float cz, float ex, float ey,
+				float ez)
+{
+	for(const auto& p : planes)
+	{
+		const float distance = p.a * cx + p.b * cy + p.c * cz + p.d;
+		const float radius = p.abs_a * ex + p.abs_b * ey + p.abs_c * ez;
+		if(distance - radius > 0.0f)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+std::size_t test_bounds_scalar(const std::array<plane_soa, 6>& planes, const bbox_soa& boxes,
+							   std::size_t begin, std::uint64_t* visible)
+{
+	const auto count = boxes.size();
+	for(std::size_t i = begin; i < count; ++i)
+	{
+		const float cx = (boxes.min_x[i] + boxes.max_x[i]) * 0.5f;
+		const float cy = (boxes.min_y[i] + boxes.max_y[i]) * 0.5f;
+		const float cz = (boxes.min_z[i] + boxes.max_z[i]) * 0.5f;
+		const float ex = (boxes.max_x[i] - boxes.min_x[i]) * 0.5f;
+		const float ey = (boxes.max_y[i] - boxes.min_y[i]) * 0.5f;
+		const float ez = (boxes.max_z[i] - boxes.min_z[i]) * 0.5f;
+		if(!is_outside(planes, cx, cy, cz, ex, ey, ez))
+		{
+			visible[i / 64] |= std::uint64_t(1) << (i % 64);
+		}
+	}
+	return count;
+}
+
+#if ETH_ON(ETH_SIMD_AVX)
+// Eight boxes per iteration. Returns the index of the first box left.
+std::size_t test_bounds_simd(const std::array<plane_soa, 6>& planes, const bbox_soa& boxes,
+							 std::uint64_t* visible)
+{
+	const auto count = boxes.size() & ~std::size_t(7);
+	const auto half = _mm256_set1_ps(0.5f);
+	const auto zero = _mm256_setzero_ps();
+	for(std::size_t i = 0; i < count; i += 8)
+	{
+		const auto min_x = _mm256_loadu_ps(&boxes.min_x[i]);
+		const auto min_y = _mm256_loadu_ps(&boxes.min_y[i]);
+		const auto min_z = _mm256_loadu_ps(&boxes.min_z[i]);
+		const auto max_x = _mm256_loadu_ps(&boxes.max_x[i]);
+		const auto max_y = _mm256_loadu_ps(&boxes.max_y[i]);
+		const auto max_z = _mm256_loadu_ps(&boxes.max_z[i]);
+		const auto cx = _mm256_mul_ps(_mm256_add_ps(min_x, max_x), half);
+		const auto cy = _mm256_mul_ps(_mm256_add_ps(min_y, max_y), half);
+		const auto cz = _mm256_mul_ps(_mm256_add_ps(min_z, max_z), half);
+		const auto ex = _mm256_mul_ps(_mm256_sub_ps(max_x, min_x), half);
+		const auto ey = _mm256_mul_ps(_mm256_sub_ps(max_y, min_y), half);
+		const auto ez = _mm256_mul_ps(_mm256_sub_ps(max_z, min_z), half);
+
+		auto outside = _mm256_setzero_ps();
+		for(const auto& p : planes)
+		{
+			auto distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.a), cx), _mm256_set1_ps(p.d));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(p.b), cy));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(p.c), cz));
+			auto radius = _mm256_mul_ps(_mm256_set1_ps(p.abs_a), ex);
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(p.abs_b), ey));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(p.abs_c), ez));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_sub_ps(distance, radius), zero, _CMP_GT_OQ));
+		}
+
+		const auto inside = std::uint64_t(~_mm256_movemask_ps(outside) & 0xff);
+		visible[i / 64] |= inside << (i % 64);
+	}
+	return count;
+}
+#elif ETH_ON(ETH_SIMD_SSE)
+// Four boxes per iteration. Returns the index of the first box left.
+std::size_t test_bounds_simd(const std::array<plane_soa, 6>& planes, const bbox_soa& boxes,
+							 std::uint64_t* visible)
+{
+	const auto count = boxes.size() & ~std::size_t(3);
+	const auto half = _mm_set1_ps(0.5f);
+	const auto zero = _mm_setzero_ps();
+	for(std::size_t i = 0; i < count; i += 4)
+	{
+		const auto min_x = _mm_loadu_ps(&boxes.min_x[i]);
+		const auto min_y = _mm_loadu_ps(&boxes.min_y[i]);
+		const auto min_z = _mm_loadu_ps(&boxes.min_z[i]);
+		const auto max_x = _mm_loadu_ps(&boxes.max_x[i]);
+		const auto max_y = _mm_loadu_ps(&boxes.max_y[i]);
+		const auto max_z = _mm_loadu_ps(&boxes.max_z[i]);
+		const auto cx = _mm_mul_ps(_mm_add_ps(min_x, max_x), half);
+		const auto cy = _mm_mul_ps(_mm_add_ps(min_y, max_y), half);
+		const auto cz = _mm_mul_ps(_mm_add_ps(min_z, max_z), half);
+		const auto ex = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+		const auto ey = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+		const auto ez = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+		auto outside = _mm_setzero_ps();
+		for(const auto& p : planes)
+		{
+			auto distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.a), cx), _mm_set1_ps(p.d));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p.b), cy));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p.c), cz));
+			auto radius = _mm_mul_ps(_mm_set1_ps(p.abs_a), ex);
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(p.abs_b), ey));
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(p.abs_c), ez));
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(_mm_sub_ps(distance, radius), zero));
+		}
+
+		const auto inside = std::uint64_t(~_mm_movemask_ps(outside) & 0xf);
+		visible[i / 64] |= inside << (i % 64);
+	}
+	return count;
+}
+#elif ETH_ON(ETH_SIMD_NEON)
+// Four boxes per iteration. Returns the index of the first box left.
+std::size_t test_bounds_simd(const std::array<plane_soa, 6>& planes, const bbox_soa& boxes,
+							 std::uint64_t* visible)
+{
+	const auto count = boxes.size() & ~std::size_t(3);
+	const auto half = vdupq_n_f32(0.5f);
+	const auto zero = vdupq_n_f32(0.0f);
+	const std::uint32_t lane_bits[4] = {1, 2, 4, 8};
+	const auto bits = vld1q_u32(lane_bits);
+	for(std::size_t i = 0; i < count; i += 4)
+	{
+		const auto min_x = vld1q_f32(&boxes.min_x[i]);
+		const auto min_y = vld1q_f32(&boxes.min_y[i]);
+		const auto min_z = vld1q_f32(&boxes.min_z[i]);
+		const auto max_x = vld1q_f32(&boxes.max_x[i]);
+		const auto max_y = vld1q_f32(&boxes.max_y[i]);
+		const auto max_z = vld1q_f32(&boxes.max_z[i]);
+		const auto cx = vmulq_f32(vaddq_f32(min_x, max_x), half);
+		const auto cy = vmulq_f32(vaddq_f32(min_y, max_y), half);
+		const auto cz = vmulq_f32(vaddq_f32(min_z, max_z), half);
+		const auto ex = vmulq_f32(vsubq_f32(max_x, min_x), half);
+		const auto ey = vmulq_f32(vsubq_f32(max_y, min_y), half);
+		const auto ez = vmulq_f32(vsubq_f32(max_z, min_z), half);
+
+		auto outside = vdupq_n_u32(0);
+		for(const auto& p : planes)
+		{
+			auto distance = vmlaq_n_f32(vdupq_n_f32(p.d), cx, p.a);
+			distance = vmlaq_n_f32(distance, cy, p.b);
+			distance = vmlaq_n_f32(distance, cz, p.c);
+			auto radius = vmulq_n_f32(ex, p.abs_a);
+			radius = vmlaq_n_f32(radius, ey, p.abs_b);
+			radius = vmlaq_n_f32(radius, ez, p.abs_c);
+			outside = vorrq_u32(outside, vcgtq_f32(vsubq_f32(distance, radius), zero));
+		}
+
+		// pack the lanes into four bits
+		const auto lanes = vandq_u32(vmvnq_u32(outside), bits);
+		const auto pairs = vpadd_u32(vget_low_u32(lanes), vget_high_u32(lanes));
+		const auto inside = std::uint64_t(vget_lane_u32(vpadd_u32(pairs, pairs), 0));
+		visible[i / 64] |= inside << (i % 64);
+	}
+	return count;
+}
+#else
+std::size_t test_bounds_simd(const std::array<plane_soa, 6>& /*unused*/, const bbox_soa& /*unused*/,
+							 std::uint64_t* /*unused*/)
+{
+	return 0;
+}
+#endif
+
+#if ETH_ON(ETH_SIMD_SELSE) && ETH_ON(ETH_SIMD_AVELSE) && ETH_ON(ETH_SIMD_NELSE)
+void transform_bounds_scalar(const bbox& local, const mat4& m, bbox_soa& out, std::size_t i)
+{
+	const auto center = (local.min + local.max) * 0.5f;
+	const auto extents = (local.max - local.min) * 0.5f;
+	const auto world_center =
+		vec3(m[0]) * center.x + vec3(m[1]) * center.y + vec3(m[2]) * center.z + vec3(m[3]);
+	const auto world_extents = abs(vec3(m[0])) * extents.x + abs(vec3(m[1])) * extents.y +
+							   abs(vec3(m[2])) * extents.z;
+
+	out.min_x[i] = world_center.x - world_extents.x;
+	out.min_y[i] = world_center.y - world_extents.y;
+	out.min_z[i] = world_center.z - world_extents.z;
+	out.max_x[i] = world_center.x + world_extents.x;
+	out.max_y[i] = world_center.y + world_extents.y;
+	out.max_z[i] = world_center.z + world_extents.z;
+}
+#endif
+}
+
+void bbox_soa::resize(std::size_t count)
+{
+	min_x.resize(count);
+	min_y.resize(count);
+	min_z.resize(count);
+	max_x.resize(count);
+	max_y.resize(count);
+	max_z.resize(count);
+}
+
+void bbox_soa::clear()
+{
+	resize(0);
+}
+
+void bbox_soa::set(std::size_t i, const bbox& bounds)
+{
+	min_x[i] = bounds.min.x;
+	min_y[i] = bounds.min.y;
+	min_z[i] = bounds.min.z;
+	max_x[i] = bounds.max.x;
+	max_y[i] = bounds.max.y;
+	max_z[i] = bounds.max.z;
+}
+
+bbox bbox_soa::get(std::size_t i) const
+{
+	return bbox(min_x[i], min_y[i], min_z[i], max_x[i], max_y[i], max_z[i]);
+}
+
+void transform_bounds(const bbox* local, const transform* world, std::size_t count, bbox_soa& out)
+{
+	out.resize(count);
+
+#if ETH_ON(ETH_SIMD_SSE) || ETH_ON(ETH_SIMD_AVX)
+	// One box at a time with the matrix columns in the lanes, the matrices
+	// are stored per object so there is nothing to gain from going wider.
+	const auto half = _mm_set1_ps(0.5f);
+	const auto abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		const auto& m = world[i].get_matrix();
+		const auto& b = local[i];
+		const auto col0 = _mm_loadu_ps(&m[0][0]);
+		const auto col1 = _mm_loadu_ps(&m[1][0]);
+		const auto col2 = _mm_loadu_ps(&m[2][0]);
+		const auto col3 = _mm_loadu_ps(&m[3][0]);
+
+		const auto lo = _mm_set_ps(0.0f, b.min.z, b.min.y, b.min.x);
+		const auto hi = _mm_set_ps(0.0f, b.max.z, b.max.y, b.max.x);
+		const auto center = _mm_mul_ps(_mm_add_ps(lo, hi), half);
+		const auto extents = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+
+		auto world_center = _mm_add_ps(col3, _mm_mul_ps(col0, _mm_shuffle_ps(center, center, 0x00)));
+		world_center = _mm_add_ps(world_center, _mm_mul_ps(col1, _mm_shuffle_ps(center, center, 0x55)));
+		world_center = _mm_add_ps(world_center, _mm_mul_ps(col2, _mm_shuffle_ps(center, center, 0xaa)));
+
+		auto world_extents = _mm_mul_ps(_mm_and_ps(col0, abs_mask), _mm_shuffle_ps(extents, extents, 0x00));
+		world_extents = _mm_add_ps(
+			world_extents, _mm_mul_ps(_mm_and_ps(col1, abs_mask), _mm_shuffle_ps(extents, extents, 0x55)));
+		world_extents = _mm_add_ps(
+			world_extents, _mm_mul_ps(_mm_and_ps(col2, abs_mask), _mm_shuffle_ps(extents, extents, 0xaa)));
+
+		alignas(16) float world_min[4];
+		alignas(16) float world_max[4];
+		_mm_store_ps(world_min, _mm_sub_ps(world_center, world_extents));
+		_mm_store_ps(world_max, _mm_add_ps(world_center, world_extents));
+		out.min_x[i] = world_min[0];
+		out.min_y[i] = world_min[1];
+		out.min_z[i] = world_min[2];
+		out.max_x[i] = world_max[0];
+		out.max_y[i] = world_max[1];
+		out.max_z[i] = world_max[2];
+	}
+#elif ETH_ON(ETH_SIMD_NEON)
+	const auto half = vdupq_n_f32(0.5f);
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		const auto& m = world[i].get_matrix();
+		const auto& b = local[i];
+		const auto col0 = vld1q_f32(&m[0][0]);
+		const auto col1 = vld1q_f32(&m[1][0]);
+		const auto col2 = vld1q_f32(&m[2][0]);
+		const auto col3 = vld1q_f32(&m[3][0]);
+
+		const float min_values[4] = {b.min.x, b.min.y, b.min.z, 0.0f};
+		const float max_values[4] = {b.max.x, b.max.y, b.max.z, 0.0f};
+		const auto lo = vld1q_f32(min_values);
+		const auto hi = vld1q_f32(max_values);
+		const auto center = vmulq_f32(vaddq_f32(lo, hi), half);
+		const auto extents = vmulq_f32(vsubq_f32(hi, lo), half);
+
+		auto world_center = vmlaq_n_f32(col3, col0, vgetq_lane_f32(center, 0));
+		world_center = vmlaq_n_f32(world_center, col1, vgetq_lane_f32(center, 1));
+		world_center = vmlaq_n_f32(world_center, col2, vgetq_lane_f32(center, 2));
+
+		auto world_extents = vmulq_n_f32(vabsq_f32(col0), vgetq_lane_f32(extents, 0));
+		world_extents = vmlaq_n_f32(world_extents, vabsq_f32(col1), vgetq_lane_f32(extents, 1));
+		world_extents = vmlaq_n_f32(world_extents, vabsq_f32(col2), vgetq_lane_f32(extents, 2));
+
+		float world_min[4];
+		float world_max[4];
+		vst1q_f32(world_min, vsubq_f32(world_center, world_extents));
+		vst1q_f32(world_max, vaddq_f32(world_center, world_extents));
+		out.min_x[i] = world_min[0];
+		out.min_y[i] = world_min[1];
+		out.min_z[i] = world_min[2];
+		out.max_x[i] = world_max[0];
+		out.max_y[i] = world_max[1];
+		out.max_z[i] = world_max[2];
+	}
+#else
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		transform_bounds_scalar(local[i], world[i].get_matrix(), out, i);
+	}
+#endif
+}
+
+void test_bounds(const frustum& f, const bbox_soa& boxes, std::vector<std::uint64_t>& visible)
+{
+	visible.assign((boxes.size() + 63) / 64, 0);
+	if(boxes.size() == 0)
+	{
+		return;
+	}
+
+	const auto planes = get_planes(f);
+	const auto done = test_bounds_simd(planes, boxes, visible.data());
+	test_bounds_scalar(planes, boxes, done, visible.data());
+}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "bbox.h"
+#include "frustum.h"
+#include "transform.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace math
+{
+//-----------------------------------------------------------------------------
+// Main class declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//  Name : bbox_soa (Struct)
+/// <summary>
+/// Many boxes stored as one array per component so that several of them
+/// can be processed by a single simd instruction.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct bbox_soa
+{
+	void resize(std::size_t count);
+	void clear();
+	void set(std::size_t i, const bbox& bounds);
+	bbox get(std::size_t i) const;
+
+	std::size_t size() const
+	{
+		return min_x.size();
+	}
+
+	std::vector<float> min_x;
+	std::vector<float> min_y;
+	std::vector<float> min_z;
+	std::vector<float> max_x;
+	std::vector<float> max_y;
+	std::vector<float> max_z;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : transform_bounds ()
+/// <summary>
+/// Transforms every local box by the matrix with the same index and stores
+/// the axis aligned boxes enclosing the results. Gives the same boxes as
+/// bbox::mul. The output is resized to count.
+/// </summary>
+//-----------------------------------------------------------------------------
+void transform_bounds(const bbox* local, const transform* world, std::size_t count, bbox_soa& out);
+
+//-----------------------------------------------------------------------------
+//  Name : test_bounds ()
+/// <summary>
+/// Tests every box against the frustum and sets bit i of the mask when box
+/// i is at least partially inside, like frustum::test_aabb. The mask is
+/// resized to hold one bit per box.
+/// </summary>
+//-----------------------------------------------------------------------------
+void test_bounds(const frustum& f, const bbox_soa& boxes, std::vector<std::uint64_t>& visible);
+
+//-----------------------------------------------------------------------------
+//  Name : is_visible ()
+/// <summary>
+/// Reads the bit of a box from a mask written by test_bounds.
+/// </summary>
+//-----------------------------------------------------------------------------
+inline bool is_visible(const std::vector<std::uint64_t>& visible, std::size_t i)
+{
+	return ((visible[i / 64] >> (i % 64)) & 0x1) != 0;
+}
+}
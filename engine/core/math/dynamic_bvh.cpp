@@ -0,0 +1,286 @@
+#include "dynamic_bvh.h"
+
+#include <algorithm>
+
+namespace math
+{
+namespace
+{
+bbox combine(const bbox& a, const bbox& b)
+{
+	return bbox(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+float surface_area(const bbox& bounds)
+{
+	const auto d = bounds.max - bounds.min;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool contains(const bbox& outer, const bbox& inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+		   inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+}
+
+dynamic_bvh::dynamic_bvh(float margin)
+	: margin_(margin)
+{
+}
+
+std::uint32_t dynamic_bvh::insert(const bbox& bounds, std::uint64_t user_data)
+{
+	const auto proxy = allocate_node();
+	auto& n = nodes_[proxy];
+	n.bounds = bounds;
+	n.bounds.inflate(margin_);
+	n.user_data = user_data;
+	n.height = 0;
+
+	insert_leaf(proxy);
+	++count_;
+	return proxy;
+}
+
+void dynamic_bvh::remove(std::uint32_t proxy)
+{
+	remove_leaf(proxy);
+	free_node(proxy);
+	--count_;
+}
+
+bool dynamic_bvh::update(std::uint32_t proxy, const bbox& bounds)
+{
+	if(contains(nodes_[proxy].bounds, bounds))
+	{
+		return false;
+	}
+
+	remove_leaf(proxy);
+	nodes_[proxy].bounds = bounds;
+	nodes_[proxy].bounds.inflate(margin_);
+	insert_leaf(proxy);
+	return true;
+}
+
+void dynamic_bvh::clear()
+{
+	nodes_.clear();
+	root_ = null_node;
+	free_list_ = null_node;
+	count_ = 0;
+}
+
+std::uint32_t dynamic_bvh::allocate_node()
+{
+	if(free_list_ == null_node)
+	{
+		nodes_.emplace_back();
+		return static_cast<std::uint32_t>(nodes_.size() - 1);
+	}
+
+	const auto index = free_list_;
+	free_list_ = nodes_[index].parent;
+	nodes_[index] = node();
+	return index;
+}
+
+void dynamic_bvh::free_node(std::uint32_t index)
+{
+	auto& n = nodes_[index];
+	n.parent = free_list_;
+	n.child1 = null_node;
+	n.child2 = null_node;
+	n.height = -1;
+	free_list_ = index;
+}
+
+void dynamic_bvh::insert_leaf(std::uint32_t leaf)
+{
+	if(root_ == null_node)
+	{
+		root_ = leaf;
+		nodes_[root_].parent = null_node;
+		return;
+	}
+
+	// walk down choosing the child that grows the least in surface area
+	const auto leaf_bounds = nodes_[leaf].bounds;
+	auto index = root_;
+	while(!nodes_[index].is_leaf())
+	{
+		const auto& n = nodes_[index];
+		const auto area = surface_area(n.bounds);
+		const auto combined_area = surface_area(combine(n.bounds, leaf_bounds));
+
+		// cost of making a new parent for this node and the new leaf
+		const auto cost = 2.0f * combined_area;
+		// minimum cost of pushing the leaf further down the tree
+		const auto inheritance_cost = 2.0f * (combined_area - area);
+
+		const auto child_cost = [&](std::uint32_t child) {
+			const auto& c = nodes_[child];
+			const auto enlarged = surface_area(combine(c.bounds, leaf_bounds));
+			if(c.is_leaf())
+			{
+				return enlarged + inheritance_cost;
+			}
+			return enlarged - surface_area(c.bounds) + inheritance_cost;
+		};
+
+		const auto cost1 = child_cost(n.child1);
+		const auto cost2 = child_cost(n.child2);
+		if(cost < cost1 && cost < cost2)
+		{
+			break;
+		}
+
+		index = cost1 < cost2 ? n.child1 : n.child2;
+	}
+
+	const auto sibling = index;
+	const auto old_parent = nodes_[sibling].parent;
+	const auto new_parent = allocate_node();
+	{
+		auto& p = nodes_[new_parent];
+		p.parent = old_parent;
+		p.bounds = combine(leaf_bounds, nodes_[sibling].bounds);
+		p.height = nodes_[sibling].height + 1;
+		p.child1 = sibling;
+		p.child2 = leaf;
+	}
+	nodes_[sibling].parent = new_parent;
+	nodes_[leaf].parent = new_parent;
+
+	if(old_parent == null_node)
+	{
+		root_ = new_parent;
+	}
+	else if(nodes_[old_parent].child1 == sibling)
+	{
+		nodes_[old_parent].child1 = new_parent;
+	}
+	else
+	{
+		nodes_[old_parent].child2 = new_parent;
+	}
+
+	refit(new_parent);
+}
+
+void dynamic_bvh::remove_leaf(std::uint32_t leaf)
+{
+	if(leaf == root_)
+	{
+		root_ = null_node;
+		return;
+	}
+
+	const auto parent = nodes_[leaf].parent;
+	const auto grand_parent = nodes_[parent].parent;
+	const auto sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+	free_node(parent);
+	nodes_[sibling].parent = grand_parent;
+	if(grand_parent == null_node)
+	{
+		root_ = sibling;
+		return;
+	}
+
+	if(nodes_[grand_parent].child1 == parent)
+	{
+		nodes_[grand_parent].child1 = sibling;
+	}
+	else
+	{
+		nodes_[grand_parent].child2 = sibling;
+	}
+
+	refit(grand_parent);
+}
+
+void dynamic_bvh::refit(std::uint32_t index)
+{
+	while(index != null_node)
+	{
+		index = balance(index);
+
+		auto& n = nodes_[index];
+		const auto& c1 = nodes_[n.child1];
+		const auto& c2 = nodes_[n.child2];
+		n.height = 1 + std::max(c1.height, c2.height);
+		n.bounds = combine(c1.bounds, c2.bounds);
+
+		index = n.parent;
+	}
+}
+
+std::uint32_t dynamic_bvh::balance(std::uint32_t a)
+{
+	// rotates the taller grand child up when the two subtrees of 'a' differ
+	// in height by more than one, returns the node now in the place of 'a'
+	if(nodes_[a].is_leaf() || nodes_[a].height < 2)
+	{
+		return a;
+	}
+
+	const auto b = nodes_[a].child1;
+	const auto c = nodes_[a].child2;
+	const auto difference = nodes_[c].height - nodes_[b].height;
+	if(difference >= -1 && difference <= 1)
+	{
+		return a;
+	}
+
+	// 'up' is the taller child which takes the place of 'a'
+	const auto up = difference > 1 ? c : b;
+	const auto other = difference > 1 ? b : c;
+	const auto f = nodes_[up].child1;
+	const auto g = nodes_[up].child2;
+
+	nodes_[up].child1 = a;
+	nodes_[up].parent = nodes_[a].parent;
+	nodes_[a].parent = up;
+
+	const auto old_parent = nodes_[up].parent;
+	if(old_parent == null_node)
+	{
+		root_ = up;
+	}
+	else if(nodes_[old_parent].child1 == a)
+	{
+		nodes_[old_parent].child1 = up;
+	}
+	else
+	{
+		nodes_[old_parent].child2 = up;
+	}
+
+	// the taller grand child stays under 'up', the other one replaces 'up'
+	// under 'a'
+	const auto keep = nodes_[f].height > nodes_[g].height ? f : g;
+	const auto move = keep == f ? g : f;
+	nodes_[up].child2 = keep;
+	if(difference > 1)
+	{
+		nodes_[a].child2 = move;
+	}
+	else
+	{
+		nodes_[a].child1 = move;
+	}
+	nodes_[move].parent = a;
+
+	auto& na = nodes_[a];
+	na.bounds = combine(nodes_[other].bounds, nodes_[move].bounds);
+	na.height = 1 + std::max(nodes_[other].height, nodes_[move].height);
+
+	auto& nu = nodes_[up];
+	nu.bounds = combine(na.bounds, nodes_[keep].bounds);
+	nu.height = 1 + std::max(na.height, nodes_[keep].height);
+
+	return up;
+}
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include "bbox.h"
+#include "frustum.h"
+#include "math_types.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace math
+{
+//-----------------------------------------------------------------------------
+// Main class declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//  Name : dynamic_bvh (Class)
+/// <summary>
+/// Dynamic bounding volume hierarchy of axis aligned boxes. Every leaf
+/// stores a box slightly larger than the one it was inserted with so that
+/// objects moving a little do not have to be reinserted every frame.
+/// Queries walk the tree top down and skip whole subtrees that are outside
+/// of the query volume.
+/// </summary>
+//-----------------------------------------------------------------------------
+class dynamic_bvh
+{
+public:
+	static const std::uint32_t null_node = 0xffffffff;
+
+	//-------------------------------------------------------------------------
+	// Constructors & Destructors
+	//-------------------------------------------------------------------------
+	explicit dynamic_bvh(float margin = 0.1f);
+
+	//-------------------------------------------------------------------------
+	// Public Methods
+	//-------------------------------------------------------------------------
+	//-----------------------------------------------------------------------------
+	//  Name : insert ()
+	/// <summary>
+	/// Inserts a box into the tree and returns the proxy used to refer to it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::uint32_t insert(const bbox& bounds, std::uint64_t user_data);
+
+	//-----------------------------------------------------------------------------
+	//  Name : remove ()
+	/// <summary>
+	/// Removes a proxy previously returned by insert.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void remove(std::uint32_t proxy);
+
+	//-----------------------------------------------------------------------------
+	//  Name : update ()
+	/// <summary>
+	/// Updates the box of a proxy. The proxy is only reinserted when the new
+	/// box is no longer contained by the enlarged one stored in the tree.
+	/// Returns true if the tree was changed.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool update(std::uint32_t proxy, const bbox& bounds);
+
+	//-----------------------------------------------------------------------------
+	//  Name : clear ()
+	/// <summary>
+	/// Removes every proxy.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void clear();
+
+	std::uint64_t get_user_data(std::uint32_t proxy) const
+	{
+		return nodes_[proxy].user_data;
+	}
+
+	const bbox& get_fat_bounds(std::uint32_t proxy) const
+	{
+		return nodes_[proxy].bounds;
+	}
+
+	std::size_t size() const
+	{
+		return count_;
+	}
+
+	bool empty() const
+	{
+		return count_ == 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : query ()
+	/// <summary>
+	/// Calls the visitor with the user data of every proxy whose box is at
+	/// least partially inside the frustum. Planes a node is fully inside of
+	/// are not tested again for any of its children.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename F>
+	void query(const frustum& volume, F&& visitor) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : query ()
+	/// <summary>
+	/// Calls the visitor with the user data of every proxy whose box
+	/// intersects the specified box.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename F>
+	void query(const bbox& volume, F&& visitor) const;
+
+private:
+	struct node
+	{
+		bbox bounds;
+		std::uint64_t user_data = 0;
+		// doubles as the next free node when the node is not used
+		std::uint32_t parent = null_node;
+		std::uint32_t child1 = null_node;
+		std::uint32_t child2 = null_node;
+		// leaf is 0, free node is -1
+		std::int32_t height = -1;
+
+		bool is_leaf() const
+		{
+			return child1 == null_node;
+		}
+	};
+
+	//-------------------------------------------------------------------------
+	// Private Methods
+	//-------------------------------------------------------------------------
+	std::uint32_t allocate_node();
+	void free_node(std::uint32_t index);
+	void insert_leaf(std::uint32_t leaf);
+	void remove_leaf(std::uint32_t leaf);
+	std::uint32_t balance(std::uint32_t index);
+	void refit(std::uint32_t index);
+
+	//-------------------------------------------------------------------------
+	// Private Member Variables
+	//-------------------------------------------------------------------------
+	std::vector<node> nodes_;
+	std::uint32_t root_ = null_node;
+	std::uint32_t free_list_ = null_node;
+	std::size_t count_ = 0;
+	float margin_ = 0.1f;
+};
+
+template <typename F>
+inline void dynamic_bvh::query(const frustum& volume, F&& visitor) const
+{
+	if(root_ == null_node)
+	{
+		return;
+	}
+
+	// the stack is local so that several queries can run in parallel
+	std::vector<std::pair<std::uint32_t, unsigned int>> stack;
+	stack.reserve(64);
+	stack.emplace_back(root_, 0u);
+	while(!stack.empty())
+	{
+		const auto index = stack.back().first;
+		auto bits = stack.back().second;
+		stack.pop_back();
+
+		const auto& n = nodes_[index];
+		int last_outside = -1;
+		if(volume.classify_aabb(n.bounds, bits, last_outside) == volume_query::outside)
+		{
+			continue;
+		}
+
+		if(n.is_leaf())
+		{
+			visitor(n.user_data);
+		}
+		else
+		{
+			stack.emplace_back(n.child1, bits);
+			stack.emplace_back(n.child2, bits);
+		}
+	}
+}
+
+template <typename F>
+inline void dynamic_bvh::query(const bbox& volume, F&& visitor) const
+{
+	if(root_ == null_node)
+	{
+		return;
+	}
+
+	// the stack is local so that several queries can run in parallel
+	std::vector<std::uint32_t> stack;
+	stack.reserve(64);
+	stack.emplace_back(root_);
+	while(!stack.empty())
+	{
+		const auto index = stack.back();
+		stack.pop_back();
+
+		const auto& n = nodes_[index];
+		if(!n.bounds.intersect(volume))
+		{
+			continue;
+		}
+
+		if(n.is_leaf())
+		{
+			visitor(n.user_data);
+		}
+		else
+		{
+			stack.emplace_back(n.child1);
+			stack.emplace_back(n.child2);
+		}
+	}
+}
+}
@@ -492,18 +492,38 @@ bool frustum::test_aabb(const bbox& AABB) const
 }
 
 //-----------------------------------------------------------------------------
-//  Name : testAABB ()
+//  Name : testOBB ()
 /// <summary>
-/// Determine whether or not the box passed is within the frustum.
+/// Determine whether or not the box passed is within the frustum once
+/// transformed by t. The box axes are projected onto the plane normals so
+/// neither the frustum nor the inverse of t are needed.
 /// </summary>
 //-----------------------------------------------------------------------------
-bool frustum::test_obb(frustum frustum, const bbox& AABB, const transform& t)
+bool frustum::test_obb(const frustum& f, const bbox& AABB, const transform& t)
 {
-	transform invTransform = inverse(t);
+	const auto& m = t.get_matrix();
+	const auto extents = AABB.get_extents();
+	const vec3 center = m * vec4(AABB.get_center(), 1.0f);
+	const vec3 axis_x = vec3(m[0]) * extents.x;
+	const vec3 axis_y = vec3(m[1]) * extents.y;
+	const vec3 axis_z = vec3(m[2]) * extents.z;
+
+	for(const auto& plane : f.planes)
+	{
+		const vec3 normal(plane.data);
+		const float radius =
+			glm::abs(dot(normal, axis_x)) + glm::abs(dot(normal, axis_y)) + glm::abs(dot(normal, axis_z));
 
-	frustum.mul(invTransform);
+		// If even the nearest point is outside, then the box is totally
+		// outside the frustum
+		if(plane::dot_coord(plane, center) - radius > 0.0f)
+		{
+			return false;
+		}
+	}
 
-	return frustum.test_aabb(AABB);
+	// Intersecting / inside
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -53,7 +53,7 @@ public:
 	// Public Static Functions
 	//-------------------------------------------------------------------------
 	static frustum mul(frustum f, const transform& t);
-	static bool test_obb(frustum f, const bbox& bounds, const transform& t);
+	static bool test_obb(const frustum& f, const bbox& bounds, const transform& t);
 	static bool test_extruded_obb(frustum f, const bbox_extruded& bounds, const transform& t);
 	static volume_query classify_obb(frustum f, const bbox& bounds, const transform& t);
 	static volume_query classify_obb(frustum f, const bbox& bounds, const transform& t,
@@ -1,10 +1,13 @@
 #pragma once
 
 #include "bbox.h"
+#include "bbox_batch.h"
 #include "bbox_extruded.h"
 #include "bsphere.h"
+#include "dynamic_bvh.h"
 #include "frustum.h"
 #include "math_types.h"
+#include "matrix_simd.h"
 #include "plane.h"
 #include "transform.h"
 #include <cstdint>
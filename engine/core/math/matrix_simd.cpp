@@ -0,0 +1,62 @@
+#include "matrix_simd.h"
+#include "../common/platform/config.hpp"
+
+#if ETH_ON(ETH_SIMD_SSE) || ETH_ON(ETH_SIMD_AVX)
+#include <immintrin.h>
+#elif ETH_ON(ETH_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace math
+{
+// Matrices are column major, column j of the result is the lhs columns
+// weighted by the components of column j of rhs.
+#if ETH_ON(ETH_SIMD_SSE) || ETH_ON(ETH_SIMD_AVX)
+void multiply(const transform::mat4_t& lhs, const transform::mat4_t& rhs, transform::mat4_t& out)
+{
+	const float* l = value_ptr(lhs);
+	const float* r = value_ptr(rhs);
+	const auto c0 = _mm_loadu_ps(l + 0);
+	const auto c1 = _mm_loadu_ps(l + 4);
+	const auto c2 = _mm_loadu_ps(l + 8);
+	const auto c3 = _mm_loadu_ps(l + 12);
+
+	float* o = value_ptr(out);
+	for(int j = 0; j < 4; ++j)
+	{
+		const auto col = _mm_loadu_ps(r + j * 4);
+		auto result = _mm_mul_ps(c0, _mm_shuffle_ps(col, col, _MM_SHUFFLE(0, 0, 0, 0)));
+		result = _mm_add_ps(result, _mm_mul_ps(c1, _mm_shuffle_ps(col, col, _MM_SHUFFLE(1, 1, 1, 1))));
+		result = _mm_add_ps(result, _mm_mul_ps(c2, _mm_shuffle_ps(col, col, _MM_SHUFFLE(2, 2, 2, 2))));
+		result = _mm_add_ps(result, _mm_mul_ps(c3, _mm_shuffle_ps(col, col, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm_storeu_ps(o + j * 4, result);
+	}
+}
+#elif ETH_ON(ETH_SIMD_NEON)
+void multiply(const transform::mat4_t& lhs, const transform::mat4_t& rhs, transform::mat4_t& out)
+{
+	const float* l = value_ptr(lhs);
+	const float* r = value_ptr(rhs);
+	const auto c0 = vld1q_f32(l + 0);
+	const auto c1 = vld1q_f32(l + 4);
+	const auto c2 = vld1q_f32(l + 8);
+	const auto c3 = vld1q_f32(l + 12);
+
+	float* o = value_ptr(out);
+	for(int j = 0; j < 4; ++j)
+	{
+		const auto col = vld1q_f32(r + j * 4);
+		auto result = vmulq_n_f32(c0, vgetq_lane_f32(col, 0));
+		result = vmlaq_n_f32(result, c1, vgetq_lane_f32(col, 1));
+		result = vmlaq_n_f32(result, c2, vgetq_lane_f32(col, 2));
+		result = vmlaq_n_f32(result, c3, vgetq_lane_f32(col, 3));
+		vst1q_f32(o + j * 4, result);
+	}
+}
+#else
+void multiply(const transform::mat4_t& lhs, const transform::mat4_t& rhs, transform::mat4_t& out)
+{
+	out = lhs * rhs;
+}
+#endif
+}
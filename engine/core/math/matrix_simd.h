@@ -0,0 +1,15 @@
+#pragma once
+
+#include "transform.h"
+
+namespace math
+{
+//-----------------------------------------------------------------------------
+//  Name : multiply ()
+/// <summary>
+/// Computes lhs * rhs using simd when the target supports it. Gives the
+/// same result as the glm operator. The output may be one of the inputs.
+/// </summary>
+//-----------------------------------------------------------------------------
+void multiply(const transform::mat4_t& lhs, const transform::mat4_t& rhs, transform::mat4_t& out);
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace core
+{
+
+//-----------------------------------------------------------------------------
+//  Name : block_pool
+/// <summary>
+/// Process wide pool of fixed size blocks. Blocks are carved out of
+/// contiguous chunks which grow geometrically, so objects allocated one
+/// after another end up next to each other in memory. Freed blocks are
+/// recycled and the chunks are never returned to the system.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <std::size_t Size, std::size_t Align>
+class block_pool
+{
+	union node {
+		node* next;
+		typename std::aligned_storage<Size, Align>::type storage;
+	};
+
+public:
+	//-----------------------------------------------------------------------------
+	//  Name : get ()
+	/// <summary>
+	/// Gets the pool instance. It is intentionally leaked since blocks can
+	/// be released during static destruction (e.g. a weak_ptr control block).
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static block_pool& get()
+	{
+		static auto pool = new block_pool();
+		return *pool;
+	}
+
+	void* allocate()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(free_ == nullptr)
+		{
+			grow();
+		}
+		auto result = free_;
+		free_ = free_->next;
+		return result;
+	}
+
+	void deallocate(void* p)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto n = static_cast<node*>(p);
+		n->next = free_;
+		free_ = n;
+	}
+
+private:
+	block_pool() = default;
+
+	void grow()
+	{
+		auto chunk = std::make_unique<node[]>(chunk_size_);
+		for(std::size_t i = chunk_size_; i > 0; --i)
+		{
+			chunk[i - 1].next = free_;
+			free_ = &chunk[i - 1];
+		}
+		chunks_.emplace_back(std::move(chunk));
+		chunk_size_ = chunk_size_ * 2;
+	}
+
+	std::mutex mutex_;
+	node* free_ = nullptr;
+	std::size_t chunk_size_ = 64;
+	std::vector<std::unique_ptr<node[]>> chunks_;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : pool_allocator
+/// <summary>
+/// Stateless allocator that serves single object allocations from a
+/// block_pool shared by every allocator of the same size and alignment.
+/// Arrays and over-aligned types go through the global operator new.
+/// Meant to be used with std::allocate_shared to keep objects of the same
+/// type packed together.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename T>
+class pool_allocator
+{
+	using pool_t = block_pool<sizeof(T), alignof(T)>;
+	static const bool pooled = alignof(T) <= alignof(std::max_align_t);
+
+public:
+	using value_type = T;
+
+	template <typename U>
+	struct rebind
+	{
+		using other = pool_allocator<U>;
+	};
+
+	pool_allocator() = default;
+
+	template <typename U>
+	pool_allocator(const pool_allocator<U>& /*unused*/)
+	{
+	}
+
+	T* allocate(std::size_t n)
+	{
+		if(pooled && n == 1)
+		{
+			return static_cast<T*>(pool_t::get().allocate());
+		}
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, std::size_t n)
+	{
+		if(pooled && n == 1)
+		{
+			pool_t::get().deallocate(p);
+			return;
+		}
+		::operator delete(p);
+	}
+
+	template <typename U>
+	bool operator==(const pool_allocator<U>& /*unused*/) const
+	{
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const pool_allocator<U>& /*unused*/) const
+	{
+		return false;
+	}
+};
+}
@@ -0,0 +1,94 @@
+#include "task_graph.h"
+
+#include <algorithm>
+
+namespace core
+{
+namespace
+{
+bool intersects(const std::vector<task_graph::resource_id_t>& lhs,
+				const std::vector<task_graph::resource_id_t>& rhs)
+{
+	return std::find_first_of(std::begin(lhs), std::end(lhs), std::begin(rhs), std::end(rhs)) !=
+		   std::end(lhs);
+}
+}
+
+task_graph::node_id_t task_graph::add_node(const std::string& name, std::vector<resource_id_t> reads,
+										   std::vector<resource_id_t> writes, std::function<void()> work,
+										   bool on_owner_thread)
+{
+	node n;
+	n.name = name;
+	n.reads = std::move(reads);
+	n.writes = std::move(writes);
+	n.work = std::move(work);
+	n.on_owner_thread = on_owner_thread;
+
+	for(node_id_t i = 0; i < nodes_.size(); ++i)
+	{
+		const auto& other = nodes_[i];
+		const bool conflict = intersects(other.writes, n.reads) || intersects(other.writes, n.writes) ||
+							  intersects(other.reads, n.writes);
+		if(conflict)
+		{
+			n.dependencies.emplace_back(i);
+		}
+	}
+
+	nodes_.emplace_back(std::move(n));
+	return nodes_.size() - 1;
+}
+
+void task_graph::run(task_system& system)
+{
+	std::vector<task_future<void>> futures;
+	futures.reserve(nodes_.size());
+
+	std::vector<task_future<void>> dependencies;
+	for(const auto& n : nodes_)
+	{
+		dependencies.clear();
+		for(const auto dependency : n.dependencies)
+		{
+			dependencies.emplace_back(futures[dependency]);
+		}
+
+		const auto* work = &n.work;
+		auto func = [work]() { (*work)(); };
+		if(n.on_owner_thread)
+		{
+			futures.emplace_back(system.push_on_owner_thread_after(dependencies, func));
+		}
+		else
+		{
+			futures.emplace_back(system.push_on_worker_thread_after(dependencies, func));
+		}
+	}
+
+	for(const auto& f : futures)
+	{
+		f.wait();
+	}
+}
+
+void task_graph::clear()
+{
+	nodes_.clear();
+}
+
+const std::vector<task_graph::node_id_t>& task_graph::get_dependencies(node_id_t id) const
+{
+	return nodes_.at(id).dependencies;
+}
+
+const std::string& task_graph::get_name(node_id_t id) const
+{
+	return nodes_.at(id).name;
+}
+
+std::size_t task_graph::size() const
+{
+	return nodes_.size();
+}
+}
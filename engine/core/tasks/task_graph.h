@@ -0,0 +1,74 @@
+#pragma once
+
+#include "task_system.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace core
+{
+
+//-----------------------------------------------------------------------------
+//  Name : task_graph
+/// <summary>
+/// A small graph of work items for a frame. Every node declares the
+/// resources it reads and writes (e.g. component type ids). A node runs after
+/// every previously added node that writes something it touches or reads
+/// something it writes. Nodes without such conflicts run in parallel.
+/// </summary>
+//-----------------------------------------------------------------------------
+class task_graph
+{
+public:
+	using resource_id_t = std::uint64_t;
+	using node_id_t = std::size_t;
+
+	//-----------------------------------------------------------------------------
+	//  Name : add_node ()
+	/// <summary>
+	/// Adds a node and links it to the previously added nodes it conflicts
+	/// with. If on_owner_thread is set the node is executed on the owner thread.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	node_id_t add_node(const std::string& name, std::vector<resource_id_t> reads,
+					   std::vector<resource_id_t> writes, std::function<void()> work,
+					   bool on_owner_thread = false);
+
+	//-----------------------------------------------------------------------------
+	//  Name : run ()
+	/// <summary>
+	/// Executes all nodes respecting their dependencies and waits for them.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void run(task_system& system);
+
+	//-----------------------------------------------------------------------------
+	//  Name : clear ()
+	/// <summary>
+	/// Removes all nodes.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void clear();
+
+	const std::vector<node_id_t>& get_dependencies(node_id_t id) const;
+
+	const std::string& get_name(node_id_t id) const;
+
+	std::size_t size() const;
+
+private:
+	struct node
+	{
+		std::string name;
+		std::vector<resource_id_t> reads;
+		std::vector<resource_id_t> writes;
+		std::vector<node_id_t> dependencies;
+		std::function<void()> work;
+		bool on_owner_thread = false;
+	};
+
+	std::vector<node> nodes_;
+};
+}
@@ -1,13 +1,100 @@
 #include "task_system.h"
 #include "../common/platform/thread.hpp"
 #include <limits>
+#include <random>
 
 namespace core
 {
+namespace
+{
+struct worker_context
+{
+	const task_system* system = nullptr;
+	std::size_t index = 0;
+};
+
+thread_local worker_context current_worker;
+
+std::size_t random_index(std::size_t max)
+{
+	// xorshift, good enough for picking a victim
+	thread_local std::uint32_t state = std::random_device{}() | 1u;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return static_cast<std::size_t>(state) % max;
+}
+}
+
+namespace detail
+{
+bool task_state::add_continuation(const std::shared_ptr<pending_task>& continuation)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if(done_)
+	{
+		return false;
+	}
+
+	continuations_.emplace_back(continuation);
+	return true;
+}
+
+void task_state::set_done()
+{
+	std::vector<std::shared_ptr<pending_task>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(done_)
+		{
+			return;
+		}
+		done_ = true;
+		continuations.swap(continuations_);
+	}
+
+	for(const auto& continuation : continuations)
+	{
+		continuation->release_dependency();
+	}
+}
+
+bool task_state::is_done() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return done_;
+}
+
+bool task_state::cancel()
+{
+	std::uint8_t expected = idle;
+	return run_state_.compare_exchange_strong(expected, cancelled) || expected == cancelled;
+}
+
+bool task_state::start()
+{
+	std::uint8_t expected = idle;
+	return run_state_.compare_exchange_strong(expected, started);
+}
+
+void pending_task::release_dependency()
+{
+	if(--dependencies == 0)
+	{
+		system->schedule(std::move(t), queue_index);
+	}
+}
+}
 
-task::task_concept::~task_concept() noexcept = default;
+task::task_concept::~task_concept() noexcept
+{
+	// a task destroyed without being invoked (cancelled or dropped) still
+	// has to release its continuations so they can observe the broken promise.
+	state_->set_done();
+}
 
 task::task_concept::task_concept() noexcept
+	: state_(std::make_shared<detail::task_state>())
 {
 	static std::atomic<std::uint64_t> id = {1};
 	id_ = id++;
@@ -15,6 +102,8 @@ task::task_concept::task_concept() noexcept
 
 void task_system::task_queue::sort()
 {
+	// Only futures that are not ours can end up here not ready. Ours are
+	// dependency counted and enter the queue when they can run.
 	if(tasks_.size() > 1)
 	{
 		std::stable_partition(tasks_.begin(), tasks_.end(), [](const auto& task1) { return task1.ready(); });
@@ -35,13 +124,22 @@ std::size_t task_system::task_queue::get_pending_tasks() const
 
 void task_system::task_queue::clear()
 {
-	std::unique_lock<std::mutex> lock(mutex_);
-	tasks_.clear();
+	std::deque<task> tasks;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		tasks.swap(tasks_);
+	}
+	// destroyed outside the lock since dropping a task may
+	// release continuations that get pushed back here.
+	tasks.clear();
 }
 
 void task_system::task_queue::set_done()
 {
-	done_.store(true);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		done_.store(true);
+	}
 	cv_.notify_all();
 }
 
@@ -85,21 +183,31 @@ bool task_system::task_queue::try_push(task& t)
 	return true;
 }
 
-std::pair<bool, task> task_system::task_queue::pop(duration_t pop_timeout)
+std::pair<bool, task> task_system::task_queue::pop(duration_t pop_timeout,
+												   const std::function<bool()>& wake_condition)
 {
 	std::unique_lock<std::mutex> lock(mutex_);
 	bool wait = pop_timeout > duration_t(0);
 	bool timed_wait = pop_timeout != duration_t::max();
 	if(wait && tasks_.empty())
 	{
+		// Marked under the lock before the condition is checked, so a
+		// wake_up either finds this queue sleeping or the condition is
+		// already met.
+		sleeping_ = true;
+		const auto should_wake = [&]() {
+			return !tasks_.empty() || woken_ || done_.load() || (wake_condition && wake_condition());
+		};
 		if(timed_wait)
 		{
-			cv_.wait_for(lock, pop_timeout);
+			cv_.wait_for(lock, pop_timeout, should_wake);
 		}
 		else
 		{
-			cv_.wait(lock);
+			cv_.wait(lock, should_wake);
 		}
+		sleeping_ = false;
+		woken_ = false;
 	}
 
 	if(tasks_.empty())
@@ -136,73 +244,248 @@ void task_system::task_queue::push(task t)
 	cv_.notify_one();
 }
 
-void task_system::task_queue::wake_up()
+bool task_system::task_queue::wake_up()
 {
-	cv_.notify_all();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(!sleeping_)
+		{
+			return false;
+		}
+		woken_ = true;
+	}
+	cv_.notify_one();
+	return true;
 }
 
 bool task_system::task_queue::cancel(uint64_t id)
 {
-	bool res = false;
+	task cancelled;
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
-		tasks_.erase(std::remove_if(std::begin(tasks_), std::end(tasks_),
-									[id, &res](const auto& task) {
-										auto cmp = task.get_id() == id;
-										if(cmp)
-										{
-											res = true;
-										}
-										return cmp;
-									}),
-					 std::end(tasks_));
+		auto it = std::find_if(std::begin(tasks_), std::end(tasks_),
+							   [id](const auto& task) { return task.get_id() == id; });
+		if(it != std::end(tasks_))
+		{
+			cancelled = std::move(*it);
+			tasks_.erase(it);
+		}
 	}
 	cv_.notify_one();
 
-	return res;
+	return static_cast<bool>(cancelled);
 }
 
 void task_system::run(std::size_t idx, const std::function<bool()>& condition, duration_t pop_timeout)
 {
+	if(idx != get_owner_thread_idx())
+	{
+		current_worker.system = this;
+		current_worker.index = idx;
+	}
+
 	while(condition())
 	{
 		const auto queue_index = get_thread_queue_idx(idx);
 		bool is_done = queues_[queue_index].is_done();
-		bool is_empty = queues_[queue_index].get_pending_tasks() == 0;
-		if(is_done && is_empty)
+		bool is_empty = get_pending_tasks(queue_index) == 0;
+		if(is_done && (is_empty || !wait_on_destruct_))
 		{
 			return;
 		}
 
 		std::pair<bool, task> p = {false, task()};
 
-		if(idx != 0 && is_empty)
+		if(mode_ == scheduler_mode::work_stealing)
 		{
-			std::size_t steal_attempts = threads_count_;
-			const auto queue_idx = get_most_free_queue_idx(true);
-			for(std::size_t k = 0; k < steal_attempts; ++k)
+			// Read before looking for work, anything pushed locally after
+			// this keeps the worker from going to sleep.
+			const auto local_pushes = local_pushes_.load();
+			if(idx != 0)
 			{
-				if(queue_index != queue_idx)
+				p = pop_local(queue_index);
+
+				if(!p.first)
 				{
-					p = queues_[queue_idx].try_pop();
-					if(p.first)
+					p = queues_[queue_index].pop(duration_t(0));
+				}
+
+				if(!p.first)
+				{
+					p = steal(queue_index);
+				}
+			}
+
+			if(!p.first)
+			{
+				sleeping_workers_++;
+				if(idx != 0)
+				{
+					p = queues_[queue_index].pop(pop_timeout, [this, local_pushes]() {
+						return local_pushes_.load() != local_pushes;
+					});
+				}
+				else
+				{
+					p = queues_[queue_index].pop(pop_timeout);
+				}
+				sleeping_workers_--;
+			}
+		}
+		else
+		{
+			if(idx != 0 && is_empty)
+			{
+				std::size_t steal_attempts = threads_count_;
+				const auto queue_idx = get_most_free_queue_idx(true);
+				for(std::size_t k = 0; k < steal_attempts; ++k)
+				{
+					if(queue_index != queue_idx)
 					{
-						break;
+						p = queues_[queue_idx].try_pop();
+						if(p.first)
+						{
+							break;
+						}
 					}
 				}
 			}
+
+			if(!p.first)
+			{
+				p = queues_[queue_index].pop(pop_timeout);
+			}
 		}
 
-		if(!p.first)
+		if(p.first)
 		{
-			p = queues_[queue_index].pop(pop_timeout);
+			p.second();
 		}
+	}
+}
+
+std::size_t task_system::get_any_worker_thread_idx() const
+{
+	if(mode_ == scheduler_mode::locked_queues || threads_count_ == 1)
+	{
+		return get_most_free_queue_idx(true);
+	}
+
+	const auto current = get_current_worker_idx();
+	if(current != get_owner_thread_idx())
+	{
+		return current;
+	}
 
+	// skip the owner
+	return 1 + (next_worker_++ % (threads_count_ - 1));
+}
+
+void task_system::schedule(task t, std::size_t queue_index)
+{
+	if(joined_)
+	{
+		return;
+	}
+
+	// worker continuations stay on the worker that released them
+	if(mode_ == scheduler_mode::work_stealing && queue_index != get_owner_thread_idx())
+	{
+		const auto current = get_current_worker_idx();
+		if(current != get_owner_thread_idx())
+		{
+			push_local(current, std::move(t));
+			return;
+		}
+	}
+
+	queues_[queue_index].push(std::move(t));
+}
+
+std::size_t task_system::get_current_worker_idx() const
+{
+	if(current_worker.system == this)
+	{
+		return current_worker.index;
+	}
+
+	return get_owner_thread_idx();
+}
+
+void task_system::push_local(std::size_t queue_index, task t)
+{
+	deques_[queue_index]->push(t.release());
+
+	// someone could steal this. A worker counts itself as sleeping before it
+	// checks the pushes, so either it sees this one or it is seen here.
+	++local_pushes_;
+	if(sleeping_workers_ > 0)
+	{
+		const auto workers = threads_count_ - 1;
+		const auto first = random_index(workers);
+		for(std::size_t i = 0; i < workers; ++i)
+		{
+			const auto victim = 1 + (first + i) % workers;
+			if(victim != queue_index && queues_[victim].wake_up())
+			{
+				break;
+			}
+		}
+	}
+}
+
+std::pair<bool, task> task_system::pop_local(std::size_t queue_index)
+{
+	task::task_concept* t = nullptr;
+	if(deques_[queue_index]->pop(t))
+	{
+		return std::make_pair(true, task(t));
+	}
+
+	return std::make_pair(false, task{});
+}
+
+std::pair<bool, task> task_system::steal(std::size_t queue_index)
+{
+	const std::size_t workers = threads_count_ - 1;
+	if(workers < 2)
+	{
+		return std::make_pair(false, task{});
+	}
+
+	const std::size_t steal_attempts = threads_count_;
+	for(std::size_t k = 0; k < steal_attempts; ++k)
+	{
+		const auto victim = 1 + random_index(workers);
+		if(victim == queue_index)
+		{
+			continue;
+		}
+
+		task::task_concept* t = nullptr;
+		if(deques_[victim]->steal(t))
+		{
+			return std::make_pair(true, task(t));
+		}
+
+		auto p = queues_[victim].try_pop();
 		if(p.first)
 		{
-			p.second();
+			return p;
 		}
 	}
+
+	return std::make_pair(false, task{});
+}
+
+std::size_t task_system::get_pending_tasks(std::size_t queue_index) const
+{
+	std::size_t pending = queues_[queue_index].get_pending_tasks();
+	if(deques_[queue_index])
+	{
+		pending += deques_[queue_index]->size();
+	}
+	return pending;
 }
 
 std::size_t task_system::get_thread_queue_idx(std::size_t idx, std::size_t seed)
@@ -238,8 +521,14 @@ task_system::task_system(bool wait_on_destruct)
 }
 
 task_system::task_system(bool wait_on_destruct, std::size_t nthreads)
-	: threads_count_{nthreads}
+	: task_system(wait_on_destruct, nthreads, scheduler_mode::work_stealing)
+{
+}
+
+task_system::task_system(bool wait_on_destruct, std::size_t nthreads, scheduler_mode mode)
+	: threads_count_{std::max<std::size_t>(nthreads, 1)}
 	, wait_on_destruct_(wait_on_destruct)
+	, mode_(mode)
 {
 	queues_.reserve(threads_count_);
 	queues_.emplace_back();
@@ -248,6 +537,16 @@ task_system::task_system(bool wait_on_destruct, std::size_t nthreads)
 		queues_.emplace_back();
 	}
 
+	// the owner thread has no deque
+	deques_.resize(threads_count_);
+	if(mode_ == scheduler_mode::work_stealing)
+	{
+		for(std::size_t th = 1; th < threads_count_; ++th)
+		{
+			deques_[th] = std::make_unique<work_stealing_deque<task::task_concept*>>();
+		}
+	}
+
 	// two seperate loops.
 	threads_.reserve(threads_count_);
 	threads_.emplace_back();
@@ -277,6 +576,22 @@ task_system::~task_system()
 			th.join();
 		}
 	}
+
+	joined_ = true;
+
+	// destroy whatever was left
+	for(auto& deque : deques_)
+	{
+		task::task_concept* t = nullptr;
+		while(deque && deque->pop(t))
+		{
+			task discarded(t);
+		}
+	}
+	for(auto& q : queues_)
+	{
+		q.clear();
+	}
 }
 
 void task_system::run_on_owner_thread(duration_t max_duration)
@@ -308,11 +623,11 @@ task_system::system_info task_system::get_info() const
 {
 	system_info info;
 	info.queue_infos.reserve(queues_.size());
-	for(const auto& queue : queues_)
+	for(std::size_t i = 0; i < queues_.size(); ++i)
 	{
 		info.queue_infos.emplace_back();
 		auto& q_info = info.queue_infos.back();
-		q_info.pending_tasks = queue.get_pending_tasks();
+		q_info.pending_tasks = get_pending_tasks(i);
 		info.pending_tasks += q_info.pending_tasks;
 	}
 	return info;
@@ -2,6 +2,7 @@
 #define TASK_SYSTEM_H
 
 #include "future_traits.hpp"
+#include "work_stealing_deque.hpp"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
@@ -10,6 +11,7 @@
 #include <cstdint>
 #include <deque>
 #include <exception>
+#include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
@@ -22,6 +24,72 @@ namespace core
 {
 class task_system;
 
+namespace detail
+{
+struct pending_task;
+
+//-----------------------------------------------------------------------------
+//  Name : task_state
+/// <summary>
+/// Completion state shared between a task and its futures. Tasks that
+/// depend on it register as continuations and are scheduled by whoever
+/// finishes their last dependency, so nobody has to poll for readiness.
+/// </summary>
+//-----------------------------------------------------------------------------
+class task_state
+{
+public:
+	//-----------------------------------------------------------------------------
+	//  Name : add_continuation ()
+	/// <summary>
+	/// Registers a continuation. Returns false if the state is already done,
+	/// in which case the continuation was not registered.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool add_continuation(const std::shared_ptr<pending_task>& continuation);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_done ()
+	/// <summary>
+	/// Marks the state as done and releases the registered continuations.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_done();
+
+	bool is_done() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : cancel ()
+	/// <summary>
+	/// Marks a task that did not start yet as cancelled so it is dropped
+	/// instead of run. Returns false if the task already started.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool cancel();
+
+	//-----------------------------------------------------------------------------
+	//  Name : start ()
+	/// <summary>
+	/// Marks the task as started. Returns false if it was cancelled.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool start();
+
+private:
+	enum run_state : std::uint8_t
+	{
+		idle,
+		started,
+		cancelled
+	};
+
+	mutable std::mutex mutex_;
+	bool done_ = false;
+	std::atomic<std::uint8_t> run_state_{idle};
+	std::vector<std::shared_ptr<pending_task>> continuations_;
+};
+}
+
 template <typename T>
 class task_future
 {
@@ -70,11 +138,13 @@ public:
 		return future_.wait_until(abs_time);
 	}
 
-	static task_future<T> from_shared_future(std::shared_future<T>&& fut, std::uint64_t id = 0)
+	static task_future<T> from_shared_future(std::shared_future<T>&& fut, std::uint64_t id = 0,
+											 std::shared_ptr<detail::task_state> state = nullptr)
 	{
 		task_future<T> res;
 		res.future_ = std::move(fut);
 		res.id_ = id;
+		res.state_ = std::move(state);
 		return res;
 	}
 
@@ -91,6 +161,7 @@ public:
 private:
 	friend class task_system;
 	std::shared_future<T> future_;
+	std::shared_ptr<detail::task_state> state_;
 	task_system* executor_ = nullptr;
 	std::uint64_t id_ = 0;
 };
@@ -123,6 +194,8 @@ using is_future = async::detail::is_future<T>;
 
 class task
 {
+	friend class task_system;
+
 	template <typename T>
 	using decay_future_t = async::detail::decay_future_t<T>;
 
@@ -187,7 +260,14 @@ public:
 	{
 		if(t_)
 		{
+			// A cancelled task is dropped, its future sees a broken promise.
+			if(!t_->state_->start())
+			{
+				t_.reset();
+				return;
+			}
 			t_->invoke_();
+			t_->state_->set_done();
 		}
 	}
 
@@ -225,6 +305,18 @@ private:
 	{
 	}
 
+	struct task_concept;
+
+	explicit task(task_concept* t) noexcept
+		: t_(t)
+	{
+	}
+
+	task_concept* release() noexcept
+	{
+		return t_.release();
+	}
+
 	struct task_concept
 	{
 		task_concept() noexcept;
@@ -232,6 +324,7 @@ private:
 		virtual void invoke_() = 0;
 		virtual bool ready_() const noexcept = 0;
 		std::uint64_t id_ = 0;
+		std::shared_ptr<detail::task_state> state_;
 	};
 
 	template <class>
@@ -259,7 +352,7 @@ private:
 
 		task_future<R> get_future()
 		{
-			return task_future<R>::from_shared_future(f_.get_future().share(), id_);
+			return task_future<R>::from_shared_future(f_.get_future().share(), id_, state_);
 		}
 
 		void invoke_() override
@@ -301,7 +394,7 @@ private:
 
 		task_future<R> get_future()
 		{
-			return task_future<R>::from_shared_future(f_.get_future().share(), id_);
+			return task_future<R>::from_shared_future(f_.get_future().share(), id_, state_);
 		}
 
 		void invoke_() override
@@ -375,13 +468,48 @@ private:
 	std::unique_ptr<task_concept> t_;
 };
 
+namespace detail
+{
+//-----------------------------------------------------------------------------
+//  Name : pending_task
+/// <summary>
+/// A task waiting on its dependencies. Scheduled when the last one is done.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct pending_task
+{
+	void release_dependency();
+
+	task t;
+	task_system* system = nullptr;
+	std::size_t queue_index = 0;
+	std::atomic<std::size_t> dependencies{1};
+};
+}
+
 class task_system
 {
 	using duration_t = std::chrono::steady_clock::duration;
 	template <typename T>
 	friend class task_future;
+	friend struct detail::pending_task;
 
 public:
+	//-----------------------------------------------------------------------------
+	//  Name : scheduler_mode
+	/// <summary>
+	/// work_stealing - every worker owns a lock-free deque that it pushes to and
+	/// pops from without locking, idle workers steal from random victims.
+	/// locked_queues - every thread owns a mutex guarded queue, idle workers
+	/// steal from the most free one.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	enum class scheduler_mode
+	{
+		work_stealing,
+		locked_queues
+	};
+
 	struct queue_info
 	{
 		std::size_t pending_tasks = 0;
@@ -396,6 +524,8 @@ public:
 
 	task_system(bool wait_on_destruct, std::size_t nthreads);
 
+	task_system(bool wait_on_destruct, std::size_t nthreads, scheduler_mode mode);
+
 	//-----------------------------------------------------------------------------
 	//  Name : ~task_system ()
 	/// <summary>
@@ -433,9 +563,11 @@ public:
 	/// there.
 	/// </summary>
 	//-----------------------------------------------------------------------------
-	std::size_t get_any_worker_thread_idx() const
+	std::size_t get_any_worker_thread_idx() const;
+
+	scheduler_mode get_scheduler_mode() const
 	{
-		return get_most_free_queue_idx(true);
+		return mode_;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -580,7 +712,138 @@ public:
 		return push_or_execute_on_thread(idx, std::forward<F>(f), std::forward<Args>(args)...);
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : push_on_worker_thread_after ()
+	/// <summary>
+	/// Pushes a task to a worker thread to be executed once all of the
+	/// dependencies are ready. Their results are not passed to the task.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <class F, typename T>
+	decltype(auto) push_on_worker_thread_after(const std::vector<task_future<T>>& dependencies, F&& f)
+	{
+		const std::size_t idx = get_any_worker_thread_idx();
+		return push_after(idx, dependencies, std::forward<F>(f));
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : push_on_owner_thread_after ()
+	/// <summary>
+	/// Pushes a task to the owner thread to be executed once all of the
+	/// dependencies are ready. Their results are not passed to the task.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <class F, typename T>
+	decltype(auto) push_on_owner_thread_after(const std::vector<task_future<T>>& dependencies, F&& f)
+	{
+		const std::size_t idx = get_owner_thread_idx();
+		return push_after(idx, dependencies, std::forward<F>(f));
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : parallel_for ()
+	/// <summary>
+	/// Splits the range [begin, end) into chunks of grain elements and calls
+	/// f(chunk_begin, chunk_end) for each of them across the workers. The
+	/// calling thread takes part in the work and the function returns when all
+	/// chunks are processed. Chunks are claimed dynamically so helpers that
+	/// start late simply find nothing left to do.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename F>
+	void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& f)
+	{
+		if(begin >= end)
+		{
+			return;
+		}
+
+		grain = std::max<std::size_t>(grain, 1);
+		const std::size_t chunks = (end - begin + grain - 1) / grain;
+		const std::size_t helpers = std::min(chunks, threads_count_) - 1;
+
+		struct parallel_for_state
+		{
+			std::atomic<std::size_t> next{0};
+			std::atomic<std::size_t> done{0};
+			std::mutex error_mutex;
+			std::exception_ptr error;
+		};
+
+		auto state = std::make_shared<parallel_for_state>();
+		auto* func = &f;
+		auto work = [state, func, begin, end, grain, chunks]() {
+			for(;;)
+			{
+				const std::size_t chunk = state->next++;
+				if(chunk >= chunks)
+				{
+					return;
+				}
+
+				const std::size_t chunk_begin = begin + chunk * grain;
+				const std::size_t chunk_end = std::min(chunk_begin + grain, end);
+				try
+				{
+					(*func)(chunk_begin, chunk_end);
+				}
+				catch(...)
+				{
+					std::lock_guard<std::mutex> lock(state->error_mutex);
+					if(!state->error)
+					{
+						state->error = std::current_exception();
+					}
+				}
+				state->done++;
+			}
+		};
+
+		for(std::size_t i = 0; i < helpers; ++i)
+		{
+			push_on_worker_thread(work);
+		}
+
+		work();
+
+		// whatever is left is already being processed
+		while(state->done < chunks)
+		{
+			std::this_thread::yield();
+		}
+
+		if(state->error)
+		{
+			std::rethrow_exception(state->error);
+		}
+	}
+
 private:
+	//-----------------------------------------------------------------------------
+	//  Name : push_after ()
+	/// <summary>
+	/// Pushes a ready task that is held back until all of the dependencies
+	/// are ready.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <class F, typename T>
+	decltype(auto) push_after(std::size_t idx, const std::vector<task_future<T>>& dependencies, F&& f)
+	{
+		std::vector<std::shared_ptr<detail::task_state>> states;
+		for(const auto& dependency : dependencies)
+		{
+			collect_dependency(states, dependency);
+		}
+
+		auto t = task::make_ready_task(std::forward<F>(f));
+		if(!states.empty())
+		{
+			return push_continuation(std::move(t), idx, states);
+		}
+
+		return push_task(std::move(t), idx, false);
+	}
+
 	//-----------------------------------------------------------------------------
 	//  Name : push_impl ()
 	/// <summary>
@@ -613,8 +876,88 @@ private:
 	decltype(auto) push_impl(std::false_type /*unused*/, std::size_t idx, bool execute_if_ready, F&& f,
 							 Args&&... args)
 	{
-		return push_task(task::make_awaitable_task(std::forward<F>(f), std::forward<Args>(args)...), idx,
-						 execute_if_ready);
+		std::vector<std::shared_ptr<detail::task_state>> dependencies;
+		const bool counted = nonstd::check_all_true(collect_dependency(dependencies, args)...);
+
+		auto t = task::make_awaitable_task(std::forward<F>(f), std::forward<Args>(args)...);
+		if(counted && !dependencies.empty())
+		{
+			return push_continuation(std::move(t), idx, dependencies);
+		}
+
+		return push_task(std::move(t), idx, execute_if_ready);
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : collect_dependency ()
+	/// <summary>
+	/// Collects the completion state of a not yet ready future argument.
+	/// Returns false if the argument is a future which can't be tracked and
+	/// must be polled instead.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	static bool collect_dependency(std::vector<std::shared_ptr<detail::task_state>>& dependencies,
+								   const task_future<T>& f)
+	{
+		if(!f.state_)
+		{
+			return f.is_ready();
+		}
+
+		if(!f.state_->is_done())
+		{
+			dependencies.emplace_back(f.state_);
+		}
+		return true;
+	}
+
+	template <typename T, typename std::enable_if_t<!is_future<T>::value>* = nullptr>
+	static bool collect_dependency(std::vector<std::shared_ptr<detail::task_state>>& /*unused*/,
+								   const T& /*unused*/)
+	{
+		return true;
+	}
+
+	template <typename T, typename std::enable_if_t<is_future<T>::value>* = nullptr>
+	static bool collect_dependency(std::vector<std::shared_ptr<detail::task_state>>& /*unused*/,
+								   const T& f)
+	{
+		using namespace std::chrono_literals;
+		return f.valid() && f.wait_for(0s) == std::future_status::ready;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : push_continuation ()
+	/// <summary>
+	/// Registers an awaitable task on the states of its dependencies. It enters
+	/// a run queue only when the last of them is done.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	auto push_continuation(T&& t, std::size_t idx,
+						   const std::vector<std::shared_ptr<detail::task_state>>& dependencies) ->
+		typename std::remove_reference<decltype(t.second)>::type
+	{
+		t.second.executor_ = this;
+
+		auto pending = std::make_shared<detail::pending_task>();
+		pending->t = std::move(t.first);
+		pending->system = this;
+		pending->queue_index = get_thread_queue_idx(idx);
+		pending->dependencies = dependencies.size() + 1;
+
+		for(const auto& dependency : dependencies)
+		{
+			if(!dependency->add_continuation(pending))
+			{
+				pending->release_dependency();
+			}
+		}
+
+		// release our own guard reference
+		pending->release_dependency();
+		return std::move(t.second);
 	}
 
 	//-----------------------------------------------------------------------------
@@ -638,7 +981,8 @@ private:
 		t.second.executor_ = this;
 
 		const auto queue_index = get_thread_queue_idx(idx);
-		if(execute_if_ready && t.first.ready() &&
+		const bool ready = t.first.ready();
+		if(execute_if_ready && ready &&
 		   ((get_thread_id(queue_index) == std::this_thread::get_id()) || (queue_index != 0)))
 		{
 			t.first();
@@ -646,10 +990,68 @@ private:
 			return std::move(t.second);
 		}
 
+		// Ready tasks pushed by a worker to itself go to its own deque
+		// without taking any locks.
+		if(ready && mode_ == scheduler_mode::work_stealing && queue_index != get_owner_thread_idx() &&
+		   queue_index == get_current_worker_idx())
+		{
+			push_local(queue_index, std::move(t.first));
+			return std::move(t.second);
+		}
+
 		queues_[queue_index].push(std::move(t.first));
 		return std::move(t.second);
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : schedule ()
+	/// <summary>
+	/// Schedules a continuation whose dependencies are all done.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void schedule(task t, std::size_t queue_index);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_current_worker_idx ()
+	/// <summary>
+	/// Gets the index of the worker thread that is calling this function. If
+	/// the caller is not one of our workers the owner thread index is returned.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::size_t get_current_worker_idx() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : push_local ()
+	/// <summary>
+	/// Pushes a ready task to the calling worker's deque.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void push_local(std::size_t queue_index, task t);
+
+	//-----------------------------------------------------------------------------
+	//  Name : pop_local ()
+	/// <summary>
+	/// Pops a task from the calling worker's deque.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::pair<bool, task> pop_local(std::size_t queue_index);
+
+	//-----------------------------------------------------------------------------
+	//  Name : steal ()
+	/// <summary>
+	/// Tries to steal a task from randomly chosen victims.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::pair<bool, task> steal(std::size_t queue_index);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_pending_tasks ()
+	/// <summary>
+	/// Gets the pending tasks count for a queue including its deque.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::size_t get_pending_tasks(std::size_t queue_index) const;
+
 	bool cancel(std::uint64_t id)
 	{
 		bool cancelled = false;
@@ -747,10 +1149,13 @@ private:
 		bool is_done() const;
 		std::pair<bool, task> try_pop();
 		bool try_push(task& t);
-		std::pair<bool, task> pop(duration_t pop_timeout = duration_t::max());
+		/// Waits up to pop_timeout for a task, or until wake_condition holds.
+		std::pair<bool, task> pop(duration_t pop_timeout = duration_t::max(),
+								  const std::function<bool()>& wake_condition = nullptr);
 
 		void push(task t);
-		void wake_up();
+		/// Wakes the worker sleeping on this queue. Returns false if none is.
+		bool wake_up();
 
 		bool cancel(std::uint64_t id);
 		void clear();
@@ -761,14 +1166,29 @@ private:
 		std::condition_variable cv_;
 		mutable std::mutex mutex_;
 		std::atomic_bool done_{false};
+		/// Whether a worker waits on cv_ and whether it was told to stop.
+		bool sleeping_ = false;
+		bool woken_ = false;
 	};
 
 	std::vector<task_queue> queues_;
+	/// Per worker lock-free deques. Only used in work_stealing mode.
+	std::vector<std::unique_ptr<work_stealing_deque<task::task_concept*>>> deques_;
 	std::vector<std::thread> threads_;
 	std::size_t threads_count_;
+	/// Number of workers blocked waiting on their queue.
+	std::atomic<std::size_t> sleeping_workers_{0};
+	/// Incremented by every push_local. Sleeping workers watch it to wake
+	/// up for work they can steal.
+	std::atomic<std::size_t> local_pushes_{0};
+	/// Round robin counter for pushes from non worker threads.
+	mutable std::atomic<std::size_t> next_worker_{0};
+	/// Set once the workers are joined. Continuations are dropped after that.
+	std::atomic_bool joined_{false};
 	//
 	const std::thread::id owner_thread_id_ = std::this_thread::get_id();
 	bool wait_on_destruct_ = false;
+	scheduler_mode mode_ = scheduler_mode::work_stealing;
 };
 
 template <typename T>
@@ -819,6 +1239,13 @@ inline void task_future<T>::cancel() const
 	{
 		bool cancelled = executor_->cancel(id_);
 
+		// Continuations still waiting on their dependencies are in no queue.
+		// They are dropped once released instead of being run.
+		if(!cancelled && state_)
+		{
+			cancelled = state_->cancel();
+		}
+
 		if(!cancelled)
 		{
 			wait();
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace core
+{
+
+//-----------------------------------------------------------------------------
+//  Name : work_stealing_deque
+/// <summary>
+/// Lock-free Chase-Lev work stealing deque. The owner thread pushes and pops
+/// at the bottom (lifo) while any other thread can steal from the top (fifo).
+/// Only trivially copyable types are supported (usually pointers) since
+/// elements are read speculatively by the thieves.
+/// Retired buffers are kept alive until the deque is destroyed, so a thief
+/// never reads from freed memory.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename T>
+class work_stealing_deque
+{
+	static_assert(std::is_trivially_copyable<T>::value, "work_stealing_deque requires trivially copyable types");
+
+	class circular_array
+	{
+	public:
+		explicit circular_array(std::int64_t log_size)
+			: log_size_(log_size)
+			, mask_((std::int64_t(1) << log_size) - 1)
+			, items_(new std::atomic<T>[std::size_t(1) << log_size])
+		{
+		}
+
+		std::int64_t capacity() const
+		{
+			return mask_ + 1;
+		}
+
+		T get(std::int64_t i) const
+		{
+			return items_[static_cast<std::size_t>(i & mask_)].load(std::memory_order_relaxed);
+		}
+
+		void put(std::int64_t i, T x)
+		{
+			items_[static_cast<std::size_t>(i & mask_)].store(x, std::memory_order_relaxed);
+		}
+
+		std::unique_ptr<circular_array> grow(std::int64_t bottom, std::int64_t top) const
+		{
+			auto result = std::make_unique<circular_array>(log_size_ + 1);
+			for(std::int64_t i = top; i != bottom; ++i)
+			{
+				result->put(i, get(i));
+			}
+			return result;
+		}
+
+	private:
+		std::int64_t log_size_ = 0;
+		std::int64_t mask_ = 0;
+		std::unique_ptr<std::atomic<T>[]> items_;
+	};
+
+public:
+	explicit work_stealing_deque(std::int64_t log_size = 10)
+	{
+		buffers_.emplace_back(std::make_unique<circular_array>(log_size));
+		array_.store(buffers_.back().get(), std::memory_order_relaxed);
+	}
+
+	work_stealing_deque(const work_stealing_deque&) = delete;
+	work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+	//-----------------------------------------------------------------------------
+	//  Name : size ()
+	/// <summary>
+	/// Approximate number of elements. Can be called from any thread.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::size_t size() const
+	{
+		const auto b = bottom_.load(std::memory_order_relaxed);
+		const auto t = top_.load(std::memory_order_relaxed);
+		return static_cast<std::size_t>(b >= t ? b - t : 0);
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : push ()
+	/// <summary>
+	/// Pushes an element at the bottom. Must be called by the owner thread only.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void push(T x)
+	{
+		const auto b = bottom_.load(std::memory_order_relaxed);
+		const auto t = top_.load(std::memory_order_acquire);
+		auto a = array_.load(std::memory_order_relaxed);
+		if(b - t > a->capacity() - 1)
+		{
+			buffers_.emplace_back(a->grow(b, t));
+			a = buffers_.back().get();
+			array_.store(a, std::memory_order_release);
+		}
+		a->put(b, x);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom_.store(b + 1, std::memory_order_relaxed);
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : pop ()
+	/// <summary>
+	/// Pops an element from the bottom. Must be called by the owner thread only.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool pop(T& out)
+	{
+		const auto b = bottom_.load(std::memory_order_relaxed) - 1;
+		auto a = array_.load(std::memory_order_relaxed);
+		bottom_.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto t = top_.load(std::memory_order_relaxed);
+
+		bool result = true;
+		if(t <= b)
+		{
+			out = a->get(b);
+			if(t == b)
+			{
+				// last element, race against the thieves
+				if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+												 std::memory_order_relaxed))
+				{
+					result = false;
+				}
+				bottom_.store(b + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			result = false;
+			bottom_.store(b + 1, std::memory_order_relaxed);
+		}
+		return result;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : steal ()
+	/// <summary>
+	/// Steals an element from the top. Can be called from any thread.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool steal(T& out)
+	{
+		auto t = top_.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const auto b = bottom_.load(std::memory_order_acquire);
+
+		if(t < b)
+		{
+			auto a = array_.load(std::memory_order_acquire);
+			auto x = a->get(t);
+			if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return false;
+			}
+			out = x;
+			return true;
+		}
+		return false;
+	}
+
+private:
+	/// Padded to keep thieves and the owner off each other's cache lines.
+	std::atomic<std::int64_t> top_{0};
+	char pad0_[64 - sizeof(std::atomic<std::int64_t>)];
+	std::atomic<std::int64_t> bottom_{0};
+	char pad1_[64 - sizeof(std::atomic<std::int64_t>)];
+	std::atomic<circular_array*> array_{nullptr};
+	/// Owned buffers. Only touched by the owner thread.
+	std::vector<std::unique_ptr<circular_array>> buffers_;
+};
+}
@@ -59,6 +59,4 @@ struct animation
 	std::vector<node_animation> channels;
 };
 
-// elapsed_time = math::modf(elapsed_time + dt , anim.duration);
-
 } // namespace runtime
@@ -0,0 +1,450 @@
+#include "animation_clip.h"
+
+#include <core/common/platform/config.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if ETH_ON(ETH_SIMD_SSE) || ETH_ON(ETH_SIMD_AVX)
+#include <immintrin.h>
+#elif ETH_ON(ETH_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace runtime
+{
+namespace
+{
+const float time_steps = 65535.0f;
+const float rotation_steps = 32767.0f;
+
+// Four float operations used by the sampling and blending code.
+#if ETH_ON(ETH_SIMD_SSE) || ETH_ON(ETH_SIMD_AVX)
+using float4 = __m128;
+
+inline float4 load(const float* p)
+{
+	return _mm_loadu_ps(p);
+}
+
+inline void store(float* p, float4 v)
+{
+	_mm_storeu_ps(p, v);
+}
+
+inline float4 splat(float v)
+{
+	return _mm_set1_ps(v);
+}
+
+inline float4 add(float4 a, float4 b)
+{
+	return _mm_add_ps(a, b);
+}
+
+inline float4 sub(float4 a, float4 b)
+{
+	return _mm_sub_ps(a, b);
+}
+
+inline float4 mul(float4 a, float4 b)
+{
+	return _mm_mul_ps(a, b);
+}
+
+inline float4 div(float4 a, float4 b)
+{
+	return _mm_div_ps(a, b);
+}
+
+inline float dot(float4 a, float4 b)
+{
+	auto m = _mm_mul_ps(a, b);
+	m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+	m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(m);
+}
+
+// Reads four keys, the last one may belong to the next key.
+inline float4 load_unsigned(const std::uint16_t* p)
+{
+	const auto v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+}
+
+inline float4 load_signed(const std::int16_t* p)
+{
+	const auto v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+	return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+}
+#elif ETH_ON(ETH_SIMD_NEON)
+using float4 = float32x4_t;
+
+inline float4 load(const float* p)
+{
+	return vld1q_f32(p);
+}
+
+inline void store(float* p, float4 v)
+{
+	vst1q_f32(p, v);
+}
+
+inline float4 splat(float v)
+{
+	return vdupq_n_f32(v);
+}
+
+inline float4 add(float4 a, float4 b)
+{
+	return vaddq_f32(a, b);
+}
+
+inline float4 sub(float4 a, float4 b)
+{
+	return vsubq_f32(a, b);
+}
+
+inline float4 mul(float4 a, float4 b)
+{
+	return vmulq_f32(a, b);
+}
+
+inline float4 div(float4 a, float4 b)
+{
+	float la[4], lb[4];
+	vst1q_f32(la, a);
+	vst1q_f32(lb, b);
+	for(int i = 0; i < 4; ++i)
+	{
+		la[i] /= lb[i];
+	}
+	return vld1q_f32(la);
+}
+
+inline float dot(float4 a, float4 b)
+{
+	const auto m = vmulq_f32(a, b);
+	const auto s = vadd_f32(vget_low_f32(m), vget_high_f32(m));
+	return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+inline float4 load_unsigned(const std::uint16_t* p)
+{
+	return vcvtq_f32_u32(vmovl_u16(vld1_u16(p)));
+}
+
+inline float4 load_signed(const std::int16_t* p)
+{
+	return vcvtq_f32_s32(vmovl_s16(vld1_s16(p)));
+}
+#else
+struct float4
+{
+	float v[4];
+};
+
+inline float4 load(const float* p)
+{
+	return {{p[0], p[1], p[2], p[3]}};
+}
+
+inline void store(float* p, float4 a)
+{
+	std::copy(a.v, a.v + 4, p);
+}
+
+inline float4 splat(float v)
+{
+	return {{v, v, v, v}};
+}
+
+inline float4 add(float4 a, float4 b)
+{
+	return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+
+inline float4 sub(float4 a, float4 b)
+{
+	return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+}
+
+inline float4 mul(float4 a, float4 b)
+{
+	return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+
+inline float4 div(float4 a, float4 b)
+{
+	return {{a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]}};
+}
+
+inline float dot(float4 a, float4 b)
+{
+	return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2] + a.v[3] * b.v[3];
+}
+
+inline float4 load_unsigned(const std::uint16_t* p)
+{
+	return {{float(p[0]), float(p[1]), float(p[2]), float(p[3])}};
+}
+
+inline float4 load_signed(const std::int16_t* p)
+{
+	return {{float(p[0]), float(p[1]), float(p[2]), float(p[3])}};
+}
+#endif
+
+inline float4 lerp(float4 a, float4 b, float t)
+{
+	return add(a, mul(sub(b, a), splat(t)));
+}
+
+inline float4 normalize(float4 q)
+{
+	const float length = std::sqrt(dot(q, q));
+	if(length <= 0.0f)
+	{
+		const float identity[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+		return load(identity);
+	}
+	return div(q, splat(length));
+}
+
+// Finds the last key at or before the time. Playback mostly moves a key or
+// two forward from the previous call, anything else is a binary search.
+std::uint32_t find_key(const std::uint16_t* times, std::uint32_t count, float time, std::uint32_t& cursor)
+{
+	std::uint32_t key = cursor < count ? cursor : 0;
+	if(float(times[key]) <= time)
+	{
+		for(int step = 0; step < 4; ++step)
+		{
+			if(key + 1 >= count || float(times[key + 1]) > time)
+			{
+				cursor = key;
+				return key;
+			}
+			++key;
+		}
+	}
+
+	const auto it = std::upper_bound(times, times + count, time,
+									 [](float t, std::uint16_t key_time) { return t < float(key_time); });
+	key = it == times ? 0 : std::uint32_t(it - times - 1);
+	cursor = key;
+	return key;
+}
+
+// Key pair around the time and the position between them.
+std::uint32_t find_keys(const std::uint16_t* times, std::uint32_t count, float time, std::uint32_t& cursor,
+						std::uint32_t& next, float& factor)
+{
+	const auto key = find_key(times, count, time, cursor);
+	next = key + 1 < count ? key + 1 : key;
+	factor = 0.0f;
+
+	const float begin = float(times[key]);
+	const float end = float(times[next]);
+	if(end > begin)
+	{
+		factor = std::min(std::max((time - begin) / (end - begin), 0.0f), 1.0f);
+	}
+	return key;
+}
+} // namespace
+
+void blend_pose(const joint_pose& pose, float weight, joint_pose& result)
+{
+	const auto w = splat(weight);
+	store(result.position, add(load(result.position), mul(load(pose.position), w)));
+	store(result.scale, add(load(result.scale), mul(load(pose.scale), w)));
+
+	// q and -q are the same rotation, add the one closest to the sum.
+	const auto rotation = load(pose.rotation);
+	const auto sum = load(result.rotation);
+	const auto rotation_weight = dot(rotation, sum) < 0.0f ? splat(-weight) : w;
+	store(result.rotation, add(sum, mul(rotation, rotation_weight)));
+}
+
+void normalize_pose(joint_pose& pose, float total_weight)
+{
+	if(total_weight <= 0.0f)
+	{
+		pose = {};
+		return;
+	}
+
+	const auto w = splat(total_weight);
+	store(pose.position, div(load(pose.position), w));
+	store(pose.scale, div(load(pose.scale), w));
+	store(pose.rotation, normalize(load(pose.rotation)));
+}
+
+animation_clip::animation_clip(const animation& anim)
+{
+	duration_ = anim.duration.count();
+	for(const auto& ch : anim.channels)
+	{
+		for(const auto& key : ch.position_keys)
+		{
+			duration_ = std::max(duration_, key.time.count());
+		}
+		for(const auto& key : ch.rotation_keys)
+		{
+			duration_ = std::max(duration_, key.time.count());
+		}
+		for(const auto& key : ch.scaling_keys)
+		{
+			duration_ = std::max(duration_, key.time.count());
+		}
+	}
+
+	channels_.reserve(anim.channels.size());
+	for(const auto& ch : anim.channels)
+	{
+		channel c;
+		c.node_name = ch.node_name;
+		c.position = add_vector_track(ch.position_keys);
+		c.rotation = add_rotation_track(ch.rotation_keys);
+		c.scaling = add_vector_track(ch.scaling_keys);
+		channels_.emplace_back(std::move(c));
+	}
+
+	// The four wide loads read one value past the last key.
+	vector_keys_.emplace_back(0);
+	vector_keys_.shrink_to_fit();
+	vector_times_.shrink_to_fit();
+	rotation_keys_.shrink_to_fit();
+	rotation_times_.shrink_to_fit();
+}
+
+std::uint16_t animation_clip::quantize_time(node_animation::seconds_t time) const
+{
+	if(duration_ <= 0.0f)
+	{
+		return 0;
+	}
+	const float t = std::min(std::max(time.count() / duration_, 0.0f), 1.0f);
+	return static_cast<std::uint16_t>(std::lround(t * time_steps));
+}
+
+animation_clip::track animation_clip::add_vector_track(const std::vector<node_animation::key<math::vec3>>& keys)
+{
+	track result;
+	result.first_key = static_cast<std::uint32_t>(vector_times_.size());
+	result.key_count = static_cast<std::uint32_t>(keys.size());
+	if(keys.empty())
+	{
+		return result;
+	}
+
+	math::vec3 min = keys.front().value;
+	math::vec3 max = keys.front().value;
+	for(const auto& key : keys)
+	{
+		min = math::min(min, key.value);
+		max = math::max(max, key.value);
+	}
+
+	const auto extent = max - min;
+	for(int i = 0; i < 3; ++i)
+	{
+		result.offset[i] = min[i];
+		result.scale[i] = extent[i] / time_steps;
+	}
+
+	for(const auto& key : keys)
+	{
+		vector_times_.emplace_back(quantize_time(key.time));
+		for(int i = 0; i < 3; ++i)
+		{
+			const float t = extent[i] > 0.0f ? (key.value[i] - min[i]) / extent[i] : 0.0f;
+			vector_keys_.emplace_back(static_cast<std::uint16_t>(std::lround(t * time_steps)));
+		}
+	}
+
+	return result;
+}
+
+animation_clip::track
+animation_clip::add_rotation_track(const std::vector<node_animation::key<math::quat>>& keys)
+{
+	track result;
+	result.first_key = static_cast<std::uint32_t>(rotation_times_.size());
+	result.key_count = static_cast<std::uint32_t>(keys.size());
+
+	// Neighbouring keys are kept in the same hemisphere so that they can be
+	// interpolated without checking the sign.
+	math::quat previous(1.0f, 0.0f, 0.0f, 0.0f);
+	for(const auto& key : keys)
+	{
+		auto q = math::normalize(key.value);
+		if(math::dot(q, previous) < 0.0f)
+		{
+			q = -q;
+		}
+		previous = q;
+
+		rotation_times_.emplace_back(quantize_time(key.time));
+		for(float v : {q.x, q.y, q.z, q.w})
+		{
+			rotation_keys_.emplace_back(static_cast<std::int16_t>(std::lround(v * rotation_steps)));
+		}
+	}
+
+	return result;
+}
+
+void animation_clip::sample(std::size_t channel, float time, std::uint32_t* cursors, joint_pose& pose) const
+{
+	const auto& c = channels_[channel];
+	const float t = duration_ > 0.0f ? std::min(std::max(time / duration_, 0.0f), 1.0f) * time_steps : 0.0f;
+
+	auto sample_vector = [&](const track& tr, std::uint32_t& cursor, float* out) {
+		if(tr.key_count == 0)
+		{
+			return;
+		}
+		std::uint32_t next = 0;
+		float factor = 0.0f;
+		const auto key =
+			find_keys(vector_times_.data() + tr.first_key, tr.key_count, t, cursor, next, factor);
+
+		const auto* keys = vector_keys_.data() + std::size_t(tr.first_key) * 3;
+		const auto a = load_unsigned(keys + key * 3);
+		const auto b = load_unsigned(keys + next * 3);
+		const auto value = add(load(tr.offset), mul(lerp(a, b, factor), load(tr.scale)));
+
+		// The fourth lane holds the next key, keep the one of the pose.
+		const float w = out[3];
+		store(out, value);
+		out[3] = w;
+	};
+
+	sample_vector(c.position, cursors[0], pose.position);
+	sample_vector(c.scaling, cursors[2], pose.scale);
+
+	const auto& tr = c.rotation;
+	if(tr.key_count > 0)
+	{
+		std::uint32_t next = 0;
+		float factor = 0.0f;
+		const auto key =
+			find_keys(rotation_times_.data() + tr.first_key, tr.key_count, t, cursors[1], next, factor);
+
+		const auto* keys = rotation_keys_.data() + std::size_t(tr.first_key) * 4;
+		const auto a = load_signed(keys + key * 4);
+		const auto b = load_signed(keys + next * 4);
+		store(pose.rotation, normalize(lerp(a, b, factor)));
+	}
+}
+
+std::size_t animation_clip::get_memory_size() const
+{
+	return sizeof(*this) + channels_.capacity() * sizeof(channel) +
+		   vector_times_.capacity() * sizeof(std::uint16_t) + vector_keys_.capacity() * sizeof(std::uint16_t) +
+		   rotation_times_.capacity() * sizeof(std::uint16_t) + rotation_keys_.capacity() * sizeof(std::int16_t);
+}
+
+} // namespace runtime
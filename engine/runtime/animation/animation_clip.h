@@ -0,0 +1,122 @@
+#pragma once
+#include "animation.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace runtime
+{
+
+//-----------------------------------------------------------------------------
+//  Name : joint_pose (Struct)
+/// <summary>
+/// Position, rotation and scale of a node. Every member is four floats so
+/// that it can be loaded by a single simd instruction, the rotation is
+/// stored as x, y, z, w.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct alignas(16) joint_pose
+{
+	float position[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	float rotation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+	float scale[4] = {1.0f, 1.0f, 1.0f, 0.0f};
+};
+
+//-----------------------------------------------------------------------------
+//  Name : blend_pose ()
+/// <summary>
+/// Adds a weighted pose to an accumulated one. The accumulated pose must
+/// start from zero and be finished with normalize_pose.
+/// </summary>
+//-----------------------------------------------------------------------------
+void blend_pose(const joint_pose& pose, float weight, joint_pose& result);
+
+//-----------------------------------------------------------------------------
+//  Name : normalize_pose ()
+/// <summary>
+/// Divides an accumulated pose by the sum of the weights added to it and
+/// normalizes its rotation.
+/// </summary>
+//-----------------------------------------------------------------------------
+void normalize_pose(joint_pose& pose, float total_weight);
+
+//-----------------------------------------------------------------------------
+//  Name : animation_clip (Class)
+/// <summary>
+/// Compact copy of an animation used for playback. Key times are stored as
+/// 16 bit fractions of the duration, positions and scales as 16 bit values
+/// inside the range of their channel and rotations as 16 bit components,
+/// about half the size of the source keys.
+/// </summary>
+//-----------------------------------------------------------------------------
+class animation_clip
+{
+public:
+	struct track
+	{
+		/// First key in the key arrays of the clip.
+		std::uint32_t first_key = 0;
+		std::uint32_t key_count = 0;
+		/// Vector keys decode as offset + key * scale.
+		float offset[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		float scale[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	};
+
+	struct channel
+	{
+		std::string node_name;
+		track position;
+		track rotation;
+		track scaling;
+	};
+
+	/// Number of cursors a channel uses when sampling.
+	static constexpr std::size_t cursors_per_channel = 3;
+
+	animation_clip(const animation& anim);
+
+	//-----------------------------------------------------------------------------
+	//  Name : sample ()
+	/// <summary>
+	/// Evaluates a channel at a time in seconds. The cursors remember the
+	/// keys found by the previous call so playing forward does not search,
+	/// they are cursors_per_channel values starting at zero.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void sample(std::size_t channel, float time, std::uint32_t* cursors, joint_pose& pose) const;
+
+	float get_duration() const
+	{
+		return duration_;
+	}
+
+	const std::vector<channel>& get_channels() const
+	{
+		return channels_;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_memory_size ()
+	/// <summary>
+	/// Bytes used by the keys of the clip.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::size_t get_memory_size() const;
+
+private:
+	track add_vector_track(const std::vector<node_animation::key<math::vec3>>& keys);
+	track add_rotation_track(const std::vector<node_animation::key<math::quat>>& keys);
+	std::uint16_t quantize_time(node_animation::seconds_t time) const;
+
+	float duration_ = 0.0f;
+	std::vector<channel> channels_;
+	/// Positions and scales, three values per key.
+	std::vector<std::uint16_t> vector_times_;
+	std::vector<std::uint16_t> vector_keys_;
+	/// Rotations, four values per key.
+	std::vector<std::uint16_t> rotation_times_;
+	std::vector<std::int16_t> rotation_keys_;
+};
+
+} // namespace runtime
@@ -9,6 +9,8 @@
 
 #include <core/audio/sound.h>
 #include <core/filesystem/filesystem.h>
+#include <core/filesystem/filesystem_mapped_file.h>
+#include <core/filesystem/filesystem_pack.h>
 #include <core/graphics/index_buffer.h>
 #include <core/graphics/shader.h>
 #include <core/graphics/texture.h>
@@ -28,6 +30,70 @@ namespace runtime
 namespace asset_reader
 {
 
+static void release_data_view(void* /*unused*/, void* user_data)
+{
+	delete static_cast<std::shared_ptr<const void>*>(user_data);
+}
+
+//-----------------------------------------------------------------------------
+//  Name : make_ref ()
+/// <summary>
+/// References the mapped pages directly instead of copying them. The owner
+/// of the view is kept alive until the renderer releases the memory.
+/// </summary>
+//-----------------------------------------------------------------------------
+static const gfx::memory_view* make_ref(const fs::data_view& view)
+{
+	return gfx::make_ref(view.data, static_cast<std::uint32_t>(view.size), release_data_view,
+						 new std::shared_ptr<const void>(view.owner));
+}
+
+//-----------------------------------------------------------------------------
+//  Name : has_compiled ()
+/// <summary>
+/// Checks whether the compiled asset is available. The mounted packs are
+/// searched first so that a packed asset costs no file system calls.
+/// </summary>
+//-----------------------------------------------------------------------------
+static bool has_compiled(const std::string& compiled_key, const std::string& compiled_absolute_key)
+{
+	if(fs::find_packed(compiled_key))
+	{
+		return true;
+	}
+
+	fs::error_code err;
+	return fs::exists(compiled_absolute_key, err);
+}
+
+//-----------------------------------------------------------------------------
+//  Name : open_compiled ()
+/// <summary>
+/// Opens the compiled asset from the mounted packs or from the loose file.
+/// Returns an empty view on failure.
+/// </summary>
+//-----------------------------------------------------------------------------
+static fs::data_view open_compiled(const std::string& compiled_key, const std::string& compiled_absolute_key)
+{
+	auto view = fs::find_packed(compiled_key);
+	if(view)
+	{
+		return view;
+	}
+
+	fs::error_code err;
+	auto file = fs::open_mapped_file(compiled_absolute_key, err);
+	if(!file)
+	{
+		return view;
+	}
+
+	view.data = file->data();
+	view.size = file->size();
+	view.owner = std::move(file);
+	return view;
+}
+
 template <>
 bool load_from_file<gfx::texture>(core::task_future<asset_handle<gfx::texture>>& output,
 								  const std::string& key)
@@ -56,25 +122,24 @@ bool load_from_file<gfx::texture>(core::task_future<asset_handle<gfx::texture>>&
 	auto cache_key = fs::replace(key, ":/data", ":/cache");
 	fs::path absolute_key = fs::absolute(fs::resolve_protocol(cache_key).string());
 	auto compiled_absolute_key = absolute_key.string() + ".asset";
+	auto compiled_key = cache_key.generic_string() + ".asset";
 
-	fs::error_code err;
-	if(!fs::exists(compiled_absolute_key, err))
+	if(!has_compiled(compiled_key, compiled_absolute_key))
 	{
 		APPLOG_ERROR("Asset with key {0} and absolute_path {1} does not exist!", key, compiled_absolute_key);
 		output = ts.push_or_execute_on_worker_thread(create_resource_func_fallback);
 		return true;
 	}
 
-	auto read_memory = std::make_shared<fs::byte_array_t>();
-	auto read_memory_func = [read_memory, compiled_absolute_key]() {
+	auto read_memory = std::make_shared<fs::data_view>();
+	auto read_memory_func = [read_memory, compiled_key, compiled_absolute_key]() {
 		if(!read_memory)
 		{
 			return false;
 		}
-		auto stream = std::ifstream{compiled_absolute_key, std::ios::in | std::ios::binary};
-		*read_memory = fs::read_stream(stream);
+		*read_memory = open_compiled(compiled_key, compiled_absolute_key);
 
-		return true;
+		return bool(*read_memory);
 	};
 
 	auto create_resource_func = [ result = original, read_memory, key ](bool read_result) mutable
@@ -89,15 +154,13 @@ bool load_from_file<gfx::texture>(core::task_future<asset_handle<gfx::texture>>&
 			return result;
 		}
 		// if nothing was read
-		if(read_memory->empty())
+		if(!*read_memory || read_memory->size == 0)
 		{
 			return result;
 		}
 
-		const gfx::memory_view* mem =
-			gfx::copy(read_memory->data(), static_cast<std::uint32_t>(read_memory->size()));
+		const gfx::memory_view* mem = make_ref(*read_memory);
 
-		read_memory->clear();
 		read_memory.reset();
 
 		if(nullptr != mem)
@@ -144,26 +207,25 @@ bool load_from_file<gfx::shader>(core::task_future<asset_handle<gfx::shader>>& o
 	fs::path absolute_key = fs::absolute(fs::resolve_protocol(cache_key).string());
 	const auto& renderer_extension = gfx::get_renderer_filename_extension();
 	auto compiled_absolute_key = absolute_key.string() + renderer_extension + ".asset";
+	auto compiled_key = cache_key.generic_string() + renderer_extension + ".asset";
 
-	fs::error_code err;
-	if(!fs::exists(compiled_absolute_key, err))
+	if(!has_compiled(compiled_key, compiled_absolute_key))
 	{
 		APPLOG_ERROR("Asset with key {0} and absolute_path {1} does not exist!", key, compiled_absolute_key);
 		output = ts.push_or_execute_on_worker_thread(create_resource_func_fallback);
 		return true;
 	}
 
-	auto read_memory = std::make_shared<fs::byte_array_t>();
+	auto read_memory = std::make_shared<fs::data_view>();
 
-	auto read_memory_func = [read_memory, compiled_absolute_key]() {
+	auto read_memory_func = [read_memory, compiled_key, compiled_absolute_key]() {
 		if(!read_memory)
 		{
 			return false;
 		}
-		auto stream = std::ifstream{compiled_absolute_key, std::ios::in | std::ios::binary};
-		*read_memory = fs::read_stream(stream);
+		*read_memory = open_compiled(compiled_key, compiled_absolute_key);
 
-		return true;
+		return bool(*read_memory);
 	};
 
 	auto create_resource_func = [ result = original, read_memory, key ](bool read_result) mutable
@@ -178,14 +240,12 @@ bool load_from_file<gfx::shader>(core::task_future<asset_handle<gfx::shader>>& o
 			return result;
 		}
 		// if nothing was read
-		if(read_memory->empty())
+		if(!*read_memory || read_memory->size == 0)
 		{
 			return result;
 		}
 
-		const gfx::memory_view* mem =
-			gfx::copy(read_memory->data(), static_cast<std::uint32_t>(read_memory->size()));
-		read_memory->clear();
+		const gfx::memory_view* mem = make_ref(*read_memory);
 		read_memory.reset();
 
 		if(nullptr != mem)
@@ -230,9 +290,9 @@ bool load_from_file<mesh>(core::task_future<asset_handle<mesh>>& output, const s
 	fs::path absolute_key = fs::absolute(fs::resolve_protocol(cache_key).string());
 
 	auto compiled_absolute_key = absolute_key.string() + ".asset";
+	auto compiled_key = cache_key.generic_string() + ".asset";
 
-	fs::error_code err;
-	if(!fs::exists(compiled_absolute_key, err))
+	if(!has_compiled(compiled_key, compiled_absolute_key))
 	{
 		APPLOG_ERROR("Asset with key {0} and absolute_path {1} does not exist!", key, compiled_absolute_key);
 		output = ts.push_or_execute_on_worker_thread(create_resource_func_fallback);
@@ -245,16 +305,35 @@ bool load_from_file<mesh>(core::task_future<asset_handle<mesh>>& output, const s
 	};
 
 	auto wrapper = std::make_shared<wrapper_t>();
-	auto read_memory_func = [wrapper, compiled_absolute_key]() mutable {
-		mesh::load_data data;
+	auto read_memory_func = [wrapper, compiled_key, compiled_absolute_key]() mutable {
+		auto file = open_compiled(compiled_key, compiled_absolute_key);
+		if(!file)
+		{
+			return false;
+		}
+
+		fs::memory_istream stream(std::move(file));
 		{
-			std::ifstream stream{compiled_absolute_key, std::ios::in | std::ios::binary};
+			cereal::iarchive_binary_t ar(stream);
 
-			if(stream.bad())
+			std::uint32_t tag = 0;
+			try_load(ar, cereal::make_nvp("tag", tag));
+			if(tag == mesh::compiled_data::tag)
 			{
-				return false;
+				mesh::compiled_data data;
+				try_load(ar, cereal::make_nvp("mesh", data));
+
+				return wrapper->mesh->load_compiled(data);
 			}
+		}
+
+		// Meshes compiled before the ready to upload format still need the
+		// full preparation.
+		stream.clear();
+		stream.seekg(0);
 
+		mesh::load_data data;
+		{
 			cereal::iarchive_binary_t ar(stream);
 
 			try_load(ar, cereal::make_nvp("mesh", data));
@@ -323,9 +402,9 @@ bool load_from_file<audio::sound>(core::task_future<asset_handle<audio::sound>>&
 	fs::path absolute_key = fs::absolute(fs::resolve_protocol(cache_key).string());
 
 	auto compiled_absolute_key = absolute_key.string() + ".asset";
+	auto compiled_key = cache_key.generic_string() + ".asset";
 
-	fs::error_code err;
-	if(!fs::exists(compiled_absolute_key, err))
+	if(!has_compiled(compiled_key, compiled_absolute_key))
 	{
 		APPLOG_ERROR("Asset with key {0} and absolute_path {1} does not exist!", key, compiled_absolute_key);
 		output = ts.push_or_execute_on_worker_thread(create_resource_func_fallback);
@@ -338,15 +417,15 @@ bool load_from_file<audio::sound>(core::task_future<asset_handle<audio::sound>>&
 	};
 
 	auto wrapper = std::make_shared<wrapper_t>();
-	auto read_memory_func = [wrapper, compiled_absolute_key]() mutable {
+	auto read_memory_func = [wrapper, compiled_key, compiled_absolute_key]() mutable {
 		{
-			std::ifstream stream{compiled_absolute_key, std::ios::in | std::ios::binary};
-
-			if(stream.bad())
+			auto file = open_compiled(compiled_key, compiled_absolute_key);
+			if(!file)
 			{
 				return false;
 			}
 
+			fs::memory_istream stream(std::move(file));
 			cereal::iarchive_binary_t ar(stream);
 
 			try_load(ar, cereal::make_nvp("sound", wrapper->data));
@@ -403,9 +482,9 @@ bool load_from_file<runtime::animation>(core::task_future<asset_handle<runtime::
 	fs::path absolute_key = fs::absolute(fs::resolve_protocol(cache_key).string());
 
 	auto compiled_absolute_key = absolute_key.string() + ".asset";
+	auto compiled_key = cache_key.generic_string() + ".asset";
 
-	fs::error_code err;
-	if(!fs::exists(compiled_absolute_key, err))
+	if(!has_compiled(compiled_key, compiled_absolute_key))
 	{
 		APPLOG_ERROR("Asset with key {0} and absolute_path {1} does not exist!", key, compiled_absolute_key);
 		output = ts.push_or_execute_on_worker_thread(create_resource_func_fallback);
@@ -418,16 +497,16 @@ bool load_from_file<runtime::animation>(core::task_future<asset_handle<runtime::
 	};
 
 	auto wrapper = std::make_shared<wrapper_t>();
-	auto read_memory_func = [wrapper, compiled_absolute_key]() mutable {
+	auto read_memory_func = [wrapper, compiled_key, compiled_absolute_key]() mutable {
 		auto& data = *wrapper->anim;
 		{
-			std::ifstream stream{compiled_absolute_key, std::ios::in | std::ios::binary};
-
-			if(stream.bad())
+			auto file = open_compiled(compiled_key, compiled_absolute_key);
+			if(!file)
 			{
 				return false;
 			}
 
+			fs::memory_istream stream(std::move(file));
 			cereal::iarchive_binary_t ar(stream);
 
 			try_load(ar, cereal::make_nvp("animation", data));
@@ -485,9 +564,9 @@ bool load_from_file<material>(core::task_future<asset_handle<material>>& output,
 	fs::path absolute_key = fs::absolute(fs::resolve_protocol(cache_key).string());
 
 	auto compiled_absolute_key = absolute_key.string() + ".asset";
+	auto compiled_key = cache_key.generic_string() + ".asset";
 
-	fs::error_code err;
-	if(!fs::exists(compiled_absolute_key, err))
+	if(!has_compiled(compiled_key, compiled_absolute_key))
 	{
 		APPLOG_ERROR("Asset with key {0} and absolute_path {1} does not exist!", key, compiled_absolute_key);
 		output = am.load<material>("embedded:/fallback");
@@ -501,13 +580,14 @@ bool load_from_file<material>(core::task_future<asset_handle<material>>& output,
 
 	auto wrapper = std::make_shared<wrapper_t>();
 
-	auto read_memory_func = [wrapper, compiled_absolute_key]() mutable {
-		std::ifstream stream{compiled_absolute_key, std::ios::in | std::ios::binary};
-
-		if(stream.bad())
+	auto read_memory_func = [wrapper, compiled_key, compiled_absolute_key]() mutable {
+		auto file = open_compiled(compiled_key, compiled_absolute_key);
+		if(!file)
 		{
 			return false;
 		}
+
+		fs::memory_istream stream(std::move(file));
 		cereal::iarchive_binary_t ar(stream);
 
 		try_load(ar, cereal::make_nvp("material", wrapper->material));
@@ -560,27 +640,33 @@ bool load_from_file<prefab>(core::task_future<asset_handle<prefab>>& output, con
 	fs::path absolute_key = fs::absolute(fs::resolve_protocol(cache_key).string());
 
 	auto compiled_absolute_key = absolute_key.string() + ".asset";
+	auto compiled_key = cache_key.generic_string() + ".asset";
 
-	fs::error_code err;
-	if(!fs::exists(compiled_absolute_key, err))
+	if(!has_compiled(compiled_key, compiled_absolute_key))
 	{
 		APPLOG_ERROR("Asset with key {0} and absolute_path {1} does not exist!", key, compiled_absolute_key);
 		output = ts.push_or_execute_on_worker_thread(create_resource_func_fallback);
 		return true;
 	}
 
-	std::shared_ptr<std::istringstream> read_memory = std::make_shared<std::istringstream>();
+	auto read_memory = std::make_shared<std::shared_ptr<std::istream>>();
 
-	auto read_memory_func = [read_memory, compiled_absolute_key]() {
+	auto read_memory_func = [read_memory, compiled_key, compiled_absolute_key]() {
 		if(!read_memory)
 		{
 			return false;
 		}
 
-		auto stream =
-			std::fstream{compiled_absolute_key, std::fstream::in | std::fstream::out | std::ios::binary};
-		auto mem = fs::read_stream(stream);
-		*read_memory = std::istringstream(std::string(mem.begin(), mem.end()));
+		auto file = open_compiled(compiled_key, compiled_absolute_key);
+		if(!file)
+		{
+			return false;
+		}
+
+		// The data outlives the load and the file can be recompiled in the
+		// meantime, so it is copied out of the mapping once.
+		auto mem = std::make_shared<fs::byte_array_t>(file.data, file.data + file.size);
+		*read_memory = std::make_shared<fs::memory_istream>(std::move(mem));
 
 		return true;
 	};
@@ -590,7 +676,7 @@ bool load_from_file<prefab>(core::task_future<asset_handle<prefab>>& output, con
 		if(read_result)
 		{
 			auto pfab = std::make_shared<prefab>();
-			pfab->data = read_memory;
+			pfab->data = *read_memory;
 
 			result.link->id = key;
 			result.link->asset = pfab;
@@ -632,27 +718,33 @@ bool load_from_file<scene>(core::task_future<asset_handle<scene>>& output, const
 	fs::path absolute_key = fs::absolute(fs::resolve_protocol(cache_key).string());
 
 	auto compiled_absolute_key = absolute_key.string() + ".asset";
+	auto compiled_key = cache_key.generic_string() + ".asset";
 
-	fs::error_code err;
-	if(!fs::exists(compiled_absolute_key, err))
+	if(!has_compiled(compiled_key, compiled_absolute_key))
 	{
 		APPLOG_ERROR("Asset with key {0} and absolute_path {1} does not exist!", key, compiled_absolute_key);
 		output = ts.push_or_execute_on_worker_thread(create_resource_func_fallback);
 		return true;
 	}
 
-	std::shared_ptr<std::istringstream> read_memory = std::make_shared<std::istringstream>();
+	auto read_memory = std::make_shared<std::shared_ptr<std::istream>>();
 
-	auto read_memory_func = [read_memory, compiled_absolute_key]() {
+	auto read_memory_func = [read_memory, compiled_key, compiled_absolute_key]() {
 		if(!read_memory)
 		{
 			return false;
 		}
 
-		auto stream =
-			std::fstream{compiled_absolute_key, std::fstream::in | std::fstream::out | std::ios::binary};
-		auto mem = fs::read_stream(stream);
-		*read_memory = std::istringstream(std::string(mem.begin(), mem.end()));
+		auto file = open_compiled(compiled_key, compiled_absolute_key);
+		if(!file)
+		{
+			return false;
+		}
+
+		// The data outlives the load and the file can be recompiled in the
+		// meantime, so it is copied out of the mapping once.
+		auto mem = std::make_shared<fs::byte_array_t>(file.data, file.data + file.size);
+		*read_memory = std::make_shared<fs::memory_istream>(std::move(mem));
 
 		return true;
 	};
@@ -662,7 +754,7 @@ bool load_from_file<scene>(core::task_future<asset_handle<scene>>& output, const
 		if(read_result)
 		{
 			auto sc = std::make_shared<scene>();
-			sc->data = read_memory;
+			sc->data = *read_memory;
 
 			result.link->id = key;
 			result.link->asset = sc;
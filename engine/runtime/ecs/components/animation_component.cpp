@@ -0,0 +1,288 @@
+#include "animation_component.h"
+#include "transform_component.h"
+
+#include <algorithm>
+#include <cmath>
+
+void animation_component::set_animation(asset_handle<runtime::animation> animation)
+{
+	layers_.clear();
+	if(animation)
+	{
+		layer l;
+		l.animation = std::move(animation);
+		layers_.emplace_back(std::move(l));
+	}
+
+	touch();
+}
+
+asset_handle<runtime::animation> animation_component::get_animation() const
+{
+	if(layers_.empty())
+	{
+		return {};
+	}
+	return layers_.front().animation;
+}
+
+void animation_component::blend(asset_handle<runtime::animation> animation, float weight)
+{
+	auto it = std::find_if(std::begin(layers_), std::end(layers_),
+						   [&animation](const layer& l) { return l.animation == animation; });
+	if(weight <= 0.0f)
+	{
+		if(it != std::end(layers_))
+		{
+			layers_.erase(it);
+		}
+	}
+	else if(it != std::end(layers_))
+	{
+		it->weight = weight;
+	}
+	else if(animation)
+	{
+		layer l;
+		l.animation = std::move(animation);
+		l.weight = weight;
+		layers_.emplace_back(std::move(l));
+	}
+
+	touch();
+}
+
+const std::vector<animation_component::layer>& animation_component::get_layers() const
+{
+	return layers_;
+}
+
+void animation_component::set_speed(float speed)
+{
+	speed_ = speed;
+
+	touch();
+}
+
+float animation_component::get_speed() const
+{
+	return speed_;
+}
+
+void animation_component::set_loop(bool on)
+{
+	loop_ = on;
+
+	touch();
+}
+
+bool animation_component::is_looping() const
+{
+	return loop_;
+}
+
+void animation_component::set_playing(bool on)
+{
+	playing_ = on;
+
+	touch();
+}
+
+bool animation_component::is_playing() const
+{
+	return playing_;
+}
+
+bool animation_component::needs_binding(std::uint64_t subtree_version) const
+{
+	if(subtree_version != subtree_version_ || bindings_.size() != layers_.size())
+	{
+		return true;
+	}
+
+	for(std::size_t i = 0; i < layers_.size(); ++i)
+	{
+		if(bindings_[i].source != layers_[i].animation.get())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void animation_component::bind(const std::vector<std::shared_ptr<const runtime::animation_clip>>& clips,
+							   const std::unordered_map<std::string, runtime::entity>& nodes,
+							   std::uint64_t subtree_version)
+{
+	subtree_version_ = subtree_version;
+
+	// Nodes that stay bound keep their rest pose, the local transform they
+	// have now is the animated one.
+	std::unordered_map<std::uint64_t, runtime::joint_pose> previous_rest_poses;
+	for(std::size_t i = 0; i < targets_.size() && i < rest_poses_.size(); ++i)
+	{
+		previous_rest_poses.emplace(targets_[i].id().id(), rest_poses_[i]);
+	}
+
+	auto previous_bindings = std::move(bindings_);
+	bindings_.clear();
+	targets_.clear();
+
+	std::unordered_map<std::string, std::int32_t> target_ids;
+	for(std::size_t i = 0; i < layers_.size(); ++i)
+	{
+		layer_binding binding;
+		binding.source = layers_[i].animation.get();
+		binding.clip = i < clips.size() ? clips[i] : nullptr;
+		if(binding.clip)
+		{
+			const auto& channels = binding.clip->get_channels();
+			binding.targets.resize(channels.size(), -1);
+			binding.cursors.resize(channels.size() * runtime::animation_clip::cursors_per_channel, 0);
+			for(std::size_t c = 0; c < channels.size(); ++c)
+			{
+				const auto& name = channels[c].node_name;
+				auto target = target_ids.find(name);
+				if(target == target_ids.end())
+				{
+					auto node = nodes.find(name);
+					if(node == nodes.end())
+					{
+						continue;
+					}
+					target = target_ids.emplace(name, static_cast<std::int32_t>(targets_.size())).first;
+					targets_.emplace_back(node->second);
+				}
+				binding.targets[c] = target->second;
+			}
+
+			// Same clip, the cursors are still good hints.
+			if(i < previous_bindings.size() && previous_bindings[i].clip == binding.clip)
+			{
+				binding.cursors = std::move(previous_bindings[i].cursors);
+			}
+		}
+		bindings_.emplace_back(std::move(binding));
+	}
+
+	// Tracks without keys leave the node as it was when bound.
+	rest_poses_.resize(targets_.size());
+	for(std::size_t i = 0; i < targets_.size(); ++i)
+	{
+		auto& rest = rest_poses_[i];
+		auto previous = previous_rest_poses.find(targets_[i].id().id());
+		if(previous != previous_rest_poses.end())
+		{
+			rest = previous->second;
+			continue;
+		}
+		rest = {};
+
+		auto transform_comp = targets_[i].get_component<transform_component>().lock();
+		if(transform_comp)
+		{
+			const auto& local = transform_comp->get_local_transform();
+			const auto& position = local.get_position();
+			const auto& rotation = local.get_rotation();
+			const auto& scale = local.get_scale();
+			std::copy(&position[0], &position[0] + 3, rest.position);
+			std::copy(&scale[0], &scale[0] + 3, rest.scale);
+			rest.rotation[0] = rotation.x;
+			rest.rotation[1] = rotation.y;
+			rest.rotation[2] = rotation.z;
+			rest.rotation[3] = rotation.w;
+		}
+	}
+
+	poses_.resize(targets_.size());
+	weights_.resize(targets_.size());
+}
+
+void animation_component::update(runtime::entity_component_system& ecs, float dt)
+{
+	if(bindings_.empty() || targets_.empty())
+	{
+		return;
+	}
+
+	runtime::joint_pose zero;
+	zero.rotation[3] = 0.0f;
+	std::fill(zero.scale, zero.scale + 4, 0.0f);
+	std::fill(std::begin(poses_), std::end(poses_), zero);
+	std::fill(std::begin(weights_), std::end(weights_), 0.0f);
+
+	for(std::size_t i = 0; i < bindings_.size() && i < layers_.size(); ++i)
+	{
+		auto& l = layers_[i];
+		auto& binding = bindings_[i];
+		if(!binding.clip || l.weight <= 0.0f)
+		{
+			continue;
+		}
+
+		const auto& clip = *binding.clip;
+		const float duration = clip.get_duration();
+		if(playing_)
+		{
+			l.time += dt * speed_;
+			if(loop_ && duration > 0.0f)
+			{
+				l.time = std::fmod(l.time, duration);
+				if(l.time < 0.0f)
+				{
+					l.time += duration;
+				}
+			}
+			else
+			{
+				l.time = std::min(std::max(l.time, 0.0f), duration);
+			}
+		}
+
+		for(std::size_t c = 0; c < binding.targets.size(); ++c)
+		{
+			const auto target = binding.targets[c];
+			if(target < 0)
+			{
+				continue;
+			}
+
+			auto pose = rest_poses_[std::size_t(target)];
+			clip.sample(c, l.time, &binding.cursors[c * runtime::animation_clip::cursors_per_channel], pose);
+			runtime::blend_pose(pose, l.weight, poses_[std::size_t(target)]);
+			weights_[std::size_t(target)] += l.weight;
+		}
+	}
+
+	for(std::size_t i = 0; i < targets_.size(); ++i)
+	{
+		if(weights_[i] <= 0.0f || !ecs.valid(targets_[i].id()))
+		{
+			continue;
+		}
+
+		// Raw access, the nodes only belong to this component.
+		auto transform_comp = ecs.get_component_ptr<transform_component>(targets_[i].id());
+		if(transform_comp == nullptr)
+		{
+			continue;
+		}
+
+		auto& p = poses_[i];
+		runtime::normalize_pose(p, weights_[i]);
+
+		math::transform local;
+		local.set_position(math::vec3(p.position[0], p.position[1], p.position[2]));
+		local.set_rotation(math::quat(p.rotation[3], p.rotation[0], p.rotation[1], p.rotation[2]));
+		local.set_scale(math::vec3(p.scale[0], p.scale[1], p.scale[2]));
+		transform_comp->set_local_transform(local);
+	}
+}
+
+void animation_component::remap_entities(const runtime::entity_remap_t& remap)
+{
+	for(auto& target : targets_)
+	{
+		target = remap(target);
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+//-----------------------------------------------------------------------------
+// animation_component Header Includes
+//-----------------------------------------------------------------------------
+#include "../../animation/animation_clip.h"
+#include "../../assets/asset_handle.h"
+#include "../ecs.h"
+
+#include <core/common/basetypes.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Main Class Declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//  Name : animation_component (Class)
+/// <summary>
+/// Plays animations on the nodes under its entity, e.g. the bones created
+/// for a skinned model. Several animations can play at once and are blended
+/// by their weights.
+/// </summary>
+//-----------------------------------------------------------------------------
+class animation_component : public runtime::component_impl<animation_component>
+{
+	SERIALIZABLE(animation_component)
+	REFLECTABLEV(animation_component, runtime::component)
+
+public:
+	struct layer
+	{
+		asset_handle<runtime::animation> animation;
+		/// Playback position in seconds.
+		float time = 0.0f;
+		float weight = 1.0f;
+	};
+
+	//-------------------------------------------------------------------------
+	// Public Methods
+	//-------------------------------------------------------------------------
+	//-----------------------------------------------------------------------------
+	//  Name : set_animation ()
+	/// <summary>
+	/// Replaces every layer with a single animation played from the start.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_animation(asset_handle<runtime::animation> animation);
+	asset_handle<runtime::animation> get_animation() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : blend ()
+	/// <summary>
+	/// Sets the weight of an animation, adding a layer for it when it is not
+	/// playing yet. A weight of zero removes the layer.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void blend(asset_handle<runtime::animation> animation, float weight);
+
+	const std::vector<layer>& get_layers() const;
+
+	void set_speed(float speed);
+	float get_speed() const;
+	void set_loop(bool on);
+	bool is_looping() const;
+	void set_playing(bool on);
+	bool is_playing() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : needs_binding ()
+	/// <summary>
+	/// Checks whether the layers or the hierarchy under the entity changed
+	/// since bind was last called, see transform_component::get_subtree_version.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool needs_binding(std::uint64_t subtree_version) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : bind ()
+	/// <summary>
+	/// Sets the clip of every layer and finds the node each of its channels
+	/// animates. The rest pose of a node is taken the first time it is bound
+	/// and kept by later binds. Changes the component so it must not run in
+	/// parallel.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void bind(const std::vector<std::shared_ptr<const runtime::animation_clip>>& clips,
+			  const std::unordered_map<std::string, runtime::entity>& nodes, std::uint64_t subtree_version);
+
+	//-----------------------------------------------------------------------------
+	//  Name : update ()
+	/// <summary>
+	/// Advances the layers and writes the blended pose to the local transforms
+	/// of the bound nodes. Only touches this component and its nodes so
+	/// different components can be updated in parallel.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update(runtime::entity_component_system& ecs, float dt);
+
+	//-----------------------------------------------------------------------------
+	//  Name : remap_entities (virtual )
+	/// <summary>
+	/// Remaps the bound nodes.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void remap_entities(const runtime::entity_remap_t& remap) override;
+
+private:
+	struct layer_binding
+	{
+		const runtime::animation* source = nullptr;
+		std::shared_ptr<const runtime::animation_clip> clip;
+		/// Target of each channel or -1.
+		std::vector<std::int32_t> targets;
+		std::vector<std::uint32_t> cursors;
+	};
+
+	//-------------------------------------------------------------------------
+	// Private Member Variables.
+	//-------------------------------------------------------------------------
+	/// Playing animations.
+	std::vector<layer> layers_;
+	///
+	float speed_ = 1.0f;
+	///
+	bool loop_ = true;
+	///
+	bool playing_ = true;
+	/// Runtime data matching the layers.
+	std::vector<layer_binding> bindings_;
+	/// Animated nodes and their poses.
+	std::vector<runtime::entity> targets_;
+	std::vector<runtime::joint_pose> rest_poses_;
+	std::vector<runtime::joint_pose> poses_;
+	std::vector<float> weights_;
+	/// Subtree version of the entity at the last bind.
+	std::uint64_t subtree_version_ = 0;
+};
@@ -59,16 +59,14 @@ void model_component::set_model(const model& model)
 	touch();
 }
 
-void model_component::set_bone_transforms(const std::vector<math::transform>& bone_transforms)
+const std::vector<math::transform::mat4_t>& model_component::get_skinning_transforms() const
 {
-	bone_transforms_ = bone_transforms;
-
-	touch();
+	return skinning_transforms_;
 }
 
-const std::vector<math::transform>& model_component::get_bone_transforms() const
+std::vector<math::transform::mat4_t>& model_component::get_skinning_transforms()
 {
-	return bone_transforms_;
+	return skinning_transforms_;
 }
 
 void model_component::set_bone_entities(const std::vector<runtime::entity>& bone_entities)
@@ -83,6 +81,14 @@ const std::vector<runtime::entity>& model_component::get_bone_entities() const
 	return bone_entities_;
 }
 
+void model_component::remap_entities(const runtime::entity_remap_t& remap)
+{
+	for(auto& bone_entity : bone_entities_)
+	{
+		bone_entity = remap(bone_entity);
+	}
+}
+
 bool model_component::casts_reflection() const
 {
 	return casts_reflection_;
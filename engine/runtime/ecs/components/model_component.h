@@ -107,8 +107,25 @@ public:
 
 	void set_bone_entities(const std::vector<runtime::entity>& bone_entities);
 	const std::vector<runtime::entity>& get_bone_entities() const;
-	void set_bone_transforms(const std::vector<math::transform>& bone_transforms);
-	const std::vector<math::transform>& get_bone_transforms() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : remap_entities (virtual )
+	/// <summary>
+	/// Remaps the bone entities.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void remap_entities(const runtime::entity_remap_t& remap) override;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_skinning_transforms ()
+	/// <summary>
+	/// Skinning matrix of every bone of the skin, i.e. the world transform of
+	/// the bone multiplied by its bind pose. Indexed like the bones of the
+	/// skin bind data and kept between frames so it can be filled in place.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const std::vector<math::transform::mat4_t>& get_skinning_transforms() const;
+	std::vector<math::transform::mat4_t>& get_skinning_transforms();
 
 private:
 	//-------------------------------------------------------------------------
@@ -124,5 +141,6 @@ private:
 	model model_;
 	///
 	std::vector<runtime::entity> bone_entities_;
-	std::vector<math::transform> bone_transforms_;
+	///
+	std::vector<math::transform::mat4_t> skinning_transforms_;
 };
@@ -4,8 +4,45 @@
 
 #include <algorithm>
 
+std::atomic<std::uint64_t> transform_component::hierarchy_version_{0};
+
+transform_component::transform_component()
+{
+	hierarchy_version_++;
+}
+
+std::uint64_t transform_component::get_hierarchy_version()
+{
+	return hierarchy_version_;
+}
+
+std::uint64_t transform_component::get_subtree_version() const
+{
+	return subtree_version_;
+}
+
+void transform_component::touch_subtree()
+{
+	const auto version = ++hierarchy_version_;
+	subtree_version_ = version;
+
+	auto parent = parent_;
+	while(parent.valid())
+	{
+		auto parent_transform = parent.get_component<transform_component>().lock();
+		if(!parent_transform)
+		{
+			break;
+		}
+		parent_transform->subtree_version_ = version;
+		parent = parent_transform->parent_;
+	}
+}
+
 void transform_component::on_entity_set()
 {
+	touch_subtree();
+
 	for(auto& child : children_)
 	{
 		if(child.valid())
@@ -21,6 +58,8 @@ void transform_component::on_entity_set()
 
 transform_component::~transform_component()
 {
+	hierarchy_version_++;
+
 	if(parent_.valid())
 	{
 		auto parent_transform = parent_.get_component<transform_component>().lock();
@@ -319,6 +358,30 @@ bool check_parent(const runtime::entity& e, const runtime::entity& parent)
 	return true;
 }
 
+void transform_component::remap_entities(const runtime::entity_remap_t& remap)
+{
+	parent_ = remap(parent_);
+	for(auto& child : children_)
+	{
+		child = remap(child);
+	}
+}
+
+void transform_component::adopt_children()
+{
+	for(auto child : children_)
+	{
+		if(child.valid())
+		{
+			auto child_transform = child.get_component<transform_component>().lock();
+			if(child_transform)
+			{
+				child_transform->parent_ = get_entity();
+			}
+		}
+	}
+}
+
 void transform_component::set_parent(runtime::entity parent, bool world_position_stays,
 									 bool local_position_stays)
 {
@@ -378,8 +441,14 @@ const runtime::entity& transform_component::get_parent() const
 void transform_component::attach_child(const runtime::entity& child)
 {
 	children_.push_back(child);
+	touch_subtree();
 
-	set_dirty(is_dirty());
+	// The new child is now relative to us.
+	auto child_transform = child.get_component<transform_component>().lock();
+	if(child_transform)
+	{
+		child_transform->set_dirty(true);
+	}
 }
 
 void transform_component::remove_child(const runtime::entity& child)
@@ -387,6 +456,7 @@ void transform_component::remove_child(const runtime::entity& child)
 	children_.erase(std::remove_if(std::begin(children_), std::end(children_),
 								   [&child](const auto& other) { return child == other; }),
 					std::end(children_));
+	touch_subtree();
 }
 
 void transform_component::cleanup_dead_children()
@@ -394,6 +464,7 @@ void transform_component::cleanup_dead_children()
 	children_.erase(std::remove_if(std::begin(children_), std::end(children_),
 								   [](const auto& other) { return other.valid() == false; }),
 					std::end(children_));
+	touch_subtree();
 }
 
 void transform_component::set_transform(const math::transform& tr)
@@ -475,6 +546,23 @@ void transform_component::resolve(bool force)
 	}
 }
 
+void transform_component::resolve(const math::transform* parent_transform)
+{
+	if(is_dirty())
+	{
+		if(parent_transform != nullptr)
+		{
+			world_transform_ = *parent_transform * local_transform_;
+		}
+		else
+		{
+			world_transform_ = local_transform_;
+		}
+
+		set_dirty(false);
+	}
+}
+
 bool transform_component::is_dirty() const
 {
 	return dirty_;
@@ -482,12 +570,20 @@ bool transform_component::is_dirty() const
 
 void transform_component::set_dirty(bool dirty)
 {
+	// A dirty transform always has a dirty subtree, so there is nothing
+	// to propagate.
+	const bool was_dirty = dirty_;
 	dirty_ = dirty;
 
 	if(dirty_ == true)
 	{
 		touch();
 
+		if(was_dirty)
+		{
+			return;
+		}
+
 		for(const auto& child : children_)
 		{
 			if(child.valid())
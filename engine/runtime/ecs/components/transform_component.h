@@ -4,6 +4,8 @@
 
 #include <core/math/math_includes.h>
 
+#include <atomic>
+
 //-----------------------------------------------------------------------------
 // Main Class Declarations
 //-----------------------------------------------------------------------------
@@ -32,7 +34,7 @@ public:
 	///
 	/// </summary>
 	//-----------------------------------------------------------------------------
-	transform_component() = default;
+	transform_component();
 
 	//-----------------------------------------------------------------------------
 	//  Name : ~transform_component ()
@@ -57,6 +59,34 @@ public:
 	//-----------------------------------------------------------------------------
 	void resolve(bool force = false);
 
+	//-----------------------------------------------------------------------------
+	//  Name : resolve ()
+	/// <summary>
+	/// Resolves a dirty world transform against the already resolved world
+	/// transform of the parent (nullptr for roots) without going through the
+	/// parent entity. Used by the batched hierarchy update.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void resolve(const math::transform* parent_transform);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_hierarchy_version ()
+	/// <summary>
+	/// Counter that changes whenever a transform is created, destroyed or
+	/// attached somewhere else in a hierarchy.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static std::uint64_t get_hierarchy_version();
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_subtree_version ()
+	/// <summary>
+	/// Changes whenever a transform is attached to or removed from the
+	/// hierarchy under this one, at any depth.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::uint64_t get_subtree_version() const;
+
 	//-----------------------------------------------------------------------------
 	//  Name : is_dirty (virtual )
 	/// <summary>
@@ -77,6 +107,14 @@ public:
 	//-----------------------------------------------------------------------------
 	virtual void on_entity_set() override;
 
+	//-----------------------------------------------------------------------------
+	//  Name : remap_entities (virtual )
+	/// <summary>
+	/// Remaps the parent and the children.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void remap_entities(const runtime::entity_remap_t& remap) override;
+
 	//-----------------------------------------------------------------------------
 	//  Name : get_local_transform ()
 	/// <summary>
@@ -522,6 +560,16 @@ public:
 	//-----------------------------------------------------------------------------
 	void remove_child(const runtime::entity& child);
 
+	//-----------------------------------------------------------------------------
+	//  Name : adopt_children ()
+	/// <summary>
+	/// Sets this entity as the parent of every child that has a transform,
+	/// without touching the list of children. Used once a loaded hierarchy
+	/// has all of its components.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void adopt_children();
+
 	//-----------------------------------------------------------------------------
 	//  Name : cleanup_dead_children ()
 	/// <summary>
@@ -533,6 +581,15 @@ public:
 	void cleanup_dead_children();
 
 protected:
+	//-----------------------------------------------------------------------------
+	//  Name : touch_subtree ()
+	/// <summary>
+	/// Bumps the hierarchy version and stores it as the subtree version of
+	/// this transform and all of its parents.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void touch_subtree();
+
     void apply_transform(math::transform& trans);
     void apply_local_transform(const math::transform& trans);
 
@@ -549,4 +606,9 @@ protected:
 	math::transform world_transform_;
 	/// Should recalc world transform.
 	bool dirty_ = true;
+	/// Changes whenever the structure of any hierarchy changes.
+	static std::atomic<std::uint64_t> hierarchy_version_;
+	/// Value of hierarchy_version_ when the hierarchy under this transform
+	/// last changed.
+	std::uint64_t subtree_version_ = 0;
 };
@@ -1,17 +1,35 @@
 #include "prefab.h"
-#include "utils.h"
 
 runtime::entity prefab::instantiate()
 {
-	std::vector<runtime::entity> out_data;
-	if(!data)
+	auto instances = instantiate(1);
+	if(instances.empty())
 		return {};
+	else
+		return instances.front();
+}
 
-	if(!ecs::utils::deserialize_data(*data, out_data))
-		return {};
+std::vector<runtime::entity> prefab::instantiate(std::size_t count)
+{
+	std::vector<runtime::entity> instances;
+	if(!data)
+		return instances;
 
-	if(out_data.empty())
-		return {};
-	else
-		return out_data.front();
+	if(!template_)
+	{
+		auto decoded = std::make_shared<ecs::utils::entity_template>();
+		if(!ecs::utils::read_template(*data, *decoded))
+			return instances;
+
+		template_ = decoded;
+	}
+
+	// The first root of every copy.
+	const auto roots = ecs::utils::instantiate(*template_, count);
+	const auto roots_per_copy = template_->roots.size();
+	for(std::size_t i = 0; roots_per_copy > 0 && i < roots.size(); i += roots_per_copy)
+	{
+		instances.emplace_back(roots[i]);
+	}
+	return instances;
 }
@@ -1,11 +1,33 @@
 #pragma once
 
 #include "../ecs.h"
+#include "utils.h"
+
 #include <fstream>
 #include <memory>
 
 struct prefab
 {
+	//-----------------------------------------------------------------------------
+	//  Name : instantiate ()
+	/// <summary>
+	/// Creates one instance of the prefab.
+	/// </summary>
+	//-----------------------------------------------------------------------------
 	runtime::entity instantiate();
+
+	//-----------------------------------------------------------------------------
+	//  Name : instantiate ()
+	/// <summary>
+	/// Creates count instances of the prefab in one batch. The data is
+	/// decoded on the first call only.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::vector<runtime::entity> instantiate(std::size_t count);
+
 	std::shared_ptr<std::istream> data;
+
+private:
+	/// Decoded data, shared by every instance.
+	std::shared_ptr<ecs::utils::entity_template> template_;
 };
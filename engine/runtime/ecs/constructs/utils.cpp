@@ -1,9 +1,18 @@
 #include "utils.h"
 #include "../../meta/ecs/entity.hpp"
+#include "../components/transform_component.h"
 
+#include <core/filesystem/filesystem_mapped_file.h>
 #include <core/serialization/associative_archive.h>
 #include <core/serialization/binary_archive.h>
 #include <core/serialization/serialization.h>
+#include <core/serialization/types/string.hpp>
+#include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
 
 namespace ecs
 {
@@ -42,6 +51,204 @@ static bool deserialize_t(std::istream& stream, std::vector<runtime::entity>& ou
 	return false;
 }
 
+// The binary format starts with the ids of all entities, the ids of the
+// saved ones and a table of chunks. Every chunk is a binary archive with
+// the name and components of its entities, which refer to other entities
+// by id only.
+static const std::uint32_t binary_magic = 0x4e435345; // "ESCN"
+static const std::uint32_t binary_version = 1;
+static const std::uint32_t binary_chunk_size = 256;
+
+struct staged_entity
+{
+	std::string name;
+	std::vector<std::shared_ptr<runtime::component>> components;
+};
+
+struct world_scope
+{
+	world_scope(runtime::entity_component_system& world)
+	{
+		runtime::set_serialization_world(&world);
+	}
+	~world_scope()
+	{
+		runtime::set_serialization_world(nullptr);
+	}
+};
+
+struct lookup_scope
+{
+	lookup_scope(const runtime::serialization_lookup_t& lookup)
+	{
+		runtime::set_serialization_lookup(&lookup);
+	}
+	~lookup_scope()
+	{
+		runtime::set_serialization_lookup(nullptr);
+	}
+};
+
+template <typename T>
+static void write_pod(std::ostream& stream, const T& value)
+{
+	stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_pod(const fs::byte_array_t& buffer, std::size_t& offset, T& value)
+{
+	if(buffer.size() - offset < sizeof(T))
+	{
+		return false;
+	}
+	std::memcpy(&value, buffer.data() + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+template <typename T>
+static bool read_pods(const fs::byte_array_t& buffer, std::size_t& offset, std::vector<T>& values)
+{
+	std::uint32_t count = 0;
+	if(!read_pod(buffer, offset, count) || (buffer.size() - offset) / sizeof(T) < count)
+	{
+		return false;
+	}
+	values.resize(count);
+	for(auto& value : values)
+	{
+		read_pod(buffer, offset, value);
+	}
+	return true;
+}
+
+static bool is_binary(std::istream& stream)
+{
+	std::uint32_t magic = 0;
+	stream.seekg(0, stream.beg);
+	stream.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	const bool result = stream.gcount() == sizeof(magic) && magic == binary_magic;
+	stream.clear();
+	stream.seekg(0, stream.beg);
+	return result;
+}
+
+// Saves the data once, which fills the serialization map with every entity
+// reachable from it. Leaves the map filled so that references to any of
+// them are saved as the id only.
+static std::vector<runtime::entity> gather_entities(const std::vector<runtime::entity>& data)
+{
+	auto& serialization_map = runtime::get_serialization_map();
+	serialization_map.clear();
+	{
+		std::ostringstream discard;
+		cereal::oarchive_binary_t ar(discard);
+		try_save(ar, cereal::make_nvp("data", data));
+	}
+
+	std::vector<runtime::entity> entities;
+	entities.reserve(serialization_map.size());
+	for(const auto& entry : serialization_map)
+	{
+		if(entry.second.valid())
+		{
+			entities.emplace_back(entry.second);
+		}
+	}
+	return entities;
+}
+
+static void bake_template(const std::vector<runtime::entity>& data,
+						  const std::vector<runtime::entity>& entities, entity_template& out_template)
+{
+	out_template = {};
+	for(const auto& entity : entities)
+	{
+		out_template.ids.emplace_back(entity.id().id());
+	}
+	for(const auto& entity : data)
+	{
+		out_template.roots.emplace_back(entity.id().id());
+	}
+
+	std::ostringstream stream;
+	for(std::uint32_t first = 0; first < entities.size(); first += binary_chunk_size)
+	{
+		entity_template::chunk chunk;
+		chunk.first = first;
+		chunk.count = std::min<std::uint32_t>(binary_chunk_size, std::uint32_t(entities.size()) - first);
+		chunk.offset = std::size_t(stream.tellp());
+		{
+			cereal::oarchive_binary_t ar(stream);
+			for(std::uint32_t e = chunk.first; e < chunk.first + chunk.count; ++e)
+			{
+				const auto& entity = entities[e];
+				const auto components = entity.all_components_shared();
+				try_save(ar, cereal::make_nvp("name", entity.get_name()));
+				try_save(ar, cereal::make_nvp("components", components));
+			}
+		}
+		chunk.size = std::size_t(stream.tellp()) - chunk.offset;
+		out_template.chunks.emplace_back(chunk);
+	}
+	runtime::get_serialization_map().clear();
+
+	const auto bytes = stream.str();
+	out_template.data = std::make_shared<fs::byte_array_t>(std::begin(bytes), std::end(bytes));
+}
+
+static bool read_binary_template(std::istream& stream, entity_template& out_template)
+{
+	auto buffer = std::make_shared<fs::byte_array_t>(fs::read_stream(stream));
+	stream.clear();
+	stream.seekg(0);
+
+	out_template = {};
+	std::size_t offset = 0;
+	std::uint32_t magic = 0;
+	std::uint32_t version = 0;
+	std::uint32_t chunk_count = 0;
+	if(!read_pod(*buffer, offset, magic) || !read_pod(*buffer, offset, version) ||
+	   version != binary_version || !read_pods(*buffer, offset, out_template.ids) ||
+	   !read_pods(*buffer, offset, out_template.roots) || !read_pod(*buffer, offset, chunk_count) ||
+	   (buffer->size() - offset) / (2 * sizeof(std::uint32_t) + sizeof(std::uint64_t)) < chunk_count)
+	{
+		return false;
+	}
+
+	std::vector<std::uint64_t> sizes(chunk_count);
+	out_template.chunks.resize(chunk_count);
+	for(std::size_t i = 0; i < chunk_count; ++i)
+	{
+		auto& chunk = out_template.chunks[i];
+		if(!read_pod(*buffer, offset, chunk.first) || !read_pod(*buffer, offset, chunk.count) ||
+		   !read_pod(*buffer, offset, sizes[i]) ||
+		   chunk.first + std::uint64_t(chunk.count) > out_template.ids.size())
+		{
+			return false;
+		}
+	}
+
+	// The chunks follow the table.
+	const auto data_offset = offset;
+	for(std::size_t i = 0; i < chunk_count; ++i)
+	{
+		auto& chunk = out_template.chunks[i];
+		if(buffer->size() - offset < sizes[i])
+		{
+			return false;
+		}
+		chunk.offset = offset - data_offset;
+		chunk.size = std::size_t(sizes[i]);
+		offset += chunk.size;
+	}
+
+	buffer->erase(std::begin(*buffer), std::begin(*buffer) + std::ptrdiff_t(data_offset));
+	out_template.data = buffer;
+	return true;
+}
+
 void save_entity_to_file(const fs::path& full_path, const runtime::entity& data)
 {
 	save_entities_to_file(full_path, {data});
@@ -71,24 +278,281 @@ bool load_entities_from_file(const fs::path& full_path, std::vector<runtime::ent
 	return deserialize_t<cereal::iarchive_associative_t>(is, out_data);
 }
 
-runtime::entity clone_entity(const runtime::entity& data)
+void save_entities_to_binary_file(const fs::path& full_path, const std::vector<runtime::entity>& data)
+{
+	entity_template binary_template;
+	bake_template(data, binary_template);
+
+	std::ofstream os(full_path.string(), std::fstream::binary | std::fstream::trunc);
+	write_pod(os, binary_magic);
+	write_pod(os, binary_version);
+	write_pod(os, std::uint32_t(binary_template.ids.size()));
+	for(const auto id : binary_template.ids)
+	{
+		write_pod(os, id);
+	}
+	write_pod(os, std::uint32_t(binary_template.roots.size()));
+	for(const auto id : binary_template.roots)
+	{
+		write_pod(os, id);
+	}
+	write_pod(os, std::uint32_t(binary_template.chunks.size()));
+	for(const auto& chunk : binary_template.chunks)
+	{
+		write_pod(os, chunk.first);
+		write_pod(os, chunk.count);
+		write_pod(os, std::uint64_t(chunk.size));
+	}
+	os.write(reinterpret_cast<const char*>(binary_template.data->data()),
+			 std::streamsize(binary_template.data->size()));
+}
+
+void bake_template(const std::vector<runtime::entity>& data, entity_template& out_template)
+{
+	bake_template(data, gather_entities(data), out_template);
+}
+
+bool read_template(std::istream& stream, entity_template& out_template)
+{
+	if(is_binary(stream))
+	{
+		return read_binary_template(stream, out_template);
+	}
+
+	// Text archives are loaded once into the system to be encoded again.
+	std::vector<runtime::entity> data;
+	if(!deserialize_t<cereal::iarchive_associative_t>(stream, data))
+	{
+		return false;
+	}
+	auto entities = gather_entities(data);
+	bake_template(data, entities, out_template);
+	for(auto& entity : entities)
+	{
+		entity.destroy();
+	}
+	return true;
+}
+
+static std::vector<runtime::entity> instantiate(const entity_template& source, std::size_t count,
+												runtime::entity_component_system& ecs, bool parallel)
+{
+	std::vector<runtime::entity> roots;
+	const auto entity_count = source.ids.size();
+	if(count == 0 || entity_count == 0 || !source.data)
+	{
+		return roots;
+	}
+
+	// Every entity exists before the components that refer to it are read.
+	std::vector<runtime::serialization_lookup_t> lookups(count);
+	std::vector<runtime::entity> entities;
+	entities.reserve(count * entity_count);
+	for(auto& lookup : lookups)
+	{
+		lookup.reserve(entity_count);
+		for(const auto id : source.ids)
+		{
+			entities.emplace_back(ecs.create());
+			lookup[id] = entities.back();
+		}
+	}
+
+	// Components are built on the workers, each task decodes one chunk for
+	// several copies. The owner thread keeps running its own tasks while it
+	// waits, assets requested by the components are created there. A
+	// private world is filled on the calling thread alone.
+	std::vector<staged_entity> staged(entities.size());
+	const auto decode = [&](const entity_template::chunk& chunk, std::size_t first_copy,
+							std::size_t last_copy) {
+		for(auto copy = first_copy; copy < last_copy; ++copy)
+		{
+			fs::memory_istream chunk_stream(
+				fs::data_view{source.data, source.data->data() + chunk.offset, chunk.size});
+			lookup_scope scope(lookups[copy]);
+			cereal::iarchive_binary_t ar(chunk_stream);
+			const auto base = copy * entity_count;
+			for(std::size_t e = chunk.first; e < chunk.first + chunk.count; ++e)
+			{
+				try_load(ar, cereal::make_nvp("name", staged[base + e].name));
+				try_load(ar, cereal::make_nvp("components", staged[base + e].components));
+			}
+		}
+	};
+
+	if(parallel)
+	{
+		auto& ts = core::get_subsystem<core::task_system>();
+		std::vector<core::task_future<void>> tasks;
+		for(const auto& chunk : source.chunks)
+		{
+			const std::size_t copies_per_task =
+				std::max<std::size_t>(binary_chunk_size / std::max(chunk.count, 1u), 1);
+			for(std::size_t copy = 0; copy < count; copy += copies_per_task)
+			{
+				const auto last_copy = std::min(copy + copies_per_task, count);
+				tasks.emplace_back(ts.push_on_worker_thread([&decode, &chunk, copy, last_copy]() {
+					decode(chunk, copy, last_copy);
+				}));
+			}
+		}
+		for(const auto& task : tasks)
+		{
+			task.wait();
+		}
+	}
+	else
+	{
+		for(const auto& chunk : source.chunks)
+		{
+			decode(chunk, 0, count);
+		}
+	}
+
+	// Commit everything at once.
+	std::vector<transform_component*> transforms;
+	for(std::size_t e = 0; e < entities.size(); ++e)
+	{
+		auto& entity = entities[e];
+		entity.set_name(staged[e].name);
+		for(const auto& component : staged[e].components)
+		{
+			if(component)
+			{
+				entity.assign(component);
+				component->touch();
+			}
+		}
+
+		auto transform = entity.get_component<transform_component>().lock();
+		if(transform)
+		{
+			transforms.emplace_back(transform.get());
+		}
+	}
+	for(auto transform : transforms)
+	{
+		transform->adopt_children();
+	}
+
+	roots.reserve(count * source.roots.size());
+	for(const auto& lookup : lookups)
+	{
+		for(const auto id : source.roots)
+		{
+			auto it = lookup.find(id);
+			roots.emplace_back(it != lookup.end() ? it->second : runtime::entity());
+		}
+	}
+	return roots;
+}
+
+std::vector<runtime::entity> instantiate(const entity_template& source, std::size_t count)
 {
-	std::stringstream stream;
-	serialize_t<cereal::oarchive_binary_t>(stream, {data});
+	auto& ecs = core::get_subsystem<runtime::entity_component_system>();
+	return instantiate(source, count, ecs, true);
+}
 
-	std::vector<runtime::entity> vec_data;
-	deserialize_t<cereal::iarchive_binary_t>(stream, vec_data);
+std::vector<runtime::entity> instantiate(const entity_template& source, std::size_t count,
+										 runtime::entity_component_system& world)
+{
+	return instantiate(source, count, world, false);
+}
 
-	if(!vec_data.empty())
+runtime::entity clone_entity(const runtime::entity& data)
+{
+	auto clones = clone_entities(data, 1);
+	if(!clones.empty())
 	{
-		return vec_data.front();
+		return clones.front();
 	}
 	return {};
 }
 
+std::vector<runtime::entity> clone_entities(const runtime::entity& data, std::size_t count)
+{
+	entity_template source;
+	bake_template({data}, source);
+	return instantiate(source, count);
+}
+
 bool deserialize_data(std::istream& stream, std::vector<runtime::entity>& out_data)
 {
+	if(is_binary(stream))
+	{
+		entity_template source;
+		if(!read_binary_template(stream, source))
+		{
+			return false;
+		}
+		out_data = instantiate(source, 1);
+		return true;
+	}
 	return deserialize_t<cereal::iarchive_associative_t>(stream, out_data);
 }
+
+bool deserialize_data(std::istream& stream, runtime::entity_component_system& world,
+					  std::vector<runtime::entity>& out_data)
+{
+	if(is_binary(stream))
+	{
+		entity_template source;
+		if(!read_binary_template(stream, source))
+		{
+			return false;
+		}
+		out_data = instantiate(source, 1, world);
+		return true;
+	}
+
+	world_scope scope(world);
+	return deserialize_t<cereal::iarchive_associative_t>(stream, out_data);
+}
+
+std::vector<runtime::entity> unload_entities(const std::vector<runtime::entity>& data,
+											 runtime::entity_component_system& world)
+{
+	// Take the whole hierarchies and detach them, nothing left behind refers
+	// to them then.
+	std::vector<runtime::entity> entities;
+	std::vector<std::size_t> roots;
+	for(auto root : data)
+	{
+		roots.emplace_back(entities.size());
+		entities.emplace_back(root);
+		if(!root.valid())
+		{
+			continue;
+		}
+
+		auto root_transform = root.get_component<transform_component>().lock();
+		if(root_transform && root_transform->get_parent().valid())
+		{
+			root_transform->set_parent(runtime::entity());
+		}
+
+		for(auto i = roots.back(); i < entities.size(); ++i)
+		{
+			auto transform = entities[i].get_component<transform_component>().lock();
+			if(transform)
+			{
+				const auto& children = transform->get_children();
+				entities.insert(std::end(entities), std::begin(children), std::end(children));
+			}
+		}
+	}
+
+	auto& ecs = core::get_subsystem<runtime::entity_component_system>();
+	const auto moved = ecs.move_entities(entities, world);
+
+	std::vector<runtime::entity> result;
+	result.reserve(roots.size());
+	for(const auto root : roots)
+	{
+		result.emplace_back(moved[root]);
+	}
+	return result;
+}
+}
 }
 }
@@ -4,7 +4,9 @@
 
 #include <core/filesystem/filesystem.h>
 
+#include <cstdint>
 #include <fstream>
+#include <memory>
 #include <vector>
 
 namespace ecs
@@ -12,7 +14,88 @@ namespace ecs
 namespace utils
 {
 
+//-----------------------------------------------------------------------------
+//  Name : entity_template (Struct)
+/// <summary>
+/// Entities encoded once in the binary scene format so that they can be
+/// instantiated any number of times without parsing a text archive again.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct entity_template
+{
+	struct chunk
+	{
+		/// Range of ids decoded by the chunk.
+		std::uint32_t first = 0;
+		std::uint32_t count = 0;
+		/// Range of the chunk in the data.
+		std::size_t offset = 0;
+		std::size_t size = 0;
+	};
+
+	/// Ids the entities were saved with, their components refer to each
+	/// other by these.
+	std::vector<std::uint64_t> ids;
+	/// Ids of the entities an instance returns.
+	std::vector<std::uint64_t> roots;
+	std::vector<chunk> chunks;
+	/// Binary archives of the chunks.
+	std::shared_ptr<const fs::byte_array_t> data;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : bake_template ()
+/// <summary>
+/// Encodes the entities and every entity they refer to.
+/// </summary>
+//-----------------------------------------------------------------------------
+void bake_template(const std::vector<runtime::entity>& data, entity_template& out_template);
+
+//-----------------------------------------------------------------------------
+//  Name : read_template ()
+/// <summary>
+/// Reads a template from data saved in either format. Text archives are
+/// loaded into the system once and removed again after encoding them.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool read_template(std::istream& stream, entity_template& out_template);
+
+//-----------------------------------------------------------------------------
+//  Name : instantiate ()
+/// <summary>
+/// Creates count copies of the template in one batch. Entity references
+/// inside a copy point to the entities of the same copy. Returns the roots
+/// of every copy one after the other. Must be called on the owner thread.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::vector<runtime::entity> instantiate(const entity_template& source, std::size_t count);
+
+//-----------------------------------------------------------------------------
+//  Name : instantiate ()
+/// <summary>
+/// Same as above but into the given world, decoding on the calling thread.
+/// A worker can fill a private world with it.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::vector<runtime::entity> instantiate(const entity_template& source, std::size_t count,
+										 runtime::entity_component_system& world);
+
+//-----------------------------------------------------------------------------
+//  Name : clone_entity ()
+/// <summary>
+/// Copies the entity and every entity it refers to.
+/// </summary>
+//-----------------------------------------------------------------------------
 runtime::entity clone_entity(const runtime::entity& data);
+
+//-----------------------------------------------------------------------------
+//  Name : clone_entities ()
+/// <summary>
+/// Makes count copies of the entity, encoding it only once.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::vector<runtime::entity> clone_entities(const runtime::entity& data, std::size_t count);
+
 //-----------------------------------------------------------------------------
 //  Name : save_entity ()
 /// <summary>
@@ -53,14 +136,46 @@ void save_entities_to_file(const fs::path& full_path, const std::vector<runtime:
 //-----------------------------------------------------------------------------
 bool load_entities_from_file(const fs::path& full_path, std::vector<runtime::entity>& out_data);
 
+//-----------------------------------------------------------------------------
+//  Name : save_entities_to_binary_file ()
+/// <summary>
+/// Saves the entities and every entity they refer to in the binary scene
+/// format. Entities are split in chunks which can be loaded in parallel.
+/// </summary>
+//-----------------------------------------------------------------------------
+void save_entities_to_binary_file(const fs::path& full_path, const std::vector<runtime::entity>& data);
+
 //-----------------------------------------------------------------------------
 //  Name : deserialize_data ()
 /// <summary>
-///
-///
-///
+/// Loads entities saved either by save_entities_to_file or by
+/// save_entities_to_binary_file. Must be called on the owner thread.
 /// </summary>
 //-----------------------------------------------------------------------------
 bool deserialize_data(std::istream& stream, std::vector<runtime::entity>& out_data);
+
+//-----------------------------------------------------------------------------
+//  Name : deserialize_data ()
+/// <summary>
+/// Loads entities saved in either format into a private world. Can be
+/// called from any thread, as long as nothing else uses the world. Move them
+/// to the entity_component_system subsystem with its merge on the owner
+/// thread.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool deserialize_data(std::istream& stream, runtime::entity_component_system& world,
+					  std::vector<runtime::entity>& out_data);
+
+//-----------------------------------------------------------------------------
+//  Name : unload_entities ()
+/// <summary>
+/// Moves the entities and all of their children from the subsystem into a
+/// private world, the reverse of merge. The roots are detached from their
+/// parents. Returns the roots in the world, which can then be saved or
+/// disposed on a worker. Must be called on the owner thread.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::vector<runtime::entity> unload_entities(const std::vector<runtime::entity>& data,
+											 runtime::entity_component_system& world);
 }
 }
@@ -35,6 +35,8 @@ event<void(entity)> on_entity_destroyed;
 event<void(entity, chandle<component>)> on_component_added;
 event<void(entity, chandle<component>)> on_component_removed;
 
+const std::uint32_t component_storage::npos;
+
 component_storage::component_storage(std::size_t size)
 {
 	expand(size);
@@ -42,34 +44,183 @@ component_storage::component_storage(std::size_t size)
 
 void component_storage::expand(std::size_t n)
 {
-	data.resize(n);
+	if(sparse_.size() < n)
+	{
+		sparse_.resize(n, npos);
+		bits_.resize((n + 63) / 64, 0);
+	}
+
+	if(changed_words_ < bits_.size())
+	{
+		// Grow along with the sparse array, keeping what is marked already.
+		const auto words = bits_.size();
+		std::unique_ptr<std::atomic<std::uint64_t>[]> changed_bits(new std::atomic<std::uint64_t>[words]);
+		for(std::size_t i = 0; i < words; ++i)
+		{
+			const auto value = i < changed_words_ ? changed_bits_[i].load(std::memory_order_relaxed) : 0;
+			changed_bits[i].store(value, std::memory_order_relaxed);
+		}
+		changed_bits_ = std::move(changed_bits);
+		changed_words_ = words;
+	}
 }
 
 void component_storage::reserve(std::size_t n)
 {
-	data.reserve(n);
+	sparse_.reserve(n);
+	bits_.reserve((n + 63) / 64);
+	entities_.reserve(n);
+	packed_.reserve(n);
+	owners_.reserve(n);
 }
 
 std::shared_ptr<component> component_storage::get(std::size_t n) const
 {
 	expects(n < size());
-	return data[n];
+	const auto slot = sparse_[n];
+	if(slot == npos)
+	{
+		return nullptr;
+	}
+	return owners_[slot];
 }
 
 void component_storage::destroy(std::size_t n)
 {
 	expects(n < size());
-	auto& element = data[n];
-	element.reset();
+	const auto slot = sparse_[n];
+	if(slot == npos)
+	{
+		return;
+	}
+
+	// Keep the component alive until the packed arrays are consistent again,
+	// its destructor may call back into the system.
+	auto element = std::move(owners_[slot]);
+
+	// Move the last element into the freed slot.
+	const auto last = static_cast<std::uint32_t>(packed_.size() - 1);
+	if(slot != last)
+	{
+		const auto moved = entities_[last];
+		entities_[slot] = moved;
+		packed_[slot] = packed_[last];
+		owners_[slot] = std::move(owners_[last]);
+		sparse_[moved] = slot;
+	}
+	entities_.pop_back();
+	packed_.pop_back();
+	owners_.pop_back();
+	sparse_[n] = npos;
+	bits_[n / 64] &= ~(std::uint64_t(1) << (n % 64));
+	removed_[current_].push_back(static_cast<std::uint32_t>(n));
 }
 
 std::weak_ptr<component> component_storage::set(unsigned int index,
 												const std::shared_ptr<component>& component)
 {
-	data[index] = component;
+	expand(index + 1);
+	auto& slot = sparse_[index];
+	if(slot == npos)
+	{
+		slot = static_cast<std::uint32_t>(packed_.size());
+		entities_.push_back(index);
+		packed_.push_back(component.get());
+		owners_.push_back(component);
+		bits_[index / 64] |= std::uint64_t(1) << (index % 64);
+		added_[current_].push_back(index);
+	}
+	else
+	{
+		// Release the previous component only after the new one is in place.
+		auto previous = std::move(owners_[slot]);
+		packed_[slot] = component.get();
+		owners_[slot] = component;
+	}
 	return component;
 }
 
+void component_storage::mark_changed(std::size_t n)
+{
+	if(n >= size())
+	{
+		return;
+	}
+
+	// Only the first change of a frame is listed.
+	const auto bit = std::uint64_t(1) << (n % 64);
+	if((changed_bits_[n / 64].fetch_or(bit, std::memory_order_relaxed) & bit) != 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(changes_mutex_);
+	changed_[current_].push_back(static_cast<std::uint32_t>(n));
+}
+
+void component_storage::advance_changes()
+{
+	std::lock_guard<std::mutex> lock(changes_mutex_);
+	for(const auto n : changed_[current_])
+	{
+		changed_bits_[n / 64].fetch_and(~(std::uint64_t(1) << (n % 64)), std::memory_order_relaxed);
+	}
+
+	current_ ^= 1;
+	changed_[current_].clear();
+	added_[current_].clear();
+	removed_[current_].clear();
+}
+
+entity::id_t command_buffer::create()
+{
+	// Fresh slots start at version one, like the ones created directly.
+	const entity::id_t id(manager_->reserve_index(), 1);
+	command cmd;
+	cmd.type = command_type::create;
+	cmd.id = id;
+	record(std::move(cmd));
+	return id;
+}
+
+void command_buffer::destroy(entity::id_t id)
+{
+	command cmd;
+	cmd.type = command_type::destroy;
+	cmd.id = id;
+	record(std::move(cmd));
+}
+
+void command_buffer::assign(entity::id_t id, const std::shared_ptr<component>& comp)
+{
+	command cmd;
+	cmd.type = command_type::assign;
+	cmd.id = id;
+	cmd.comp = comp;
+	record(std::move(cmd));
+}
+
+void command_buffer::remove(entity::id_t id, rtti::type_index_sequential_t::index_t family)
+{
+	command cmd;
+	cmd.type = command_type::remove;
+	cmd.id = id;
+	cmd.family = family;
+	record(std::move(cmd));
+}
+
+void command_buffer::set_sort_key(std::uint64_t key)
+{
+	sort_key_ = key;
+}
+
+void command_buffer::record(command&& cmd)
+{
+	cmd.sort_key = sort_key_;
+	std::lock_guard<std::mutex> lock(mutex_);
+	commands_.emplace_back(std::move(cmd));
+}
+
 /////////////////////////////////////////////////////////////////////////////
 const entity::id_t entity::INVALID;
 
@@ -98,6 +249,11 @@ void entity::destroy()
 	invalidate();
 }
 
+entity_component_system::entity_component_system(bool emit_events)
+	: emit_events_(emit_events)
+{
+}
+
 entity_component_system::~entity_component_system()
 {
 	dispose();
@@ -105,7 +261,8 @@ entity_component_system::~entity_component_system()
 
 size_t entity_component_system::size() const
 {
-	return entity_component_mask_.size() - free_list_.size();
+	// Slots reserved by a command buffer are neither alive nor free.
+	return alive_count_;
 }
 
 size_t entity_component_system::capacity() const
@@ -115,7 +272,9 @@ size_t entity_component_system::capacity() const
 
 bool entity_component_system::valid(entity::id_t id) const
 {
-	return id.index() < entity_version_.size() && entity_version_[id.index()] == id.version();
+	// Slots reserved by a command buffer exist before their entity does.
+	return id.index() < entity_version_.size() && entity_version_[id.index()] == id.version() &&
+		   entity_alive_[id.index()] != 0;
 }
 
 bool entity_component_system::valid_index(uint32_t index) const
@@ -138,8 +297,13 @@ entity entity_component_system::create()
 		free_list_.pop_back();
 		version = entity_version_[index];
 	}
+	entity_alive_[index] = 1;
+	++alive_count_;
 	entity entity(this, entity::id_t(index, version));
-	on_entity_created(entity);
+	if(emit_events_)
+	{
+		on_entity_created(entity);
+	}
 	return entity;
 }
 
@@ -153,17 +317,222 @@ const std::string& entity_component_system::get_entity_name(entity::id_t id)
 	return entity_names_[id.id()];
 }
 
+command_buffer& entity_component_system::get_command_buffer()
+{
+	// Systems are told apart by serial, an address could be reused.
+	thread_local std::vector<std::pair<std::uint64_t, command_buffer*>> thread_buffers;
+	for(const auto& entry : thread_buffers)
+	{
+		if(entry.first == serial_)
+		{
+			return *entry.second;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(buffers_mutex_);
+	buffers_.emplace_back(new command_buffer(this));
+	thread_buffers.emplace_back(serial_, buffers_.back().get());
+	return *buffers_.back();
+}
+
+void entity_component_system::playback_commands()
+{
+	std::vector<command_buffer::command> commands;
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex_);
+		for(auto& buffer : buffers_)
+		{
+			std::lock_guard<std::mutex> buffer_lock(buffer->mutex_);
+			std::move(std::begin(buffer->commands_), std::end(buffer->commands_),
+					  std::back_inserter(commands));
+			buffer->commands_.clear();
+		}
+	}
+
+	std::stable_sort(std::begin(commands), std::end(commands),
+					 [](const auto& lhs, const auto& rhs) { return lhs.sort_key < rhs.sort_key; });
+
+	// Create first so that every other command finds its entity.
+	using command_type = command_buffer::command_type;
+	for(const auto& cmd : commands)
+	{
+		const auto index = cmd.id.index();
+		if(cmd.type != command_type::create || (index < entity_alive_.size() && entity_alive_[index] != 0))
+		{
+			continue;
+		}
+
+		accomodate_entity(index);
+		entity_version_[index] = cmd.id.version();
+		entity_alive_[index] = 1;
+		++alive_count_;
+		if(emit_events_)
+		{
+			on_entity_created(entity(this, cmd.id));
+		}
+	}
+
+	for(const auto& cmd : commands)
+	{
+		if(!valid(cmd.id))
+		{
+			continue;
+		}
+
+		switch(cmd.type)
+		{
+			case command_type::assign:
+				assign(cmd.id, cmd.comp);
+				break;
+			case command_type::remove:
+				if(has_component(cmd.id, cmd.family))
+				{
+					remove(cmd.id, cmd.family);
+				}
+				break;
+			case command_type::destroy:
+				destroy(cmd.id);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+std::uint64_t entity_component_system::next_serial()
+{
+	static std::atomic<std::uint64_t> serial{0};
+	return ++serial;
+}
+
+void entity_component_system::mark_changed(entity::id_t id, rtti::type_index_sequential_t::index_t family)
+{
+	if(family < component_pools_.size() && component_pools_[family])
+	{
+		component_pools_[family]->mark_changed(id.index());
+	}
+}
+
+void entity_component_system::advance_changes()
+{
+	for(auto& pool : component_pools_)
+	{
+		if(pool)
+		{
+			pool->advance_changes();
+		}
+	}
+}
+
+std::vector<entity> entity_component_system::merge(entity_component_system& source,
+												   const std::vector<entity>& handles)
+{
+	// Listing an entity twice moves it once, the handles come first so that
+	// their new handles are the first ones returned.
+	std::vector<entity> entities(handles);
+	for(entity entity : source.all_entities())
+	{
+		entities.emplace_back(entity);
+	}
+
+	auto moved = source.move_entities(entities, *this);
+	moved.resize(handles.size());
+	return moved;
+}
+
+std::vector<entity> entity_component_system::move_entities(const std::vector<entity>& entities,
+														   entity_component_system& target)
+{
+	expects(&target != this);
+
+	// Every entity exists in the target before the components that refer to
+	// it are moved.
+	std::unordered_map<std::uint64_t, entity> moved;
+	std::vector<entity::id_t> ids;
+	std::vector<entity> result;
+	result.reserve(entities.size());
+	for(const auto& handle : entities)
+	{
+		if(handle.manager_ != this || !valid(handle.id_))
+		{
+			result.emplace_back();
+			continue;
+		}
+
+		auto it = moved.find(handle.id_.id());
+		if(it == moved.end())
+		{
+			auto created = target.create();
+			target.set_entity_name(created.id(), get_entity_name(handle.id_));
+			it = moved.emplace(handle.id_.id(), created).first;
+			ids.emplace_back(handle.id_);
+		}
+		result.emplace_back(it->second);
+	}
+
+	const entity_remap_t remap = [this, &moved](const entity& handle) {
+		if(handle.manager_ == this)
+		{
+			auto it = moved.find(handle.id_.id());
+			if(it != moved.end())
+			{
+				return it->second;
+			}
+		}
+		return handle;
+	};
+
+	// Take the components off the entities here and keep them alive.
+	std::vector<std::vector<std::shared_ptr<component>>> components(ids.size());
+	for(std::size_t i = 0; i < ids.size(); ++i)
+	{
+		components[i] = all_components_shared(ids[i]);
+		for(const auto& component : components[i])
+		{
+			remove(ids[i], component->runtime_id());
+		}
+	}
+
+	for(std::size_t i = 0; i < ids.size(); ++i)
+	{
+		const auto id = moved[ids[i].id()].id();
+		for(const auto& component : components[i])
+		{
+			component->remap_entities(remap);
+		}
+		for(const auto& component : components[i])
+		{
+			target.assign(id, component);
+			component->touch();
+		}
+		destroy(ids[i]);
+	}
+
+	return result;
+}
+
 void entity_component_system::dispose()
 {
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex_);
+		for(auto& buffer : buffers_)
+		{
+			std::lock_guard<std::mutex> buffer_lock(buffer->mutex_);
+			buffer->commands_.clear();
+		}
+	}
+
 	for(entity entity : all_entities())
 	{
 		entity.destroy();
 	}
 
-	component_pools_.clear();
+	// The pools are empty now, keeping them keeps the removals listed.
 	entity_component_mask_.clear();
 	entity_version_.clear();
+	entity_alive_.clear();
 	free_list_.clear();
+	alive_count_ = 0;
 	index_counter_ = 0;
 }
 
@@ -180,7 +549,10 @@ void entity_component_system::remove(entity::id_t id, rtti::type_index_sequentia
 	// Find the pool for this component family.
 	auto& pool = component_pools_[family];
 	chandle<component> handle(pool->get(id.index()));
-	on_component_removed(get(id), handle);
+	if(emit_events_)
+	{
+		on_component_removed(get(id), handle);
+	}
 	// Remove component bit.
 	entity_component_mask_[id.index()].reset(family);
 
@@ -260,7 +632,10 @@ chandle<component> entity_component_system::assign(entity::id_t id, const std::s
 	comp->entity_ = get(id);
 	comp->on_entity_set();
 	chandle<component> handle(ptr);
-	on_component_added(get(id), handle);
+	if(emit_events_)
+	{
+		on_component_added(get(id), handle);
+	}
 	return handle;
 }
 
@@ -283,9 +658,14 @@ void entity_component_system::destroy(entity::id_t id)
 		}
 	}
 
-	on_entity_destroyed(get(id));
+	if(emit_events_)
+	{
+		on_entity_destroyed(get(id));
+	}
 	entity_component_mask_[index].reset();
 	entity_version_[index]++;
+	entity_alive_[index] = 0;
+	--alive_count_;
 	free_list_.push_back(index);
 }
 
@@ -304,4 +684,13 @@ entity::id_t entity_component_system::create_id(uint32_t index) const
 component::~component()
 {
 }
+
+void component::touch()
+{
+	last_touched_ = static_cast<std::uint32_t>(ecs::get_frame());
+	if(entity_.valid())
+	{
+		entity_.manager_->mark_changed(entity_.id(), runtime_id());
+	}
+}
 }
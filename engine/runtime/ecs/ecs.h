@@ -4,11 +4,16 @@
 
 #include <core/common/assert.hpp>
 #include <core/common/nonstd/type_index.hpp>
+#include <core/memory/pool_allocator.hpp>
 #include <core/reflection/registration.h>
 #include <core/serialization/serialization.h>
 #include <core/signals/event.hpp>
+#include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <bitset>
 #include <cstdint>
 #include <cstdlib>
@@ -23,9 +28,14 @@
 #include <string>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace runtime
 {
 
@@ -34,24 +44,66 @@ namespace ecs
 using frame_getter_t = std::function<std::uint64_t()>;
 void set_frame_getter(frame_getter_t frame_getter);
 std::uint64_t get_frame();
+
+//-----------------------------------------------------------------------------
+//  Name : component_ids ()
+/// <summary>
+/// Gets the runtime ids of the specified component types. Can be used to
+/// declare the reads and writes of a core::task_graph node.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename... Components>
+std::vector<std::uint64_t> component_ids();
+
+namespace detail
+{
+/// Index of the lowest set bit. x must not be zero.
+inline std::uint32_t count_trailing_zeros(std::uint64_t x)
+{
+#if defined(_MSC_VER)
+	unsigned long index = 0;
+	_BitScanForward64(&index, x);
+	return static_cast<std::uint32_t>(index);
+#else
+	return static_cast<std::uint32_t>(__builtin_ctzll(x));
+#endif
+}
+}
 }
 
 template <typename C>
 using chandle = std::weak_ptr<C>;
 
 class component;
+
+/**
+ * Sparse set of the components of one family.
+ *
+ * The sparse array maps an entity index to a slot in the packed arrays,
+ * which hold the components of the family back to back. Iteration and
+ * lookups through the raw pointers never touch the reference counts. The
+ * packed owners keep the shared ownership that chandle observes.
+ */
 class component_storage
 {
 public:
+	static const std::uint32_t npos = 0xffffffffu;
+
 	component_storage(std::size_t size = 100);
 
+	/// Number of entity slots covered by the sparse array.
 	inline std::size_t size() const
 	{
-		return data.size();
+		return sparse_.size();
 	}
 	inline std::size_t capacity() const
 	{
-		return data.capacity();
+		return sparse_.capacity();
+	}
+	/// Number of components stored.
+	inline std::size_t count() const
+	{
+		return packed_.size();
 	}
 	/// Ensure at least n elements will fit in the pool.
 	void expand(std::size_t n);
@@ -66,24 +118,114 @@ public:
 		return std::static_pointer_cast<T>(get(n));
 	}
 
+	/// Raw access that does not touch the reference count. Returns nullptr
+	/// if the entity at index n has no component of this family.
+	inline component* get_ptr(std::size_t n) const
+	{
+		if(n >= sparse_.size())
+		{
+			return nullptr;
+		}
+		const auto slot = sparse_[n];
+		return slot == npos ? nullptr : packed_[slot];
+	}
+
+	template <typename T>
+	T* get_ptr(std::size_t n) const
+	{
+		static_assert(std::is_base_of<component, T>::value, "Invalid component type.");
+
+		return static_cast<T*>(get_ptr(n));
+	}
+
+	/// Bits of the entities [word * 64, word * 64 + 64) that have a component
+	/// of this family.
+	inline std::uint64_t word(std::size_t word) const
+	{
+		return word < bits_.size() ? bits_[word] : 0;
+	}
+
+	/// Packed entity indices, parallel to components().
+	inline const std::vector<std::uint32_t>& entities() const
+	{
+		return entities_;
+	}
+
+	/// Packed component pointers, parallel to entities().
+	inline const std::vector<component*>& components() const
+	{
+		return packed_;
+	}
+
 	void destroy(std::size_t n);
 
 	template <typename T, typename... Args>
 	std::weak_ptr<T> set(unsigned int index, Args&&... args)
 	{
-		auto element = std::make_shared<T>(std::forward<Args>(args)...);
-		data[index] = std::move(element);
-		return std::static_pointer_cast<T>(data[index]);
+		auto element = std::allocate_shared<T>(core::pool_allocator<T>(), std::forward<Args>(args)...);
+		set(index, element);
+		return element;
 	}
 
 	std::weak_ptr<component> set(unsigned int index, const std::shared_ptr<component>& component);
 
+	/// Record that the component at entity index n was changed. Safe to call
+	/// from any thread as long as nothing is created or destroyed meanwhile.
+	void mark_changed(std::size_t n);
+
+	/// Start a new frame of changes, the ones recorded so far become the ones
+	/// returned by changed(), added() and removed().
+	void advance_changes();
+
+	/// Entity indices whose component was changed during the last frame, each
+	/// one listed once.
+	inline const std::vector<std::uint32_t>& changed() const
+	{
+		return changed_[current_ ^ 1];
+	}
+
+	/// Entity indices which got a component during the last frame. An index
+	/// may repeat and its component may be gone already.
+	inline const std::vector<std::uint32_t>& added() const
+	{
+		return added_[current_ ^ 1];
+	}
+
+	/// Entity indices which lost their component during the last frame. An
+	/// index may repeat and may have a component again.
+	inline const std::vector<std::uint32_t>& removed() const
+	{
+		return removed_[current_ ^ 1];
+	}
+
 private:
-	std::vector<std::shared_ptr<component>> data;
+	/// Entity index to packed slot or npos.
+	std::vector<std::uint32_t> sparse_;
+	/// Packed slot to entity index.
+	std::vector<std::uint32_t> entities_;
+	/// Packed component pointers.
+	std::vector<component*> packed_;
+	/// Packed owners.
+	std::vector<std::shared_ptr<component>> owners_;
+	/// One bit per entity slot, set if it has a component of this family.
+	std::vector<std::uint64_t> bits_;
+	/// One bit per entity slot, set once it is in the current changed list.
+	std::unique_ptr<std::atomic<std::uint64_t>[]> changed_bits_;
+	std::size_t changed_words_ = 0;
+	/// Lists being recorded at current_ and the ones of the last frame at
+	/// the other index.
+	std::array<std::vector<std::uint32_t>, 2> changed_;
+	std::array<std::vector<std::uint32_t>, 2> added_;
+	std::array<std::vector<std::uint32_t>, 2> removed_;
+	std::uint32_t current_ = 0;
+	std::mutex changes_mutex_;
 };
 
 class entity_component_system;
 
+template <typename C>
+class component_ref;
+
 /** A convenience handle around an entity::Id.
  *
  * If an entity is destroyed, any copies will be invalidated. Use valid() to
@@ -221,6 +363,9 @@ public:
 	template <typename C>
 	chandle<C> get_component() const;
 
+	template <typename C>
+	component_ref<C> get_component_ref() const;
+
 	template <typename... Components>
 	std::tuple<chandle<Components>...> components() const;
 
@@ -242,10 +387,58 @@ public:
 	void destroy();
 
 private:
+	friend class component;
+	friend class entity_component_system;
+
 	entity::id_t id_ = INVALID;
 	entity_component_system* manager_ = nullptr;
 };
 
+/// Gives the handle an entity has after moving to another world, or the
+/// same handle for entities which did not move.
+using entity_remap_t = std::function<entity(const entity&)>;
+
+/**
+ * A non owning handle to a component.
+ *
+ * Unlike chandle it does not observe the component through its control
+ * block, so copying and dereferencing it never touches an atomic. It is
+ * resolved through the entity_component_system on every access and becomes
+ * empty once the entity is destroyed or the component removed.
+ */
+template <typename C>
+class component_ref
+{
+public:
+	component_ref() = default;
+	component_ref(entity_component_system* manager, entity::id_t id)
+		: id_(id)
+		, manager_(manager)
+	{
+	}
+
+	C* get() const;
+
+	C* operator->() const
+	{
+		return get();
+	}
+
+	C& operator*() const
+	{
+		return *get();
+	}
+
+	explicit operator bool() const
+	{
+		return get() != nullptr;
+	}
+
+private:
+	entity::id_t id_ = entity::INVALID;
+	entity_component_system* manager_ = nullptr;
+};
+
 class component : public std::enable_shared_from_this<component>
 {
 	REFLECTABLEV(component)
@@ -292,15 +485,11 @@ public:
 	//-----------------------------------------------------------------------------
 	//  Name : touch (virtual )
 	/// <summary>
-	///
-	///
-	///
+	/// Marks the component as changed during this frame. It is listed by
+	/// entity_component_system::changed during the next one.
 	/// </summary>
 	//-----------------------------------------------------------------------------
-	void touch()
-	{
-		last_touched_ = static_cast<std::uint32_t>(ecs::get_frame());
-	}
+	void touch();
 
 	//-----------------------------------------------------------------------------
 	//  Name : is_dirty (virtual )
@@ -327,6 +516,17 @@ public:
 	{
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : remap_entities (virtual )
+	/// <summary>
+	/// Called when the component moves to another world. Every entity it
+	/// refers to must be replaced by what remap returns for it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	virtual void remap_entities(const entity_remap_t& /*remap*/)
+	{
+	}
+
 	//-----------------------------------------------------------------------------
 	//  Name : get_entity ()
 	/// <summary>
@@ -386,6 +586,91 @@ extern event<void(entity)> on_entity_destroyed;
 extern event<void(entity, chandle<component>)> on_component_added;
 extern event<void(entity, chandle<component>)> on_component_removed;
 
+/**
+ * Records structural changes from any thread to be played back by
+ * entity_component_system::playback_commands on the owner thread.
+ *
+ * Every thread gets its own buffer through
+ * entity_component_system::get_command_buffer. Ids of the entities it
+ * creates are reserved right away, so the other commands and later frames
+ * can refer to them before they exist.
+ */
+class command_buffer
+{
+public:
+	/**
+	 * Reserve an entity that is created at the next playback.
+	 */
+	entity::id_t create();
+
+	/**
+	 * Destroy an entity at the next playback, if it is still alive by then.
+	 */
+	void destroy(entity::id_t id);
+
+	/**
+	 * Assign a component at the next playback. The component is constructed
+	 * right away on the calling thread.
+	 */
+	template <typename C, typename... Args>
+	void assign(entity::id_t id, Args&&... args)
+	{
+		assign(id, std::allocate_shared<C>(core::pool_allocator<C>(), std::forward<Args>(args)...));
+	}
+	void assign(entity::id_t id, const std::shared_ptr<component>& comp);
+
+	/**
+	 * Remove a component at the next playback, if the entity still has it.
+	 */
+	template <typename C>
+	void remove(entity::id_t id)
+	{
+		remove(id, rtti::type_index_sequential_t::id<component, C>());
+	}
+	void remove(entity::id_t id, rtti::type_index_sequential_t::index_t family);
+
+	/**
+	 * Commands are played back ordered by this key, then in the order they
+	 * were recorded. Give each job its own key, e.g. the first index of a
+	 * parallel_for chunk, and the order no longer depends on which thread
+	 * ran it.
+	 */
+	void set_sort_key(std::uint64_t key);
+
+private:
+	friend class entity_component_system;
+
+	enum class command_type : std::uint8_t
+	{
+		create,
+		assign,
+		remove,
+		destroy
+	};
+
+	struct command
+	{
+		std::uint64_t sort_key = 0;
+		command_type type = command_type::create;
+		entity::id_t id;
+		rtti::type_index_sequential_t::index_t family = 0;
+		std::shared_ptr<component> comp;
+	};
+
+	explicit command_buffer(entity_component_system* manager)
+		: manager_(manager)
+	{
+	}
+
+	void record(command&& cmd);
+
+	entity_component_system* manager_ = nullptr;
+	/// Guards the commands against a playback on the owner thread.
+	std::mutex mutex_;
+	std::vector<command> commands_;
+	std::uint64_t sort_key_ = 0;
+};
+
 /**
  * Manages entity::Id creation and component assignment.
  */
@@ -395,7 +680,9 @@ class entity_component_system
 public:
 	using component_mask_t = std::bitset<MAX_COMPONENTS>;
 
-	explicit entity_component_system() = default;
+	/// A world which does not emit the entity and component events can be
+	/// filled on a worker thread without any system noticing, see merge.
+	explicit entity_component_system(bool emit_events = true);
 	virtual ~entity_component_system();
 	/// An iterator over a view of the entities in an entity_component_system.
 	/// If All is true it will iterate over all valid entities and will ignore the
@@ -432,26 +719,14 @@ public:
 			: manager_(manager)
 			, i_(index)
 			, capacity_(manager_->capacity())
-			, free_cursor_(~0UL)
 		{
-			if(All)
-			{
-				std::sort(manager_->free_list_.begin(), manager_->free_list_.end());
-				free_cursor_ = 0;
-			}
 		}
 		view_iterator(entity_component_system* manager, const component_mask_t mask, std::uint32_t index)
 			: manager_(manager)
 			, mask_(mask)
 			, i_(index)
 			, capacity_(manager_->capacity())
-			, free_cursor_(~0UL)
 		{
-			if(All)
-			{
-				std::sort(manager_->free_list_.begin(), manager_->free_list_.end());
-				free_cursor_ = 0;
-			}
 		}
 
 		void next()
@@ -475,20 +750,13 @@ public:
 
 		inline bool valid_entity()
 		{
-			const std::vector<std::uint32_t>& free_list = manager_->free_list_;
-			if(free_cursor_ < free_list.size() && free_list[free_cursor_] == i_)
-			{
-				++free_cursor_;
-				return false;
-			}
-			return true;
+			return manager_->entity_alive_[i_] != 0;
 		}
 
 		entity_component_system* manager_;
 		component_mask_t mask_;
 		std::uint32_t i_;
 		size_t capacity_;
-		size_t free_cursor_;
 	};
 
 	template <bool All>
@@ -526,7 +794,7 @@ public:
 			return iterator_type(manager_, mask_, manager_->capacity());
 		}
 
-	private:
+	protected:
 		friend class entity_component_system;
 
 		explicit base_view(entity_component_system* manager)
@@ -554,12 +822,10 @@ public:
 			using type = T;
 		};
 
-		void for_each(typename identity<std::function<void(entity entity, Components&...)>>::type f)
+		template <typename F>
+		void for_each(F&& f)
 		{
-			for(auto it : *this)
-			{
-				f(it, *(it.template get_component<Components>().lock().get())...);
-			}
+			this->manager_->template for_each<Components...>(std::forward<F>(f));
 		}
 
 	private:
@@ -720,8 +986,10 @@ public:
 	template <typename C, typename... Args>
 	chandle<C> assign(entity::id_t id, Args&&... args)
 	{
+		// Components of the same type are allocated next to each other.
 		return std::static_pointer_cast<C>(
-			assign(id, std::make_shared<C>(std::forward<Args>(args)...)).lock());
+			assign(id, std::allocate_shared<C>(core::pool_allocator<C>(), std::forward<Args>(args)...))
+				.lock());
 	}
 
 	chandle<component> assign(entity::id_t id, const std::shared_ptr<component>& comp);
@@ -776,6 +1044,41 @@ public:
 		return chandle<C>(pool->template get<C>(id.index()));
 	}
 
+	/**
+	 * Retrieve a raw pointer to a component assigned to an entity::Id without
+	 * touching its reference count. The pointer is only valid until the
+	 * component is removed.
+	 *
+	 * @returns Pointer to an instance of C, or nullptr if the entity::Id does not
+	 * have that component.
+	 */
+	template <typename C>
+	C* get_component_ptr(entity::id_t id) const
+	{
+		assert_valid(id);
+		auto family = rtti::type_index_sequential_t::id<component, C>();
+		if(family >= component_pools_.size())
+		{
+			return nullptr;
+		}
+		auto& pool = component_pools_[family];
+		if(!pool)
+		{
+			return nullptr;
+		}
+		return pool->template get_ptr<C>(id.index());
+	}
+
+	/**
+	 * Retrieve a non owning handle to a component assigned to an entity::Id.
+	 */
+	template <typename C>
+	component_ref<C> get_component_ref(entity::id_t id)
+	{
+		assert_valid(id);
+		return component_ref<C>(this, id);
+	}
+
 	template <typename... Components>
 	std::tuple<chandle<Components>...> components(entity::id_t id)
 	{
@@ -810,10 +1113,61 @@ public:
 		using type = T;
 	};
 
-	template <typename... Components>
-	void for_each(typename identity<std::function<void(entity e, Components&...)>>::type f)
+	/**
+	 * Calls f(entity, Components&...) for every entity that has all of the
+	 * specified components. The callable is invoked directly and gets raw
+	 * references, nothing is type erased or reference counted.
+	 */
+	template <typename... Components, typename F>
+	void for_each(F&& f)
+	{
+		for_each_index<Components...>(0, capacity(), [this, &f](std::uint32_t index) {
+			f(entity(this, create_id(index)), get_component_unchecked<Components>(index)...);
+		});
+	}
+
+	/**
+	 * Calls f(entity, Components&...) for every entity in the index range
+	 * [begin, end) that has all of the specified components. Meant for
+	 * splitting an iteration in chunks. Does not mutate the system so
+	 * different ranges can be processed concurrently.
+	 */
+	template <typename... Components, typename F>
+	void for_each_in_range(std::size_t begin, std::size_t end, F&& f)
+	{
+		for_each_index<Components...>(begin, std::min(end, capacity()), [this, &f](std::uint32_t index) {
+			f(entity(this, create_id(index)), get_component_unchecked<Components>(index)...);
+		});
+	}
+
+	/**
+	 * Calls f(entity) for every valid entity in the index range [begin, end).
+	 */
+	template <typename F>
+	void for_each_entity_in_range(std::size_t begin, std::size_t end, F&& f)
+	{
+		end = std::min(end, capacity());
+		for(std::size_t i = begin; i < end; ++i)
+		{
+			if(entity_alive_[i] != 0)
+			{
+				f(entity(this, create_id(static_cast<std::uint32_t>(i))));
+			}
+		}
+	}
+
+	/**
+	 * Same as for_each but the entities are split in chunks of grain
+	 * elements that are processed on the task_system workers. The callable
+	 * must not create, destroy, assign or remove anything.
+	 */
+	template <typename... Components, typename F>
+	void parallel_for_each(F&& f, std::size_t grain = 256)
 	{
-		return entities_with_components<Components...>().for_each(f);
+		auto& ts = core::get_subsystem<core::task_system>();
+		ts.parallel_for(0, capacity(), grain, [this, &f](std::size_t begin, std::size_t end) {
+			for_each_in_range<Components...>(begin, end, f);
+		});
 	}
 
 	/**
@@ -875,8 +1229,103 @@ public:
 		unpack<Args...>(id, args...);
 	}
 
+	/**
+	 * Get the command buffer of the calling thread. Safe to call from any
+	 * thread.
+	 */
+	command_buffer& get_command_buffer();
+
+	/**
+	 * Play back the commands recorded by every thread. Creations come
+	 * first, then the rest ordered by sort key and recording order.
+	 * Must be called on the owner thread.
+	 */
+	void playback_commands();
+
+	/**
+	 * Record that a component of the entity was changed. Safe to call from
+	 * any thread while nothing is created, destroyed, assigned or removed.
+	 * component::touch calls it.
+	 */
+	void mark_changed(entity::id_t id, rtti::type_index_sequential_t::index_t family);
+
+	/**
+	 * Start a new frame of changes. What was changed, added and removed
+	 * since the previous call is what changed, added and removed return
+	 * until the next one. Must be called on the owner thread, once per frame.
+	 */
+	void advance_changes();
+
+	/**
+	 * Entity indices whose C was touched during the last frame, each listed
+	 * once. Lets a system visit only what changed instead of polling
+	 * is_touched on every component.
+	 *
+	 * @code
+	 * for (auto index : ecs.changed<transform_component>()) {
+	 *   if (!ecs.valid_index(index)) continue;
+	 *   auto id = ecs.create_id(index);
+	 * }
+	 * @endcode
+	 */
+	template <typename C>
+	const std::vector<std::uint32_t>& changed() const
+	{
+		const auto pool = get_pool<C>();
+		return pool ? pool->changed() : empty_indices();
+	}
+
+	/**
+	 * Entity indices which got a C during the last frame. An index may
+	 * repeat and the component may be gone already.
+	 */
+	template <typename C>
+	const std::vector<std::uint32_t>& added() const
+	{
+		const auto pool = get_pool<C>();
+		return pool ? pool->added() : empty_indices();
+	}
+
+	/**
+	 * Entity indices which lost their C, or were destroyed, during the last
+	 * frame. An index may repeat and may have a C again.
+	 */
+	template <typename C>
+	const std::vector<std::uint32_t>& removed() const
+	{
+		const auto pool = get_pool<C>();
+		return pool ? pool->removed() : empty_indices();
+	}
+
+	/**
+	 * Move every entity of the source world into this one. The components
+	 * move as they are, without being serialized again, and the entities
+	 * they refer to are remapped. Returns the new handles of the given
+	 * source entities. Both worlds must be idle, call it on the owner
+	 * thread of this one.
+	 *
+	 * @code
+	 * // On a worker.
+	 * entity_component_system staging(false);
+	 * std::vector<entity> roots;
+	 * ecs::utils::deserialize_data(stream, staging, roots);
+	 * // Back on the owner thread.
+	 * roots = ecs.merge(staging, roots);
+	 * @endcode
+	 */
+	std::vector<entity> merge(entity_component_system& source, const std::vector<entity>& handles = {});
+
+	/**
+	 * Move the entities into the target world, the reverse of merge. Entities
+	 * they refer to which are not listed stay behind, so pass whole
+	 * hierarchies. Returns their handles in the target, which can then be
+	 * disposed or saved away from the owner thread.
+	 */
+	std::vector<entity> move_entities(const std::vector<entity>& entities, entity_component_system& target);
+
 	/**
 	 * Destroy all entities and reset the entity_component_system.
+	 * Commands that were not played back yet are dropped.
 	 */
 	void dispose();
 
@@ -885,6 +1334,13 @@ public:
 
 private:
 	friend class entity;
+	friend class command_buffer;
+
+	/// Reserve a fresh entity slot, from any thread.
+	std::uint32_t reserve_index()
+	{
+		return index_counter_++;
+	}
 
 	inline void assert_valid(entity::id_t id) const
 	{
@@ -936,6 +1392,7 @@ private:
 		{
 			entity_component_mask_.resize(index + 1);
 			entity_version_.resize(index + 1);
+			entity_alive_.resize(index + 1);
 			for(auto& pool : component_pools_)
 			{
 				if(pool)
@@ -946,6 +1403,78 @@ private:
 		}
 	}
 
+	/// Gets the bits of the entities [word * 64, word * 64 + 64) that have
+	/// all of the specified components.
+	template <typename... Components>
+	std::uint64_t component_word(std::size_t word) const
+	{
+		std::uint64_t result = ~std::uint64_t(0);
+		for(auto family : {rtti::type_index_sequential_t::id<component, Components>()...})
+		{
+			if(family >= component_pools_.size() || !component_pools_[family])
+			{
+				return 0;
+			}
+			result &= component_pools_[family]->word(word);
+		}
+		return result;
+	}
+
+	/// Calls f(index) for every entity index in [begin, end) that has all of
+	/// the specified components, walking the component bits 64 entities at
+	/// a time.
+	template <typename... Components, typename F>
+	void for_each_index(std::size_t begin, std::size_t end, F&& f) const
+	{
+		const auto all = ~std::uint64_t(0);
+		for(std::size_t word = begin / 64; word * 64 < end; ++word)
+		{
+			const std::size_t base = word * 64;
+			auto range = all;
+			if(base < begin)
+			{
+				range &= all << (begin - base);
+			}
+			if(end - base < 64)
+			{
+				range &= ~(all << (end - base));
+			}
+
+			auto bits = component_word<Components...>(word) & range;
+			while(bits != 0)
+			{
+				const auto bit = ecs::detail::count_trailing_zeros(bits);
+				f(static_cast<std::uint32_t>(base + bit));
+
+				// Read the word again since the callable is allowed to
+				// assign or remove components of the entities ahead.
+				bits = component_word<Components...>(word) & range & (all << bit << 1);
+			}
+		}
+	}
+
+	template <typename C>
+	const component_storage* get_pool() const
+	{
+		const auto family = rtti::type_index_sequential_t::id<component, C>();
+		return family < component_pools_.size() ? component_pools_[family].get() : nullptr;
+	}
+
+	static const std::vector<std::uint32_t>& empty_indices()
+	{
+		static const std::vector<std::uint32_t> empty;
+		return empty;
+	}
+
+	/// Gets a component that is known to be assigned, without touching its
+	/// reference count.
+	template <typename C>
+	C& get_component_unchecked(std::uint32_t index) const
+	{
+		auto family = rtti::type_index_sequential_t::id<component, C>();
+		return *component_pools_[family]->template get_ptr<C>(index);
+	}
+
 	template <typename C>
 	component_storage& accomodate_component()
 	{
@@ -970,7 +1499,9 @@ private:
 		return *pool;
 	}
 
-	std::uint32_t index_counter_ = 0;
+	/// Next fresh entity slot. Command buffers reserve slots from other
+	/// threads.
+	std::atomic<std::uint32_t> index_counter_{0};
 
 	// Each element in component_pools_ corresponds to a Pool for a component.
 	// The index into the vector is the component::family().
@@ -983,8 +1514,24 @@ private:
 	std::vector<std::uint32_t> entity_version_;
 	// List of available entity slots.
 	std::vector<std::uint32_t> free_list_;
+	// Non zero for entity slots that are in use. Index into the vector is the
+	// entity::Id.
+	std::vector<std::uint8_t> entity_alive_;
+	// Number of non zero entries in entity_alive_.
+	std::size_t alive_count_ = 0;
 
 	std::unordered_map<std::uint64_t, std::string> entity_names_;
+	/// Whether the entity and component events are emitted.
+	bool emit_events_ = true;
+
+	/// Unique among all systems ever created, keys the thread local
+	/// command buffers.
+	std::uint64_t serial_ = next_serial();
+	/// Command buffers of every thread that recorded into this system.
+	std::mutex buffers_mutex_;
+	std::vector<std::unique_ptr<command_buffer>> buffers_;
+
+	static std::uint64_t next_serial();
 };
 
 template <typename C, typename... Args>
@@ -1020,6 +1567,23 @@ chandle<C> entity::get_component() const
 	return manager_->get_component<C>(id_);
 }
 
+template <typename C>
+component_ref<C> entity::get_component_ref() const
+{
+	expects(valid());
+	return manager_->get_component_ref<C>(id_);
+}
+
+template <typename C>
+C* component_ref<C>::get() const
+{
+	if(manager_ == nullptr || !manager_->valid(id_))
+	{
+		return nullptr;
+	}
+	return manager_->template get_component_ptr<C>(id_);
+}
+
 template <typename... Components>
 std::tuple<chandle<Components>...> entity::components() const
 {
@@ -1095,6 +1659,18 @@ inline std::string entity::to_string() const
 }
 }
 
+namespace runtime
+{
+namespace ecs
+{
+template <typename... Components>
+std::vector<std::uint64_t> component_ids()
+{
+	return {static_cast<std::uint64_t>(rtti::type_index_sequential_t::id<component, Components>())...};
+}
+}
+}
+
 namespace std
 {
 template <>
@@ -0,0 +1,97 @@
+#include "animation_system.h"
+#include "../../animation/animation_clip.h"
+#include "../components/animation_component.h"
+#include "../components/transform_component.h"
+
+#include <core/system/subsystem.h>
+
+#include <vector>
+
+namespace runtime
+{
+namespace
+{
+void collect_nodes(const entity& e, std::unordered_map<std::string, entity>& nodes)
+{
+	auto transform_comp = e.get_component<transform_component>().lock();
+	if(!transform_comp)
+	{
+		return;
+	}
+
+	for(const auto& child : transform_comp->get_children())
+	{
+		if(child.valid())
+		{
+			nodes.emplace(child.get_name(), child);
+			collect_nodes(child, nodes);
+		}
+	}
+}
+}
+
+std::shared_ptr<const animation_clip> animation_system::get_clip(const std::shared_ptr<animation>& anim)
+{
+	if(!anim)
+	{
+		return nullptr;
+	}
+
+	auto& entry = clips_[anim.get()];
+	if(!entry.clip || entry.source.lock() != anim)
+	{
+		entry.source = anim;
+		entry.clip = std::make_shared<animation_clip>(*anim);
+	}
+	return entry.clip;
+}
+
+void animation_system::frame_update(delta_t dt)
+{
+	auto& ecs = core::get_subsystem<entity_component_system>();
+
+	// Binding walks the hierarchy and fills the clip cache so it stays on
+	// this thread. Only changes under the entity itself call for it.
+	bool rebound = false;
+	std::vector<std::shared_ptr<const animation_clip>> clips;
+	std::unordered_map<std::string, entity> nodes;
+	ecs.for_each<animation_component>([&](entity e, animation_component& anim_comp) {
+		const auto transform_comp = ecs.get_component_ptr<transform_component>(e.id());
+		const auto subtree_version = transform_comp ? transform_comp->get_subtree_version() : 0;
+		if(!anim_comp.needs_binding(subtree_version))
+		{
+			return;
+		}
+
+		clips.clear();
+		for(const auto& layer : anim_comp.get_layers())
+		{
+			clips.emplace_back(get_clip(layer.animation.get_asset()));
+		}
+
+		nodes.clear();
+		collect_nodes(e, nodes);
+		anim_comp.bind(clips, nodes, subtree_version);
+		rebound = true;
+	});
+
+	if(rebound)
+	{
+		// Drop the clips of unloaded animations.
+		for(auto it = clips_.begin(); it != clips_.end();)
+		{
+			if(it->second.source.expired())
+			{
+				it = clips_.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	ecs.parallel_for_each<animation_component>(
+		[&ecs, dt](entity e, animation_component& anim_comp) { anim_comp.update(ecs, dt.count()); });
+}
+}
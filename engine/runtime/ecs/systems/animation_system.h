@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../ecs.h"
+
+#include <core/common/basetypes.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace runtime
+{
+struct animation;
+class animation_clip;
+
+class animation_system
+{
+public:
+	//-----------------------------------------------------------------------------
+	//  Name : frame_update (virtual )
+	/// <summary>
+	/// Binds changed animation components and evaluates all of them in
+	/// parallel. Runs before the scene graph so the new poses are resolved
+	/// in the same frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void frame_update(delta_t dt);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_clip ()
+	/// <summary>
+	/// Compact clip of an animation. Every component playing the same
+	/// animation shares it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::shared_ptr<const animation_clip> get_clip(const std::shared_ptr<animation>& anim);
+
+private:
+	struct clip_entry
+	{
+		std::weak_ptr<animation> source;
+		std::shared_ptr<const animation_clip> clip;
+	};
+
+	/// Clips by source animation.
+	std::unordered_map<const animation*, clip_entry> clips_;
+};
+}
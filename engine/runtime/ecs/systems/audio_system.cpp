@@ -1,5 +1,4 @@
 #include "audio_system.h"
-#include "../../system/events.h"
 #include "../components/audio_listener_component.h"
 #include "../components/audio_source_component.h"
 #include "../components/transform_component.h"
@@ -12,7 +11,7 @@ void audio_system::frame_update(delta_t dt)
 {
 	auto& ecs = core::get_subsystem<entity_component_system>();
 
-	ecs.for_each<transform_component, audio_source_component>(
+	ecs.parallel_for_each<transform_component, audio_source_component>(
 		[](entity e, transform_component& transform, audio_source_component& source) {
 			source.update(transform.get_transform());
 		});
@@ -21,14 +20,4 @@ void audio_system::frame_update(delta_t dt)
 			listener.update(transform.get_transform());
 		});
 }
-
-audio_system::audio_system()
-{
-	on_frame_update.connect(this, &audio_system::frame_update);
-}
-
-audio_system::~audio_system()
-{
-	on_frame_update.disconnect(this, &audio_system::frame_update);
-}
 }
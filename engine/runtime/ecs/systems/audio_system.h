@@ -7,8 +7,6 @@ namespace runtime
 class audio_system
 {
 public:
-	audio_system();
-	~audio_system();
 	//-----------------------------------------------------------------------------
 	//  Name : frame_update (virtual )
 	/// <summary>
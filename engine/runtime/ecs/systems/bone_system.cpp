@@ -1,6 +1,5 @@
 #include "bone_system.h"
 #include "../../rendering/mesh.h"
-#include "../../system/events.h"
 #include "../components/model_component.h"
 #include "../components/transform_component.h"
 
@@ -35,40 +34,50 @@ void process_node(const std::unique_ptr<mesh::armature_node>& node, const skin_b
 	}
 }
 
-static std::vector<math::transform>
-get_transforms_for_bones(const std::vector<runtime::entity>& bone_entities)
+// Fills the skinning matrices in place, bones whose entity is gone keep
+// their bind pose.
+static void update_skinning_transforms(runtime::entity_component_system& ecs,
+									   const std::vector<runtime::entity>& bone_entities,
+									   const skin_bind_data& skin_data,
+									   std::vector<math::transform::mat4_t>& skinning_transforms)
 {
-	std::vector<math::transform> result;
-	if(!bone_entities.empty())
+	const auto& bind_list = skin_data.get_bones();
+	if(bone_entities.empty())
 	{
-		result.reserve(bone_entities.size());
-		for(const auto& e : bone_entities)
+		skinning_transforms.clear();
+		return;
+	}
+
+	skinning_transforms.resize(bind_list.size());
+	for(std::size_t i = 0; i < bind_list.size(); ++i)
+	{
+		const auto& bind_pose = bind_list[i].bind_pose_transform.get_matrix();
+		auto& skinning_transform = skinning_transforms[i];
+
+		transform_component* bone_transform = nullptr;
+		if(i < bone_entities.size() && ecs.valid(bone_entities[i].id()))
 		{
-			if(e.valid())
-			{
-				const auto bone_transform = e.get_component<transform_component>();
-				if(!bone_transform.expired())
-				{
-					result.emplace_back(bone_transform.lock()->get_transform());
-				}
-				else
-				{
-					result.emplace_back();
-				}
-			}
-			else
-			{
-				result.emplace_back();
-			}
+			// Raw access instead of locking the handle, no bone is removed
+			// while the matrices are updated.
+			bone_transform = ecs.get_component_ptr<transform_component>(bone_entities[i].id());
 		}
-	}
 
-	return result;
+		if(bone_transform != nullptr)
+		{
+			math::multiply(bone_transform->get_transform().get_matrix(), bind_pose, skinning_transform);
+		}
+		else
+		{
+			skinning_transform = bind_pose;
+		}
+	}
 }
 
 void bone_system::frame_update(delta_t)
 {
 	auto& ecs = core::get_subsystem<runtime::entity_component_system>();
+
+	// Creating the bone entities is a structural change so it stays on this thread.
 	ecs.for_each<model_component>([&ecs](runtime::entity e, model_component& model_comp) {
 
 		const auto& model = model_comp.get_model();
@@ -81,32 +90,45 @@ void bone_system::frame_update(delta_t)
 		const auto& skin_data = mesh->get_skin_bind_data();
 
 		// Has skinning data?
-		if(skin_data.has_bones())
+		if(skin_data.has_bones() && model_comp.get_bone_entities().size() <= 1)
 		{
-			if(model_comp.get_bone_entities().size() <= 1)
+			const auto& armature = mesh->get_armature();
+			std::vector<runtime::entity> be;
+			process_node(armature, skin_data, e, be, ecs);
+			model_comp.set_bone_entities(be);
+			model_comp.set_static(false);
+		}
+
+		// The bind poses are shared by every model using the mesh, resolve
+		// their lazily computed matrices before going wide.
+		if(skin_data.has_bones() && model_comp.get_skinning_transforms().size() != skin_data.get_bones().size())
+		{
+			for(const auto& bone : skin_data.get_bones())
 			{
-				const auto& armature = mesh->get_armature();
-				std::vector<runtime::entity> be;
-				process_node(armature, skin_data, e, be, ecs);
-				model_comp.set_bone_entities(be);
-				model_comp.set_static(false);
+				bone.bind_pose_transform.get_matrix();
 			}
-
-			const auto& bone_entities = model_comp.get_bone_entities();
-			auto transforms = get_transforms_for_bones(bone_entities);
-			model_comp.set_bone_transforms(std::move(transforms));
 		}
-
 	});
-}
 
-bone_system::bone_system()
-{
-	runtime::on_frame_update.connect(this, &bone_system::frame_update);
-}
+	ecs.parallel_for_each<model_component>([&ecs](runtime::entity e, model_component& model_comp) {
 
-bone_system::~bone_system()
-{
-	runtime::on_frame_update.disconnect(this, &bone_system::frame_update);
+		const auto& model = model_comp.get_model();
+		auto mesh = model.get_lod(0);
+
+		// If mesh isnt loaded yet skip it.
+		if(!mesh)
+			return;
+
+		const auto& skin_data = mesh->get_skin_bind_data();
+
+		// Has skinning data?
+		if(skin_data.has_bones())
+		{
+			update_skinning_transforms(ecs, model_comp.get_bone_entities(), skin_data,
+									   model_comp.get_skinning_transforms());
+			model_comp.touch();
+		}
+
+	});
 }
 }
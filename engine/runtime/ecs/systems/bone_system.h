@@ -7,8 +7,6 @@ namespace runtime
 class bone_system
 {
 public:
-	bone_system();
-	~bone_system();
 	//-----------------------------------------------------------------------------
 	//  Name : frame_update (virtual )
 	/// <summary>
@@ -1,5 +1,4 @@
 #include "camera_system.h"
-#include "../../system/events.h"
 #include "../components/camera_component.h"
 #include "../components/transform_component.h"
 
@@ -16,14 +15,4 @@ void camera_system::frame_update(delta_t)
 			camera.update(transform.get_transform());
 		});
 }
-
-camera_system::camera_system()
-{
-	on_frame_update.connect(this, &camera_system::frame_update);
-}
-
-camera_system::~camera_system()
-{
-	on_frame_update.disconnect(this, &camera_system::frame_update);
-}
 }
@@ -7,8 +7,6 @@ namespace runtime
 class camera_system
 {
 public:
-	camera_system();
-	~camera_system();
 	//-----------------------------------------------------------------------------
 	//  Name : frame_update (virtual )
 	/// <summary>
@@ -4,6 +4,7 @@
 #include "../../rendering/material.h"
 #include "../../rendering/mesh.h"
 #include "../../rendering/model.h"
+#include "../../rendering/render_queue.h"
 #include "../../rendering/renderer.h"
 #include "../../system/events.h"
 #include "../components/camera_component.h"
@@ -18,13 +19,269 @@
 #include <core/graphics/texture.h>
 #include <core/graphics/vertex_buffer.h>
 #include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <tuple>
 
 namespace runtime
 {
+namespace
+{
+const gfx::uniform_id u_camera_wpos("u_camera_wpos");
+const gfx::uniform_id u_camera_clip_planes("u_camera_clip_planes");
+const gfx::uniform_id u_lod_params("u_lod_params");
+
+const std::uint16_t shadow_atlas_size = 2048;
+const std::uint16_t shadow_min_tile_size = 128;
+const std::uint16_t cascade_map_size = 512;
+const std::uint16_t spot_map_size = 512;
+const std::uint16_t point_map_size = 256;
+const std::size_t max_cascades = 4;
+// Cascades end at this distance from the camera at most.
+const float max_shadow_distance = 150.0f;
+// How far towards the light casters outside a cascade are still drawn.
+const float cascade_caster_distance = 100.0f;
+// Subtracted from the depth of a surface before comparing it to the map.
+const float directional_depth_bias = 0.002f;
+const float local_depth_bias = 0.0005f;
+
+// Scales and offsets clip space to the uv rect of the tile. The view rect
+// of a tile counts rows from the top, while the texture does so from the
+// bottom when the origin is at the bottom left.
+math::mat4 get_atlas_bias(const shadow_atlas::tile& tile, std::uint16_t atlas_size)
+{
+	const float size = float(atlas_size);
+	const float scale = float(tile.size) * 0.5f / size;
+	const float center_x = (float(tile.x) + float(tile.size) * 0.5f) / size;
+	const float center_y = (float(tile.y) + float(tile.size) * 0.5f) / size;
+
+	math::mat4 bias(1.0f);
+	bias[0][0] = scale;
+	bias[3][0] = center_x;
+	if(gfx::is_origin_bottom_left())
+	{
+		bias[1][1] = scale;
+		bias[3][1] = 1.0f - center_y;
+	}
+	else
+	{
+		bias[1][1] = -scale;
+		bias[3][1] = center_y;
+	}
+	return bias;
+}
+
+math::vec4 get_atlas_rect(const shadow_atlas::tile& tile, std::uint16_t atlas_size)
+{
+	const float size = float(atlas_size);
+	// Half a texel in so that filtering stays inside the tile.
+	const float left = (float(tile.x) + 0.5f) / size;
+	const float right = (float(tile.x + tile.size) - 0.5f) / size;
+	float top = (float(tile.y) + 0.5f) / size;
+	float bottom = (float(tile.y + tile.size) - 0.5f) / size;
+	if(gfx::is_origin_bottom_left())
+	{
+		top = 1.0f - top;
+		bottom = 1.0f - bottom;
+		std::swap(top, bottom);
+	}
+	return math::vec4(left, top, right, bottom);
+}
+
+// First texture row of the tile, blits address the texture directly.
+std::uint16_t get_atlas_row(const shadow_atlas::tile& tile, std::uint16_t atlas_size)
+{
+	if(gfx::is_origin_bottom_left())
+	{
+		return std::uint16_t(atlas_size - tile.y - tile.size);
+	}
+	return tile.y;
+}
+
+camera get_spot_shadow_camera(const math::transform& world, const light& light)
+{
+	const auto position = world.get_position();
+	const float range = light.spot_data.get_range();
+
+	camera cam;
+	cam.set_fov(light.spot_data.get_outer_angle());
+	cam.set_aspect_ratio(1.0f, true);
+	cam.set_near_clip(math::max(range * 0.001f, 0.01f));
+	cam.set_far_clip(range);
+	cam.look_at(position, position + world.z_unit_axis(), world.y_unit_axis());
+	return cam;
+}
+
+// Faces follow the world axes in the order +x -x +y -y +z -z which the
+// lighting shader expects.
+camera get_point_shadow_camera(std::uint32_t face, const math::transform& world, const light& light)
+{
+	static const std::array<math::vec3, 6> directions = {{
+		{1.0f, 0.0f, 0.0f},
+		{-1.0f, 0.0f, 0.0f},
+		{0.0f, 1.0f, 0.0f},
+		{0.0f, -1.0f, 0.0f},
+		{0.0f, 0.0f, 1.0f},
+		{0.0f, 0.0f, -1.0f},
+	}};
+	static const std::array<math::vec3, 6> ups = {{
+		{0.0f, 1.0f, 0.0f},
+		{0.0f, 1.0f, 0.0f},
+		{0.0f, 0.0f, -1.0f},
+		{0.0f, 0.0f, 1.0f},
+		{0.0f, 1.0f, 0.0f},
+		{0.0f, 1.0f, 0.0f},
+	}};
+
+	const auto position = world.get_position();
+	const float range = light.point_data.range;
+
+	camera cam;
+	cam.set_fov(90.0f);
+	cam.set_aspect_ratio(1.0f, true);
+	cam.set_near_clip(math::max(range * 0.001f, 0.01f));
+	cam.set_far_clip(range);
+	cam.look_at(position, position + directions[face], ups[face]);
+	return cam;
+}
+
+// Splits the shadowed part of the view between the uniform and the
+// logarithmic split distances and fits an orthographic camera around the
+// bounding sphere of every slice. The sphere does not change with the
+// orientation of the view and stable cameras only move in whole texels, so
+// the maps do not shimmer and stay the same while the view stands still.
+std::size_t get_cascade_cameras(const camera& view_camera, const math::transform& world, const light& light,
+								std::array<camera, max_cascades>& cameras, math::vec4& splits)
+{
+	const auto count =
+		math::clamp<std::size_t>(std::size_t(light.directional_data.num_splits), 1, max_cascades);
+	const float near_clip = math::max(view_camera.get_near_clip(), 0.01f);
+	const float far_clip = math::max(math::min(view_camera.get_far_clip(), max_shadow_distance), near_clip);
+	const float distribution = math::clamp(light.directional_data.split_distribution, 0.0f, 1.0f);
+	const bool perspective = view_camera.get_projection_mode() == projection_mode::perspective;
+	const float tan_half_fov = math::tan(math::radians(view_camera.get_fov()) * 0.5f);
+	const float aspect = view_camera.get_aspect_ratio();
+
+	const auto position = view_camera.get_position();
+	const auto view_x = view_camera.x_unit_axis();
+	const auto view_y = view_camera.y_unit_axis();
+	const auto view_z = view_camera.z_unit_axis();
+	const auto light_x = world.x_unit_axis();
+	const auto light_y = world.y_unit_axis();
+	const auto light_z = world.z_unit_axis();
+
+	splits = math::vec4(std::numeric_limits<float>::max());
+	float split_near = near_clip;
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		const float t = float(i + 1) / float(count);
+		const float log_split = near_clip * math::pow(far_clip / near_clip, t);
+		const float uniform_split = near_clip + (far_clip - near_clip) * t;
+		const float split_far = math::mix(uniform_split, log_split, distribution);
+		splits[int(i)] = split_far;
+
+		std::array<math::vec3, 8> corners;
+		math::vec3 center(0.0f, 0.0f, 0.0f);
+		for(std::size_t c = 0; c < corners.size(); ++c)
+		{
+			const float distance = c < 4 ? split_near : split_far;
+			const float half_height = perspective ? distance * tan_half_fov : view_camera.get_ortho_size();
+			const float half_width = half_height * aspect;
+			corners[c] = position + view_z * distance + view_x * ((c & 1) ? half_width : -half_width) +
+						 view_y * ((c & 2) ? half_height : -half_height);
+			center += corners[c];
+		}
+		center /= float(corners.size());
+
+		float radius = 0.0f;
+		for(const auto& corner : corners)
+		{
+			radius = math::max(radius, math::distance(corner, center));
+		}
+		// Rounded up so that it does not change with the float noise of the
+		// view transform.
+		radius = math::ceil(radius * 16.0f) / 16.0f;
+
+		float center_x = math::dot(center, light_x);
+		float center_y = math::dot(center, light_y);
+		float center_z = math::dot(center, light_z);
+		if(light.directional_data.stabilize)
+		{
+			const float texel = 2.0f * radius / float(cascade_map_size);
+			center_x = math::floor(center_x / texel) * texel;
+			center_y = math::floor(center_y / texel) * texel;
+			center_z = math::floor(center_z / radius) * radius;
+		}
+
+		// The depth range covers a radius more for the snapped depth.
+		const auto snapped_center = light_x * center_x + light_y * center_y + light_z * center_z;
+		const auto eye = snapped_center - light_z * (radius + cascade_caster_distance);
+
+		auto& cam = cameras[i];
+		cam.set_projection_mode(projection_mode::orthographic);
+		cam.set_aspect_ratio(1.0f, true);
+		cam.set_viewport_size(usize32_t(cascade_map_size, cascade_map_size));
+		cam.set_orthographic_size(radius);
+		cam.set_near_clip(0.01f);
+		cam.set_far_clip(cascade_caster_distance + radius * 3.0f);
+		cam.look_at(eye, eye + light_z, light_y);
+
+		split_near = split_far;
+	}
+	return count;
+}
+
+struct shadow_job
+{
+	camera view;
+	light_shadow::map* map = nullptr;
+	bool rebuild_static = false;
+	std::vector<entity::id_t> static_casters;
+	std::vector<entity::id_t> dynamic_casters;
+};
+
+// Same as mesh::calculate_screen_rect relative to the viewport height but
+// with the view projection computed once per camera instead of per point.
+float calculate_screen_height_percent(const mesh& mesh, const math::transform& world,
+									  const math::mat4& view_proj)
+{
+	const auto bounds = math::bbox::mul(mesh.get_bounds(), world);
+	const auto& lo = bounds.min;
+	const auto& hi = bounds.max;
+	const std::array<math::vec3, 8> corners = {{
+		{lo.x, lo.y, lo.z},
+		{hi.x, lo.y, lo.z},
+		{lo.x, lo.y, hi.z},
+		{hi.x, lo.y, hi.z},
+		{lo.x, hi.y, lo.z},
+		{hi.x, hi.y, lo.z},
+		{lo.x, hi.y, hi.z},
+		{hi.x, hi.y, hi.z},
+	}};
+
+	float min_y = std::numeric_limits<float>::max();
+	float max_y = std::numeric_limits<float>::lowest();
+	for(const auto& corner : corners)
+	{
+		const auto clip = view_proj * math::vec4(corner, 1.0f);
+		const float y = clip.y / clip.w;
+		min_y = math::min(min_y, y);
+		max_y = math::max(max_y, y);
+	}
+
+	// clip space spans two units from bottom to top
+	return (max_y - min_y) * 50.0f;
+}
 
 bool update_lod_data(lod_data& data, const std::vector<urange32_t>& lod_limits, std::size_t total_lods,
-					 float transition_time, float dt, asset_handle<mesh> mesh, const math::transform& world,
-					 const camera& cam)
+					 float transition_time, float dt, const asset_handle<mesh>& mesh,
+					 const math::transform& world, const math::mat4& view_proj)
 {
 	if(!mesh)
 		return false;
@@ -32,10 +289,8 @@ bool update_lod_data(lod_data& data, const std::vector<urange32_t>& lod_limits,
 	if(total_lods <= 1)
 		return true;
 
-	const auto& viewport = cam.get_viewport_size();
-	irect32_t rect = mesh->calculate_screen_rect(world, cam);
-
-	float percent = math::clamp((float(rect.height()) / float(viewport.height)) * 100.0f, 0.0f, 100.0f);
+	float percent =
+		math::clamp(calculate_screen_height_percent(*mesh.get(), world, view_proj), 0.0f, 100.0f);
 
 	std::size_t lod = 0;
 	for(size_t i = 0; i < lod_limits.size(); ++i)
@@ -65,86 +320,221 @@ bool update_lod_data(lod_data& data, const std::vector<urange32_t>& lod_limits,
 
 	return true;
 }
+}
 
-bool should_rebuild_reflections(visibility_set_models_t& visibility_set, const reflection_probe& probe)
+void deferred_rendering::update_bvh(entity_component_system& ecs)
 {
+	++bvh_frame_;
+	for(const auto& id : dirty_entities_)
+	{
+		bvh_entries_[id.index()].dirty = false;
+	}
+	dirty_entities_.clear();
+	if(bvh_entries_.size() < ecs.capacity())
+	{
+		bvh_entries_.resize(ecs.capacity());
+	}
 
-	if(probe.method == reflect_method::environment)
-		return false;
+	// Visit what changed during the last frame and the models which were
+	// still waiting for their mesh, rather than every model.
+	bvh_candidates_.swap(pending_models_);
+	pending_models_.clear();
+	for(const auto* indices : {&ecs.changed<transform_component>(), &ecs.changed<model_component>(),
+							   &ecs.added<transform_component>(), &ecs.added<model_component>(),
+							   &ecs.removed<transform_component>(), &ecs.removed<model_component>()})
+	{
+		bvh_candidates_.insert(std::end(bvh_candidates_), std::begin(*indices), std::end(*indices));
+	}
+	std::sort(std::begin(bvh_candidates_), std::end(bvh_candidates_));
+	bvh_candidates_.erase(std::unique(std::begin(bvh_candidates_), std::end(bvh_candidates_)),
+						  std::end(bvh_candidates_));
 
-	for(auto& element : visibility_set)
+	for(const auto index : bvh_candidates_)
 	{
-		auto& transform_comp_handle = std::get<1>(element);
-		auto& model_comp_handle = std::get<2>(element);
-		auto transform_comp_ptr = transform_comp_handle.lock();
-		auto model_comp_ptr = model_comp_handle.lock();
-		if(!transform_comp_ptr || !model_comp_ptr)
+		if(index >= bvh_entries_.size())
+		{
 			continue;
+		}
 
-		auto& transform_comp_ref = *transform_comp_ptr.get();
-		auto& model_comp_ref = *model_comp_ptr.get();
+		auto& entry = bvh_entries_[index];
+		const auto id = ecs.valid_index(index) ? ecs.create_id(index) : entity::INVALID;
+		const bool alive = id != entity::INVALID && ecs.valid(id);
+		auto transform_comp_ptr = alive ? ecs.get_component_ptr<transform_component>(id) : nullptr;
+		auto model_comp_ptr = alive ? ecs.get_component_ptr<model_component>(id) : nullptr;
 
-		const auto& model = model_comp_ref.get_model();
-		if(!model.is_valid())
+		// Drop whatever lost its model or was destroyed.
+		if(!transform_comp_ptr || !model_comp_ptr)
+		{
+			if(entry.proxy != math::dynamic_bvh::null_node)
+			{
+				vacated_bounds_.emplace_back(bvh_.get_fat_bounds(entry.proxy));
+				bvh_.remove(entry.proxy);
+			}
+			entry = bvh_entry();
 			continue;
+		}
 
-		const auto mesh = model.get_lod(0);
+		auto& transform_comp_ref = *transform_comp_ptr;
+		auto& model_comp_ref = *model_comp_ptr;
 
-		const auto& world_transform = transform_comp_ref.get_transform();
+		// The slot may still hold an entity which was destroyed.
+		if(entry.id != id && entry.proxy != math::dynamic_bvh::null_node)
+		{
+			bvh_.remove(entry.proxy);
+			entry.proxy = math::dynamic_bvh::null_node;
+		}
+		entry.id = id;
 
-		const auto& bounds = mesh->get_bounds();
+		auto mesh = model_comp_ref.get_model().get_lod(0);
 
-		bool result = false;
+		// If mesh isnt loaded yet it cannot be culled. Look again next frame.
+		if(!mesh)
+		{
+			if(entry.proxy != math::dynamic_bvh::null_node)
+			{
+				bvh_.remove(entry.proxy);
+				entry.proxy = math::dynamic_bvh::null_node;
+			}
+			pending_models_.emplace_back(index);
+			continue;
+		}
 
-		for(std::uint32_t i = 0; i < 6; ++i)
+		const auto world_bounds = math::bbox::mul(mesh->get_bounds(), transform_comp_ref.get_transform());
+		if(entry.proxy == math::dynamic_bvh::null_node)
 		{
-			const auto& frustum = camera::get_face_camera(i, world_transform).get_frustum();
-			result |= math::frustum::test_obb(frustum, bounds, world_transform);
+			entry.proxy = bvh_.insert(world_bounds, id.id());
 		}
+		else
+		{
+			// A static caster may have been cached in shadows where it no
+			// longer is.
+			if(model_comp_ref.is_static() || model_comp_ref.is_touched())
+			{
+				vacated_bounds_.emplace_back(bvh_.get_fat_bounds(entry.proxy));
+			}
+			bvh_.update(entry.proxy, world_bounds);
+		}
+
+		entry.dirty = true;
+		dirty_entities_.emplace_back(id);
+	}
+}
+
+bool deferred_rendering::should_rebuild_reflections(entity_component_system& ecs, const math::transform& world,
+													const reflection_probe& probe) const
+{
+	if(probe.method == reflect_method::environment)
+		return false;
 
-		if(result)
+	if(dirty_entities_.empty())
+		return false;
+
+	// Same reach as the far clip of the face cameras.
+	math::bbox reach;
+	reach.from_sphere(world.get_position(), probe.box_data.extents.r);
+
+	bool result = false;
+	bvh_.query(reach, [&](std::uint64_t data) {
+		const entity::id_t id(data);
+		if(result || !bvh_entries_[id.index()].dirty || !ecs.valid(id))
+			return;
+
+		const auto model_comp_ptr = ecs.get_component_ptr<model_component>(id);
+		result = model_comp_ptr && model_comp_ptr->is_static() && model_comp_ptr->casts_reflection();
+	});
+
+	return result;
+}
+
+bool deferred_rendering::should_rebuild_shadows(entity_component_system& ecs,
+												const math::frustum& volume) const
+{
+	for(const auto& bounds : vacated_bounds_)
+	{
+		if(volume.test_aabb(bounds))
 			return true;
 	}
 
-	return false;
+	if(dirty_entities_.empty())
+		return false;
+
+	bool result = false;
+	bvh_.query(volume, [&](std::uint64_t data) {
+		const entity::id_t id(data);
+		if(result || !bvh_entries_[id.index()].dirty || !ecs.valid(id))
+			return;
+
+		// Whether it casts shadows or not, it may have been drawn before.
+		const auto model_comp_ptr = ecs.get_component_ptr<model_component>(id);
+		result = model_comp_ptr && model_comp_ptr->is_static();
+	});
+
+	return result;
 }
 
-bool should_rebuild_shadows(visibility_set_models_t& visibility_set, const light&)
+bool deferred_rendering::reserve_shadow_maps(light_shadow& shadow, std::size_t count, std::uint16_t size)
 {
-	//	for(auto& element : visibility_set)
-	//	{
-	//		auto& transform_comp_handle = std::get<1>(element);
-	//		auto& model_comp_handle = std::get<2>(element);
-	//		auto transform_comp_ptr = transform_comp_handle.lock();
-	//		auto model_comp_ptr = model_comp_handle.lock();
-	//		if(!transform_comp_ptr || !model_comp_ptr)
-	//			continue;
+	if(shadow.maps.size() == count && (count == 0 || shadow.maps.front().tile.size == size))
+	{
+		return true;
+	}
 
-	//		auto& transform_comp_ref = *transform_comp_ptr.get();
-	//		auto& model_comp_ref = *model_comp_ptr.get();
+	release_shadow_maps(shadow);
+	shadow.maps.resize(count);
+	for(auto& map : shadow.maps)
+	{
+		map.tile = shadow_atlas_.allocate(size);
+		if(!map.tile.is_valid())
+		{
+			release_shadow_maps(shadow);
+			return false;
+		}
+	}
+	return true;
+}
 
-	//		const auto& model = model_comp_ref.get_model();
-	//		if(!model.is_valid())
-	//			continue;
+void deferred_rendering::release_shadow_maps(light_shadow& shadow)
+{
+	for(const auto& map : shadow.maps)
+	{
+		shadow_atlas_.release(map.tile);
+	}
+	shadow.maps.clear();
+}
 
-	//		const auto mesh = model.get_lod(0);
+void deferred_rendering::draw_shadow_casters(gfx::view_id id, entity_component_system& ecs,
+											 const std::vector<entity::id_t>& casters)
+{
+	// Depth is kept in a color target, the nearest caster wins through min
+	// blending no matter the draw order.
+	const std::uint64_t states = BGFX_STATE_BLEND_EQUATION(BGFX_STATE_BLEND_EQUATION_MIN) |
+								 BGFX_STATE_BLEND_FUNC(BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_ONE);
 
-	//		const auto& world_transform = transform_comp_ref.get_transform();
-	//		const auto& bounds = mesh->get_bounds();
+	for(const auto caster : casters)
+	{
+		if(!ecs.valid(caster))
+			continue;
 
-	//		bool result = false;
+		auto transform_comp_ptr = ecs.get_component_ptr<transform_component>(caster);
+		auto model_comp_ptr = ecs.get_component_ptr<model_component>(caster);
+		if(!transform_comp_ptr || !model_comp_ptr)
+			continue;
 
-	//		// for(std::uint32_t i = 0; i < 6; ++i)
-	//		//{
-	//		//	const auto& frustum = camera::get_face_camera(i, world_transform).get_frustum();
-	//		//	result |= math::frustum::test_obb(frustum, bounds, world_transform);
-	//		//}
+		const auto& model = model_comp_ptr->get_model();
+		const auto mesh = model.get_lod(0);
+		if(!mesh)
+			continue;
 
-	//		if(result)
-	//			return true;
-	//	}
+		const auto& skinning_transforms = model_comp_ptr->get_skinning_transforms();
+		const bool skinned = !skinning_transforms.empty() && mesh->get_skin_bind_data().has_bones();
+		auto program = skinned ? shadow_skinned_program_.get() : shadow_program_.get();
+		if(!program)
+			continue;
 
-	return false;
+		// Both faces are drawn so that open meshes cast shadows as well.
+		model.render(id, transform_comp_ptr->get_transform(), skinning_transforms, false, false, false,
+					 states, 0, program, [](gpu_program&) {});
+	}
 }
 
 visibility_set_models_t deferred_rendering::gather_visible_models(entity_component_system& ecs,
@@ -153,71 +543,127 @@ visibility_set_models_t deferred_rendering::gather_visible_models(entity_compone
 																  bool static_only /*= true*/,
 																  bool require_reflection_caster /*= false*/)
 {
-	visibility_set_models_t result;
-	chandle<transform_component> transform_comp_handle;
-	chandle<model_component> model_comp_handle;
-	for(auto entity : ecs.entities_with_components(transform_comp_handle, model_comp_handle))
-	{
-		auto model_comp_ptr = model_comp_handle.lock();
-		auto transform_comp_ptr = transform_comp_handle.lock();
+	auto& ts = core::get_subsystem<core::task_system>();
+
+	// The frustum is lazily updated so resolve it before going wide.
+	const math::frustum* frustum = camera ? &camera->get_frustum() : nullptr;
 
-		if(static_only && !model_comp_ptr->is_static())
+	// Narrow down the candidates through the hierarchy first. Without a
+	// camera there is nothing to cull against.
+	std::vector<entity::id_t> candidates;
+	if(frustum)
+	{
+		bvh_.query(*frustum, [&](std::uint64_t data) { candidates.emplace_back(data); });
+	}
+	else if(dirty_only)
+	{
+		candidates = dirty_entities_;
+	}
+	else
+	{
+		candidates.reserve(bvh_.size());
+		for(const auto& entry : bvh_entries_)
 		{
-			continue;
+			if(entry.proxy != math::dynamic_bvh::null_node)
+			{
+				candidates.emplace_back(entry.id);
+			}
 		}
+	}
 
-		if(require_reflection_caster && !model_comp_ptr->casts_reflection())
+	// Keep the iteration order of the entities no matter in which order the
+	// hierarchy returned them.
+	std::sort(std::begin(candidates), std::end(candidates),
+			  [](entity::id_t lhs, entity::id_t rhs) { return lhs.index() < rhs.index(); });
+
+	// Every chunk collects into its own set so that the result keeps the
+	// candidate order no matter which worker processed it.
+	const std::size_t grain = 256;
+	std::vector<visibility_set_models_t> chunk_results((candidates.size() + grain - 1) / grain);
+
+	ts.parallel_for(0, candidates.size(), grain, [&](std::size_t begin, std::size_t end) {
+		auto& result = chunk_results[begin / grain];
+		result.reserve(end - begin);
+
+		std::vector<math::bbox> local_bounds;
+		std::vector<math::transform> world_transforms;
+		if(frustum)
 		{
-			continue;
+			local_bounds.reserve(end - begin);
+			world_transforms.reserve(end - begin);
 		}
 
-		auto mesh = model_comp_ptr->get_model().get_lod(0);
+		for(std::size_t i = begin; i < end; ++i)
+		{
+			const auto id = candidates[i];
+			if(!ecs.valid(id))
+				continue;
+
+			auto transform_comp_ptr = ecs.get_component_ptr<transform_component>(id);
+			auto model_comp_ptr = ecs.get_component_ptr<model_component>(id);
+			if(!transform_comp_ptr || !model_comp_ptr)
+				continue;
 
-		// If mesh isnt loaded yet skip it.
-		if(!mesh)
-			continue;
+			auto& transform_comp_ref = *transform_comp_ptr;
+			auto& model_comp_ref = *model_comp_ptr;
 
-		if(camera)
-		{
-			const auto& frustum = camera->get_frustum();
+			if(static_only && !model_comp_ref.is_static())
+				continue;
 
-			const auto& world_transform = transform_comp_ptr->get_transform();
+			if(require_reflection_caster && !model_comp_ref.casts_reflection())
+				continue;
 
-			const auto& bounds = mesh->get_bounds();
+			// Only dirty mesh components.
+			if(dirty_only && !bvh_entries_[id.index()].dirty)
+				continue;
+
+			auto mesh = model_comp_ref.get_model().get_lod(0);
+
+			// If mesh isnt loaded yet skip it.
+			if(!mesh)
+				continue;
 
-			// Test the bounding box of the mesh
-			if(math::frustum::test_obb(frustum, bounds, world_transform))
+			if(frustum)
 			{
-				// Only dirty mesh components.
-				if(dirty_only)
-				{
-					if(transform_comp_ptr->is_touched() || model_comp_ptr->is_touched())
-					{
-						result.emplace_back(entity, transform_comp_handle, model_comp_handle);
-					}
-				} // End if dirty_only
-				else
-				{
-					result.emplace_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
-				}
+				local_bounds.emplace_back(mesh->get_bounds());
+				world_transforms.emplace_back(transform_comp_ref.get_transform());
+			}
 
-			} // Enf if visble
+			result.emplace_back(&ecs, id);
 		}
-		else
+
+		// The hierarchy stores loose world boxes, test the tight ones of the
+		// whole chunk at once.
+		if(frustum && !result.empty())
 		{
-			// Only dirty mesh components.
-			if(dirty_only)
+			math::bbox_soa world_bounds;
+			std::vector<std::uint64_t> visible;
+			math::transform_bounds(local_bounds.data(), world_transforms.data(), local_bounds.size(),
+								   world_bounds);
+			math::test_bounds(*frustum, world_bounds, visible);
+
+			std::size_t kept = 0;
+			for(std::size_t i = 0; i < result.size(); ++i)
 			{
-				if(transform_comp_ptr->is_touched() || model_comp_ptr->is_touched())
+				if(math::is_visible(visible, i))
 				{
-					result.emplace_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
+					result[kept++] = std::move(result[i]);
 				}
-			} // End if dirty_only
-			else
-			{
-				result.emplace_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
 			}
+			result.erase(std::begin(result) + static_cast<std::ptrdiff_t>(kept), std::end(result));
 		}
+	});
+
+	visibility_set_models_t result;
+	std::size_t total = 0;
+	for(const auto& chunk_result : chunk_results)
+	{
+		total += chunk_result.size();
+	}
+	result.reserve(total);
+	for(auto& chunk_result : chunk_results)
+	{
+		std::move(std::begin(chunk_result), std::end(chunk_result), std::back_inserter(result));
 	}
 	return result;
 }
@@ -226,17 +672,25 @@ void deferred_rendering::frame_render(std::chrono::duration<float> dt)
 {
 	auto& ecs = core::get_subsystem<entity_component_system>();
 
+	queue_.begin_frame();
+	update_bvh(ecs);
+
 	build_reflections_pass(ecs, dt);
 	build_shadows_pass(ecs, dt);
 	camera_pass(ecs, dt);
+
+	vacated_bounds_.clear();
 }
 
 void deferred_rendering::build_reflections_pass(entity_component_system& ecs, std::chrono::duration<float> dt)
 {
-	auto dirty_models = gather_visible_models(ecs, nullptr, true, true, true);
+	// Cascades are fitted to the cameras, the probes only see the shadows of
+	// the local lights.
+	const light_shadows_t no_cascades;
+
 	ecs.for_each<transform_component, reflection_probe_component>(
-		[this, &ecs, dt, &dirty_models](entity ce, transform_component& transform_comp,
-										reflection_probe_component& reflection_probe_comp) {
+		[this, &ecs, &no_cascades, dt](entity ce, transform_component& transform_comp,
+									   reflection_probe_component& reflection_probe_comp) {
 			const auto& world_tranform = transform_comp.get_transform();
 			const auto& probe = reflection_probe_comp.get_probe();
 
@@ -246,7 +700,7 @@ void deferred_rendering::build_reflections_pass(entity_component_system& ecs, st
 			if(!transform_comp.is_touched() && !reflection_probe_comp.is_touched())
 			{
 				// If reflections shouldn't be rebuilt - continue.
-				should_rebuild = should_rebuild_reflections(dirty_models, probe);
+				should_rebuild = should_rebuild_reflections(ecs, world_tranform, probe);
 			}
 
 			if(!should_rebuild)
@@ -266,8 +720,9 @@ void deferred_rendering::build_reflections_pass(entity_component_system& ecs, st
 					visibility_set = gather_visible_models(ecs, &camera, !should_rebuild, true, true);
 
 				std::shared_ptr<gfx::frame_buffer> output = nullptr;
-				output = g_buffer_pass(output, camera, render_view, visibility_set, camera_lods, dt);
-				output = lighting_pass(output, camera, render_view, ecs, dt);
+				auto draw_list = build_draw_list(camera, ecs, visibility_set, camera_lods, dt);
+				output = g_buffer_pass(output, camera, render_view, draw_list);
+				output = lighting_pass(output, camera, render_view, ecs, no_cascades, dt);
 				output = atmospherics_pass(output, camera, render_view, ecs, dt);
 				output = tonemapping_pass(output, camera, render_view);
 
@@ -285,51 +740,225 @@ void deferred_rendering::build_reflections_pass(entity_component_system& ecs, st
 
 void deferred_rendering::build_shadows_pass(entity_component_system& ecs, std::chrono::duration<float> dt)
 {
-	auto dirty_models = gather_visible_models(ecs, nullptr, true, true, true);
-	ecs.for_each<transform_component, light_component>(
-		[this, &ecs, dt, &dirty_models](entity ce, transform_component& transform_comp,
-										light_component& light_comp) {
-			// const auto& world_tranform = transform_comp.get_transform();
-			const auto& light = light_comp.get_light();
+	if(!static_shadow_fbo_ || !shadow_fbo_)
+	{
+		static auto shadow_format = gfx::get_best_format(BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER,
+														 gfx::format_search_flags::one_channel |
+															 gfx::format_search_flags::full_precision_float);
+		static auto flags = gfx::get_default_rt_sampler_flags() | BGFX_SAMPLER_POINT;
+
+		const auto size = shadow_atlas_.get_size();
+		auto static_shadow_map = std::make_shared<gfx::texture>(size, size, false, 1, shadow_format, flags);
+		auto shadow_map =
+			std::make_shared<gfx::texture>(size, size, false, 1, shadow_format, flags | BGFX_TEXTURE_BLIT_DST);
+		static_shadow_fbo_ = std::make_shared<gfx::frame_buffer>(
+			std::vector<std::shared_ptr<gfx::texture>>{static_shadow_map});
+		shadow_fbo_ =
+			std::make_shared<gfx::frame_buffer>(std::vector<std::shared_ptr<gfx::texture>>{shadow_map});
+	}
 
-			bool should_rebuild = true;
+	std::vector<std::pair<entity, camera*>> cameras;
+	ecs.for_each<camera_component>([&cameras](entity ce, camera_component& camera_comp) {
+		cameras.emplace_back(ce, &camera_comp.get_camera());
+	});
 
-			if(!transform_comp.is_touched() && !light_comp.is_touched())
+	std::vector<shadow_job> jobs;
+	const auto add_job = [this, &ecs, &jobs](const camera& view, light_shadow& shadow, std::size_t index,
+											 bool light_changed) {
+		auto& map = shadow.maps[index];
+		const math::mat4 view_proj = view.get_view_projection().get_matrix();
+
+		shadow_job job;
+		job.view = view;
+		job.map = &map;
+		job.rebuild_static = light_changed || !map.static_valid || view_proj != map.view_proj ||
+							 should_rebuild_shadows(ecs, view.get_frustum());
+
+		map.view_proj = view_proj;
+		shadow.matrices[index] = get_atlas_bias(map.tile, shadow_atlas_.get_size()) * view_proj;
+		shadow.rects[index] = get_atlas_rect(map.tile, shadow_atlas_.get_size());
+		jobs.emplace_back(std::move(job));
+	};
+
+	ecs.for_each<transform_component, light_component>([&](entity e, transform_component& transform_comp,
+															light_component& light_comp) {
+		const auto& world_transform = transform_comp.get_transform();
+		const auto& light = light_comp.get_light();
+		const bool light_changed = transform_comp.is_touched() || light_comp.is_touched();
+
+		if(light.type == light_type::directional)
+		{
+			std::array<camera, max_cascades> cascades;
+			for(const auto& pair : cameras)
 			{
-				// If shadows shouldn't be rebuilt - continue.
-				should_rebuild = should_rebuild_shadows(dirty_models, light);
+				auto& shadow = camera_shadows_[pair.first][e];
+				shadow.last_used = bvh_frame_;
+				shadow.depth_bias = directional_depth_bias;
+
+				const auto count =
+					get_cascade_cameras(*pair.second, world_transform, light, cascades, shadow.splits);
+				if(!reserve_shadow_maps(shadow, count, cascade_map_size))
+					continue;
+
+				for(std::size_t i = 0; i < count; ++i)
+				{
+					add_job(cascades[i], shadow, i, light_changed);
+				}
 			}
+			return;
+		}
 
-			if(!should_rebuild)
-				return;
+		auto& shadow = local_shadows_[e];
+		shadow.last_used = bvh_frame_;
+		shadow.depth_bias = local_depth_bias;
+		shadow.splits = math::vec4(std::numeric_limits<float>::max());
 
-		});
+		if(light.type == light_type::spot)
+		{
+			if(reserve_shadow_maps(shadow, 1, spot_map_size))
+			{
+				add_job(get_spot_shadow_camera(world_transform, light), shadow, 0, light_changed);
+			}
+		}
+		else if(light.type == light_type::point)
+		{
+			if(reserve_shadow_maps(shadow, 6, point_map_size))
+			{
+				for(std::uint32_t face = 0; face < 6; ++face)
+				{
+					add_job(get_point_shadow_camera(face, world_transform, light), shadow, face,
+							light_changed);
+				}
+			}
+		}
+	});
+
+	// Give back the maps of lights and cameras which are gone.
+	const auto release_unused = [this](light_shadows_t& shadows) {
+		for(auto it = shadows.begin(); it != shadows.end();)
+		{
+			if(it->second.last_used != bvh_frame_)
+			{
+				release_shadow_maps(it->second);
+				it = shadows.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	};
+	release_unused(local_shadows_);
+	for(auto it = camera_shadows_.begin(); it != camera_shadows_.end();)
+	{
+		release_unused(it->second);
+		it = it->second.empty() ? camera_shadows_.erase(it) : std::next(it);
+	}
+
+	// Sort the casters of every map before drawing so that all the cached
+	// maps are done before they are copied.
+	for(auto& job : jobs)
+	{
+		const auto casters = gather_visible_models(ecs, &job.view, false, false, false);
+		for(const auto& element : casters)
+		{
+			const auto id = element.id();
+			const auto model_comp_ptr = ecs.get_component_ptr<model_component>(id);
+			if(!model_comp_ptr || !model_comp_ptr->casts_shadow())
+				continue;
+
+			if(model_comp_ptr->is_static())
+			{
+				if(job.rebuild_static)
+				{
+					job.static_casters.emplace_back(id);
+				}
+			}
+			else
+			{
+				job.dynamic_casters.emplace_back(id);
+			}
+		}
+	}
+
+	const auto atlas_size = shadow_atlas_.get_size();
+	const auto set_tile = [](gfx::view_id id, const shadow_atlas::tile& tile) {
+		gfx::set_view_rect(id, tile.x, tile.y, tile.size, tile.size);
+		gfx::set_view_scissor(id, tile.x, tile.y, tile.size, tile.size);
+	};
+
+	for(auto& job : jobs)
+	{
+		if(!job.rebuild_static)
+			continue;
+
+		gfx::render_pass pass("shadow_static_fill");
+		pass.bind(static_shadow_fbo_.get());
+		set_tile(pass.id, job.map->tile);
+		pass.clear(BGFX_CLEAR_COLOR, 0xffffffff, 1.0f, 0);
+		pass.set_view_proj(job.view.get_view(), job.view.get_projection());
+		draw_shadow_casters(pass.id, ecs, job.static_casters);
+		job.map->static_valid = true;
+	}
+
+	// The sampled map only has to be refreshed where the cached one changed
+	// or dynamic casters are or were.
+	gfx::render_pass copy_pass("shadow_copy");
+	copy_pass.touch();
+	const auto static_shadow_map = static_shadow_fbo_->get_texture()->native_handle();
+	const auto shadow_map = shadow_fbo_->get_texture()->native_handle();
+	for(const auto& job : jobs)
+	{
+		const auto& tile = job.map->tile;
+		if(job.rebuild_static || !job.dynamic_casters.empty() || job.map->had_dynamic_casters)
+		{
+			const auto row = get_atlas_row(tile, atlas_size);
+			gfx::blit(copy_pass.id, shadow_map, tile.x, row, static_shadow_map, tile.x, row, tile.size,
+					  tile.size);
+		}
+	}
+
+	for(auto& job : jobs)
+	{
+		job.map->had_dynamic_casters = !job.dynamic_casters.empty();
+		if(job.dynamic_casters.empty())
+			continue;
+
+		gfx::render_pass pass("shadow_dynamic_fill");
+		pass.bind(shadow_fbo_.get());
+		set_tile(pass.id, job.map->tile);
+		pass.set_view_proj(job.view.get_view(), job.view.get_projection());
+		draw_shadow_casters(pass.id, ecs, job.dynamic_casters);
+	}
 }
 
 void deferred_rendering::camera_pass(entity_component_system& ecs, std::chrono::duration<float> dt)
 {
 	ecs.for_each<camera_component>([this, &ecs, dt](entity ce, camera_component& camera_comp) {
 		auto& camera_lods = lod_data_[ce];
+		auto& camera_shadows = camera_shadows_[ce];
 		auto& camera = camera_comp.get_camera();
 		auto& render_view = camera_comp.get_render_view();
 
-		auto output = deferred_render_full(camera, render_view, ecs, camera_lods, dt);
+		auto output = deferred_render_full(camera, render_view, ecs, camera_lods, camera_shadows, dt);
 	});
 }
 
 std::shared_ptr<gfx::frame_buffer> deferred_rendering::deferred_render_full(
 	camera& camera, gfx::render_view& render_view, entity_component_system& ecs,
-	std::unordered_map<entity, lod_data>& camera_lods, std::chrono::duration<float> dt)
+	std::unordered_map<entity, lod_data>& camera_lods, const light_shadows_t& camera_shadows,
+	std::chrono::duration<float> dt)
 {
 	std::shared_ptr<gfx::frame_buffer> output = nullptr;
 
 	auto visibility_set = gather_visible_models(ecs, &camera, false, false, false);
+	auto draw_list = build_draw_list(camera, ecs, visibility_set, camera_lods, dt);
 
-	output = g_buffer_pass(output, camera, render_view, visibility_set, camera_lods, dt);
+	output = g_buffer_pass(output, camera, render_view, draw_list);
 
 	output = reflection_probe_pass(output, camera, render_view, ecs, dt);
 
-	output = lighting_pass(output, camera, render_view, ecs, dt);
+	output = lighting_pass(output, camera, render_view, ecs, camera_shadows, dt);
 
 	output = atmospherics_pass(output, camera, render_view, ecs, dt);
 
@@ -338,11 +967,101 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::deferred_render_full(
 	return output;
 }
 
-std::shared_ptr<gfx::frame_buffer>
-deferred_rendering::g_buffer_pass(std::shared_ptr<gfx::frame_buffer> input, camera& camera,
-								  gfx::render_view& render_view, visibility_set_models_t& visibility_set,
-								  std::unordered_map<entity, lod_data>& camera_lods,
-								  std::chrono::duration<float> dt)
+draw_list_t deferred_rendering::build_draw_list(camera& camera, entity_component_system& ecs,
+												const visibility_set_models_t& visibility_set,
+												std::unordered_map<entity, lod_data>& camera_lods,
+												std::chrono::duration<float> dt)
+{
+	auto& ts = core::get_subsystem<core::task_system>();
+
+	// The lod state lives in a map, so find the entries before going wide.
+	// References to the elements stay valid while inserting.
+	std::vector<lod_data*> lods;
+	lods.reserve(visibility_set.size());
+	for(const auto& element : visibility_set)
+	{
+		lods.emplace_back(&camera_lods[element]);
+	}
+
+	// The projection is lazily updated so resolve it before going wide.
+	const math::mat4 view_proj = camera.get_projection().get_matrix() * camera.get_view().get_matrix();
+	const auto camera_pos = camera.get_position();
+
+	// Every chunk collects into its own list, the final order comes from the
+	// sort keys.
+	const std::size_t grain = 128;
+	std::vector<draw_list_t> chunk_results((visibility_set.size() + grain - 1) / grain);
+
+	ts.parallel_for(0, visibility_set.size(), grain, [&](std::size_t begin, std::size_t end) {
+		auto& result = chunk_results[begin / grain];
+		for(std::size_t i = begin; i < end; ++i)
+		{
+			const auto id = visibility_set[i].id();
+			if(!ecs.valid(id))
+				continue;
+
+			// Raw access instead of locking the handles, nothing is removed
+			// while the list is built.
+			auto transform_comp_ptr = ecs.get_component_ptr<transform_component>(id);
+			auto model_comp_ptr = ecs.get_component_ptr<model_component>(id);
+			if(!transform_comp_ptr || !model_comp_ptr)
+				continue;
+
+			const auto& model = model_comp_ptr->get_model();
+			if(!model.is_valid())
+				continue;
+
+			const auto& world_transform = transform_comp_ptr->get_transform();
+
+			auto& lod_data = *lods[i];
+			draw_item item;
+			item.world_transform = &world_transform;
+			item.model_comp = model_comp_ptr;
+			item.transition_time = model.get_lod_transition_time();
+			item.current_time = lod_data.current_time;
+			item.current_lod_index = lod_data.current_lod_index;
+			item.target_lod_index = lod_data.target_lod_index;
+
+			const auto current_mesh = model.get_lod(item.current_lod_index);
+			if(!current_mesh)
+				continue;
+
+			if(false == update_lod_data(lod_data, model.get_lod_limits(), model.get_lods().size(),
+										item.transition_time, dt.count(), current_mesh, world_transform,
+										view_proj))
+				continue;
+
+			// Positive floats compare the same as their bit patterns.
+			const float distance = math::distance2(world_transform.get_position(), camera_pos);
+			std::uint32_t distance_bits = 0;
+			std::memcpy(&distance_bits, &distance, sizeof(distance_bits));
+			item.sort_key = (std::uint64_t(distance_bits) << 32) | id.index();
+
+			result.emplace_back(item);
+		}
+	});
+
+	draw_list_t result;
+	std::size_t total = 0;
+	for(const auto& chunk_result : chunk_results)
+	{
+		total += chunk_result.size();
+	}
+	result.reserve(total);
+	for(auto& chunk_result : chunk_results)
+	{
+		std::move(std::begin(chunk_result), std::end(chunk_result), std::back_inserter(result));
+	}
+
+	std::sort(std::begin(result), std::end(result),
+			  [](const draw_item& lhs, const draw_item& rhs) { return lhs.sort_key < rhs.sort_key; });
+	return result;
+}
+
+std::shared_ptr<gfx::frame_buffer> deferred_rendering::g_buffer_pass(std::shared_ptr<gfx::frame_buffer> input,
+																	 camera& camera,
+																	 gfx::render_view& render_view,
+																	 const draw_list_t& draw_list)
 {
 	const auto& view = camera.get_view();
 	const auto& proj = camera.get_projection();
@@ -353,63 +1072,112 @@ deferred_rendering::g_buffer_pass(std::shared_ptr<gfx::frame_buffer> input, came
 	pass.set_view_proj(view, proj);
 	pass.bind(g_buffer_fbo.get());
 
-	for(auto& element : visibility_set)
-	{
-		auto& e = std::get<0>(element);
-		auto& transform_comp_handle = std::get<1>(element);
-		auto& model_comp_handle = std::get<2>(element);
-		auto transform_comp_ptr = transform_comp_handle.lock();
-		auto model_comp_ptr = model_comp_handle.lock();
-		if(!transform_comp_ptr || !model_comp_ptr)
-			continue;
+	const auto camera_pos = camera.get_position();
+	const auto clip_planes = math::vec2(camera.get_near_clip(), camera.get_far_clip());
 
-		auto& transform_comp_ref = *transform_comp_ptr.get();
-		auto& model_comp_ref = *model_comp_ptr.get();
+	const auto caps = gfx::get_caps();
+	const bool instancing_supported = 0 != (caps->supported & BGFX_CAPS_INSTANCING);
 
-		const auto& model = model_comp_ref.get_model();
-		if(!model.is_valid())
-			continue;
-
-		const auto& world_transform = transform_comp_ref.get_transform();
-		const auto clip_planes = math::vec2(camera.get_near_clip(), camera.get_far_clip());
-
-		auto& lod_data = camera_lods[e];
-		const auto transition_time = model.get_lod_transition_time();
-		const auto lod_count = model.get_lods().size();
-		const auto& lod_limits = model.get_lod_limits();
-		const auto current_time = lod_data.current_time;
-		const auto current_lod_index = lod_data.current_lod_index;
-		const auto target_lod_index = lod_data.target_lod_index;
+	// Draws of the same subset of the same mesh with the same material are
+	// collected and submitted at once after the loop.
+	struct instance_data
+	{
+		math::mat4 world;
+		math::vec4 lod_params;
+	};
+	struct instance_group
+	{
+		const model* source = nullptr;
+		unsigned int lod = 0;
+		std::uint32_t group_id = 0;
+		std::vector<instance_data> instances;
+	};
+	using instance_key = std::tuple<const mesh*, std::uint32_t, const material*>;
+	std::map<instance_key, instance_group> instance_groups;
+
+	const auto add_instances = [&](const model& model, unsigned int lod, const math::transform& world_transform,
+								   const math::vec3& params) {
+		const auto mesh = model.get_lod(lod);
+		for(std::uint32_t group_id = 0; group_id < std::uint32_t(mesh->get_subset_count()); ++group_id)
+		{
+			const auto mat = model.get_material_for_group(group_id);
+			auto& group = instance_groups[instance_key(mesh.get(), group_id, mat.get())];
+			group.source = &model;
+			group.lod = lod;
+			group.group_id = group_id;
+			group.instances.emplace_back(instance_data{world_transform, math::vec4(params, 0.0f)});
+		}
+	};
 
-		const auto current_mesh = model.get_lod(current_lod_index);
-		if(!current_mesh)
-			continue;
+	for(const auto& item : draw_list)
+	{
+		const auto& model = item.model_comp->get_model();
+		const auto& world_transform = *item.world_transform;
+		const auto& skinning_transforms = item.model_comp->get_skinning_transforms();
+		const auto transition_time = item.transition_time;
+		const auto current_time = item.current_time;
 
-		if(false == update_lod_data(lod_data, lod_limits, lod_count, transition_time, dt.count(),
-									current_mesh, world_transform, camera))
-			continue;
 		const auto params = math::vec3{0.0f, -1.0f, (transition_time - current_time) / transition_time};
 
 		const auto params_inv = math::vec3{1.0f, 1.0f, current_time / transition_time};
 
-		const auto& bone_transforms = model_comp_ref.get_bone_transforms();
+		// The instanced shader transforms normals by the world matrix, which
+		// is only correct for uniform scales.
+		const auto& scale = world_transform.get_scale();
+		const bool uniform_scale = math::all(math::equal(scale, math::vec3(scale.x), math::epsilon<float>()));
 
-		model.render(pass.id, world_transform, bone_transforms, true, true, true, 0, current_lod_index,
-					 nullptr, [&camera, &clip_planes, &params](auto& p) {
-						 auto camera_pos = camera.get_position();
-						 p.set_uniform("u_camera_wpos", camera_pos);
-						 p.set_uniform("u_camera_clip_planes", clip_planes);
-						 p.set_uniform("u_lod_params", params);
-					 });
+		const bool can_instance = instancing_supported && skinning_transforms.empty() && uniform_scale &&
+								  model.supports_instancing(item.current_lod_index) &&
+								  (current_time == 0.0f || model.supports_instancing(item.target_lod_index));
+		if(can_instance)
+		{
+			add_instances(model, item.current_lod_index, world_transform, params);
+			if(current_time != 0.0f)
+			{
+				add_instances(model, item.target_lod_index, world_transform, params_inv);
+			}
+			continue;
+		}
+
+		const auto depth = math::distance2(world_transform.get_position(), camera_pos);
+		model.enqueue(queue_, pass.id, 0, world_transform, skinning_transforms, true, true, true, 0,
+					  item.current_lod_index, math::vec4(params, 0.0f), depth);
 
 		if(current_time != 0.0f)
 		{
-			model.render(
-				pass.id, world_transform, bone_transforms, true, true, true, 0, target_lod_index, nullptr,
-				[&params_inv](auto& p) { p.set_uniform("u_lod_params", params_inv); });
+			model.enqueue(queue_, pass.id, 0, world_transform, skinning_transforms, true, true, true, 0,
+						  item.target_lod_index, math::vec4(params_inv, 0.0f), depth);
+		}
+	}
+
+	const std::uint16_t stride = sizeof(instance_data);
+	for(const auto& pair : instance_groups)
+	{
+		const auto& group = pair.second;
+		std::uint32_t offset = 0;
+		const auto total = std::uint32_t(group.instances.size());
+		while(offset < total)
+		{
+			// The transient buffer may not fit every instance at once.
+			const auto count = gfx::get_avail_instance_data_buffer(total - offset, stride);
+			if(count == 0)
+				break;
+
+			gfx::instance_data_buffer idb;
+			gfx::alloc_instance_data_buffer(&idb, count, stride);
+			std::memcpy(idb.data, &group.instances[offset], count * stride);
+
+			group.source->enqueue_instanced(queue_, pass.id, 0, idb, group.group_id, true, true, true, 0,
+											group.lod, 0.0f);
+			offset += count;
 		}
 	}
 
+	queue_.flush([&camera_pos, &clip_planes](auto& p) {
+		p.set_uniform(u_camera_wpos, camera_pos);
+		p.set_uniform(u_camera_clip_planes, clip_planes);
+	});
+
 	return g_buffer_fbo;
 }
 
@@ -417,6 +1185,7 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::lighting_pass(std::shared
 																	 camera& camera,
 																	 gfx::render_view& render_view,
 																	 entity_component_system& ecs,
+																	 const light_shadows_t& camera_shadows,
 																	 std::chrono::duration<float> dt)
 {
 	const auto& view = camera.get_view();
@@ -424,6 +1193,7 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::lighting_pass(std::shared
 
 	const auto& viewport_size = camera.get_viewport_size();
 	auto g_buffer_fbo = render_view.get_g_buffer_fbo(viewport_size).get();
+	auto shadow_map = shadow_fbo_ ? shadow_fbo_->get_texture().get() : nullptr;
 
 	static auto light_buffer_format = gfx::get_best_format(
 		BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER, gfx::format_search_flags::four_channels |
@@ -444,14 +1214,47 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::lighting_pass(std::shared
 			.get_texture("RBUFFER", viewport_size.width, viewport_size.height, false, 1, light_buffer_format)
 			.get();
 
+	clusters_.clear();
+	const bool use_clusters = clustered_lighting_ && clustered_light_program_;
+
 	ecs.for_each<transform_component, light_component>(
-		[this, &camera, &pass, &buffer_size, &view, &proj, g_buffer_fbo,
-		 refl_buffer](entity e, transform_component& transform_comp_ref, light_component& light_comp_ref) {
+		[this, &camera, &pass, &buffer_size, &view, &proj, &camera_shadows, use_clusters, g_buffer_fbo,
+		 refl_buffer, shadow_map](entity e, transform_component& transform_comp_ref,
+								  light_component& light_comp_ref) {
 			const auto& light = light_comp_ref.get_light();
 			const auto& world_transform = transform_comp_ref.get_transform();
 			const auto& light_position = world_transform.get_position();
 			const auto& light_direction = world_transform.z_unit_axis();
 
+			// Unshadowed local lights are shaded together by the clustered pass.
+			const auto local_shadow = local_shadows_.find(e);
+			const bool has_shadow =
+				local_shadow != local_shadows_.end() && !local_shadow->second.maps.empty();
+			if(use_clusters && !has_shadow && light.type != light_type::directional)
+			{
+				cluster_light cluster_data;
+				cluster_data.color_intensity = math::vec4(light.color.value.r, light.color.value.g,
+														  light.color.value.b, light.intensity);
+				cluster_data.direction_type = math::vec4(light_direction, 0.0f);
+				if(light.type == light_type::point)
+				{
+					cluster_data.position_range = math::vec4(light_position, light.point_data.range);
+					cluster_data.data = math::vec4(light.point_data.exponent_falloff, 0.0f, 0.0f, 0.0f);
+				}
+				else
+				{
+					cluster_data.position_range = math::vec4(light_position, light.spot_data.get_range());
+					cluster_data.direction_type.w = 1.0f;
+					cluster_data.data.x = math::cos(math::radians(light.spot_data.get_inner_angle() * 0.5f));
+					cluster_data.data.y = math::cos(math::radians(light.spot_data.get_outer_angle() * 0.5f));
+				}
+
+				if(clusters_.add_light(cluster_data))
+				{
+					return;
+				}
+			}
+
 			irect32_t rect(0, 0, irect32_t::value_type(buffer_size.width),
 						   irect32_t::value_type(buffer_size.height));
 			if(light_comp_ref.compute_projected_sphere_rect(rect, light_position, light_direction, view,
@@ -507,6 +1310,28 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::lighting_pass(std::shared
 				program->set_texture(5, "s_tex5", refl_buffer);
 				program->set_texture(6, "s_tex6", ibl_brdf_lut_.get());
 
+				const auto& shadows = light.type == light_type::directional ? camera_shadows : local_shadows_;
+				const auto shadow = shadows.find(e);
+				float shadow_params[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+				if(shadow != shadows.end() && !shadow->second.maps.empty() && shadow_map)
+				{
+					const auto& shadow_data = shadow->second;
+					shadow_params[0] = float(shadow_data.maps.size());
+					shadow_params[1] = shadow_data.depth_bias;
+					shadow_params[2] = 1.0f / float(shadow_atlas_.get_size());
+					shadow_params[3] = light.shadow == shadow_type::hard ? 0.0f : 1.0f;
+					program->set_uniform("u_shadow_matrix", math::value_ptr(shadow_data.matrices[0]),
+										 std::uint16_t(shadow_data.matrices.size()));
+					program->set_uniform("u_shadow_rects", math::value_ptr(shadow_data.rects[0]),
+										 std::uint16_t(shadow_data.rects.size()));
+					program->set_uniform("u_shadow_splits", shadow_data.splits);
+				}
+				program->set_uniform("u_shadow_params", shadow_params);
+				if(shadow_map)
+				{
+					program->set_texture(7, "s_tex7", shadow_map);
+				}
+
 				gfx::set_scissor(rect.left, rect.top, rect.width(), rect.height());
 				auto topology = gfx::clip_quad(1.0f);
 				gfx::set_state(topology | BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A | BGFX_STATE_BLEND_ADD);
@@ -517,6 +1342,71 @@ std::shared_ptr<gfx::frame_buffer> deferred_rendering::lighting_pass(std::shared
 			}
 		});
 
+	if(!clusters_.empty())
+	{
+		clusters_.build(camera);
+
+		const auto flags = BGFX_SAMPLER_POINT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
+		const auto grid_width = std::uint16_t(light_clusters::tiles_x * light_clusters::tiles_y);
+		const auto grid_height = std::uint16_t(light_clusters::slices);
+		const auto index_width = std::uint16_t(light_clusters::index_width);
+		auto grid = render_view.get_texture("CLUSTER_GRID", grid_width, grid_height, false, 1,
+											gfx::texture_format::RG32F, flags);
+		auto indices = render_view.get_texture("CLUSTER_INDICES", index_width,
+											   std::uint16_t(light_clusters::index_height), false, 1,
+											   gfx::texture_format::R32F, flags);
+		auto lights = render_view.get_texture("CLUSTER_LIGHTS", 4, light_clusters::max_lights, false, 1,
+											  gfx::texture_format::RGBA32F, flags);
+
+		const auto& grid_data = clusters_.get_grid();
+		gfx::update_texture_2d(grid->native_handle(), 0, 0, 0, 0, grid_width, grid_height,
+							   gfx::copy(grid_data.data(), std::uint32_t(grid_data.size() * sizeof(float))));
+
+		// Only the rows in use are uploaded.
+		const auto& index_data = clusters_.get_indices();
+		if(!index_data.empty())
+		{
+			const auto index_rows = (std::uint32_t(index_data.size()) + index_width - 1) / index_width;
+			std::vector<float> index_upload(index_rows * index_width, 0.0f);
+			std::copy(std::begin(index_data), std::end(index_data), std::begin(index_upload));
+			gfx::update_texture_2d(
+				indices->native_handle(), 0, 0, 0, 0, index_width, std::uint16_t(index_rows),
+				gfx::copy(index_upload.data(), std::uint32_t(index_upload.size() * sizeof(float))));
+		}
+
+		const auto& light_data = clusters_.get_lights();
+		gfx::update_texture_2d(
+			lights->native_handle(), 0, 0, 0, 0, 4, std::uint16_t(light_data.size()),
+			gfx::copy(light_data.data(), std::uint32_t(light_data.size() * sizeof(cluster_light))));
+
+		auto program = clustered_light_program_.get();
+		program->begin();
+		auto camera_pos = camera.get_position();
+		program->set_uniform("u_camera_position", camera_pos);
+		program->set_uniform("u_cluster_view", math::value_ptr(clusters_.get_view_params()[0]),
+							 std::uint16_t(clusters_.get_view_params().size()));
+		program->set_uniform("u_cluster_projection", clusters_.get_projection_params());
+		program->set_uniform("u_cluster_depth", clusters_.get_depth_params());
+		program->set_texture(0, "s_tex0", g_buffer_fbo->get_texture(0).get());
+		program->set_texture(1, "s_tex1", g_buffer_fbo->get_texture(1).get());
+		program->set_texture(2, "s_tex2", g_buffer_fbo->get_texture(2).get());
+		program->set_texture(3, "s_tex3", g_buffer_fbo->get_texture(3).get());
+		program->set_texture(4, "s_tex4", g_buffer_fbo->get_texture(4).get());
+		program->set_texture(5, "s_tex5", refl_buffer);
+		program->set_texture(6, "s_tex6", ibl_brdf_lut_.get());
+		program->set_texture(8, "s_tex8", grid.get());
+		program->set_texture(9, "s_tex9", indices.get());
+		program->set_texture(10, "s_tex10", lights.get());
+
+		gfx::set_scissor(0, 0, std::uint16_t(buffer_size.width), std::uint16_t(buffer_size.height));
+		auto topology = gfx::clip_quad(1.0f);
+		gfx::set_state(topology | BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A | BGFX_STATE_BLEND_ADD);
+		gfx::submit(pass.id, program->native_handle());
+		gfx::set_state(BGFX_STATE_DEFAULT);
+
+		program->end();
+	}
+
 	return l_buffer_fbo;
 }
 
@@ -724,12 +1614,30 @@ void deferred_rendering::receive(entity e)
 	{
 		pair.second.erase(e);
 	}
+
+	const auto id = e.id();
+	if(id.index() < bvh_entries_.size())
+	{
+		auto& entry = bvh_entries_[id.index()];
+		if(entry.id == id && entry.proxy != math::dynamic_bvh::null_node)
+		{
+			vacated_bounds_.emplace_back(bvh_.get_fat_bounds(entry.proxy));
+			bvh_.remove(entry.proxy);
+		}
+		if(entry.id == id)
+		{
+			entry = bvh_entry();
+		}
+	}
 }
 deferred_rendering::deferred_rendering()
+	: shadow_atlas_(shadow_atlas_size, shadow_min_tile_size)
 {
 	on_entity_destroyed.connect(this, &deferred_rendering::receive);
 	on_frame_render.connect(this, &deferred_rendering::frame_render);
 
+	queue_.set_params_uniform(u_lod_params);
+
 	auto& ts = core::get_subsystem<core::task_system>();
 	auto& am = core::get_subsystem<runtime::asset_manager>();
 	auto vs_clip_quad = am.load<gfx::shader>("engine:/data/shaders/vs_clip_quad.sc");
@@ -752,6 +1660,15 @@ deferred_rendering::deferred_rendering()
 	fs_box_reflection_probe.wait();
 	auto fs_atmospherics = am.load<gfx::shader>("engine:/data/shaders/fs_atmospherics.sc");
 	fs_atmospherics.wait();
+	auto vs_shadow = am.load<gfx::shader>("engine:/data/shaders/vs_shadow.sc");
+	vs_shadow.wait();
+	auto vs_shadow_skinned = am.load<gfx::shader>("engine:/data/shaders/vs_shadow_skinned.sc");
+	vs_shadow_skinned.wait();
+	auto fs_shadow = am.load<gfx::shader>("engine:/data/shaders/fs_shadow.sc");
+	fs_shadow.wait();
+	auto fs_deferred_clustered_light =
+		am.load<gfx::shader>("engine:/data/shaders/fs_deferred_clustered_light.sc");
+	fs_deferred_clustered_light.wait();
 	ibl_brdf_lut_ = am.load<gfx::texture>("engine:/data/textures/ibl_brdf_lut.png").get();
 	ts.push_or_execute_on_owner_thread(
 		[this](asset_handle<gfx::shader> vs, asset_handle<gfx::shader> fs) {
@@ -766,6 +1683,13 @@ deferred_rendering::deferred_rendering()
 		},
 		vs_clip_quad, fs_deferred_spot_light);
 
+	ts.push_or_execute_on_owner_thread(
+		[this](asset_handle<gfx::shader> vs, asset_handle<gfx::shader> fs) {
+			clustered_light_program_ = std::make_unique<gpu_program>(vs, fs);
+
+		},
+		vs_clip_quad, fs_deferred_clustered_light);
+
 	ts.push_or_execute_on_owner_thread(
 		[this](asset_handle<gfx::shader> vs, asset_handle<gfx::shader> fs) {
 			directional_light_program_ = std::make_unique<gpu_program>(vs, fs);
@@ -800,6 +1724,20 @@ deferred_rendering::deferred_rendering()
 
 		},
 		vs_clip_quad_ex, fs_atmospherics);
+
+	ts.push_or_execute_on_owner_thread(
+		[this](asset_handle<gfx::shader> vs, asset_handle<gfx::shader> fs) {
+			shadow_program_ = std::make_unique<gpu_program>(vs, fs);
+
+		},
+		vs_shadow, fs_shadow);
+
+	ts.push_or_execute_on_owner_thread(
+		[this](asset_handle<gfx::shader> vs, asset_handle<gfx::shader> fs) {
+			shadow_skinned_program_ = std::make_unique<gpu_program>(vs, fs);
+
+		},
+		vs_shadow_skinned, fs_shadow);
 }
 
 deferred_rendering::~deferred_rendering()
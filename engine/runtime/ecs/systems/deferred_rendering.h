@@ -1,18 +1,25 @@
 #pragma once
 
 #include "../../rendering/gpu_program.h"
+#include "../../rendering/light_clusters.h"
+#include "../../rendering/render_queue.h"
+#include "../../rendering/shadow_atlas.h"
 #include "../components/model_component.h"
 #include "../components/transform_component.h"
 #include "../ecs.h"
 
 #include <core/common/basetypes.hpp>
+#include <core/math/dynamic_bvh.h>
 
+#include <array>
 #include <chrono>
 #include <memory>
 #include <tuple>
 #include <vector>
 
 class camera;
+struct light;
+struct reflection_probe;
 
 namespace gfx
 {
@@ -30,8 +37,65 @@ struct lod_data
 	float current_time = 0.0f;
 };
 
-using visibility_set_models_t =
-	std::vector<std::tuple<entity, chandle<transform_component>, chandle<model_component>>>;
+//-----------------------------------------------------------------------------
+//  Name : light_shadow (Struct)
+/// <summary>
+/// Shadow maps of a light in the shadow atlas. Static casters are drawn
+/// into a cached copy of every map which is only redrawn when the map moved
+/// or a static caster in it changed. Dynamic casters are drawn on top of a
+/// copy of it every frame.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct light_shadow
+{
+	static constexpr std::size_t max_maps = 6;
+
+	struct map
+	{
+		shadow_atlas::tile tile;
+		/// View projection the static casters were drawn with.
+		math::mat4 view_proj;
+		bool static_valid = false;
+		bool had_dynamic_casters = false;
+	};
+
+	std::vector<map> maps;
+	/// World to atlas transform and atlas uv rect of every map.
+	std::array<math::mat4, max_maps> matrices;
+	std::array<math::vec4, max_maps> rects;
+	/// Distance from the camera at which every cascade ends.
+	math::vec4 splits;
+	float depth_bias = 0.0f;
+	/// Frame the light was last seen in.
+	std::uint32_t last_used = 0;
+};
+
+using light_shadows_t = std::unordered_map<entity, light_shadow>;
+
+/// Visible entities with a transform and a model. Callers look the
+/// components up directly, so gathering never locks a handle.
+using visibility_set_models_t = std::vector<entity>;
+
+//-----------------------------------------------------------------------------
+//  Name : draw_item (Struct)
+/// <summary>
+/// Everything needed to submit one visible model for a camera. The
+/// pointers are only valid for the frame the item was built in.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct draw_item
+{
+	const math::transform* world_transform = nullptr;
+	const model_component* model_comp = nullptr;
+	std::uint32_t current_lod_index = 0;
+	std::uint32_t target_lod_index = 0;
+	float current_time = 0.0f;
+	float transition_time = 0.0f;
+	/// Front to back order.
+	std::uint64_t sort_key = 0;
+};
+
+using draw_list_t = std::vector<draw_item>;
 
 class deferred_rendering
 {
@@ -82,9 +146,9 @@ public:
 	//-----------------------------------------------------------------------------
 	//  Name : build_shadows ()
 	/// <summary>
-	///
-	///
-	///
+	/// Brings the shadow maps of every light up to date. Spot lights get one
+	/// map, point lights one per axis and directional lights a set of
+	/// cascades for every camera.
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	void build_shadows_pass(entity_component_system& ecs, delta_t dt);
@@ -110,7 +174,19 @@ public:
 	std::shared_ptr<gfx::frame_buffer> deferred_render_full(camera& camera, gfx::render_view& render_view,
 															entity_component_system& ecs,
 															std::unordered_map<entity, lod_data>& camera_lods,
-															delta_t dt);
+															const light_shadows_t& camera_shadows, delta_t dt);
+
+	//-----------------------------------------------------------------------------
+	//  Name : build_draw_list ()
+	/// <summary>
+	/// Selects the lod of every visible model and sorts them for submission.
+	/// The work is split in chunks across the task system workers so that
+	/// the owner thread is left with the submits only.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	draw_list_t build_draw_list(camera& camera, entity_component_system& ecs,
+								const visibility_set_models_t& visibility_set,
+								std::unordered_map<entity, lod_data>& camera_lods, delta_t dt);
 
 	//-----------------------------------------------------------------------------
 	//  Name : g_buffer_pass ()
@@ -121,22 +197,20 @@ public:
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	std::shared_ptr<gfx::frame_buffer> g_buffer_pass(std::shared_ptr<gfx::frame_buffer> input, camera& camera,
-													 gfx::render_view& render_view,
-													 visibility_set_models_t& visibility_set,
-													 std::unordered_map<entity, lod_data>& camera_lods,
-													 delta_t dt);
+													 gfx::render_view& render_view, const draw_list_t& draw_list);
 
 	//-----------------------------------------------------------------------------
 	//  Name : lighting_pass ()
 	/// <summary>
-	///
-	///
-	///
+	/// Accumulates every light in the light buffer. Directional lights are
+	/// shadowed by the cascades of the camera, other lights by their own
+	/// maps.
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	std::shared_ptr<gfx::frame_buffer> lighting_pass(std::shared_ptr<gfx::frame_buffer> input, camera& camera,
 													 gfx::render_view& render_view,
-													 entity_component_system& ecs, delta_t dt);
+													 entity_component_system& ecs,
+													 const light_shadows_t& camera_shadows, delta_t dt);
 
 	//-----------------------------------------------------------------------------
 	//  Name : reflection_probe ()
@@ -173,14 +247,140 @@ public:
 	std::shared_ptr<gfx::frame_buffer> tonemapping_pass(std::shared_ptr<gfx::frame_buffer> input,
 														camera& camera, gfx::render_view& render_view);
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_render_stats ()
+	/// <summary>
+	/// State changes of the model draws in the last frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const render_queue_stats& get_render_stats() const
+	{
+		return queue_.get_stats();
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_clustered_lighting ()
+	/// <summary>
+	/// Shades the point and spot lights without shadows in one clustered pass
+	/// instead of one pass per light. On by default.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_clustered_lighting(bool on)
+	{
+		clustered_lighting_ = on;
+	}
+
+	bool is_clustered_lighting() const
+	{
+		return clustered_lighting_;
+	}
+
 private:
+	//-----------------------------------------------------------------------------
+	//  Name : update_bvh ()
+	/// <summary>
+	/// Brings the scene hierarchy up to date with the models in the scene.
+	/// Only the entities the ecs lists as changed, added or removed are
+	/// visited. The refitted models are remembered as the dirty models of
+	/// this frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update_bvh(entity_component_system& ecs);
+
+	//-----------------------------------------------------------------------------
+	//  Name : should_rebuild_reflections ()
+	/// <summary>
+	/// Checks whether a dirty reflection caster is within reach of the probe.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool should_rebuild_reflections(entity_component_system& ecs, const math::transform& world,
+									const reflection_probe& probe) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : should_rebuild_shadows ()
+	/// <summary>
+	/// Checks whether a static model inside the volume of a shadow map, or
+	/// one which left it, changed since the last frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool should_rebuild_shadows(entity_component_system& ecs, const math::frustum& volume) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : reserve_shadow_maps ()
+	/// <summary>
+	/// Makes sure the light has the requested maps in the atlas. Returns
+	/// false and leaves it without maps when the atlas is full.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool reserve_shadow_maps(light_shadow& shadow, std::size_t count, std::uint16_t size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : release_shadow_maps ()
+	/// <summary>
+	/// Gives the maps of a light back to the atlas.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void release_shadow_maps(light_shadow& shadow);
+
+	//-----------------------------------------------------------------------------
+	//  Name : draw_shadow_casters ()
+	/// <summary>
+	/// Draws the depth of the models into the bound shadow map.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void draw_shadow_casters(gfx::view_id id, entity_component_system& ecs,
+							 const std::vector<entity::id_t>& casters);
+
+	struct bvh_entry
+	{
+		entity::id_t id = entity::INVALID;
+		std::uint32_t proxy = math::dynamic_bvh::null_node;
+		bool dirty = false;
+	};
+
+	/// Hierarchy of the world bounds of every model, the user data is the
+	/// entity id.
+	math::dynamic_bvh bvh_;
+	/// Proxy of every entity in the hierarchy indexed by entity index.
+	std::vector<bvh_entry> bvh_entries_;
+	/// Entities whose model moved or changed since the last frame.
+	std::vector<entity::id_t> dirty_entities_;
+	/// Previous bounds of the static models which moved or changed and of
+	/// the removed models. Cached shadows which overlap them are stale.
+	std::vector<math::bbox> vacated_bounds_;
+	/// Incremented every update, used to find stale shadow maps.
+	std::uint32_t bvh_frame_ = 0;
+	/// Entity indices visited by the last update.
+	std::vector<std::uint32_t> bvh_candidates_;
+	/// Entity indices of the models whose mesh is not loaded yet.
+	std::vector<std::uint32_t> pending_models_;
+
+	/// Orders the model draws of every pass to share state.
+	render_queue queue_;
+
 	std::unordered_map<entity, std::unordered_map<entity, lod_data>> lod_data_;
+	/// Tiles of every shadow map.
+	shadow_atlas shadow_atlas_;
+	/// Static casters only, redrawn when they change.
+	std::shared_ptr<gfx::frame_buffer> static_shadow_fbo_;
+	/// Static and dynamic casters, sampled by the lights.
+	std::shared_ptr<gfx::frame_buffer> shadow_fbo_;
+	/// Maps of the spot and point lights.
+	light_shadows_t local_shadows_;
+	/// Cascades of the directional lights for every camera.
+	std::unordered_map<entity, light_shadows_t> camera_shadows_;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<gpu_program> directional_light_program_;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<gpu_program> point_light_program_;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<gpu_program> spot_light_program_;
+	/// Shades all lights listed in the clusters.
+	std::unique_ptr<gpu_program> clustered_light_program_;
+	/// Unshadowed point and spot lights of the camera being lit.
+	light_clusters clusters_;
+	///
+	bool clustered_lighting_ = true;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<gpu_program> box_ref_probe_program_;
 	/// Program that is responsible for rendering.
@@ -189,6 +389,10 @@ private:
 	std::unique_ptr<gpu_program> gamma_correction_program_;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<gpu_program> atmospherics_program_;
+	/// Program that is responsible for rendering.
+	std::unique_ptr<gpu_program> shadow_program_;
+	/// Program that is responsible for rendering.
+	std::unique_ptr<gpu_program> shadow_skinned_program_;
 	///
 	asset_handle<gfx::texture> ibl_brdf_lut_;
 };
@@ -7,8 +7,6 @@ namespace runtime
 class reflection_probe_system
 {
 public:
-	reflection_probe_system();
-	~reflection_probe_system();
 	//-----------------------------------------------------------------------------
 	//  Name : frame_update (virtual )
 	/// <summary>
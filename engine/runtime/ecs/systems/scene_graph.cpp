@@ -1,44 +1,127 @@
 #include "scene_graph.h"
-#include "../../system/events.h"
 #include "../components/transform_component.h"
 
 #include <core/system/subsystem.h>
+#include <core/tasks/task_system.h>
 
 namespace runtime
 {
+namespace
+{
+const std::uint32_t npos = 0xffffffffu;
+}
 
 void scene_graph::frame_update(delta_t dt)
 {
 	auto& ecs = core::get_subsystem<runtime::entity_component_system>();
+	auto& ts = core::get_subsystem<core::task_system>();
+
+	const std::size_t grain = 1024;
+	const std::size_t capacity = ecs.capacity();
+	std::vector<std::vector<entity>> chunk_roots((capacity + grain - 1) / grain);
+	ts.parallel_for(0, capacity, grain, [&ecs, &chunk_roots, grain](std::size_t begin, std::size_t end) {
+		auto& roots = chunk_roots[begin / grain];
+		ecs.for_each_entity_in_range(begin, end, [&roots](entity e) {
+			auto transform_comp = e.get_component_ref<transform_component>();
+			if(!transform_comp || !transform_comp->get_parent().valid())
+			{
+				roots.push_back(e);
+			}
+		});
+	});
+
 	roots_.clear();
-	auto all_entities = ecs.all_entities();
-	for(const auto entity : all_entities)
+	for(const auto& roots : chunk_roots)
+	{
+		roots_.insert(std::end(roots_), std::begin(roots), std::end(roots));
+	}
+
+	if(hierarchy_version_ != transform_component::get_hierarchy_version())
 	{
-		auto transform_comp = entity.get_component<transform_component>().lock();
+		build_hierarchy();
+	}
+
+	resolve_hierarchy();
+}
+
+void scene_graph::build_hierarchy()
+{
+	hierarchy_version_ = transform_component::get_hierarchy_version();
+
+	nodes_.clear();
+	parents_.clear();
+	levels_.clear();
+
+	for(const auto& root : roots_)
+	{
+		auto transform_comp = root.get_component_ref<transform_component>().get();
 		if(transform_comp)
 		{
-			auto parent = transform_comp->get_parent();
-			if(parent.valid() == false)
-			{
-				roots_.push_back(entity);
-			}
+			nodes_.push_back(transform_comp);
+			parents_.push_back(npos);
 		}
-		else
+	}
+
+	std::size_t begin = 0;
+	levels_.push_back(begin);
+	while(begin < nodes_.size())
+	{
+		const std::size_t end = nodes_.size();
+		levels_.push_back(end);
+
+		for(std::size_t i = begin; i < end; ++i)
 		{
-			roots_.push_back(entity);
+			for(const auto& child : nodes_[i]->get_children())
+			{
+				if(!child.valid())
+				{
+					continue;
+				}
+
+				auto child_transform = child.get_component_ref<transform_component>().get();
+				if(child_transform)
+				{
+					nodes_.push_back(child_transform);
+					parents_.push_back(static_cast<std::uint32_t>(i));
+				}
+			}
 		}
+
+		begin = end;
 	}
 }
 
-scene_graph::scene_graph()
+void scene_graph::resolve_hierarchy()
 {
-	runtime::on_frame_update.connect(this, &scene_graph::frame_update);
+	auto& ts = core::get_subsystem<core::task_system>();
 
-	transform_component::static_id();
+	// Levels are resolved in order, the nodes of a level only read the
+	// already resolved world transforms of the level above.
+	for(std::size_t level = 0; level + 1 < levels_.size(); ++level)
+	{
+		ts.parallel_for(levels_[level], levels_[level + 1], 512, [this](std::size_t begin, std::size_t end) {
+			for(std::size_t i = begin; i < end; ++i)
+			{
+				auto node = nodes_[i];
+				if(!node->is_dirty())
+				{
+					continue;
+				}
+
+				const auto parent = parents_[i];
+				const math::transform* parent_transform = nullptr;
+				if(parent != npos)
+				{
+					parent_transform = &nodes_[parent]->get_transform();
+				}
+				node->resolve(parent_transform);
+			}
+		});
+	}
 }
 
-scene_graph::~scene_graph()
+scene_graph::scene_graph()
 {
-	runtime::on_frame_update.disconnect(this, &scene_graph::frame_update);
+	transform_component::static_id();
 }
 }
@@ -4,15 +4,17 @@
 
 #include <core/common/basetypes.hpp>
 
+#include <cstdint>
 #include <vector>
 
+class transform_component;
+
 namespace runtime
 {
 class scene_graph
 {
 public:
 	scene_graph();
-	~scene_graph();
 	//-----------------------------------------------------------------------------
 	//  Name : frame_update (virtual )
 	/// <summary>
@@ -37,7 +39,34 @@ public:
 	}
 
 private:
+	//-----------------------------------------------------------------------------
+	//  Name : build_hierarchy ()
+	/// <summary>
+	/// Flattens the transform hierarchies breadth first, so that every level
+	/// is a contiguous range that comes after the level of its parents.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void build_hierarchy();
+
+	//-----------------------------------------------------------------------------
+	//  Name : resolve_hierarchy ()
+	/// <summary>
+	/// Resolves the dirty world transforms one level at a time. Each level is
+	/// processed in parallel since it only reads the level above it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void resolve_hierarchy();
+
 	/// scene roots
 	std::vector<entity> roots_;
+	/// Transforms sorted by depth.
+	std::vector<transform_component*> nodes_;
+	/// Index of the parent in nodes_ for every node or npos for roots.
+	std::vector<std::uint32_t> parents_;
+	/// Offsets into nodes_ where each depth level starts, followed by the
+	/// total count.
+	std::vector<std::size_t> levels_;
+	/// Hierarchy version nodes_ was built for.
+	std::uint64_t hierarchy_version_ = std::uint64_t(-1);
 };
 }
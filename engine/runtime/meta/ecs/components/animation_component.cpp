@@ -0,0 +1,46 @@
+#include "animation_component.hpp"
+#include "component.hpp"
+
+#include "../../animation/animation.hpp"
+#include "../../assets/asset_handle.hpp"
+
+REFLECT(animation_component)
+{
+	rttr::registration::class_<animation_component>("animation_component")(
+		rttr::metadata("category", "ANIMATION"), rttr::metadata("pretty_name", "Animation"))
+		.constructor<>()(rttr::policy::ctor::as_std_shared_ptr)
+		.property("playing", &animation_component::is_playing,
+				  &animation_component::set_playing)(rttr::metadata("pretty_name", "Playing"))
+		.property("loop", &animation_component::is_looping,
+				  &animation_component::set_loop)(rttr::metadata("pretty_name", "Loop"))
+		.property("speed", &animation_component::get_speed,
+				  &animation_component::set_speed)(rttr::metadata("pretty_name", "Speed"))
+		.property("animation", &animation_component::get_animation,
+				  &animation_component::set_animation)(rttr::metadata("pretty_name", "Animation"));
+}
+
+SAVE(animation_component)
+{
+	try_save(ar, cereal::make_nvp("base_type", cereal::base_class<runtime::component>(&obj)));
+	try_save(ar, cereal::make_nvp("playing", obj.playing_));
+	try_save(ar, cereal::make_nvp("loop", obj.loop_));
+	try_save(ar, cereal::make_nvp("speed", obj.speed_));
+	const auto animation = obj.get_animation();
+	try_save(ar, cereal::make_nvp("animation", animation));
+}
+SAVE_INSTANTIATE(animation_component, cereal::oarchive_associative_t);
+SAVE_INSTANTIATE(animation_component, cereal::oarchive_binary_t);
+
+LOAD(animation_component)
+{
+	try_load(ar, cereal::make_nvp("base_type", cereal::base_class<runtime::component>(&obj)));
+	try_load(ar, cereal::make_nvp("playing", obj.playing_));
+	try_load(ar, cereal::make_nvp("loop", obj.loop_));
+	try_load(ar, cereal::make_nvp("speed", obj.speed_));
+
+	asset_handle<runtime::animation> animation;
+	try_load(ar, cereal::make_nvp("animation", animation));
+	obj.set_animation(animation);
+}
+LOAD_INSTANTIATE(animation_component, cereal::iarchive_associative_t);
+LOAD_INSTANTIATE(animation_component, cereal::iarchive_binary_t);
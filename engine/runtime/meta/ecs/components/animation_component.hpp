@@ -0,0 +1,12 @@
+#pragma once
+#include "../../../ecs/components/animation_component.h"
+#include <core/reflection/reflection.h>
+#include <core/serialization/serialization.h>
+
+REFLECT_EXTERN(animation_component);
+SAVE_EXTERN(animation_component);
+LOAD_EXTERN(animation_component);
+
+#include <core/serialization/associative_archive.h>
+#include <core/serialization/binary_archive.h>
+CEREAL_REGISTER_TYPE(animation_component)
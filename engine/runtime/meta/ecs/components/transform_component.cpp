@@ -37,17 +37,7 @@ LOAD(transform_component)
 	try_load(ar, cereal::make_nvp("local_transform", obj.local_transform_));
 	try_load(ar, cereal::make_nvp("children", obj.children_));
 
-	for(auto child : obj.children_)
-	{
-		if(child.valid())
-		{
-			auto child_transform = child.get_component<transform_component>().lock();
-			if(child_transform)
-			{
-				child_transform->parent_ = obj.get_entity();
-			}
-		}
-	}
+	obj.adopt_children();
 	obj.set_dirty(true);
 }
 LOAD_INSTANTIATE(transform_component, cereal::iarchive_associative_t);
@@ -9,11 +9,26 @@ namespace runtime
 {
 std::map<std::uint64_t, runtime::entity>& get_serialization_map()
 {
-	/// Keep count of serialized entities
-	static std::map<std::uint64_t, runtime::entity> serialization_map;
+	/// Keep count of serialized entities, per thread so that private worlds
+	/// can be loaded on workers.
+	static thread_local std::map<std::uint64_t, runtime::entity> serialization_map;
 	return serialization_map;
 }
 
+static thread_local const serialization_lookup_t* serialization_lookup = nullptr;
+
+void set_serialization_lookup(const serialization_lookup_t* lookup)
+{
+	serialization_lookup = lookup;
+}
+
+static thread_local entity_component_system* serialization_world = nullptr;
+
+void set_serialization_world(entity_component_system* world)
+{
+	serialization_world = world;
+}
+
 SAVE(entity)
 {
 	// TODO check for validity
@@ -45,7 +60,15 @@ LOAD(entity)
 
 	try_load(ar, cereal::make_nvp("entity_id", id));
 
-	if(id != entity::INVALID.id())
+	if(id != entity::INVALID.id() && serialization_lookup)
+	{
+		auto it = serialization_lookup->find(id);
+		if(it != serialization_lookup->end())
+		{
+			obj = it->second;
+		}
+	}
+	else if(id != entity::INVALID.id())
 	{
 		auto& serialization_map = get_serialization_map();
 		auto it = serialization_map.find(id);
@@ -55,7 +78,8 @@ LOAD(entity)
 		}
 		else
 		{
-			auto& ecs = core::get_subsystem<entity_component_system>();
+			auto& ecs =
+				serialization_world ? *serialization_world : core::get_subsystem<entity_component_system>();
 			obj = ecs.create();
 			serialization_map[id] = obj;
 
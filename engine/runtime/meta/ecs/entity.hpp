@@ -4,11 +4,38 @@
 #include <core/reflection/reflection.h>
 #include <core/serialization/serialization.h>
 
+#include <unordered_map>
+
 namespace runtime
 {
 
+/// Entities saved or loaded so far by the calling thread.
 std::map<std::uint64_t, runtime::entity>& get_serialization_map();
 
+/// Entities created up front for an archive whose entities only refer to
+/// each other by id.
+using serialization_lookup_t = std::unordered_map<std::uint64_t, runtime::entity>;
+
+//-----------------------------------------------------------------------------
+//  Name : set_serialization_lookup ()
+/// <summary>
+/// While set for the calling thread, loading an entity only looks its id up
+/// in the table and never creates one, so several threads can load at once.
+/// Pass nullptr to go back to the serialization map.
+/// </summary>
+//-----------------------------------------------------------------------------
+void set_serialization_lookup(const serialization_lookup_t* lookup);
+
+//-----------------------------------------------------------------------------
+//  Name : set_serialization_world ()
+/// <summary>
+/// While set for the calling thread, entities are loaded into this world
+/// instead of the entity_component_system subsystem. Pass nullptr to go
+/// back to the subsystem.
+/// </summary>
+//-----------------------------------------------------------------------------
+void set_serialization_world(entity_component_system* world);
+
 SAVE_EXTERN(entity);
 LOAD_EXTERN(entity);
 }
@@ -2,6 +2,7 @@
 
 #include "../core/math/quaternion.hpp"
 #include "../core/math/transform.hpp"
+#include "../core/math/vector.hpp"
 
 #include <core/serialization/binary_archive.h>
 
@@ -136,3 +137,75 @@ LOAD(mesh::load_data)
 	try_load(ar, cereal::make_nvp("root_node", obj.root_node));
 }
 LOAD_INSTANTIATE(mesh::load_data, cereal::iarchive_binary_t);
+
+SAVE(mesh::subset)
+{
+	try_save(ar, cereal::make_nvp("data_group_id", obj.data_group_id));
+	try_save(ar, cereal::make_nvp("vertex_start", obj.vertex_start));
+	try_save(ar, cereal::make_nvp("vertex_count", obj.vertex_count));
+	try_save(ar, cereal::make_nvp("face_start", obj.face_start));
+	try_save(ar, cereal::make_nvp("face_count", obj.face_count));
+}
+SAVE_INSTANTIATE(mesh::subset, cereal::oarchive_binary_t);
+
+LOAD(mesh::subset)
+{
+	try_load(ar, cereal::make_nvp("data_group_id", obj.data_group_id));
+	try_load(ar, cereal::make_nvp("vertex_start", obj.vertex_start));
+	try_load(ar, cereal::make_nvp("vertex_count", obj.vertex_count));
+	try_load(ar, cereal::make_nvp("face_start", obj.face_start));
+	try_load(ar, cereal::make_nvp("face_count", obj.face_count));
+}
+LOAD_INSTANTIATE(mesh::subset, cereal::iarchive_binary_t);
+
+SAVE(bone_palette)
+{
+	try_save(ar, cereal::make_nvp("bones", obj.bones_));
+	try_save(ar, cereal::make_nvp("data_group_id", obj.data_group_id_));
+	try_save(ar, cereal::make_nvp("maximum_size", obj.maximum_size_));
+	try_save(ar, cereal::make_nvp("maximum_blend_index", obj.maximum_blend_index_));
+}
+SAVE_INSTANTIATE(bone_palette, cereal::oarchive_binary_t);
+
+LOAD(bone_palette)
+{
+	std::vector<std::uint32_t> bones;
+	try_load(ar, cereal::make_nvp("bones", bones));
+	try_load(ar, cereal::make_nvp("data_group_id", obj.data_group_id_));
+	try_load(ar, cereal::make_nvp("maximum_size", obj.maximum_size_));
+	try_load(ar, cereal::make_nvp("maximum_blend_index", obj.maximum_blend_index_));
+	obj.assign_bones(bones);
+}
+LOAD_INSTANTIATE(bone_palette, cereal::iarchive_binary_t);
+
+SAVE(mesh::compiled_data)
+{
+	try_save(ar, cereal::make_nvp("vertex_format", obj.vertex_format));
+	try_save(ar, cereal::make_nvp("vertex_count", obj.vertex_count));
+	try_save(ar, cereal::make_nvp("face_count", obj.face_count));
+	try_save(ar, cereal::make_nvp("vertex_data", obj.vertex_data));
+	try_save(ar, cereal::make_nvp("index_data", obj.index_data));
+	try_save(ar, cereal::make_nvp("subsets", obj.subsets));
+	try_save(ar, cereal::make_nvp("skin_data", obj.skin_data));
+	try_save(ar, cereal::make_nvp("bone_palettes", obj.bone_palettes));
+	try_save(ar, cereal::make_nvp("bounds_min", obj.bounds.min));
+	try_save(ar, cereal::make_nvp("bounds_max", obj.bounds.max));
+	try_save(ar, cereal::make_nvp("root_node", obj.root_node));
+}
+SAVE_INSTANTIATE(mesh::compiled_data, cereal::oarchive_binary_t);
+
+LOAD(mesh::compiled_data)
+{
+	try_load(ar, cereal::make_nvp("vertex_format", obj.vertex_format));
+	try_load(ar, cereal::make_nvp("vertex_count", obj.vertex_count));
+	try_load(ar, cereal::make_nvp("face_count", obj.face_count));
+	try_load(ar, cereal::make_nvp("vertex_data", obj.vertex_data));
+	try_load(ar, cereal::make_nvp("index_data", obj.index_data));
+	try_load(ar, cereal::make_nvp("subsets", obj.subsets));
+	try_load(ar, cereal::make_nvp("skin_data", obj.skin_data));
+	try_load(ar, cereal::make_nvp("bone_palettes", obj.bone_palettes));
+	try_load(ar, cereal::make_nvp("bounds_min", obj.bounds.min));
+	try_load(ar, cereal::make_nvp("bounds_max", obj.bounds.max));
+	try_load(ar, cereal::make_nvp("root_node", obj.root_node));
+}
+LOAD_INSTANTIATE(mesh::compiled_data, cereal::iarchive_binary_t);
@@ -29,3 +29,12 @@ LOAD_EXTERN(mesh::armature_node);
 
 SAVE_EXTERN(mesh::load_data);
 LOAD_EXTERN(mesh::load_data);
+
+SAVE_EXTERN(mesh::subset);
+LOAD_EXTERN(mesh::subset);
+
+SAVE_EXTERN(bone_palette);
+LOAD_EXTERN(bone_palette);
+
+SAVE_EXTERN(mesh::compiled_data);
+LOAD_EXTERN(mesh::compiled_data);
@@ -3,6 +3,7 @@
 #include "../assets/asset_handle.h"
 
 #include <core/graphics/program.h>
+#include <core/graphics/uniform.h>
 #include <core/math/math_includes.h>
 #include <core/reflection/registration.h>
 #include <core/serialization/serialization.h>
@@ -81,6 +82,27 @@ public:
 	void set_uniform(const std::string& _name, const math::vec3& _value, std::uint16_t _num = 1);
 	void set_uniform(const std::string& _name, const math::vec2& _value, std::uint16_t _num = 1);
 
+	//-----------------------------------------------------------------------------
+	//  Name : set_uniform ()
+	/// <summary>
+	/// Sets a uniform found by its precomputed id. Values the uniform already
+	/// holds in this frame are not set again.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_uniform(const gfx::uniform_id& _id, const void* _value, std::uint16_t _num = 1);
+	void set_uniform(const gfx::uniform_id& _id, const math::vec4& _value, std::uint16_t _num = 1);
+	void set_uniform(const gfx::uniform_id& _id, const math::vec3& _value, std::uint16_t _num = 1);
+	void set_uniform(const gfx::uniform_id& _id, const math::vec2& _value, std::uint16_t _num = 1);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_texture ()
+	/// <summary>
+	/// Binds a texture to a sampler found by its precomputed id.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_texture(std::uint8_t _stage, const gfx::uniform_id& _sampler, gfx::texture* _texture,
+					 std::uint32_t _flags = std::numeric_limits<std::uint32_t>::max());
+
 	//-----------------------------------------------------------------------------
 	//  Name : get_uniform ()
 	/// <summary>
@@ -0,0 +1,264 @@
+#include "light_clusters.h"
+#include "camera.h"
+
+#include <core/common/platform/config.hpp>
+
+#include <algorithm>
+
+#if ETH_ON(ETH_SIMD_SSE) || ETH_ON(ETH_SIMD_AVX)
+#include <immintrin.h>
+#elif ETH_ON(ETH_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+enum bounds_component
+{
+	min_x,
+	min_y,
+	min_z,
+	max_x,
+	max_y,
+	max_z
+};
+
+// Bit i of the result is set when the sphere touches box first + i. The
+// distance from the center to a box is the length of how far it lies
+// outside of the box on every axis.
+#if ETH_ON(ETH_SIMD_SSE) || ETH_ON(ETH_SIMD_AVX)
+std::uint32_t test_sphere(const std::array<std::vector<float>, 6>& bounds, std::size_t first,
+						  const math::vec3& center, float radius_sqr)
+{
+	const auto zero = _mm_setzero_ps();
+	const auto cx = _mm_set1_ps(center.x);
+	const auto cy = _mm_set1_ps(center.y);
+	const auto cz = _mm_set1_ps(center.z);
+
+	const auto dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds[min_x][first]), cx),
+										  _mm_sub_ps(cx, _mm_loadu_ps(&bounds[max_x][first]))),
+							   zero);
+	const auto dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds[min_y][first]), cy),
+										  _mm_sub_ps(cy, _mm_loadu_ps(&bounds[max_y][first]))),
+							   zero);
+	const auto dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&bounds[min_z][first]), cz),
+										  _mm_sub_ps(cz, _mm_loadu_ps(&bounds[max_z][first]))),
+							   zero);
+
+	auto distance_sqr = _mm_mul_ps(dx, dx);
+	distance_sqr = _mm_add_ps(distance_sqr, _mm_mul_ps(dy, dy));
+	distance_sqr = _mm_add_ps(distance_sqr, _mm_mul_ps(dz, dz));
+	return std::uint32_t(_mm_movemask_ps(_mm_cmple_ps(distance_sqr, _mm_set1_ps(radius_sqr))));
+}
+#elif ETH_ON(ETH_SIMD_NEON)
+std::uint32_t test_sphere(const std::array<std::vector<float>, 6>& bounds, std::size_t first,
+						  const math::vec3& center, float radius_sqr)
+{
+	const auto zero = vdupq_n_f32(0.0f);
+	const auto cx = vdupq_n_f32(center.x);
+	const auto cy = vdupq_n_f32(center.y);
+	const auto cz = vdupq_n_f32(center.z);
+
+	const auto dx = vmaxq_f32(vmaxq_f32(vsubq_f32(vld1q_f32(&bounds[min_x][first]), cx),
+										 vsubq_f32(cx, vld1q_f32(&bounds[max_x][first]))),
+							   zero);
+	const auto dy = vmaxq_f32(vmaxq_f32(vsubq_f32(vld1q_f32(&bounds[min_y][first]), cy),
+										 vsubq_f32(cy, vld1q_f32(&bounds[max_y][first]))),
+							   zero);
+	const auto dz = vmaxq_f32(vmaxq_f32(vsubq_f32(vld1q_f32(&bounds[min_z][first]), cz),
+										 vsubq_f32(cz, vld1q_f32(&bounds[max_z][first]))),
+							   zero);
+
+	auto distance_sqr = vmulq_f32(dx, dx);
+	distance_sqr = vmlaq_f32(distance_sqr, dy, dy);
+	distance_sqr = vmlaq_f32(distance_sqr, dz, dz);
+	const auto mask = vcleq_f32(distance_sqr, vdupq_n_f32(radius_sqr));
+	return (vgetq_lane_u32(mask, 0) & 1u) | (vgetq_lane_u32(mask, 1) & 2u) | (vgetq_lane_u32(mask, 2) & 4u) |
+		   (vgetq_lane_u32(mask, 3) & 8u);
+}
+#else
+std::uint32_t test_sphere(const std::array<std::vector<float>, 6>& bounds, std::size_t first,
+						  const math::vec3& center, float radius_sqr)
+{
+	std::uint32_t result = 0;
+	for(std::size_t i = 0; i < 4; ++i)
+	{
+		const auto box = first + i;
+		const float dx =
+			std::max(std::max(bounds[min_x][box] - center.x, center.x - bounds[max_x][box]), 0.0f);
+		const float dy =
+			std::max(std::max(bounds[min_y][box] - center.y, center.y - bounds[max_y][box]), 0.0f);
+		const float dz =
+			std::max(std::max(bounds[min_z][box] - center.z, center.z - bounds[max_z][box]), 0.0f);
+		if(dx * dx + dy * dy + dz * dz <= radius_sqr)
+		{
+			result |= 1u << i;
+		}
+	}
+	return result;
+}
+#endif
+}
+
+static_assert(light_clusters::tiles_x % 4 == 0, "Rows of clusters are tested four at a time.");
+
+void light_clusters::clear()
+{
+	lights_.clear();
+}
+
+bool light_clusters::add_light(const cluster_light& light)
+{
+	if(lights_.size() >= max_lights)
+	{
+		return false;
+	}
+
+	lights_.emplace_back(light);
+	return true;
+}
+
+void light_clusters::update_bounds(float near_clip, float far_clip, float half_width, float half_height,
+								   bool perspective)
+{
+	const math::vec4 key(near_clip, far_clip, half_width, half_height);
+	if(!bounds_[min_x].empty() && key == bounds_key_ && perspective == bounds_perspective_)
+	{
+		return;
+	}
+	bounds_key_ = key;
+	bounds_perspective_ = perspective;
+
+	for(auto& component : bounds_)
+	{
+		component.resize(cluster_count);
+	}
+
+	const float depth_ratio = far_clip / near_clip;
+	for(std::uint32_t k = 0; k < slices; ++k)
+	{
+		const float z0 = near_clip * math::pow(depth_ratio, float(k) / float(slices));
+		const float z1 = near_clip * math::pow(depth_ratio, float(k + 1) / float(slices));
+		for(std::uint32_t j = 0; j < tiles_y; ++j)
+		{
+			const float y0 = (-1.0f + 2.0f * float(j) / float(tiles_y)) * half_height;
+			const float y1 = (-1.0f + 2.0f * float(j + 1) / float(tiles_y)) * half_height;
+			for(std::uint32_t i = 0; i < tiles_x; ++i)
+			{
+				const float x0 = (-1.0f + 2.0f * float(i) / float(tiles_x)) * half_width;
+				const float x1 = (-1.0f + 2.0f * float(i + 1) / float(tiles_x)) * half_width;
+				const auto cluster = (k * tiles_y + j) * tiles_x + i;
+
+				// A perspective tile widens with the depth.
+				const float near_scale = perspective ? z0 : 1.0f;
+				const float far_scale = perspective ? z1 : 1.0f;
+				bounds_[min_x][cluster] = std::min(x0 * near_scale, x0 * far_scale);
+				bounds_[max_x][cluster] = std::max(x1 * near_scale, x1 * far_scale);
+				bounds_[min_y][cluster] = std::min(y0 * near_scale, y0 * far_scale);
+				bounds_[max_y][cluster] = std::max(y1 * near_scale, y1 * far_scale);
+				bounds_[min_z][cluster] = z0;
+				bounds_[max_z][cluster] = z1;
+			}
+		}
+	}
+}
+
+void light_clusters::build(const camera& cam)
+{
+	const bool perspective = cam.get_projection_mode() == projection_mode::perspective;
+	const float near_clip = math::max(cam.get_near_clip(), 0.001f);
+	const float far_clip = math::max(cam.get_far_clip(), near_clip * 1.01f);
+	const float half_height =
+		perspective ? math::tan(math::radians(cam.get_fov()) * 0.5f) : cam.get_ortho_size();
+	const float half_width = half_height * cam.get_aspect_ratio();
+	update_bounds(near_clip, far_clip, half_width, half_height, perspective);
+
+	const auto position = cam.get_position();
+	const auto x_axis = cam.x_unit_axis();
+	const auto y_axis = cam.y_unit_axis();
+	const auto z_axis = cam.z_unit_axis();
+	const float slice_scale = float(slices) / math::log(far_clip / near_clip);
+	const float slice_bias = -math::log(near_clip) * slice_scale;
+
+	view_params_[0] = math::vec4(x_axis, 0.0f);
+	view_params_[1] = math::vec4(y_axis, 0.0f);
+	view_params_[2] = math::vec4(z_axis, 0.0f);
+	view_params_[3] = math::vec4(position, 1.0f);
+	projection_params_ = math::vec4(1.0f / half_width, 1.0f / half_height, perspective ? 1.0f : 0.0f, 0.0f);
+	depth_params_ = math::vec4(slice_scale, slice_bias, near_clip, far_clip);
+
+	const auto get_slice = [slice_scale, slice_bias](float depth) {
+		const float slice = math::floor(math::log(depth) * slice_scale + slice_bias);
+		return std::uint32_t(math::clamp(slice, 0.0f, float(slices - 1)));
+	};
+
+	overlap_clusters_.clear();
+	overlap_lights_.clear();
+	for(std::uint32_t l = 0; l < std::uint32_t(lights_.size()); ++l)
+	{
+		const auto& light = lights_[l];
+		const float range = light.position_range.w;
+		const auto to_light = math::vec3(light.position_range) - position;
+		const math::vec3 center(math::dot(to_light, x_axis), math::dot(to_light, y_axis),
+								math::dot(to_light, z_axis));
+		if(center.z + range < near_clip || center.z - range > far_clip)
+		{
+			continue;
+		}
+
+		const auto first_slice = get_slice(math::max(center.z - range, near_clip));
+		const auto last_slice = get_slice(math::min(center.z + range, far_clip));
+		const float range_sqr = range * range;
+		for(auto k = first_slice; k <= last_slice; ++k)
+		{
+			for(std::uint32_t j = 0; j < tiles_y; ++j)
+			{
+				const auto row = (k * tiles_y + j) * tiles_x;
+				for(std::uint32_t i = 0; i < tiles_x; i += 4)
+				{
+					const auto mask = test_sphere(bounds_, row + i, center, range_sqr);
+					for(std::uint32_t bit = 0; bit < 4; ++bit)
+					{
+						if(mask & (1u << bit))
+						{
+							overlap_clusters_.emplace_back(row + i + bit);
+							overlap_lights_.emplace_back(l);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Counting sort of the overlaps by cluster, the lights of a cluster
+	// keep their order.
+	counts_.assign(cluster_count, 0);
+	for(const auto cluster : overlap_clusters_)
+	{
+		++counts_[cluster];
+	}
+
+	grid_.resize(cluster_count * 2);
+	std::uint32_t offset = 0;
+	for(std::uint32_t c = 0; c < cluster_count; ++c)
+	{
+		const auto count = std::min(counts_[c], max_indices - offset);
+		grid_[c * 2 + 0] = float(offset);
+		grid_[c * 2 + 1] = float(count);
+		// From here on the count is where the next light of the cluster goes.
+		counts_[c] = offset;
+		offset += count;
+	}
+
+	indices_.resize(offset);
+	for(std::size_t i = 0; i < overlap_clusters_.size(); ++i)
+	{
+		const auto cluster = overlap_clusters_[i];
+		const auto end = std::uint32_t(grid_[cluster * 2 + 0] + grid_[cluster * 2 + 1]);
+		auto& next = counts_[cluster];
+		if(next < end)
+		{
+			indices_[next++] = float(overlap_lights_[i]);
+		}
+	}
+}
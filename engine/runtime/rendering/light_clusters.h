@@ -0,0 +1,147 @@
+#pragma once
+
+#include <core/math/math_includes.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class camera;
+
+//-----------------------------------------------------------------------------
+//  Name : cluster_light (Struct)
+/// <summary>
+/// A light as the clustered lighting shader reads it, one texel per member.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct cluster_light
+{
+	/// Position and range.
+	math::vec4 position_range;
+	/// Color and intensity.
+	math::vec4 color_intensity;
+	/// Direction and type, 0 for point and 1 for spot lights.
+	math::vec4 direction_type;
+	/// Exponent falloff of point lights, cosines of the half inner and
+	/// outer angles of spot lights.
+	math::vec4 data;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : light_clusters (Class)
+/// <summary>
+/// Splits the view of a camera in screen tiles and exponential depth slices
+/// and lists the lights which reach every cluster so that all of them can
+/// be shaded in a single pass. The clusters of a row are tested four at a
+/// time against the bounding sphere of a light.
+/// </summary>
+//-----------------------------------------------------------------------------
+class light_clusters
+{
+public:
+	/// Must match fs_deferred_clustered_light.sc.
+	static constexpr std::uint32_t tiles_x = 16;
+	static constexpr std::uint32_t tiles_y = 9;
+	static constexpr std::uint32_t slices = 24;
+	static constexpr std::uint32_t cluster_count = tiles_x * tiles_y * slices;
+	static constexpr std::uint32_t max_lights = 4096;
+	/// The light indices are laid out in rows of this many texels.
+	static constexpr std::uint32_t index_width = 1024;
+	static constexpr std::uint32_t index_height = 64;
+	static constexpr std::uint32_t max_indices = index_width * index_height;
+
+	//-----------------------------------------------------------------------------
+	//  Name : clear ()
+	/// <summary>
+	/// Removes every light.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void clear();
+
+	//-----------------------------------------------------------------------------
+	//  Name : add_light ()
+	/// <summary>
+	/// Adds a light to the next build. Returns false when there is no room
+	/// left for it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool add_light(const cluster_light& light);
+
+	//-----------------------------------------------------------------------------
+	//  Name : build ()
+	/// <summary>
+	/// Lists the lights of every cluster of the camera. Lights beyond the
+	/// capacity of the index list are dropped from the clusters listed last.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void build(const camera& cam);
+
+	bool empty() const
+	{
+		return lights_.empty();
+	}
+
+	const std::vector<cluster_light>& get_lights() const
+	{
+		return lights_;
+	}
+
+	/// First index and light count of every cluster.
+	const std::vector<float>& get_grid() const
+	{
+		return grid_;
+	}
+
+	const std::vector<float>& get_indices() const
+	{
+		return indices_;
+	}
+
+	/// Camera x, y and z axis and position the clusters are built in.
+	const std::array<math::vec4, 4>& get_view_params() const
+	{
+		return view_params_;
+	}
+
+	/// Scale from view space to the screen, whether the scale is divided by
+	/// the depth.
+	const math::vec4& get_projection_params() const
+	{
+		return projection_params_;
+	}
+
+	/// Slice of a depth is floor(log(depth) * x + y), z and w are the near
+	/// and far clip.
+	const math::vec4& get_depth_params() const
+	{
+		return depth_params_;
+	}
+
+private:
+	//-----------------------------------------------------------------------------
+	//  Name : update_bounds ()
+	/// <summary>
+	/// Recomputes the view space boxes of the clusters when the projection
+	/// changed.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update_bounds(float near_clip, float far_clip, float half_width, float half_height,
+					   bool perspective);
+
+	std::vector<cluster_light> lights_;
+	std::vector<float> grid_;
+	std::vector<float> indices_;
+	/// Cluster and light of every overlap found by the last build.
+	std::vector<std::uint32_t> overlap_clusters_;
+	std::vector<std::uint32_t> overlap_lights_;
+	std::vector<std::uint32_t> counts_;
+
+	/// View space boxes of the clusters, one array per component.
+	std::array<std::vector<float>, 6> bounds_;
+	math::vec4 bounds_key_ = math::vec4(0.0f);
+	bool bounds_perspective_ = false;
+
+	std::array<math::vec4, 4> view_params_;
+	math::vec4 projection_params_;
+	math::vec4 depth_params_;
+};
@@ -7,6 +7,21 @@
 #include <core/graphics/uniform.h>
 #include <core/system/subsystem.h>
 
+namespace
+{
+const gfx::uniform_id u_base_color("u_base_color");
+const gfx::uniform_id u_subsurface_color("u_subsurface_color");
+const gfx::uniform_id u_emissive_color("u_emissive_color");
+const gfx::uniform_id u_surface_data("u_surface_data");
+const gfx::uniform_id u_tiling("u_tiling");
+const gfx::uniform_id u_dither_threshold("u_dither_threshold");
+const gfx::uniform_id s_tex_color("s_tex_color");
+const gfx::uniform_id s_tex_normal("s_tex_normal");
+const gfx::uniform_id s_tex_roughness("s_tex_roughness");
+const gfx::uniform_id s_tex_metalness("s_tex_metalness");
+const gfx::uniform_id s_tex_ao("s_tex_ao");
+}
+
 material::material()
 {
 	auto& am = core::get_subsystem<runtime::asset_manager>();
@@ -41,6 +56,10 @@ void material::set_uniform(const std::string& _name, const void* _value, std::ui
 
 gpu_program* material::get_program() const
 {
+	if(instanced)
+	{
+		return program_instanced_.get();
+	}
 	return skinned ? program_skinned_.get() : program_.get();
 }
 
@@ -75,6 +94,9 @@ standard_material::standard_material()
 	vs_deferred_geom.wait();
 	auto vs_deferred_geom_skinned = am.load<gfx::shader>("engine:/data/shaders/vs_deferred_geom_skinned.sc");
 	vs_deferred_geom_skinned.wait();
+	auto vs_deferred_geom_instanced =
+		am.load<gfx::shader>("engine:/data/shaders/vs_deferred_geom_instanced.sc");
+	vs_deferred_geom_instanced.wait();
 	auto fs_deferred_geom = am.load<gfx::shader>("engine:/data/shaders/fs_deferred_geom.sc");
 	fs_deferred_geom.wait();
 	auto f = ts.push_or_execute_on_owner_thread(
@@ -91,8 +113,16 @@ standard_material::standard_material()
 		},
 		vs_deferred_geom_skinned, fs_deferred_geom);
 
+	auto f2 = ts.push_or_execute_on_owner_thread(
+		[this](asset_handle<gfx::shader> vs, asset_handle<gfx::shader> fs) {
+			program_instanced_ = std::make_unique<gpu_program>(vs, fs);
+
+		},
+		vs_deferred_geom_instanced, fs_deferred_geom);
+
 	futures_.emplace_back(std::move(f));
 	futures_.emplace_back(std::move(f1));
+	futures_.emplace_back(std::move(f2));
 }
 
 standard_material::~standard_material()
@@ -108,12 +138,12 @@ void standard_material::submit()
 	if(!is_valid())
 		return;
 
-	get_program()->set_uniform("u_base_color", &base_color_);
-	get_program()->set_uniform("u_subsurface_color", &subsurface_color_);
-	get_program()->set_uniform("u_emissive_color", &emissive_color_);
-	get_program()->set_uniform("u_surface_data", &surface_data_);
-	get_program()->set_uniform("u_tiling", &tiling_);
-	get_program()->set_uniform("u_dither_threshold", &dither_threshold_);
+	get_program()->set_uniform(u_base_color, &base_color_);
+	get_program()->set_uniform(u_subsurface_color, &subsurface_color_);
+	get_program()->set_uniform(u_emissive_color, &emissive_color_);
+	get_program()->set_uniform(u_surface_data, surface_data_);
+	get_program()->set_uniform(u_tiling, tiling_);
+	get_program()->set_uniform(u_dither_threshold, dither_threshold_);
 
 	const auto& color_map = maps_["color"];
 	const auto& normal_map = maps_["normal"];
@@ -127,9 +157,9 @@ void standard_material::submit()
 	auto metalness = metalness_map ? metalness_map : default_color_map_;
 	auto ao = ao_map ? ao_map : default_color_map_;
 
-	get_program()->set_texture(0, "s_tex_color", albedo.get());
-	get_program()->set_texture(1, "s_tex_normal", normal.get());
-	get_program()->set_texture(2, "s_tex_roughness", roughness.get());
-	get_program()->set_texture(3, "s_tex_metalness", metalness.get());
-	get_program()->set_texture(4, "s_tex_ao", ao.get());
+	get_program()->set_texture(0, s_tex_color, albedo.get());
+	get_program()->set_texture(1, s_tex_normal, normal.get());
+	get_program()->set_texture(2, s_tex_roughness, roughness.get());
+	get_program()->set_texture(3, s_tex_metalness, metalness.get());
+	get_program()->set_texture(4, s_tex_ao, ao.get());
 }
@@ -155,13 +155,28 @@ public:
 	std::uint64_t get_render_states(bool apply_cull = true, bool depth_write = true,
 									bool depth_test = true) const;
 
+	//-----------------------------------------------------------------------------
+	//  Name : supports_instancing ()
+	/// <summary>
+	/// Checks whether the material has a program that reads the world
+	/// transform from per instance data.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline bool supports_instancing() const
+	{
+		return program_instanced_ != nullptr;
+	}
+
 	bool skinned = false;
+	bool instanced = false;
 
 protected:
 	/// Program that is responsible for rendering.
 	std::unique_ptr<gpu_program> program_;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<gpu_program> program_skinned_;
+	/// Program that is responsible for rendering instances.
+	std::unique_ptr<gpu_program> program_instanced_;
 	/// Cull type for this material.
 	cull_type cull_type_ = cull_type::counter_clockwise;
 	/// Default color texture
@@ -1336,6 +1336,113 @@ void mesh::build_ib(bool hardware_copy)
 	} // End if hardware buffer required
 }
 
+constexpr std::uint32_t mesh::compiled_data::tag;
+
+static std::unique_ptr<mesh::armature_node> clone_armature(const mesh::armature_node& node)
+{
+	auto result = std::make_unique<mesh::armature_node>();
+	result->name = node.name;
+	result->local_transform = node.local_transform;
+	result->children.reserve(node.children.size());
+	for(const auto& child : node.children)
+	{
+		if(child)
+			result->children.emplace_back(clone_armature(*child));
+	}
+	return result;
+}
+
+bool mesh::load_compiled(compiled_data& data)
+{
+	// Validate the data before touching the current state.
+	const std::size_t vertex_size = std::size_t(data.vertex_count) * data.vertex_format.getStride();
+	const std::size_t index_size = std::size_t(data.face_count) * 3;
+	if(data.vertex_count == 0 || data.face_count == 0 || data.vertex_data.size() != vertex_size ||
+	   data.index_data.size() != index_size)
+	{
+		APPLOG_ERROR("Compiled mesh data is incomplete.");
+		return false;
+	}
+
+	for(const auto& sub : data.subsets)
+	{
+		if(sub.face_start < 0 || std::size_t(sub.face_start) + sub.face_count > data.face_count)
+		{
+			APPLOG_ERROR("Compiled mesh data contains an invalid subset.");
+			return false;
+		}
+	}
+
+	dispose();
+
+	vertex_format_ = data.vertex_format;
+	vertex_count_ = data.vertex_count;
+	face_count_ = data.face_count;
+
+	system_vb_ = new std::uint8_t[vertex_size];
+	memcpy(system_vb_, data.vertex_data.data(), vertex_size);
+	system_ib_ = new std::uint32_t[index_size];
+	memcpy(system_ib_, data.index_data.data(), index_size * sizeof(std::uint32_t));
+
+	// Subsets are stored in their final order, so only the look up tables
+	// need to be rebuilt.
+	triangle_data_.resize(face_count_);
+	for(const auto& src : data.subsets)
+	{
+		auto* sub = new subset(src);
+		mesh_subsets_.push_back(sub);
+		subset_lookup_[mesh_subset_key(sub->data_group_id)] = sub;
+		data_groups_[sub->data_group_id].push_back(sub);
+
+		auto fstart = static_cast<std::uint32_t>(sub->face_start);
+		for(std::uint32_t j = fstart; j < (fstart + sub->face_count); ++j)
+		{
+			triangle_data_[j].data_group_id = sub->data_group_id;
+		}
+	}
+
+	skin_bind_data_ = std::move(data.skin_data);
+	bone_palettes_ = std::move(data.bone_palettes);
+	root_ = std::move(data.root_node);
+	bbox_ = data.bounds;
+
+	prepare_status_ = mesh_status::prepared;
+	hardware_mesh_ = true;
+	optimize_mesh_ = false;
+
+	return true;
+}
+
+bool mesh::get_compiled(compiled_data& data) const
+{
+	if(prepare_status_ != mesh_status::prepared)
+		return false;
+
+	const std::size_t vertex_size = std::size_t(vertex_count_) * vertex_format_.getStride();
+	const std::size_t index_size = std::size_t(face_count_) * 3;
+
+	data.vertex_format = vertex_format_;
+	data.vertex_count = vertex_count_;
+	data.face_count = face_count_;
+	data.vertex_data.assign(system_vb_, system_vb_ + vertex_size);
+	data.index_data.assign(system_ib_, system_ib_ + index_size);
+
+	data.subsets.clear();
+	data.subsets.reserve(mesh_subsets_.size());
+	for(const auto* sub : mesh_subsets_)
+	{
+		if(sub != nullptr)
+			data.subsets.emplace_back(*sub);
+	}
+
+	data.skin_data = skin_bind_data_;
+	data.bone_palettes = bone_palettes_;
+	data.bounds = bbox_;
+	data.root_node = root_ ? clone_armature(*root_) : nullptr;
+
+	return true;
+}
+
 bool mesh::sort_mesh_data(bool optimize, bool hardware_copy, bool build_buffer)
 {
 	std::map<mesh_subset_key, std::uint32_t> subset_sizes;
@@ -2972,6 +3079,17 @@ const skin_bind_data::bone_influence* skin_bind_data::find_bone_by_id(const std:
 //-----------------------------------------------------------------------------
 //  Name : bone_palette() (Constructor)
 /// <summary>
+/// Default constructor, used when palettes are deserialized.
+/// </summary>
+//-----------------------------------------------------------------------------
+bone_palette::bone_palette()
+	: bone_palette(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//  Name : bone_palette () (Constructor)
+/// <summary>
 /// Class constructor.
 /// </summary>
 //-----------------------------------------------------------------------------
@@ -203,6 +203,7 @@ private:
 //-----------------------------------------------------------------------------
 class bone_palette
 {
+	SERIALIZABLE(bone_palette)
 public:
 	//-------------------------------------------------------------------------
 	// Public Typedefs, Structures & Enumerations
@@ -211,6 +212,7 @@ public:
 	//-------------------------------------------------------------------------
 	// Constructors & Destructors
 	//-------------------------------------------------------------------------
+	bone_palette();
 	bone_palette(std::uint32_t paletteSize);
 	bone_palette(const bone_palette& init);
 	~bone_palette();
@@ -430,6 +432,35 @@ public:
 		std::unique_ptr<armature_node> root_node = nullptr;
 	};
 
+	// Ready to upload mesh data, already welded, sorted and skinned so that
+	// loading it only has to create the gpu buffers.
+	struct compiled_data
+	{
+		/// Written in front of the compiled data to tell it apart from load_data.
+		static constexpr std::uint32_t tag = 0x3148534d; // "MSH1"
+
+		/// The final vertex format.
+		gfx::vertex_layout vertex_format;
+		/// Total number of vertices.
+		std::uint32_t vertex_count = 0;
+		/// Total number of faces.
+		std::uint32_t face_count = 0;
+		/// Final interleaved vertex data.
+		std::vector<std::uint8_t> vertex_data;
+		/// Final index data sorted by subset.
+		std::vector<std::uint32_t> index_data;
+		/// Subset table in index buffer order.
+		std::vector<subset> subsets;
+		/// Skin data without the per vertex influences.
+		skin_bind_data skin_data;
+		/// Bone palettes built when the skin was bound.
+		bone_palette_array_t bone_palettes;
+		/// Bounds of the vertex data.
+		math::bbox bounds;
+		/// Imported nodes
+		std::unique_ptr<armature_node> root_node = nullptr;
+	};
+
 	//-------------------------------------------------------------------------
 	// Constructors & Destructors
 	//-------------------------------------------------------------------------
@@ -638,6 +669,23 @@ public:
 	bool end_prepare(bool hardware_copy = true, bool weld = true, bool optimize = true,
 					 bool build_buffers = true);
 
+	//-----------------------------------------------------------------------------
+	//  Name : load_compiled ()
+	/// <summary>
+	/// Takes over data produced by get_compiled. No sorting or vertex
+	/// processing is done, so only the buffers are left to be built.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool load_compiled(compiled_data& data);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_compiled ()
+	/// <summary>
+	/// Copies the data of a prepared mesh into its ready to upload form.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool get_compiled(compiled_data& data) const;
+
 	//-----------------------------------------------------------------------------
 	//  Name : build_vb ()
 	/// <summary>
@@ -2,12 +2,16 @@
 #include "gpu_program.h"
 #include "material.h"
 #include "mesh.h"
+#include "render_queue.h"
 
 #include "../assets/asset_manager.h"
 
 #include <core/math/math_includes.h>
 #include <core/system/subsystem.h>
 
+#include <algorithm>
+#include <cstring>
+
 model::model()
 {
 	auto& am = core::get_subsystem<runtime::asset_manager>();
@@ -130,8 +134,17 @@ void model::set_lod_limits(const std::vector<urange32_t>& limits)
 	lod_limits_ = limits;
 }
 
+// The skinning transforms come from the bind data of the first lod, a
+// palette of another lod may reference bones it does not have.
+static bool fits_palette(const std::vector<std::uint32_t>& bones,
+						 const std::vector<math::transform::mat4_t>& skinning_transforms)
+{
+	return std::all_of(std::begin(bones), std::end(bones),
+					   [&](std::uint32_t bone) { return bone < skinning_transforms.size(); });
+}
+
 void model::render(gfx::view_id id, const math::transform& world_transform,
-				   const std::vector<math::transform>& bone_transforms, bool apply_cull, bool depth_write,
+				   const std::vector<math::transform::mat4_t>& skinning_transforms, bool apply_cull, bool depth_write,
 				   bool depth_test, std::uint64_t extra_states, unsigned int lod, gpu_program* user_program,
 				   std::function<void(gpu_program&)> setup_params) const
 {
@@ -142,9 +155,9 @@ void model::render(gfx::view_id id, const math::transform& world_transform,
 	}
 
 	auto render_subset = [this, &mesh](gfx::view_id id, bool skinned, std::uint32_t group_id,
-									   const std::vector<math::transform>& matrices, bool apply_cull,
-									   bool depth_write, bool depth_test, std::uint64_t extra_states,
-									   gpu_program* user_program,
+									   const math::transform::mat4_t* matrices, const std::uint32_t* indices,
+									   std::uint16_t matrix_count, bool apply_cull, bool depth_write,
+									   bool depth_test, std::uint64_t extra_states, gpu_program* user_program,
 									   std::function<void(gpu_program&)> setup_params) {
 
 		bool valid_program = false;
@@ -154,6 +167,7 @@ void model::render(gfx::view_id id, const math::transform& world_transform,
 		if(mat)
 		{
 			mat->skinned = skinned;
+			mat->instanced = false;
 			if(user_program == nullptr)
 			{
 				program = mat->get_program();
@@ -181,16 +195,17 @@ void model::render(gfx::view_id id, const math::transform& world_transform,
 				extra_states |= mat->get_render_states(apply_cull, depth_write, depth_test);
 			}
 
-			if(!matrices.empty())
+			if(matrix_count > 0)
 			{
-				using mat_type = math::transform::mat4_t;
-				std::vector<mat_type> mats;
-				mats.reserve(matrices.size());
-				for(const auto& m : matrices)
+				// Written straight to the transform cache of the frame.
+				gfx::transform transforms;
+				const auto cache = gfx::alloc_transform(&transforms, matrix_count);
+				for(std::uint16_t i = 0; i < matrix_count; ++i)
 				{
-					mats.emplace_back(m.get_matrix());
+					const auto& m = indices != nullptr ? matrices[indices[i]] : matrices[i];
+					std::memcpy(transforms.data + i * 16, math::value_ptr(m), sizeof(m));
 				}
-				gfx::set_transform(mats.data(), static_cast<std::uint16_t>(mats.size()));
+				gfx::set_transform(cache, matrix_count);
 			}
 
 			gfx::set_state(extra_states);
@@ -210,18 +225,22 @@ void model::render(gfx::view_id id, const math::transform& world_transform,
 	const auto& skin_data = mesh->get_skin_bind_data();
 
 	// Has skinning data?
-	if(skin_data.has_bones() && !bone_transforms.empty())
+	if(skin_data.has_bones() && !skinning_transforms.empty())
 	{
 		// Process each palette in the skin with a matching attribute.
 		const auto& palettes = mesh->get_bone_palettes();
 		for(const auto& palette : palettes)
 		{
 			// Apply the bone palette.
-			auto skinning_matrices = palette.get_skinning_matrices(bone_transforms, skin_data, false);
-			// auto max_blend_index = palette.get_maximum_blend_index();
+			const auto& bones = palette.get_bones();
+			if(!fits_palette(bones, skinning_transforms))
+			{
+				continue;
+			}
 
 			auto data_group = palette.get_data_group();
-			render_subset(id, true, data_group, skinning_matrices, apply_cull, depth_write, depth_test,
+			render_subset(id, true, data_group, skinning_transforms.data(), bones.data(),
+						  static_cast<std::uint16_t>(bones.size()), apply_cull, depth_write, depth_test,
 						  extra_states, user_program, setup_params);
 
 		} // Next Palette
@@ -230,12 +249,132 @@ void model::render(gfx::view_id id, const math::transform& world_transform,
 	{
 		for(std::size_t i = 0; i < mesh->get_subset_count(); ++i)
 		{
-			render_subset(id, false, std::uint32_t(i), {world_transform}, apply_cull, depth_write, depth_test,
-						  extra_states, user_program, setup_params);
+			render_subset(id, false, std::uint32_t(i), &world_transform.get_matrix(), nullptr, 1, apply_cull,
+						  depth_write, depth_test, extra_states, user_program, setup_params);
+		}
+	}
+}
+
+bool model::supports_instancing(unsigned int lod) const
+{
+	const auto mesh = get_lod(lod);
+	if(!mesh)
+	{
+		return false;
+	}
+
+	if(mesh->get_skin_bind_data().has_bones())
+	{
+		return false;
+	}
+
+	for(std::size_t i = 0; i < mesh->get_subset_count(); ++i)
+	{
+		const auto mat = get_material_for_group(i);
+		if(!mat || !mat->supports_instancing())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void model::enqueue(render_queue& queue, gfx::view_id id, std::uint8_t pass,
+					const math::transform& world_transform,
+					const std::vector<math::transform::mat4_t>& skinning_transforms, bool apply_cull,
+					bool depth_write, bool depth_test, std::uint64_t extra_states, unsigned int lod,
+					const math::vec4& params, float depth) const
+{
+	const auto mesh = get_lod(lod);
+	if(!mesh)
+	{
+		return;
+	}
+
+	auto enqueue_subset = [&](bool skinned, std::uint32_t group_id, const math::transform::mat4_t* matrices,
+							  const std::uint32_t* indices, std::uint16_t matrix_count) {
+		asset_handle<material> mat = get_material_for_group(group_id);
+		if(!mat)
+		{
+			return;
+		}
+
+		mat->skinned = skinned;
+		mat->instanced = false;
+
+		render_queue::item item;
+		item.program = mat->get_program();
+		item.mat = mat.get();
+		item.geometry = mesh.get();
+		item.group_id = group_id;
+		item.skinned = skinned;
+		item.params = params;
+		item.state = extra_states | mat->get_render_states(apply_cull, depth_write, depth_test);
+		queue.add(id, pass, item, depth, matrices, indices, matrix_count);
+	};
+
+	const auto& skin_data = mesh->get_skin_bind_data();
+
+	// Has skinning data?
+	if(skin_data.has_bones() && !skinning_transforms.empty())
+	{
+		// Process each palette in the skin with a matching attribute.
+		const auto& palettes = mesh->get_bone_palettes();
+		for(const auto& palette : palettes)
+		{
+			// Apply the bone palette.
+			const auto& bones = palette.get_bones();
+			if(!fits_palette(bones, skinning_transforms))
+			{
+				continue;
+			}
+
+			enqueue_subset(true, palette.get_data_group(), skinning_transforms.data(), bones.data(),
+						   static_cast<std::uint16_t>(bones.size()));
+
+		} // Next Palette
+	}
+	else
+	{
+		for(std::size_t i = 0; i < mesh->get_subset_count(); ++i)
+		{
+			enqueue_subset(false, std::uint32_t(i), &world_transform.get_matrix(), nullptr, 1);
 		}
 	}
 }
 
+void model::enqueue_instanced(render_queue& queue, gfx::view_id id, std::uint8_t pass,
+							  const gfx::instance_data_buffer& instances, std::uint32_t group_id,
+							  bool apply_cull, bool depth_write, bool depth_test, std::uint64_t extra_states,
+							  unsigned int lod, float depth) const
+{
+	const auto mesh = get_lod(lod);
+	if(!mesh)
+	{
+		return;
+	}
+
+	asset_handle<material> mat = get_material_for_group(group_id);
+	if(!mat)
+	{
+		return;
+	}
+
+	mat->skinned = false;
+	mat->instanced = true;
+
+	render_queue::item item;
+	item.program = mat->get_program();
+	item.mat = mat.get();
+	item.geometry = mesh.get();
+	item.group_id = group_id;
+	item.state = extra_states | mat->get_render_states(apply_cull, depth_write, depth_test);
+	queue.add(id, pass, item, depth, nullptr, nullptr, 0, &instances);
+
+	mat->instanced = false;
+}
+
 void model::recalulate_lod_limits()
 {
 	float upper_limit = 100.0f;
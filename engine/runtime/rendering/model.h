@@ -13,6 +13,7 @@
 class gpu_program;
 class mesh;
 class material;
+class render_queue;
 
 //-----------------------------------------------------------------------------
 //  Name : model (Class)
@@ -180,14 +181,50 @@ public:
 	/// <summary>
 	/// Draws a mesh with a given program. If program is nullptr then the
 	/// materials are used instead. Extra states can be added to the material
-	/// ones.
+	/// ones. The skinning transforms hold one matrix per bind bone of the
+	/// skin, the bone palettes pick theirs from it.
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	void render(gfx::view_id id, const math::transform& world_transform,
-				const std::vector<math::transform>& bone_transforms, bool apply_cull, bool depth_write,
+				const std::vector<math::transform::mat4_t>& skinning_transforms, bool apply_cull, bool depth_write,
 				bool depth_test, std::uint64_t extra_states, unsigned int lod, gpu_program* user_program,
 				std::function<void(gpu_program&)> setup_params) const;
 
+	//-----------------------------------------------------------------------------
+	//  Name : supports_instancing ()
+	/// <summary>
+	/// Checks whether the lod can be drawn through enqueue_instanced, i.e. it
+	/// is not skinned and all of its materials have an instanced program.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool supports_instancing(unsigned int lod) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : enqueue ()
+	/// <summary>
+	/// Adds the subsets of a lod to a render queue instead of submitting
+	/// them directly. The params are written to the params uniform of the
+	/// queue.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void enqueue(render_queue& queue, gfx::view_id id, std::uint8_t pass, const math::transform& world_transform,
+				 const std::vector<math::transform::mat4_t>& skinning_transforms, bool apply_cull,
+				 bool depth_write, bool depth_test, std::uint64_t extra_states, unsigned int lod,
+				 const math::vec4& params, float depth) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : enqueue_instanced ()
+	/// <summary>
+	/// Adds one subset of a lod drawn for every instance in the buffer to a
+	/// render queue. Each instance holds its world matrix followed by its lod
+	/// params.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void enqueue_instanced(render_queue& queue, gfx::view_id id, std::uint8_t pass,
+						   const gfx::instance_data_buffer& instances, std::uint32_t group_id, bool apply_cull,
+						   bool depth_write, bool depth_test, std::uint64_t extra_states, unsigned int lod,
+						   float depth) const;
+
 private:
 	void recalulate_lod_limits();
 	/// Collection of all materials for this model.
@@ -0,0 +1,267 @@
+#include "render_queue.h"
+#include "gpu_program.h"
+#include "material.h"
+#include "mesh.h"
+
+#include <cstring>
+
+std::uint64_t render_queue::make_key(gfx::view_id view, std::uint8_t pass, std::uint16_t program,
+									 std::uint16_t mat, float depth, std::uint16_t geometry)
+{
+	// | view 8 | pass 4 | program 12 | material 12 | depth 16 | mesh 12 |
+	// Positive floats compare the same as their bit patterns so the top bits
+	// are a coarse but ordered depth.
+	std::uint32_t depth_bits = 0;
+	depth = depth > 0.0f ? depth : 0.0f;
+	std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+	std::uint64_t key = 0;
+	key |= std::uint64_t(view & 0xff) << 56;
+	key |= std::uint64_t(pass & 0xf) << 52;
+	key |= std::uint64_t(program & 0xfff) << 40;
+	key |= std::uint64_t(mat & 0xfff) << 28;
+	key |= std::uint64_t(depth_bits >> 16) << 12;
+	key |= std::uint64_t(geometry & 0xfff);
+	return key;
+}
+
+void render_queue::begin_frame()
+{
+	last_frame_stats_ = frame_stats_;
+	frame_stats_ = {};
+}
+
+void render_queue::set_params_uniform(const gfx::uniform_id& id)
+{
+	params_uniform_ = id;
+	has_params_uniform_ = true;
+}
+
+std::uint16_t render_queue::get_id(std::unordered_map<const void*, std::uint16_t>& ids, const void* ptr)
+{
+	auto it = ids.find(ptr);
+	if(it != ids.end())
+	{
+		return it->second;
+	}
+
+	const auto id = static_cast<std::uint16_t>(ids.size());
+	ids.emplace(ptr, id);
+	return id;
+}
+
+void render_queue::add(gfx::view_id view, std::uint8_t pass, const item& draw, float depth,
+					   const math::transform::mat4_t* matrices, const std::uint32_t* indices,
+					   std::uint16_t matrix_count, const gfx::instance_data_buffer* instances)
+{
+	if(draw.program == nullptr || draw.geometry == nullptr)
+	{
+		return;
+	}
+
+	entry e;
+	e.view = view;
+	e.draw = draw;
+	e.draw.first_matrix = static_cast<std::uint32_t>(matrices_.size());
+	e.draw.matrix_count = 0;
+	e.draw.instances = -1;
+	if(instances != nullptr)
+	{
+		e.draw.instances = static_cast<std::int32_t>(instances_.size());
+		instances_.emplace_back(*instances);
+	}
+	else if(matrices != nullptr)
+	{
+		e.draw.matrix_count = matrix_count;
+		if(indices != nullptr)
+		{
+			for(std::uint16_t i = 0; i < matrix_count; ++i)
+			{
+				matrices_.emplace_back(matrices[indices[i]]);
+			}
+		}
+		else
+		{
+			matrices_.insert(std::end(matrices_), matrices, matrices + matrix_count);
+		}
+	}
+
+	sort_entry key;
+	key.index = static_cast<std::uint32_t>(items_.size());
+	key.key = make_key(view, pass, draw.program->native_handle().idx, get_id(material_ids_, draw.mat), depth,
+					   get_id(mesh_ids_, draw.geometry));
+
+	items_.emplace_back(e);
+	keys_.emplace_back(key);
+}
+
+void render_queue::sort()
+{
+	// Least significant digit radix sort, one byte per pass. Passes where
+	// every key has the same byte are skipped since they keep the order.
+	scratch_.resize(keys_.size());
+	for(unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		std::size_t counts[256] = {};
+		for(const auto& k : keys_)
+		{
+			++counts[(k.key >> shift) & 0xff];
+		}
+
+		if(counts[(keys_.front().key >> shift) & 0xff] == keys_.size())
+		{
+			continue;
+		}
+
+		std::size_t offset = 0;
+		for(auto& count : counts)
+		{
+			const auto c = count;
+			count = offset;
+			offset += c;
+		}
+
+		for(const auto& k : keys_)
+		{
+			scratch_[counts[(k.key >> shift) & 0xff]++] = k;
+		}
+		keys_.swap(scratch_);
+	}
+}
+
+void render_queue::flush(std::function<void(gpu_program&)> setup_program)
+{
+	if(items_.empty())
+	{
+		return;
+	}
+
+	sort();
+
+	// Render passes execute their draws in submission order, so the order of
+	// the keys is kept and uniforms set by an earlier draw are still current.
+	gpu_program* last_program = nullptr;
+	const item* last = nullptr;
+	bool preserved = false;
+	bool params_valid = false;
+	math::vec4 last_params;
+
+	for(std::size_t i = 0; i < keys_.size(); ++i)
+	{
+		const auto& e = items_[keys_[i].index];
+		const auto& draw = e.draw;
+
+		if(draw.program != last_program)
+		{
+			if(last_program != nullptr)
+			{
+				last_program->end();
+			}
+
+			last_program = draw.program;
+			last = nullptr;
+			params_valid = false;
+			if(!draw.program->begin())
+			{
+				last_program = nullptr;
+				preserved = false;
+				continue;
+			}
+
+			if(setup_program)
+			{
+				setup_program(*draw.program);
+			}
+			++frame_stats_.program_changes;
+		}
+		else
+		{
+			++frame_stats_.skipped_program_binds;
+		}
+
+		// Textures are part of the draw state which is only kept when the
+		// previous draw asked for it.
+		const bool same_material = preserved && last != nullptr && last->mat == draw.mat &&
+								   last->skinned == draw.skinned && last->instances < 0 &&
+								   draw.instances < 0;
+		if(!same_material)
+		{
+			if(draw.mat != nullptr)
+			{
+				draw.mat->skinned = draw.skinned;
+				draw.mat->instanced = draw.instances >= 0;
+				draw.mat->submit();
+				draw.mat->instanced = false;
+			}
+			++frame_stats_.material_changes;
+		}
+		else
+		{
+			++frame_stats_.skipped_material_binds;
+		}
+
+		if(has_params_uniform_)
+		{
+			if(!params_valid || last_params != draw.params)
+			{
+				draw.program->set_uniform(params_uniform_, draw.params);
+				last_params = draw.params;
+				params_valid = true;
+				++frame_stats_.uniform_changes;
+			}
+			else
+			{
+				++frame_stats_.skipped_uniform_binds;
+			}
+		}
+
+		if(!same_material || last->geometry != draw.geometry || last->group_id != draw.group_id)
+		{
+			draw.geometry->bind_render_buffers_for_subset(draw.group_id);
+			++frame_stats_.mesh_changes;
+		}
+		else
+		{
+			++frame_stats_.skipped_mesh_binds;
+		}
+
+		if(draw.matrix_count > 0)
+		{
+			gfx::set_transform(&matrices_[draw.first_matrix], draw.matrix_count);
+		}
+
+		if(draw.instances >= 0)
+		{
+			const auto& instances = instances_[std::size_t(draw.instances)];
+			gfx::set_instance_data_buffer(&instances, 0, instances.num);
+		}
+
+		gfx::set_state(draw.state);
+
+		// Keep the bindings for the next draw when it can reuse them.
+		preserved = false;
+		if(draw.instances < 0 && i + 1 < keys_.size())
+		{
+			const auto& next = items_[keys_[i + 1].index];
+			preserved = next.view == e.view && next.draw.program == draw.program &&
+						next.draw.mat == draw.mat && next.draw.skinned == draw.skinned &&
+						next.draw.instances < 0;
+		}
+
+		gfx::submit(e.view, draw.program->native_handle(), 0, preserved);
+		++frame_stats_.draws;
+		last = &draw;
+	}
+
+	if(last_program != nullptr)
+	{
+		last_program->end();
+	}
+
+	items_.clear();
+	keys_.clear();
+	matrices_.clear();
+	instances_.clear();
+	material_ids_.clear();
+	mesh_ids_.clear();
+}
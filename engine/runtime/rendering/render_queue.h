@@ -0,0 +1,158 @@
+#pragma once
+
+#include <core/graphics/graphics.h>
+#include <core/graphics/uniform.h>
+#include <core/math/math_includes.h>
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class gpu_program;
+class material;
+class mesh;
+
+//-----------------------------------------------------------------------------
+//  Name : render_queue_stats (Struct)
+/// <summary>
+/// State changes done by the render queue. Binds that were skipped because
+/// the previous draw already had them are counted separately.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct render_queue_stats
+{
+	std::uint32_t draws = 0;
+	std::uint32_t program_changes = 0;
+	std::uint32_t material_changes = 0;
+	std::uint32_t mesh_changes = 0;
+	std::uint32_t uniform_changes = 0;
+	std::uint32_t skipped_program_binds = 0;
+	std::uint32_t skipped_material_binds = 0;
+	std::uint32_t skipped_mesh_binds = 0;
+	std::uint32_t skipped_uniform_binds = 0;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : render_queue (Class)
+/// <summary>
+/// Collects draws and submits them ordered by a 64 bit key made of the
+/// view, pass, program, material, depth and mesh so that consecutive draws
+/// share as much state as possible. Programs, materials, meshes and the per
+/// draw params are only bound when they differ from the previous draw.
+/// </summary>
+//-----------------------------------------------------------------------------
+class render_queue
+{
+public:
+	struct item
+	{
+		gpu_program* program = nullptr;
+		material* mat = nullptr;
+		mesh* geometry = nullptr;
+		std::uint32_t group_id = 0;
+		/// Range in the matrices of the queue.
+		std::uint32_t first_matrix = 0;
+		std::uint16_t matrix_count = 0;
+		/// Index in the instance buffers of the queue or -1.
+		std::int32_t instances = -1;
+		std::uint64_t state = 0;
+		/// Value of the params uniform of the queue.
+		math::vec4 params;
+		bool skinned = false;
+	};
+
+	//-----------------------------------------------------------------------------
+	//  Name : make_key ()
+	/// <summary>
+	/// Packs the sort key. The depth is any positive value, smaller values
+	/// are drawn first.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static std::uint64_t make_key(gfx::view_id view, std::uint8_t pass, std::uint16_t program,
+								  std::uint16_t mat, float depth, std::uint16_t geometry);
+
+	//-----------------------------------------------------------------------------
+	//  Name : begin_frame ()
+	/// <summary>
+	/// Keeps the stats of the last frame and starts counting from zero.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void begin_frame();
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_params_uniform ()
+	/// <summary>
+	/// Name of the uniform the params of every item are written to.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_params_uniform(const gfx::uniform_id& id);
+
+	//-----------------------------------------------------------------------------
+	//  Name : add ()
+	/// <summary>
+	/// Adds a draw with the specified transforms. When indices is not null
+	/// the transforms are matrices[indices[0]] ... matrices[indices[count - 1]].
+	/// Instances are taken instead of the transforms when not null.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void add(gfx::view_id view, std::uint8_t pass, const item& draw, float depth,
+			 const math::transform::mat4_t* matrices, const std::uint32_t* indices, std::uint16_t matrix_count,
+			 const gfx::instance_data_buffer* instances = nullptr);
+
+	//-----------------------------------------------------------------------------
+	//  Name : flush ()
+	/// <summary>
+	/// Sorts and submits every added draw and empties the queue. The setup
+	/// callback is called each time a different program starts being used.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void flush(std::function<void(gpu_program&)> setup_program);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_stats ()
+	/// <summary>
+	/// Stats of the last completed frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const render_queue_stats& get_stats() const
+	{
+		return last_frame_stats_;
+	}
+
+	std::size_t size() const
+	{
+		return items_.size();
+	}
+
+private:
+	std::uint16_t get_id(std::unordered_map<const void*, std::uint16_t>& ids, const void* ptr);
+	void sort();
+
+	struct entry
+	{
+		gfx::view_id view = 0;
+		item draw;
+	};
+
+	struct sort_entry
+	{
+		std::uint64_t key = 0;
+		std::uint32_t index = 0;
+	};
+
+	/// Draws added since the last flush.
+	std::vector<entry> items_;
+	/// Keys of the items, sorted by flush.
+	std::vector<sort_entry> keys_;
+	std::vector<sort_entry> scratch_;
+	std::vector<math::transform::mat4_t> matrices_;
+	std::vector<gfx::instance_data_buffer> instances_;
+	/// Small ids used in the sort keys.
+	std::unordered_map<const void*, std::uint16_t> material_ids_;
+	std::unordered_map<const void*, std::uint16_t> mesh_ids_;
+	gfx::uniform_id params_uniform_{""};
+	bool has_params_uniform_ = false;
+	render_queue_stats frame_stats_;
+	render_queue_stats last_frame_stats_;
+};
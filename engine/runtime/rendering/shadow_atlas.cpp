@@ -0,0 +1,147 @@
+#include "shadow_atlas.h"
+
+#include <algorithm>
+
+namespace
+{
+std::uint32_t next_power_of_two(std::uint32_t value)
+{
+	std::uint32_t result = 1;
+	while(result < value)
+	{
+		result <<= 1;
+	}
+	return result;
+}
+}
+
+shadow_atlas::shadow_atlas(std::uint16_t size, std::uint16_t min_tile_size)
+{
+	const auto atlas_size = next_power_of_two(std::max<std::uint32_t>(size, 1));
+	auto tile_size = std::min(next_power_of_two(std::max<std::uint32_t>(min_tile_size, 1)), atlas_size);
+	size_ = static_cast<std::uint16_t>(atlas_size);
+
+	std::uint32_t node_count = 0;
+	std::uint32_t level_nodes = 1;
+	for(auto level_size = atlas_size; level_size >= tile_size; level_size >>= 1)
+	{
+		node_count += level_nodes;
+		level_nodes *= 4;
+		++levels_;
+	}
+	nodes_.resize(node_count, node_state::free);
+}
+
+shadow_atlas::tile shadow_atlas::allocate(std::uint16_t size)
+{
+	tile result;
+	if(size == 0 || size > size_)
+	{
+		return result;
+	}
+
+	// The deepest level whose tiles still fit the request.
+	std::uint32_t target_level = 0;
+	while(target_level + 1 < levels_ && (size_ >> (target_level + 1)) >= size)
+	{
+		++target_level;
+	}
+
+	allocate(0, 0, target_level, 0, 0, result);
+	return result;
+}
+
+bool shadow_atlas::allocate(std::uint32_t node, std::uint32_t level, std::uint32_t target_level,
+							std::uint16_t x, std::uint16_t y, tile& result)
+{
+	auto& state = nodes_[node];
+	if(state == node_state::used)
+	{
+		return false;
+	}
+
+	const auto node_size = static_cast<std::uint16_t>(size_ >> level);
+	if(level == target_level)
+	{
+		if(state != node_state::free)
+		{
+			return false;
+		}
+
+		state = node_state::used;
+		result.x = x;
+		result.y = y;
+		result.size = node_size;
+		return true;
+	}
+
+	state = node_state::split;
+	const auto half = static_cast<std::uint16_t>(node_size / 2);
+	const std::uint32_t first_child = node * 4 + 1;
+	for(std::uint32_t i = 0; i < 4; ++i)
+	{
+		const auto child_x = static_cast<std::uint16_t>(x + (i & 1) * half);
+		const auto child_y = static_cast<std::uint16_t>(y + (i >> 1) * half);
+		if(allocate(first_child + i, level + 1, target_level, child_x, child_y, result))
+		{
+			return true;
+		}
+	}
+
+	// Nothing fit, undo the split if it was done for this request.
+	const bool children_free = std::all_of(&nodes_[first_child], &nodes_[first_child] + 4,
+										   [](node_state s) { return s == node_state::free; });
+	if(children_free)
+	{
+		state = node_state::free;
+	}
+	return false;
+}
+
+void shadow_atlas::release(const tile& t)
+{
+	if(!t.is_valid())
+	{
+		return;
+	}
+
+	// Walk down to the node of the tile.
+	std::uint32_t node = 0;
+	std::uint16_t node_size = size_;
+	std::uint16_t x = 0;
+	std::uint16_t y = 0;
+	while(node_size > t.size)
+	{
+		node_size = static_cast<std::uint16_t>(node_size / 2);
+		const std::uint32_t i = (t.x >= x + node_size ? 1u : 0u) + (t.y >= y + node_size ? 2u : 0u);
+		x = static_cast<std::uint16_t>(x + (i & 1) * node_size);
+		y = static_cast<std::uint16_t>(y + (i >> 1) * node_size);
+		node = node * 4 + 1 + i;
+		if(node >= nodes_.size())
+		{
+			return;
+		}
+	}
+
+	nodes_[node] = node_state::free;
+
+	// Merge free siblings back into their parent.
+	while(node != 0)
+	{
+		const std::uint32_t parent = (node - 1) / 4;
+		const std::uint32_t first_child = parent * 4 + 1;
+		const bool children_free = std::all_of(&nodes_[first_child], &nodes_[first_child] + 4,
+											   [](node_state s) { return s == node_state::free; });
+		if(!children_free)
+		{
+			break;
+		}
+		nodes_[parent] = node_state::free;
+		node = parent;
+	}
+}
+
+void shadow_atlas::clear()
+{
+	std::fill(std::begin(nodes_), std::end(nodes_), node_state::free);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+//  Name : shadow_atlas (Class)
+/// <summary>
+/// Hands out square tiles of a square shadow map. Tile sizes are powers of
+/// two and the free space is kept as a quadtree, so released tiles merge
+/// back into bigger ones.
+/// </summary>
+//-----------------------------------------------------------------------------
+class shadow_atlas
+{
+public:
+	struct tile
+	{
+		/// Top left corner in texels.
+		std::uint16_t x = 0;
+		std::uint16_t y = 0;
+		/// Zero for no tile.
+		std::uint16_t size = 0;
+
+		bool is_valid() const
+		{
+			return size != 0;
+		}
+	};
+
+	//-----------------------------------------------------------------------------
+	//  Name : shadow_atlas ()
+	/// <summary>
+	/// Both sizes are rounded up to a power of two.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	shadow_atlas(std::uint16_t size, std::uint16_t min_tile_size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : allocate ()
+	/// <summary>
+	/// Reserves a tile of at least the requested size. Returns an invalid
+	/// tile when there is no room left.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	tile allocate(std::uint16_t size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : release ()
+	/// <summary>
+	/// Gives back a tile returned by allocate.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void release(const tile& t);
+
+	//-----------------------------------------------------------------------------
+	//  Name : clear ()
+	/// <summary>
+	/// Releases every tile.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void clear();
+
+	std::uint16_t get_size() const
+	{
+		return size_;
+	}
+
+private:
+	enum class node_state : std::uint8_t
+	{
+		free,
+		split,
+		used
+	};
+
+	bool allocate(std::uint32_t node, std::uint32_t level, std::uint32_t target_level, std::uint16_t x,
+				  std::uint16_t y, tile& result);
+
+	/// Quadtree stored level by level, the children of node i are at
+	/// 4 * i + 1 to 4 * i + 4.
+	std::vector<node_state> nodes_;
+	std::uint16_t size_ = 0;
+	std::uint32_t levels_ = 0;
+};
@@ -3,7 +3,15 @@
 #include "events.h"
 
 #include "../assets/asset_manager.h"
+#include "../ecs/components/animation_component.h"
+#include "../ecs/components/audio_listener_component.h"
+#include "../ecs/components/audio_source_component.h"
+#include "../ecs/components/camera_component.h"
+#include "../ecs/components/model_component.h"
+#include "../ecs/components/reflection_probe_component.h"
+#include "../ecs/components/transform_component.h"
 #include "../ecs/ecs.h"
+#include "../ecs/systems/animation_system.h"
 #include "../ecs/systems/audio_system.h"
 #include "../ecs/systems/bone_system.h"
 #include "../ecs/systems/camera_system.h"
@@ -15,11 +23,13 @@
 #include "../rendering/renderer.h"
 
 #include <core/audio/library.h>
+#include <core/filesystem/filesystem_pack.h>
 #include <core/logging/logging.h>
 #include <core/serialization/serialization.h>
 #include <core/simulation/simulation.h>
 #include <core/tasks/task_system.h>
 
+#include <limits>
 #include <sstream>
 
 namespace runtime
@@ -46,6 +56,7 @@ void app::setup(cmd_line::parser& parser)
 
 	parser.set_optional<std::string>("r", "renderer", "auto", "Select preferred renderer.");
 	parser.set_optional<bool>("n", "novsync", false, "Disable vsync.");
+	parser.set_optional<std::string>("p", "pack", "", "Mount a packed asset archive.");
 }
 
 void app::start(cmd_line::parser& parser)
@@ -58,17 +69,72 @@ void app::start(cmd_line::parser& parser)
 	core::add_subsystem<asset_manager>();
 	core::add_subsystem<core::task_system>(false);
 	setup_asset_manager();
+
+	std::string pack;
+	if(parser.try_get("pack", pack) && !pack.empty())
+	{
+		fs::error_code err;
+		if(!fs::mount_pack(pack, err))
+		{
+			APPLOG_ERROR("Failed to mount pack {0} : {1}", pack, err.message());
+		}
+	}
+
 	core::add_subsystem<entity_component_system>();
+	core::add_subsystem<animation_system>();
 	core::add_subsystem<scene_graph>();
 	core::add_subsystem<bone_system>();
 	core::add_subsystem<camera_system>();
 	core::add_subsystem<reflection_probe_system>();
 	core::add_subsystem<deferred_rendering>();
 	core::add_subsystem<audio_system>();
+
+	build_update_graph();
 }
 
 void app::stop()
 {
+	update_graph_.clear();
+}
+
+void app::build_update_graph()
+{
+	// Stands for the set of entities and components itself. Creating
+	// entities writes it, every other node reads it.
+	const auto structure = std::numeric_limits<core::task_graph::resource_id_t>::max();
+	const auto with_structure = [structure](std::vector<core::task_graph::resource_id_t> ids) {
+		ids.emplace_back(structure);
+		return ids;
+	};
+
+	auto& animation = core::get_subsystem<animation_system>();
+	auto& graph = core::get_subsystem<scene_graph>();
+	auto& bones = core::get_subsystem<bone_system>();
+	auto& cameras = core::get_subsystem<camera_system>();
+	auto& probes = core::get_subsystem<reflection_probe_system>();
+	auto& audio = core::get_subsystem<audio_system>();
+
+	update_graph_.clear();
+	update_graph_.add_node("animation", with_structure(ecs::component_ids<animation_component>()),
+						   ecs::component_ids<animation_component, transform_component>(),
+						   [this, &animation]() { animation.frame_update(frame_dt_); });
+	update_graph_.add_node("scene_graph", with_structure({}), ecs::component_ids<transform_component>(),
+						   [this, &graph]() { graph.frame_update(frame_dt_); });
+	// Creates the bone entities of new skinned models.
+	update_graph_.add_node("bones", ecs::component_ids<transform_component>(),
+						   with_structure(ecs::component_ids<model_component>()),
+						   [this, &bones]() { bones.frame_update(frame_dt_); }, true);
+	// Cameras and probes release render targets of unused views, the gpu
+	// handles must be destroyed by the thread that owns the renderer.
+	update_graph_.add_node("cameras", with_structure(ecs::component_ids<transform_component>()),
+						   ecs::component_ids<camera_component>(),
+						   [this, &cameras]() { cameras.frame_update(frame_dt_); }, true);
+	update_graph_.add_node("reflection_probes", with_structure({}),
+						   ecs::component_ids<reflection_probe_component>(),
+						   [this, &probes]() { probes.frame_update(frame_dt_); }, true);
+	update_graph_.add_node("audio", with_structure(ecs::component_ids<transform_component>()),
+						   ecs::component_ids<audio_source_component, audio_listener_component>(),
+						   [this, &audio]() { audio.frame_update(frame_dt_); });
 }
 
 void poll_events()
@@ -117,6 +183,8 @@ void app::run_one_frame()
 	auto& renderer = core::get_subsystem<runtime::renderer>();
 	const bool is_active = renderer.get_focused_window() != nullptr;
 	sim.run_one_frame(is_active);
+	// What changed during the previous frame is what the systems see now.
+	core::get_subsystem<entity_component_system>().advance_changes();
 	tasks.run_on_owner_thread(5ms);
 
 	auto dt = sim.get_delta_time();
@@ -138,6 +206,14 @@ void app::run_one_frame()
 
 	on_frame_update(dt);
 
+	// The systems run after the listeners so that what they moved this
+	// frame is resolved this frame.
+	frame_dt_ = dt;
+	update_graph_.run(tasks);
+
+	// Sync point for the structural changes recorded on other threads.
+	core::get_subsystem<entity_component_system>().playback_commands();
+
 	on_frame_render(dt);
 
 	on_frame_ui_render(dt);
@@ -3,6 +3,7 @@
 #include <core/cmd_line/parser.hpp>
 #include <core/common/basetypes.hpp>
 #include <core/system/subsystem.h>
+#include <core/tasks/task_graph.h>
 
 namespace runtime
 {
@@ -68,6 +69,19 @@ struct app
 	void quit(int exitcode = 0);
 
 protected:
+	//-----------------------------------------------------------------------------
+	//  Name : build_update_graph ()
+	/// <summary>
+	/// Declares what the update of every ecs system reads and writes so that
+	/// the ones which do not conflict run at the same time.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void build_update_graph();
+
+	/// Per frame update of the ecs systems.
+	core::task_graph update_graph_;
+	/// Delta time of the frame the graph runs for.
+	delta_t frame_dt_ = delta_t::zero();
 	/// exit code of the application
 	int exitcode_ = 0;
 	bool running_ = true;
@@ -0,0 +1,82 @@
+$input v_texcoord0
+
+#include "fs_pbr_lighting.sh"
+
+SAMPLER2D(s_tex8, 8); // first light index and light count of every cluster
+SAMPLER2D(s_tex9, 9); // light indices
+SAMPLER2D(s_tex10, 10); // light data
+
+uniform vec4 u_cluster_view[4]; // camera x, y and z axis, camera position
+uniform vec4 u_cluster_projection; // x, y - view to screen scale, z - divide by depth
+uniform vec4 u_cluster_depth; // x - slice scale, y - slice bias, z - near clip, w - far clip
+
+// must match light_clusters
+#define CLUSTER_TILES_X 16.0
+#define CLUSTER_TILES_Y 9.0
+#define CLUSTER_SLICES 24.0
+#define CLUSTER_MAX_LIGHTS 4096.0
+#define CLUSTER_INDEX_WIDTH 1024.0
+#define CLUSTER_INDEX_HEIGHT 64.0
+#define CLUSTER_MAX_LIGHTS_PER_CLUSTER 256
+
+vec2 cluster_of(vec3 world_position)
+{
+	vec3 to_surface = world_position - u_cluster_view[3].xyz;
+	vec3 view_position = vec3(dot(to_surface, u_cluster_view[0].xyz), dot(to_surface, u_cluster_view[1].xyz), dot(to_surface, u_cluster_view[2].xyz));
+	float depth = clamp(view_position.z, u_cluster_depth.z, u_cluster_depth.w);
+	vec2 screen = view_position.xy * u_cluster_projection.xy;
+	if(u_cluster_projection.z > 0.5)
+	{
+		screen = screen / depth;
+	}
+
+	vec2 tile = clamp(floor((screen * 0.5 + 0.5) * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y)), vec2_splat(0.0), vec2(CLUSTER_TILES_X - 1.0, CLUSTER_TILES_Y - 1.0));
+	float slice = clamp(floor(log(depth) * u_cluster_depth.x + u_cluster_depth.y), 0.0, CLUSTER_SLICES - 1.0);
+	vec2 uv = (vec2(tile.x + tile.y * CLUSTER_TILES_X, slice) + 0.5) / vec2(CLUSTER_TILES_X * CLUSTER_TILES_Y, CLUSTER_SLICES);
+	return texture2DLod(s_tex8, uv, 0.0).xy;
+}
+
+void main()
+{
+	GBufferData data = decodeGBuffer(v_texcoord0, s_tex0, s_tex1, s_tex2, s_tex3, s_tex4);
+	vec3 indirect_specular = texture2D(s_tex5, v_texcoord0).xyz;
+	vec3 clip = vec3(v_texcoord0 * 2.0 - 1.0, data.depth);
+	clip = clipTransform(clip);
+	vec3 world_position = clipToWorld(u_invViewProj, clip);
+
+	vec2 cluster = cluster_of(world_position);
+	vec3 lighting = vec3_splat(0.0);
+	for(int i = 0; i < CLUSTER_MAX_LIGHTS_PER_CLUSTER; ++i)
+	{
+		if(float(i) >= cluster.y)
+		{
+			break;
+		}
+
+		float index = cluster.x + float(i);
+		vec2 index_uv = (vec2(mod(index, CLUSTER_INDEX_WIDTH), floor(index / CLUSTER_INDEX_WIDTH)) + 0.5) / vec2(CLUSTER_INDEX_WIDTH, CLUSTER_INDEX_HEIGHT);
+		float light_v = (texture2DLod(s_tex9, index_uv, 0.0).x + 0.5) / CLUSTER_MAX_LIGHTS;
+
+		// four texels per light, see cluster_light
+		vec4 position_range = texture2DLod(s_tex10, vec2(0.125, light_v), 0.0);
+		vec4 color_intensity = texture2DLod(s_tex10, vec2(0.375, light_v), 0.0);
+		vec4 direction_type = texture2DLod(s_tex10, vec2(0.625, light_v), 0.0);
+		vec4 light_data = texture2DLod(s_tex10, vec2(0.875, light_v), 0.0);
+
+		vec3 vector_to_light = position_range.xyz - world_position;
+		vec3 vector_to_light_over_radius = vector_to_light / position_range.w;
+		float light_mask = 1.0;
+		if(direction_type.w > 0.5)
+		{
+			light_mask = RadialAttenuation(vector_to_light_over_radius, 1.0f) * SpotAttenuation(vector_to_light_over_radius, direction_type.xyz, vec2(light_data.y, 1.0f / (light_data.x - light_data.y)));
+		}
+		else
+		{
+			light_mask = RadialAttenuation(vector_to_light_over_radius, light_data.x);
+		}
+
+		lighting += pbr_shade(data, world_position, indirect_specular, vector_to_light, color_intensity.xyz, color_intensity.w, light_mask, 1.0, 0.0);
+	}
+
+	gl_FragColor = vec4(lighting, 1.0);
+}
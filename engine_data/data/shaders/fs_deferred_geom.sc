@@ -1,4 +1,4 @@
-$input v_wpos, v_pos, v_wnormal, v_wtangent, v_wbitangent, v_texcoord0
+$input v_wpos, v_pos, v_wnormal, v_wtangent, v_wbitangent, v_texcoord0, v_lod_params
 
 #include "common.sh"
 #include "lighting.sh"
@@ -20,7 +20,6 @@ uniform vec4 u_emissive_color;
 uniform vec4 u_surface_data;
 uniform vec4 u_tiling;
 uniform vec4 u_dither_threshold; //.x = alpha threshold .y = distance threshold
-uniform vec4 u_lod_params;
 
 void main()
 {
@@ -47,7 +46,7 @@ void main()
 
 	if((albedo_color.a + (dither * (1.0f - alpha_test_value)) < 1.0f) ||
 	(distance_factor + dither < 1.0f) ||
-	(u_lod_params.x - dither * u_lod_params.y) > u_lod_params.z)
+	(v_lod_params.x - dither * v_lod_params.y) > v_lod_params.z)
 	{
 		discard;
 	}
@@ -11,12 +11,105 @@ SAMPLER2D(s_tex3, 3);
 SAMPLER2D(s_tex4, 4);
 SAMPLER2D(s_tex5, 5); // reflection data
 SAMPLER2D(s_tex6, 6); // ibl_brdf_lut
+SAMPLER2D(s_tex7, 7); // shadow atlas
 
 uniform vec4 u_light_position;
 uniform vec4 u_light_direction;
 uniform vec4 u_light_color_intensity;
 uniform vec4 u_light_data;
 uniform vec4 u_camera_position;
+uniform mat4 u_shadow_matrix[6];
+uniform vec4 u_shadow_rects[6];
+uniform vec4 u_shadow_params; // x - map count, y - depth bias, z - atlas texel size, w - filter
+uniform vec4 u_shadow_splits;
+
+float shadow_map_index(vec3 world_position)
+{
+#if DIRECTIONAL_LIGHT
+	// cascades are picked by the distance from the camera
+	float view_distance = distance(world_position, u_camera_position.xyz);
+	return dot(step(u_shadow_splits, vec4_splat(view_distance)), vec4_splat(1.0));
+#elif POINT_LIGHT
+	// one map per axis, +x -x +y -y +z -z
+	vec3 light_to_surface = world_position - u_light_position.xyz;
+	vec3 axis_distance = abs(light_to_surface);
+	if(axis_distance.x >= axis_distance.y && axis_distance.x >= axis_distance.z)
+	{
+		return light_to_surface.x > 0.0 ? 0.0 : 1.0;
+	}
+	if(axis_distance.y >= axis_distance.z)
+	{
+		return light_to_surface.y > 0.0 ? 2.0 : 3.0;
+	}
+	return light_to_surface.z > 0.0 ? 4.0 : 5.0;
+#else
+	return 0.0;
+#endif
+}
+
+float shadow_visibility(vec3 world_position)
+{
+	float index = shadow_map_index(world_position);
+	if(index >= u_shadow_params.x)
+	{
+		return 1.0;
+	}
+
+	int map = int(index);
+	vec4 coord = mul(u_shadow_matrix[map], vec4(world_position, 1.0));
+	coord.xyz = coord.xyz / coord.w;
+	vec4 rect = u_shadow_rects[map];
+	float depth = coord.z - u_shadow_params.y;
+
+	if(u_shadow_params.w < 0.5)
+	{
+		return step(depth, texture2D(s_tex7, clamp(coord.xy, rect.xy, rect.zw)).x);
+	}
+
+	// 3x3 pcf, kept inside the tile of the map
+	float lit = 0.0;
+	for(int y = -1; y <= 1; ++y)
+	{
+		for(int x = -1; x <= 1; ++x)
+		{
+			vec2 uv = clamp(coord.xy + vec2(float(x), float(y)) * u_shadow_params.z, rect.xy, rect.zw);
+			lit += step(depth, texture2D(s_tex7, uv).x);
+		}
+	}
+	return lit / 9.0;
+}
+
+// Light a surface receives from one light, without its emissive color.
+// The mask is the falloff of the light over its range and cone.
+vec3 pbr_shade(GBufferData data, vec3 world_position, vec3 indirect_specular, vec3 vector_to_light, vec3 light_color, float intensity, float light_mask, float shadow, float ambient)
+{
+	vec3 lobe_roughness = vec3(0.0f, data.roughness, 1.0f);
+	vec3 specular_color = mix( 0.04f * light_color, data.base_color, data.metalness );
+	vec3 albedo_color = data.base_color - data.base_color * data.metalness;
+	vec3 indirect_diffuse = albedo_color * ambient;
+	float distance_sqr = dot( vector_to_light, vector_to_light );
+	vec3 N = data.world_normal;
+	vec3 V = normalize(u_camera_position.xyz - world_position);
+	vec3 L = vector_to_light / sqrt( distance_sqr );
+	float NoL = saturate( dot(N, L) );
+	float distance_attenuation = 1.0f;
+
+	float surface_shadow = shadow;
+	float subsurface_shadow = shadow;
+	float surface_attenuation = (intensity * distance_attenuation * light_mask) * surface_shadow;
+	float subsurface_attenuation = (distance_attenuation * light_mask) * subsurface_shadow;
+	
+	vec3 energy = AreaLightSpecular(0.0f, 0.0f, normalize(vector_to_light), lobe_roughness, vector_to_light, L, V, N);
+	SurfaceShading surface_lighting = StandardShading(albedo_color, indirect_diffuse, specular_color, indirect_specular, s_tex6, lobe_roughness, energy, data.metalness, data.ambient_occlusion, L, V, N);
+	vec3 direct_surface_lighting = surface_lighting.direct;
+	vec3 indirect_surface_lighting = surface_lighting.indirect;
+	//vec3 subsurface_lighting = SubsurfaceShadingTwoSided(data.subsurface_color, L, V, N);
+	vec3 subsurface_lighting = SubsurfaceShading(data.subsurface_color, data.subsurface_opacity, data.ambient_occlusion, L, V, N);
+	vec3 surface_multiplier = light_color * (NoL * surface_attenuation);
+	vec3 subsurface_multiplier = (light_color * subsurface_attenuation);
+	
+	return surface_multiplier * direct_surface_lighting + (subsurface_lighting + indirect_surface_lighting) * subsurface_multiplier;
+}
 
 vec4 pbr_light(vec2 texcoord0)
 {
@@ -25,24 +118,13 @@ vec4 pbr_light(vec2 texcoord0)
 	vec3 clip = vec3(texcoord0 * 2.0 - 1.0, data.depth);
 	clip = clipTransform(clip);
 	vec3 world_position = clipToWorld(u_invViewProj, clip);
-	vec3 lobe_roughness = vec3(0.0f, data.roughness, 1.0f);
-	vec3 light_color = u_light_color_intensity.xyz;
-	float intensity = u_light_color_intensity.w;
-	vec3 specular_color = mix( 0.04f * light_color, data.base_color, data.metalness );
-	vec3 albedo_color = data.base_color - data.base_color * data.metalness;
 #if DIRECTIONAL_LIGHT
 	vec3 vector_to_light = -u_light_direction.xyz;
-	vec3 indirect_diffuse = albedo_color * 0.1f;
+	float ambient = 0.1f;
 #else
 	vec3 vector_to_light = u_light_position.xyz - world_position;
-	vec3 indirect_diffuse = vec3(0.0f, 0.0f, 0.0f);
+	float ambient = 0.0f;
 #endif
-	float distance_sqr = dot( vector_to_light, vector_to_light );
-	vec3 N = data.world_normal;
-	vec3 V = normalize(u_camera_position.xyz - world_position);
-	vec3 L = vector_to_light / sqrt( distance_sqr );
-	float NoL = saturate( dot(N, L) );
-	float distance_attenuation = 1.0f;
 
 #if POINT_LIGHT
 	vec3 vector_to_light_over_radius = vector_to_light / u_light_data.x;
@@ -57,21 +139,8 @@ vec4 pbr_light(vec2 texcoord0)
 	float spot_falloff = 1.0f;
 #endif
 	
-	float surface_shadow = 1.0f;
-	float subsurface_shadow = 1.0f;
-	float surface_attenuation = (intensity * distance_attenuation * light_radius_mask * spot_falloff) * surface_shadow;
-	float subsurface_attenuation = (distance_attenuation * light_radius_mask * spot_falloff) * subsurface_shadow;
-	
-	vec3 energy = AreaLightSpecular(0.0f, 0.0f, normalize(vector_to_light), lobe_roughness, vector_to_light, L, V, N);
-	SurfaceShading surface_lighting = StandardShading(albedo_color, indirect_diffuse, specular_color, indirect_specular, s_tex6, lobe_roughness, energy, data.metalness, data.ambient_occlusion, L, V, N);
-	vec3 direct_surface_lighting = surface_lighting.direct;
-	vec3 indirect_surface_lighting = surface_lighting.indirect;
-	//vec3 subsurface_lighting = SubsurfaceShadingTwoSided(data.subsurface_color, L, V, N);
-	vec3 subsurface_lighting = SubsurfaceShading(data.subsurface_color, data.subsurface_opacity, data.ambient_occlusion, L, V, N);
-	vec3 surface_multiplier = light_color * (NoL * surface_attenuation);
-	vec3 subsurface_multiplier = (light_color * subsurface_attenuation);
-	
-	vec3 lighting = surface_multiplier * direct_surface_lighting + (subsurface_lighting + indirect_surface_lighting) * subsurface_multiplier + data.emissive_color;
+	float shadow = shadow_visibility(world_position);
+	vec3 lighting = pbr_shade(data, world_position, indirect_specular, vector_to_light, u_light_color_intensity.xyz, u_light_color_intensity.w, light_radius_mask * spot_falloff, shadow, ambient) + data.emissive_color;
 	
 	vec4 result;
 	result.xyz = lighting;
@@ -0,0 +1 @@
+vec4 v_pos       : TEXCOORD1 = vec4(0.0, 0.0, 0.0, 1.0);
\ No newline at end of file
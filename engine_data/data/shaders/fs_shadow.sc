@@ -0,0 +1,11 @@
+$input v_pos
+
+#include "common.sh"
+
+void main()
+{
+	// Depth goes to a color target which keeps the nearest value through
+	// min blending.
+	float depth = v_pos.z / v_pos.w;
+	gl_FragColor = vec4_splat(depth);
+}
@@ -9,4 +9,5 @@ vec3 v_pos       : TEXCOORD1 = vec3(0.0, 0.0, 0.0);
 vec3 v_wpos      : TEXCOORD2 = vec3(0.0, 0.0, 0.0);
 vec3 v_wnormal    : NORMAL    = vec3(0.0, 0.0, 1.0);
 vec3 v_wtangent   : TANGENT   = vec3(1.0, 0.0, 0.0);
-vec3 v_wbitangent : BITANGENT  = vec3(0.0, 1.0, 0.0);
\ No newline at end of file
+vec3 v_wbitangent : BITANGENT  = vec3(0.0, 1.0, 0.0);
+vec4 v_lod_params : TEXCOORD3 = vec4(0.0, -1.0, 1.0, 0.0);
\ No newline at end of file
@@ -1,9 +1,11 @@
 $input a_position, a_normal, a_tangent, a_bitangent, a_texcoord0, a_weight, a_indices
-$output v_wpos, v_pos, v_wnormal, v_wtangent, v_wbitangent, v_texcoord0
+$output v_wpos, v_pos, v_wnormal, v_wtangent, v_wbitangent, v_texcoord0, v_lod_params
 
 #define BGFX_CONFIG_MAX_BONES 128
 #include "common.sh"
 
+uniform vec4 u_lod_params;
+
 void main()
 {
 	//u_model should already be in the right space
@@ -34,5 +36,6 @@ void main()
 	v_wbitangent = wbitangent;
 
 	v_texcoord0 = a_texcoord0;
+	v_lod_params = u_lod_params;
 
 }
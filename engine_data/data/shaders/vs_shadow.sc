@@ -0,0 +1,12 @@
+$input a_position
+$output v_pos
+
+#include "common.sh"
+
+void main()
+{
+	vec3 wpos = mul(u_model[0], vec4(a_position, 1.0) ).xyz;
+	gl_Position = mul(u_viewProj, vec4(wpos, 1.0) );
+
+	v_pos = gl_Position;
+}
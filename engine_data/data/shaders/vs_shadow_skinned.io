@@ -0,0 +1,5 @@
+vec3 a_position  : POSITION;
+vec4 a_weight : BLENDWEIGHT;
+vec4 a_indices : BLENDINDICES;
+
+vec4 v_pos       : TEXCOORD1 = vec4(0.0, 0.0, 0.0, 1.0);
\ No newline at end of file